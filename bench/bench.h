@@ -0,0 +1,58 @@
+#ifndef LIBPT_BENCH_H
+#define LIBPT_BENCH_H
+
+/**
+ * \file bench.h
+ * \brief Helpers shared by the benchmarks (see bench/Makefile.am).
+ *
+ * A benchmark runs each measurement BENCH_NUM_RUNS times and keeps the
+ * fastest run, which filters out most of the noise caused by the other
+ * processes of the host.
+ */
+
+#include <time.h>    // clock_gettime
+#include <stdlib.h>  // strtoul
+
+#define BENCH_NUM_RUNS 7
+
+/**
+ * \return The current value of the monotonic clock (in seconds).
+ */
+
+static inline double bench_get_time() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * \brief Parse the sizes passed to a benchmark on the command line.
+ * \param argc The number of arguments (including the program name).
+ * \param argv The arguments.
+ * \param sizes An array of max_sizes elements. Its num_defaults first
+ *    elements are the default sizes, overwritten by the parsed ones.
+ * \param num_defaults The number of default sizes.
+ * \param max_sizes The capacity of the array.
+ * \return The number of sizes to consider, 0 if a size is invalid.
+ */
+
+static inline size_t bench_parse_sizes(int argc, char ** argv, size_t * sizes, size_t num_defaults, size_t max_sizes) {
+    size_t i;
+
+    if (argc <= 1) return num_defaults;
+    for (i = 0; i < (size_t) argc - 1 && i < max_sizes; i++) {
+        if ((sizes[i] = strtoul(argv[i + 1], NULL, 10)) == 0) return 0;
+    }
+    return i;
+}
+
+/**
+ * \brief Prevent the compiler from optimizing out a computation
+ *    whose result is not used.
+ * \param x The result of the computation.
+ */
+
+#define BENCH_KEEP(x) do { __asm__ __volatile__("" : : "g"(x) : "memory"); } while (0)
+
+#endif // LIBPT_BENCH_H
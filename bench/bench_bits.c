@@ -0,0 +1,115 @@
+/**
+ * \file bench_bits.c
+ * \brief Measure the time needed by bits_extract and bits_write (see
+ *    bits.h) to move fields of various widths, compared with their former
+ *    implementation (see tests/former_bits.h).
+ *
+ * Usage: bench_bits [num_bits@offset [num_bits@offset ...]]
+ *    Each field is made of num_bits bits starting at the given bit offset
+ *    (default: the fields of the IPv4, IPv6 and UDP headers listed below).
+ *    The timings are in ns per call.
+ */
+
+#include <stdlib.h>       // rand
+#include <stdio.h>        // printf, sscanf
+#include <stdint.h>       // uint8_t
+#include <stdbool.h>      // bool
+
+#include "bits.h"         // bits_extract, bits_write
+#include "former_bits.h"  // former_bits_extract, former_bits_write
+#include "bench.h"
+
+#define NUM_CALLS  4000000 // Calls per run
+#define MAX_FIELDS 16
+#define MAX_BYTES  64
+
+typedef struct {
+    const char * name;
+    size_t       num_bits;
+    size_t       offset_in_bits;
+} field_t;
+
+typedef enum {
+    BENCH_EXTRACT,
+    BENCH_FORMER_EXTRACT,
+    BENCH_WRITE,
+    BENCH_FORMER_WRITE
+} bench_mode_t;
+
+static field_t fields[MAX_FIELDS] = {
+    { "ipv4 ihl",          4,  4 },
+    { "ipv6 tclass",       8,  4 },
+    { "ipv6 flow label",  20, 12 },
+    { "ipv4 frag offset", 13,  3 },
+    { "udp port",         16,  0 },
+    { "ipv4 address",     32,  0 },
+    { "48 bits",          48,  5 }
+};
+
+/**
+ * \brief Measure the time needed to move a field.
+ * \param mode The function to call.
+ * \param field The field.
+ * \return The best time per call (in ns).
+ */
+
+static double bench(bench_mode_t mode, const field_t * field) {
+    uint8_t         packet[MAX_BYTES], value[MAX_BYTES];
+    // The former bits_write only supports offsets lower than 8 bits.
+    uint8_t       * bytes  = packet + field->offset_in_bits / 8;
+    size_t          offset = field->offset_in_bits % 8,
+                    i, run;
+    double          start, elapsed, best = 0;
+
+    for (i = 0; i < MAX_BYTES; i++) {
+        packet[i] = (uint8_t) rand();
+        value[i]  = (uint8_t) rand();
+    }
+
+    for (run = 0; run < BENCH_NUM_RUNS; run++) {
+        start = bench_get_time();
+        for (i = 0; i < NUM_CALLS; i++) {
+            switch (mode) {
+                case BENCH_EXTRACT:        bits_extract(bytes, offset, field->num_bits, value);              break;
+                case BENCH_FORMER_EXTRACT: former_bits_extract(bytes, offset, field->num_bits, value);       break;
+                case BENCH_WRITE:          bits_write(bytes, offset, value, 0, field->num_bits);             break;
+                case BENCH_FORMER_WRITE:   former_bits_write(bytes, offset, value, 0, field->num_bits);      break;
+            }
+            BENCH_KEEP(packet);
+            BENCH_KEEP(value);
+        }
+        elapsed = bench_get_time() - start;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best / NUM_CALLS * 1e9;
+}
+
+int main(int argc, char ** argv) {
+    size_t num_fields = 7, i;
+
+    if (argc > 1) {
+        for (i = 0; i < (size_t) argc - 1 && i < MAX_FIELDS; i++) {
+            fields[i].name = argv[i + 1];
+            if (sscanf(argv[i + 1], "%zu@%zu", &fields[i].num_bits, &fields[i].offset_in_bits) != 2
+            ||  fields[i].num_bits == 0
+            ||  fields[i].offset_in_bits + fields[i].num_bits > (MAX_BYTES - 1) * 8) {
+                fprintf(stderr, "Usage: %s [num_bits@offset [num_bits@offset ...]]\n", argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        num_fields = i;
+    }
+
+    printf("%-18s %6s %7s  %-17s %-17s\n", "field", "bits", "offset", "extract", "write");
+    printf("%-18s %6s %7s  %8s %8s %8s %8s\n", "", "", "", "former", "current", "former", "current");
+    for (i = 0; i < num_fields; i++) {
+        printf("%-18s %6zu %7zu  %8.1f %8.1f %8.1f %8.1f\n",
+            fields[i].name, fields[i].num_bits, fields[i].offset_in_bits,
+            bench(BENCH_FORMER_EXTRACT, &fields[i]),
+            bench(BENCH_EXTRACT,        &fields[i]),
+            bench(BENCH_FORMER_WRITE,   &fields[i]),
+            bench(BENCH_WRITE,          &fields[i])
+        );
+    }
+    return EXIT_SUCCESS;
+}
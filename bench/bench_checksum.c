@@ -0,0 +1,125 @@
+/**
+ * \file bench_checksum.c
+ * \brief Measure the time needed to compute the Internet checksum of a
+ *    buffer, for the scalar loop used before the SIMD implementations
+ *    and for each implementation of csum_partial supported by the
+ *    running CPU (see checksum.h).
+ *
+ * Usage: bench_checksum [size1 [size2 ...]]
+ *    The sizes are in bytes (default: 8 20 64 256 512 1024 1500).
+ *    The timings are in ns per call.
+ */
+
+#include <stdlib.h>    // malloc, free, rand
+#include <stdio.h>     // printf
+#include <stdint.h>    // uint*_t
+#include <stdbool.h>   // bool
+
+#include "checksum.h"  // csum_partial, csum_partial_copy
+#include "bench.h"
+
+#define NUM_BYTES   (64 * 1024 * 1024) // Bytes summed per run
+#define MAX_SIZES   16
+
+typedef enum {
+    MODE_SCALAR,  // Reference scalar loop
+    MODE_PARTIAL, // csum_partial
+    MODE_COPY     // csum_partial_copy
+} bench_mode_t;
+
+static const char * implementations[] = { "word", "sse2", "avx2", "neon" };
+
+static uint32_t scalar_csum_partial(const void * bytes, size_t size, uint32_t sum) {
+    const uint16_t * words = bytes;
+
+    while (size > 1) {
+        sum += *words++;
+        size -= sizeof(uint16_t);
+    }
+    if (size) {
+        sum += * (const uint8_t *) words;
+    }
+    return sum;
+}
+
+/**
+ * \brief Measure the time needed to sum a buffer.
+ * \param mode The function to call.
+ * \param src The buffer.
+ * \param dst The destination of csum_partial_copy.
+ * \param size The size of the buffer.
+ * \return The best time per call (in ns).
+ */
+
+static double bench(bench_mode_t mode, const uint8_t * src, uint8_t * dst, size_t size) {
+    size_t   i, run,
+             num_calls = NUM_BYTES / size;
+    double   start, elapsed, best = 0;
+    uint32_t sum = 0;
+
+    for (run = 0; run < BENCH_NUM_RUNS; run++) {
+        start = bench_get_time();
+        for (i = 0; i < num_calls; i++) {
+            switch (mode) {
+                case MODE_SCALAR:  sum += scalar_csum_partial(src, size, 0);    break;
+                case MODE_PARTIAL: sum += csum_partial(src, size, 0);           break;
+                case MODE_COPY:    sum += csum_partial_copy(dst, src, size, 0); break;
+            }
+            BENCH_KEEP(sum);
+        }
+        elapsed = bench_get_time() - start;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best / num_calls * 1e9;
+}
+
+int main(int argc, char ** argv) {
+    size_t    sizes[MAX_SIZES] = { 8, 20, 64, 256, 512, 1024, 1500 },
+              num_sizes = bench_parse_sizes(argc, argv, sizes, 7, MAX_SIZES),
+              max_size = 0,
+              i, j;
+    uint8_t * src, * dst;
+    bool      supported[sizeof(implementations) / sizeof(implementations[0])];
+
+    if (!num_sizes) {
+        fprintf(stderr, "Usage: %s [size1 [size2 ...]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < num_sizes; i++) {
+        if (sizes[i] > max_size) max_size = sizes[i];
+    }
+
+    if (!(src = malloc(max_size))) goto ERR_MALLOC_SRC;
+    if (!(dst = malloc(max_size))) goto ERR_MALLOC_DST;
+    for (i = 0; i < max_size; i++) src[i] = (uint8_t) rand();
+
+    printf("%6s %8s", "size", "scalar");
+    for (j = 0; j < sizeof(implementations) / sizeof(implementations[0]); j++) {
+        if ((supported[j] = csum_set_implementation(implementations[j]))) {
+            printf(" %8s", implementations[j]);
+        }
+    }
+    printf(" %8s\n", "copy");
+
+    for (i = 0; i < num_sizes; i++) {
+        printf("%6zu %8.1f", sizes[i], bench(MODE_SCALAR, src, dst, sizes[i]));
+        for (j = 0; j < sizeof(implementations) / sizeof(implementations[0]); j++) {
+            if (supported[j]) {
+                csum_set_implementation(implementations[j]);
+                printf(" %8.1f", bench(MODE_PARTIAL, src, dst, sizes[i]));
+            }
+        }
+        // csum_partial_copy with the last (i.e. fastest) implementation
+        printf(" %8.1f\n", bench(MODE_COPY, src, dst, sizes[i]));
+    }
+
+    free(dst);
+    free(src);
+    return EXIT_SUCCESS;
+
+ERR_MALLOC_DST:
+    free(src);
+ERR_MALLOC_SRC:
+    fprintf(stderr, "bench_checksum: not enough memory\n");
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,247 @@
+/**
+ * \file bench_dynarray_deque.c
+ * \brief Measure the growth and the clearing of a dynarray_t (see
+ *    dynarray.h), and the draining of the paced probes from a deque_t (see
+ *    deque.h), compared with their former implementation.
+ *
+ * - push: n elements are pushed into an empty dynarray. The dynarray
+ *   formerly grew by DYNARRAY_SIZE_INC cells, it now doubles its size.
+ * - refill: n elements are pushed into a dynarray which has just been
+ *   cleared. dynarray_clear formerly shrunk the buffer back to
+ *   DYNARRAY_SIZE_INIT cells, it now keeps it.
+ * - drain: n elements are removed from the front of the container, by
+ *   batches of NETWORK_DEFAULT_SEND_BATCH elements, as
+ *   network_process_paced_probes does. The paced probes were formerly
+ *   stored in a dynarray compacted after each batch, they are now stored
+ *   in a deque whose sent cells are tombstoned and then trimmed.
+ *
+ * Usage: bench_dynarray_deque [n [n ...]]
+ *    The numbers of elements (default: 1000 to 1000000).
+ *    The timings are in ns per element ("-" if the former implementation
+ *    would take too long).
+ */
+
+#include <stdlib.h>       // realloc
+#include <stdio.h>        // printf
+#include <string.h>       // memset
+#include <stdbool.h>      // bool
+
+#include "dynarray.h"     // dynarray_t
+#include "deque.h"        // deque_t
+#include "network.h"      // NETWORK_DEFAULT_SEND_BATCH
+#include "bench.h"
+
+#define NUM_ELEMENTS  4000000     // Elements handled per run
+#define MAX_MOVES     4000000000. // Elements moved per run by the former drain
+#define MAX_SIZES     16
+
+// Former growth of a dynarray (see the former dynarray.c)
+#define FORMER_DYNARRAY_SIZE_INIT 5
+#define FORMER_DYNARRAY_SIZE_INC  5
+
+typedef enum {
+    BENCH_FORMER_PUSH,
+    BENCH_PUSH,
+    BENCH_FORMER_REFILL,
+    BENCH_REFILL,
+    BENCH_FORMER_DRAIN,
+    BENCH_DRAIN
+} bench_mode_t;
+
+/**
+ * \brief Former implementation of dynarray_push_element.
+ */
+
+static bool former_dynarray_push_element(dynarray_t * dynarray, void * element) {
+    if (dynarray->size == dynarray->max_size) {
+        dynarray->elements = realloc(
+            dynarray->elements,
+            (dynarray->size + FORMER_DYNARRAY_SIZE_INC) * sizeof(void *)
+        );
+        if (!dynarray->elements) return false;
+        memset(
+            dynarray->elements + dynarray->size, 0,
+            FORMER_DYNARRAY_SIZE_INC * sizeof(void *)
+        );
+        dynarray->max_size += FORMER_DYNARRAY_SIZE_INC;
+    }
+    dynarray->elements[dynarray->size++] = element;
+    return true;
+}
+
+/**
+ * \brief Former implementation of dynarray_clear (without element_free).
+ */
+
+static bool former_dynarray_clear(dynarray_t * dynarray) {
+    if (!(dynarray->elements = realloc(dynarray->elements, FORMER_DYNARRAY_SIZE_INIT * sizeof(void *)))) {
+        return false;
+    }
+    memset(dynarray->elements, 0, FORMER_DYNARRAY_SIZE_INIT * sizeof(void *));
+    dynarray->size = 0;
+    dynarray->max_size = FORMER_DYNARRAY_SIZE_INIT;
+    return true;
+}
+
+/**
+ * \brief Push elements into a dynarray.
+ * \param dynarray A dynarray_t instance.
+ * \param n The number of elements to push.
+ * \param former Pass true to call the former implementation.
+ * \return true iif successful.
+ */
+
+static bool fill(dynarray_t * dynarray, size_t n, bool former) {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        // Elements are never dereferenced, any non-NULL address will do
+        if (!(former ?
+            former_dynarray_push_element(dynarray, dynarray) :
+            dynarray_push_element(dynarray, dynarray)
+        )) return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Remove every element from the front of a dynarray by batches,
+ *    as the former network_process_paced_probes did.
+ * \param dynarray A dynarray_t instance.
+ * \return true iif successful.
+ */
+
+static bool former_drain(dynarray_t * dynarray) {
+    size_t n;
+
+    while ((n = dynarray_get_size(dynarray)) > 0) {
+        if (n > NETWORK_DEFAULT_SEND_BATCH) n = NETWORK_DEFAULT_SEND_BATCH;
+        if (!dynarray_del_n_elements(dynarray, 0, n, NULL)) return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Remove every element from the front of a deque by batches,
+ *    as network_process_paced_probes does.
+ * \param deque A deque_t instance.
+ */
+
+static void drain(deque_t * deque) {
+    size_t i, n;
+
+    while ((n = deque_get_num_cells(deque)) > 0) {
+        if (n > NETWORK_DEFAULT_SEND_BATCH) n = NETWORK_DEFAULT_SEND_BATCH;
+        for (i = 0; i < n; i++) {
+            BENCH_KEEP(deque_del_ith_cell(deque, i));
+        }
+        deque_trim(deque);
+    }
+}
+
+/**
+ * \brief Measure the time needed to handle n elements.
+ * \param mode The measured operation.
+ * \param n The number of elements.
+ * \return The best time per element (in ns), or a negative value
+ *    in case of failure.
+ */
+
+static double bench(bench_mode_t mode, size_t n) {
+    dynarray_t * dynarray = NULL;
+    deque_t    * deque = NULL;
+    size_t       num_repeats = NUM_ELEMENTS / n,
+                 i, j, run;
+    double       start, elapsed, best = 0, ret = -1;
+    bool         former = (mode == BENCH_FORMER_PUSH || mode == BENCH_FORMER_REFILL);
+
+    if (num_repeats == 0) num_repeats = 1;
+
+    for (run = 0; run < BENCH_NUM_RUNS; run++) {
+        for (i = 0, elapsed = 0; i < num_repeats; i++) {
+            switch (mode) {
+                case BENCH_FORMER_PUSH:
+                case BENCH_PUSH:
+                    start = bench_get_time();
+                    if (!(dynarray = dynarray_create()))              goto ERR_RUN;
+                    if (!fill(dynarray, n, former))                   goto ERR_RUN;
+                    dynarray_free(dynarray, NULL);
+                    dynarray = NULL;
+                    elapsed += bench_get_time() - start;
+                    break;
+                case BENCH_FORMER_REFILL:
+                case BENCH_REFILL:
+                    if (!dynarray && !(dynarray = dynarray_create())) goto ERR_RUN;
+                    if (!fill(dynarray, n, former))                   goto ERR_RUN;
+                    if (former) {
+                        if (!former_dynarray_clear(dynarray))         goto ERR_RUN;
+                    } else {
+                        dynarray_clear(dynarray, NULL);
+                    }
+                    start = bench_get_time();
+                    if (!fill(dynarray, n, former))                   goto ERR_RUN;
+                    elapsed += bench_get_time() - start;
+                    dynarray->size = 0;
+                    break;
+                case BENCH_FORMER_DRAIN:
+                    if (!(dynarray = dynarray_create()))              goto ERR_RUN;
+                    if (!fill(dynarray, n, false))                    goto ERR_RUN;
+                    start = bench_get_time();
+                    if (!former_drain(dynarray))                      goto ERR_RUN;
+                    elapsed += bench_get_time() - start;
+                    dynarray_free(dynarray, NULL);
+                    dynarray = NULL;
+                    break;
+                case BENCH_DRAIN:
+                    if (!(deque = deque_create()))                    goto ERR_RUN;
+                    for (j = 0; j < n; j++) {
+                        if (!deque_push_back(deque, &j))              goto ERR_RUN;
+                    }
+                    start = bench_get_time();
+                    drain(deque);
+                    elapsed += bench_get_time() - start;
+                    deque_free(deque, NULL);
+                    deque = NULL;
+                    break;
+            }
+        }
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    ret = best / (num_repeats * n) * 1e9;
+
+ERR_RUN:
+    if (dynarray) dynarray_free(dynarray, NULL);
+    if (deque)    deque_free(deque, NULL);
+    return ret;
+}
+
+int main(int argc, char ** argv) {
+    size_t sizes[MAX_SIZES] = {1000, 10000, 100000, 1000000},
+           num_sizes, i;
+
+    if (!(num_sizes = bench_parse_sizes(argc, argv, sizes, 4, MAX_SIZES))) {
+        fprintf(stderr, "Usage: %s [n [n ...]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%10s  %-17s %-17s %-17s\n", "n", "push", "refill", "drain");
+    printf("%10s  %8s %8s %8s %8s %8s %8s\n", "", "former", "current", "former", "current", "former", "current");
+    for (i = 0; i < num_sizes; i++) {
+        printf("%10zu  %8.1f %8.1f %8.1f %8.1f ",
+            sizes[i],
+            bench(BENCH_FORMER_PUSH,   sizes[i]),
+            bench(BENCH_PUSH,          sizes[i]),
+            bench(BENCH_FORMER_REFILL, sizes[i]),
+            bench(BENCH_REFILL,        sizes[i])
+        );
+
+        // The former drain moves about n^2 / (2 * batch size) elements
+        if ((double) sizes[i] * sizes[i] / (2 * NETWORK_DEFAULT_SEND_BATCH) > MAX_MOVES) {
+            printf("%8s ", "-");
+        } else {
+            printf("%8.1f ", bench(BENCH_FORMER_DRAIN, sizes[i]));
+        }
+        printf("%8.1f\n", bench(BENCH_DRAIN, sizes[i]));
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+/**
+ * \file bench_map.c
+ * \brief Measure the time needed to fill and to search a map whose keys
+ *    are address_t instances, as the caches of address.c and whois.c do:
+ *
+ * - tree: a map_t without hash callback (e.g. built by map_create),
+ *   whose pairs are stored in a binary search tree (see tsearch);
+ * - map: a map_t whose keys carry address_hash, and which is thus
+ *   stored in a hashmap_t;
+ * - hashmap: a hashmap_t storing the address_t keys inline.
+ *
+ * Each map is filled once (the build time includes the copy of the keys)
+ * and searched NUM_LOOKUPS times per run for keys picked at random.
+ *
+ * Usage: bench_map [num_entries [num_entries ...]]
+ *    The numbers of entries (default: 1000 to 10000000).
+ *    The timings are in ns per insertion and per lookup.
+ */
+
+#include <stdlib.h>              // calloc, free
+#include <stdio.h>               // printf
+#include <stdint.h>              // uint32_t
+#include <stdbool.h>             // bool
+#include <arpa/inet.h>           // htonl
+
+#include "address.h"             // address_t, address_hash, address_compare
+#include "containers/map.h"      // map_t
+#include "containers/hashmap.h"  // hashmap_t
+#include "bench.h"
+
+#define NUM_LOOKUPS 250000  // Lookups per run
+#define MAX_SIZES   16
+
+typedef enum {
+    BENCH_TREE,
+    BENCH_MAP,
+    BENCH_HASHMAP
+} bench_mode_t;
+
+/**
+ * \brief Draw the index of a key.
+ * \param pseed Address of the state of the generator (xorshift).
+ * \param num_entries The number of keys.
+ * \return A value in [0, num_entries).
+ */
+
+static inline size_t draw_index(uint32_t * pseed, size_t num_entries) {
+    *pseed ^= *pseed << 13;
+    *pseed ^= *pseed >> 17;
+    *pseed ^= *pseed << 5;
+    return *pseed % num_entries;
+}
+
+/**
+ * \brief Create an empty map mapping an address_t to an address_t *.
+ * \param mode The kind of map (BENCH_TREE or BENCH_MAP).
+ * \return The newly created map if successful, NULL otherwise.
+ */
+
+static map_t * bench_map_create(bench_mode_t mode) {
+    map_t    * map = NULL;
+    object_t * dummy_key,
+             * dummy_data;
+
+    if (!(dummy_key = object_create(NULL, address_dup, address_free, address_dump, address_compare))) goto ERR_DUMMY_KEY;
+    if (!(dummy_data = object_create(NULL, NULL, NULL, NULL, NULL)))                                goto ERR_DUMMY_DATA;
+    if (mode == BENCH_MAP) dummy_key->hash = (ELEMENT_HASH) address_hash;
+    map = make_map(dummy_key, dummy_data);
+    object_free(dummy_data);
+ERR_DUMMY_DATA:
+    object_free(dummy_key);
+ERR_DUMMY_KEY:
+    return map;
+}
+
+/**
+ * \brief Measure the time needed to fill and to search a map.
+ * \param mode The kind of map.
+ * \param addresses The keys.
+ * \param num_entries The number of keys.
+ * \param pbuild Address of a double, set to the time per insertion (in ns).
+ * \param plookup Address of a double, set to the best time per lookup (in ns).
+ * \return true iif successful.
+ */
+
+static bool bench(bench_mode_t mode, const address_t * addresses, size_t num_entries, double * pbuild, double * plookup) {
+    map_t             * map = NULL;
+    hashmap_t         * hashmap = NULL;
+    const address_t   * address,
+                      * found;
+    const address_t  ** pfound;
+    size_t              i, run;
+    uint32_t            seed;
+    double              start, elapsed;
+    bool                ret = false;
+
+    // Each key is mapped to its own address
+    start = bench_get_time();
+    if (mode == BENCH_HASHMAP) {
+        if (!(hashmap = hashmap_create(sizeof(address_t), sizeof(address_t *), address_hash, address_compare))) goto ERR_CREATE;
+        for (i = 0; i < num_entries; i++) {
+            found = &addresses[i];
+            if (!hashmap_update(hashmap, &addresses[i], &found)) goto ERR_INSERT;
+        }
+    } else {
+        if (!(map = bench_map_create(mode))) goto ERR_CREATE;
+        for (i = 0; i < num_entries; i++) {
+            if (!map_update(map, &addresses[i], &addresses[i])) goto ERR_INSERT;
+        }
+    }
+    *pbuild = (bench_get_time() - start) / num_entries * 1e9;
+
+    for (run = 0; run < BENCH_NUM_RUNS; run++) {
+        seed = 2463534242u;
+        start = bench_get_time();
+        for (i = 0; i < NUM_LOOKUPS; i++) {
+            address = &addresses[draw_index(&seed, num_entries)];
+            if (mode == BENCH_HASHMAP) {
+                found = (pfound = hashmap_find(hashmap, address)) ? *pfound : NULL;
+            } else {
+                map_find(map, address, &found);
+            }
+            if (found != address) goto ERR_LOOKUP;
+        }
+        elapsed = bench_get_time() - start;
+        if (run == 0 || elapsed < *plookup) *plookup = elapsed;
+    }
+    *plookup = *plookup / NUM_LOOKUPS * 1e9;
+    ret = true;
+
+ERR_LOOKUP:
+ERR_INSERT:
+    map_free(map);
+    hashmap_free(hashmap);
+ERR_CREATE:
+    return ret;
+}
+
+int main(int argc, char ** argv) {
+    size_t       sizes[MAX_SIZES] = {1000, 10000, 100000, 1000000, 10000000},
+                 num_sizes, max_size = 0,
+                 i, j;
+    address_t  * addresses;
+    double       build[3], lookup[3];
+    bench_mode_t mode;
+
+    if (!(num_sizes = bench_parse_sizes(argc, argv, sizes, 5, MAX_SIZES))) {
+        fprintf(stderr, "Usage: %s [num_entries [num_entries ...]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < num_sizes; i++) {
+        if (sizes[i] > max_size) max_size = sizes[i];
+    }
+
+    // Distinct IPv4 addresses, scattered over the address space
+    if (!(addresses = calloc(max_size, sizeof(address_t)))) goto ERR_CALLOC;
+    for (j = 0; j < max_size; j++) {
+        addresses[j].family = AF_INET;
+        addresses[j].ip.ipv4.s_addr = htonl((uint32_t) j * 2654435761u);
+    }
+
+    printf("%10s  %-26s %-26s\n", "entries", "build", "lookup");
+    printf("%10s  %8s %8s %8s %8s %8s %8s\n", "", "tree", "map", "hashmap", "tree", "map", "hashmap");
+    for (i = 0; i < num_sizes; i++) {
+        for (mode = BENCH_TREE; mode <= BENCH_HASHMAP; mode++) {
+            if (!bench(mode, addresses, sizes[i], &build[mode], &lookup[mode])) {
+                fprintf(stderr, "Cannot benchmark %zu entries\n", sizes[i]);
+                goto ERR_BENCH;
+            }
+        }
+        printf("%10zu  %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+            sizes[i],
+            build[BENCH_TREE],  build[BENCH_MAP],  build[BENCH_HASHMAP],
+            lookup[BENCH_TREE], lookup[BENCH_MAP], lookup[BENCH_HASHMAP]
+        );
+    }
+    free(addresses);
+    return EXIT_SUCCESS;
+
+ERR_BENCH:
+    free(addresses);
+ERR_CALLOC:
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,158 @@
+/**
+ * \file bench_probe_clone.c
+ * \brief Measure the time needed to clone a probe skeleton with probe_dup,
+ *    which parses the layers of each clone, compared with a compiled probe
+ *    template (see probe_template.h) and with a batch of clones (see
+ *    probe_batch.h).
+ *
+ * Each clone then gets its TTL set, as traceroute and mda do: this is
+ * when probe_dup dissects the layers of a clone (see probe_wrap_packet).
+ *
+ * Usage: bench_probe_clone [payload_size]
+ *    The size of the payload of the skeletons (default: 2 bytes).
+ *    The timings are in ns per probe, TTL update and release included.
+ */
+
+#include <stdlib.h>         // strtoul
+#include <stdio.h>          // printf
+#include <stdbool.h>        // bool
+
+#include "probe.h"          // probe_t, probe_dup
+#include "probe_template.h" // probe_template_t
+#include "probe_batch.h"    // probe_batch_t
+#include "field_handle.h"   // FIELD_HANDLE
+#include "bench.h"
+
+#define NUM_CLONES 200000  // Clones per run
+#define BATCH_SIZE 32      // Probes per batch
+
+typedef enum {
+    BENCH_PROBE_DUP,      /**< probe_dup */
+    BENCH_TEMPLATE_CLONE, /**< probe_template_clone */
+    BENCH_BATCH           /**< probe_batch_create */
+} bench_mode_t;
+
+typedef struct {
+    const char * network;
+    const char * transport;
+} skeleton_t;
+
+static const skeleton_t skeletons[] = {
+    { "ipv4", "udp"    },
+    { "ipv4", "tcp"    },
+    { "ipv4", "icmpv4" },
+    { "ipv6", "udp"    },
+    { "ipv6", "tcp"    },
+    { "ipv6", "icmpv6" }
+};
+
+static field_handle_t ttl_handle = FIELD_HANDLE("ttl", 0);
+
+/**
+ * \brief Set the TTL of a cloned probe (see probe_mutator_t).
+ * \param probe The cloned probe.
+ * \param i The index of this probe.
+ * \param data Unused.
+ * \return true iif successful.
+ */
+
+static bool set_ttl(probe_t * probe, size_t i, void * data) {
+    field_t field = {
+        .key        = "ttl",
+        .value.int8 = i % 32 + 1,
+        .type       = TYPE_UINT8
+    };
+
+    return probe_rewrite_field_handle(probe, &ttl_handle, &field);
+}
+
+/**
+ * \brief Measure the time needed to clone a probe skeleton.
+ * \param mode The cloning method.
+ * \param skel The probe skeleton.
+ * \return The best time per probe (in ns), or a negative value
+ *    in case of failure.
+ */
+
+static double bench(bench_mode_t mode, const probe_t * skel) {
+    probe_template_t * probe_template;
+    probe_batch_t    * probe_batch;
+    probe_t          * probe;
+    size_t             i, run;
+    double             start, elapsed, best = -1;
+    bool               success;
+
+    if (!(probe_template = probe_template_create(skel))) goto ERR_PROBE_TEMPLATE_CREATE;
+
+    for (run = 0; run < BENCH_NUM_RUNS; run++) {
+        start = bench_get_time();
+        switch (mode) {
+            case BENCH_PROBE_DUP:
+                for (i = 0; i < NUM_CLONES; i++) {
+                    if (!(probe = probe_dup(skel))) goto ERR_CLONE;
+                    success = set_ttl(probe, i, NULL);
+                    probe_free(probe);
+                    if (!success) goto ERR_CLONE;
+                }
+                break;
+            case BENCH_TEMPLATE_CLONE:
+                for (i = 0; i < NUM_CLONES; i++) {
+                    if (!(probe = probe_template_clone(probe_template))) goto ERR_CLONE;
+                    success = set_ttl(probe, i, NULL);
+                    probe_free(probe);
+                    if (!success) goto ERR_CLONE;
+                }
+                break;
+            case BENCH_BATCH:
+                for (i = 0; i < NUM_CLONES; i += BATCH_SIZE) {
+                    if (!(probe_batch = probe_batch_create(probe_template, BATCH_SIZE, set_ttl, NULL))) goto ERR_CLONE;
+                    BENCH_KEEP(probe_batch);
+                    probe_batch_free(probe_batch);
+                }
+                break;
+        }
+        elapsed = bench_get_time() - start;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    best = best / NUM_CLONES * 1e9;
+
+ERR_CLONE:
+    probe_template_free(probe_template);
+ERR_PROBE_TEMPLATE_CREATE:
+    return best;
+}
+
+int main(int argc, char ** argv) {
+    probe_t * skel;
+    size_t    payload_size = 2,
+              i;
+    char      name[32];
+
+    if (argc > 2 || (argc == 2 && (payload_size = strtoul(argv[1], NULL, 10)) == 0)) {
+        fprintf(stderr, "Usage: %s [payload_size]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-12s  %10s %10s %10s\n", "skeleton", "probe_dup", "template", "batch");
+    for (i = 0; i < sizeof(skeletons) / sizeof(skeleton_t); i++) {
+        if (!(skel = probe_create()))                                                               goto ERR_PROBE_CREATE;
+        if (!probe_set_protocols(skel, skeletons[i].network, skeletons[i].transport, NULL))        goto ERR_SKEL;
+        if (!probe_payload_resize(skel, payload_size))                                              goto ERR_SKEL;
+
+        snprintf(name, sizeof(name), "%s/%s", skeletons[i].network, skeletons[i].transport);
+        printf("%-12s  %10.1f %10.1f %10.1f\n",
+            name,
+            bench(BENCH_PROBE_DUP,      skel),
+            bench(BENCH_TEMPLATE_CLONE, skel),
+            bench(BENCH_BATCH,          skel)
+        );
+        probe_free(skel);
+    }
+    return EXIT_SUCCESS;
+
+ERR_SKEL:
+    probe_free(skel);
+ERR_PROBE_CREATE:
+    fprintf(stderr, "Cannot create the %s/%s skeleton\n", skeletons[i].network, skeletons[i].transport);
+    return EXIT_FAILURE;
+}
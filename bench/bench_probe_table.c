@@ -0,0 +1,167 @@
+/**
+ * \file bench_probe_table.c
+ * \brief Measure the time needed to match a reply with a flying probe
+ *    (see probe_table.h) according to the number of probes in flight,
+ *    compared with a linear scan of the flying probes.
+ *
+ * The linear scan compares tags stored along with the probes. It is thus
+ * a lower bound of the former network_get_matching_probe, which extracted
+ * the tag of each scanned probe from its packet.
+ *
+ * Usage: bench_probe_table [num_probes [num_probes ...]]
+ *    The numbers of probes in flight (default: 10 to 100000).
+ *    The timings are in ns per reply.
+ */
+
+#include <stdlib.h>       // malloc, free
+#include <stdio.h>        // printf
+#include <stdint.h>       // uint32_t
+
+#include "probe.h"        // probe_t, probe_create, probe_free
+#include "probe_table.h"  // probe_table_t
+#include "common.h"       // ELEMENT_FREE
+#include "bench.h"
+
+#define NUM_LOOKUPS  1000000  // Replies per run
+#define NUM_SCANNED  50000000 // Probes scanned per run by the linear scan
+#define MAX_SIZES    16
+
+typedef enum {
+    BENCH_SCAN,     /**< Linear scan of the flying probes */
+    BENCH_GET,      /**< probe_table_get */
+    BENCH_POP_PUSH  /**< probe_table_pop, then probe_table_push of a new tag */
+} bench_mode_t;
+
+typedef struct {
+    uint32_t   tag;
+    probe_t  * probe;
+} flying_probe_t;
+
+/**
+ * \brief Draw the index of a flying probe.
+ * \param pseed Address of the state of the generator (xorshift).
+ * \param num_probes The number of flying probes.
+ * \return A value in [0, num_probes).
+ */
+
+static inline size_t draw_index(uint32_t * pseed, size_t num_probes) {
+    *pseed ^= *pseed << 13;
+    *pseed ^= *pseed >> 17;
+    *pseed ^= *pseed << 5;
+    return *pseed % num_probes;
+}
+
+/**
+ * \brief Linear scan of the flying probes, as network_get_matching_probe
+ *    used to do.
+ * \param flying The flying probes.
+ * \param num_probes The number of flying probes.
+ * \param tag The tag carried by the reply.
+ * \return The matching probe if any, NULL otherwise.
+ */
+
+static probe_t * scan(const flying_probe_t * flying, size_t num_probes, uint32_t tag) {
+    size_t i;
+
+    for (i = 0; i < num_probes; i++) {
+        if (flying[i].tag == tag) return flying[i].probe;
+    }
+    return NULL;
+}
+
+/**
+ * \brief Measure the time needed to match a reply.
+ * \param mode The matching method.
+ * \param num_probes The number of probes in flight.
+ * \return The best time per reply (in ns), or a negative value
+ *    in case of failure.
+ */
+
+static double bench(bench_mode_t mode, size_t num_probes) {
+    flying_probe_t * flying;
+    probe_table_t  * table;
+    probe_t        * probe;
+    size_t           num_lookups = NUM_LOOKUPS,
+                     i, j, run;
+    uint32_t         seed, next_tag;
+    double           start, elapsed, best = -1;
+
+    // The linear scan would take hours with many probes in flight
+    if (mode == BENCH_SCAN && num_lookups * num_probes / 2 > NUM_SCANNED) {
+        num_lookups = 2 * NUM_SCANNED / num_probes;
+        if (num_lookups == 0) num_lookups = 1;
+    }
+
+    if (!(flying = malloc(num_probes * sizeof(flying_probe_t)))) goto ERR_MALLOC;
+    if (!(table = probe_table_create()))                          goto ERR_PROBE_TABLE_CREATE;
+
+    // Tags are allocated in a round-robin fashion (see network_get_available_tag)
+    for (i = 0; i < num_probes; i++) {
+        if (!(probe = probe_create())) goto ERR_PROBE_CREATE;
+        flying[i].tag   = i + 1;
+        flying[i].probe = probe;
+        if (!probe_table_push(table, flying[i].tag, probe)) {
+            probe_free(probe);
+            goto ERR_PROBE_CREATE;
+        }
+    }
+    next_tag = num_probes + 1;
+
+    for (run = 0; run < BENCH_NUM_RUNS; run++) {
+        seed = 2463534242u;
+        start = bench_get_time();
+        for (i = 0; i < num_lookups; i++) {
+            j = draw_index(&seed, num_probes);
+            switch (mode) {
+                case BENCH_SCAN:
+                    probe = scan(flying, num_probes, flying[j].tag);
+                    break;
+                case BENCH_GET:
+                    probe = probe_table_get(table, flying[j].tag);
+                    break;
+                case BENCH_POP_PUSH:
+                    // The reply is matched, and a new probe takes its place
+                    probe = probe_table_pop(table, flying[j].tag);
+                    flying[j].tag = next_tag++;
+                    if (!probe_table_push(table, flying[j].tag, probe)) goto ERR_PROBE_TABLE_PUSH;
+                    break;
+            }
+            BENCH_KEEP(probe);
+        }
+        elapsed = bench_get_time() - start;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    best = best / num_lookups * 1e9;
+
+ERR_PROBE_TABLE_PUSH:
+    // Every probe is still in the table, except on failure of
+    // probe_table_push, in which case probe is the missing one.
+    if (probe_table_get_size(table) < num_probes) probe_free(probe);
+ERR_PROBE_CREATE:
+    probe_table_free(table, (ELEMENT_FREE) probe_free);
+ERR_PROBE_TABLE_CREATE:
+    free(flying);
+ERR_MALLOC:
+    return best;
+}
+
+int main(int argc, char ** argv) {
+    size_t sizes[MAX_SIZES] = {10, 100, 1000, 10000, 100000},
+           num_sizes, i;
+
+    if (!(num_sizes = bench_parse_sizes(argc, argv, sizes, 5, MAX_SIZES))) {
+        fprintf(stderr, "Usage: %s [num_probes [num_probes ...]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%10s  %10s %10s %10s\n", "in flight", "scan", "get", "pop+push");
+    for (i = 0; i < num_sizes; i++) {
+        printf("%10zu  %10.1f %10.1f %10.1f\n",
+            sizes[i],
+            bench(BENCH_SCAN,     sizes[i]),
+            bench(BENCH_GET,      sizes[i]),
+            bench(BENCH_POP_PUSH, sizes[i])
+        );
+    }
+    return EXIT_SUCCESS;
+}
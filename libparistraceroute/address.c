@@ -17,26 +17,31 @@
 #include "address.h"
 
 #ifdef USE_CACHE
-#    include "containers/map.h"
+#    include "containers/hashmap.h"
 
-static map_t * cache_ip_hostname = NULL;
+// address_t => char * (hostname)
+static hashmap_t * cache_ip_hostname = NULL;
 
 static void __cache_ip_hostname_create() __attribute__((constructor));
 static void __cache_ip_hostname_free()   __attribute__((destructor));
 
-static void str_dump(const char * s) {
-    printf("%s (%p)", s, s);
-}
-
 static void __cache_ip_hostname_create() {
-    cache_ip_hostname = map_create(
-        address_dup, address_free, address_dump, address_compare,
-        strdup,      free,         str_dump
+    cache_ip_hostname = hashmap_create(
+        sizeof(address_t), sizeof(char *),
+        address_hash, address_compare
     );
 }
 
 static void __cache_ip_hostname_free() {
-    if (cache_ip_hostname) map_free(cache_ip_hostname);
+    size_t   i = 0;
+    char  ** phostname;
+
+    if (cache_ip_hostname) {
+        while (hashmap_next(cache_ip_hostname, &i, NULL, (void **) &phostname)) {
+            free(*phostname);
+        }
+        hashmap_free(cache_ip_hostname);
+    }
 }
 
 #endif
@@ -221,6 +226,18 @@ int address_compare(const address_t * x, const address_t * y) {
     return *--px - *--py;
 }
 
+size_t address_hash(const address_t * address) {
+    const uint8_t * p = (const uint8_t *) &address->ip;
+    size_t          i, address_size = address_get_size(address);
+    uint64_t        hash = 14695981039346656037ULL; // FNV-1a
+
+    hash = (hash ^ (uint8_t) address->family) * 1099511628211ULL;
+    for (i = 0; i < address_size; i++) {
+        hash = (hash ^ p[i]) * 1099511628211ULL;
+    }
+    return (size_t) hash;
+}
+
 int address_to_string(const address_t * address, char ** pbuffer)
 {
     struct sockaddr     * sa;
@@ -298,17 +315,18 @@ bool address_resolv(const address_t * address, char ** phostname, int mask_cache
 {
     struct hostent * hp;
     bool             found = false;
-    const void     * data;
+#ifdef USE_CACHE
+    char          ** pcached;
+#endif
 
     if (!address) goto ERR_INVALID_PARAMETER;
 
 #ifdef USE_CACHE
     if (cache_ip_hostname && (mask_cache & CACHE_READ)) {
-        found = map_find(cache_ip_hostname, address, &data); //phostname);
-        if (found) {
+        if ((pcached = hashmap_find(cache_ip_hostname, address)) && *pcached) {
             // We've to strdup the cached value, otherwise the function
             // calling address_resolv will erase this cached value.
-            *phostname = strdup(data);
+            found = ((*phostname = strdup(*pcached)) != NULL);
         }
     }
 #endif
@@ -325,8 +343,11 @@ bool address_resolv(const address_t * address, char ** phostname, int mask_cache
             goto ERR_STRDUP;
         }
 #ifdef USE_CACHE
-        if (mask_cache & CACHE_WRITE) {
-            map_update(cache_ip_hostname, address, *phostname);
+        if (cache_ip_hostname && (mask_cache & CACHE_WRITE)) {
+            if ((pcached = hashmap_insert(cache_ip_hostname, address, NULL))) {
+                free(*pcached);
+                *pcached = strdup(*phostname);
+            }
         }
     }
 #endif
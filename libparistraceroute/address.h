@@ -96,6 +96,15 @@ address_t * address_create();
 
 int address_compare(const address_t * x, const address_t * y);
 
+/**
+ * \brief Hash an address_t instance.
+ * \param address An address_t instance.
+ * \return The hash of the address. Two addresses equal according to
+ *    address_compare have the same hash.
+ */
+
+size_t address_hash(const address_t * address);
+
 /**
  * \brief Release an address_t instance from the memory.
  * \param address An address instance.
@@ -72,6 +72,10 @@ algorithm_instance_t * algorithm_instance_create(
     instance->events     = dynarray_create();
     instance->caller     = NULL;
     instance->loop       = loop;
+    instance->probe_timeout = 0;
+    instance->ready_prev = NULL;
+    instance->ready_next = NULL;
+    instance->is_ready   = false;
     return instance;
 }
 
@@ -82,7 +86,8 @@ algorithm_instance_t * algorithm_instance_create(
 
 void algorithm_instance_free(algorithm_instance_t * instance) {
     if (instance) {
-        algorithm_instance_clear_events(instance);
+        // Release the events which have not been handled
+        dynarray_free(instance->events, (ELEMENT_FREE) event_free);
         free(instance);
     }
 }
@@ -115,6 +120,14 @@ inline void algorithm_instance_set_data(algorithm_instance_t * instance, void *
     if (instance) instance->data = data;
 }
 
+double algorithm_instance_get_probe_timeout(const algorithm_instance_t * instance) {
+    return instance ? instance->probe_timeout : 0;
+}
+
+void algorithm_instance_set_probe_timeout(algorithm_instance_t * instance, double timeout) {
+    if (instance) instance->probe_timeout = timeout;
+}
+
 inline event_t ** algorithm_instance_get_events(algorithm_instance_t * instance) {
     return instance ?
         (event_t**) dynarray_get_elements(instance->events) :
@@ -131,6 +144,57 @@ inline unsigned int algorithm_instance_get_num_events(algorithm_instance_t * ins
     return instance && instance->events ? instance->events->size : 0;
 }
 
+/**
+ * \brief Append an instance to the ready list of its loop. The loop is
+ *    only notified when the ready list becomes non-empty.
+ * \param instance The instance having pending events.
+ */
+
+static void pt_set_instance_ready(algorithm_instance_t * instance) {
+    pt_loop_t * loop = instance->loop;
+
+    if (instance->is_ready) return;
+
+    instance->is_ready   = true;
+    instance->ready_next = NULL;
+    instance->ready_prev = loop->ready_tail;
+    if (loop->ready_tail) {
+        loop->ready_tail->ready_next = instance;
+    } else {
+        loop->ready_head = instance;
+        eventfd_write(loop->eventfd_algorithm, 1);
+    }
+    loop->ready_tail = instance;
+}
+
+/**
+ * \brief Remove an instance from the ready list of its loop.
+ * \param instance The instance.
+ */
+
+static void pt_unset_instance_ready(algorithm_instance_t * instance) {
+    pt_loop_t * loop = instance->loop;
+
+    if (!instance->is_ready) return;
+
+    if (instance->ready_prev) instance->ready_prev->ready_next = instance->ready_next;
+    else                      loop->ready_head = instance->ready_next;
+    if (instance->ready_next) instance->ready_next->ready_prev = instance->ready_prev;
+    else                      loop->ready_tail = instance->ready_prev;
+
+    instance->ready_prev = instance->ready_next = NULL;
+    instance->is_ready   = false;
+}
+
+algorithm_instance_t * pt_pop_ready_instance(pt_loop_t * loop) {
+    algorithm_instance_t * instance;
+
+    if ((instance = loop->ready_head)) {
+        pt_unset_instance_ready(instance);
+    }
+    return instance;
+}
+
 void pt_throw(
     pt_loop_t            * loop,
     algorithm_instance_t * instance,
@@ -140,13 +204,15 @@ void pt_throw(
         if (instance) {
             // Enqueue an algorithm event
             dynarray_push_element(instance->events, event);
-            eventfd_write(instance->loop->eventfd_algorithm, 1);
+            pt_set_instance_ready(instance);
         } else if (loop) {
             // Enqueue an user event
             dynarray_push_element(loop->events_user, event);
             eventfd_write(loop->eventfd_user, 1);
         } else {
+            // Nobody owns this event
             fprintf(stderr, "pt_algorithm_throw: event ignored\n");
+            event_free(event);
         }
     }
 }
@@ -239,6 +305,7 @@ void pt_del_instance(
     algorithm_instance_t * instance
 ) {
     pt_algorithm_instance_del(loop, instance);
+    pt_unset_instance_ready(instance);
     algorithm_instance_free(instance);
 }
 
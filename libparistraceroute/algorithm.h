@@ -29,6 +29,7 @@ typedef enum {
  * \struct algorithm_t
  * \brief Structure representing an algorithm.
  * The handler is called everytime an event concerning this instance is raised.
+ * The handled event is released by the loop once the handler returns.
  */
 
 typedef struct algorithm_s {
@@ -58,6 +59,10 @@ typedef struct algorithm_instance_s {
     dynarray_t                  * events;     /**< An array of events received by the algorithm */
     struct algorithm_instance_s * caller;     /**< Reference to the entity that called the algorithm (NULL if called by user program) */
     struct pt_loop_s            * loop;       /**< Pointer to a library context */
+    double                        probe_timeout; /**< Timeout of the probes sent by this instance (in seconds, 0 to use the timeout of the network layer) */
+    struct algorithm_instance_s * ready_prev; /**< Previous instance in loop->ready_instances (if is_ready) */
+    struct algorithm_instance_s * ready_next; /**< Next instance in loop->ready_instances (if is_ready) */
+    bool                          is_ready;   /**< True iif this instance has pending events and is stored in loop->ready_instances */
 } algorithm_instance_t;
 
 //--------------------------------------------------------------------
@@ -132,6 +137,8 @@ void    *  algorithm_instance_get_data      (algorithm_instance_t * instance);
 event_t ** algorithm_instance_get_events    (algorithm_instance_t * instance);
 unsigned   algorithm_instance_get_num_events(algorithm_instance_t * instance);
 void       algorithm_instance_set_data      (algorithm_instance_t * instance, void * data);
+double     algorithm_instance_get_probe_timeout(const algorithm_instance_t * instance);
+void       algorithm_instance_set_probe_timeout(algorithm_instance_t * instance, double timeout);
 void       algorithm_instance_clear_events  (algorithm_instance_t * instance);
 
 //--------------------------------------------------------------------
@@ -146,7 +153,9 @@ void       algorithm_instance_clear_events  (algorithm_instance_t * instance);
  *    Pass NULL if this event is raised for an instance.
  * \param instance The instance that must receives the event.
  *    Pass NULL if this event has to be sent to the user program.
- * \param event The event that must be raised
+ * \param event The event that must be raised. The queue of the
+ *    recipient takes over the reference passed by the caller
+ *    (see event_ref).
  */
 
 void pt_throw(
@@ -155,6 +164,16 @@ void pt_throw(
     event_t              * event
 );
 
+/**
+ * \brief Pop the oldest algorithm instance having pending events.
+ *    Instances are appended to the ready list of the loop by pt_throw,
+ *    so that the loop only visits the instances having pending events.
+ * \param loop The libparistraceroute loop.
+ * \return The corresponding instance, NULL if no instance is ready.
+ */
+
+algorithm_instance_t * pt_pop_ready_instance(struct pt_loop_s * loop);
+
 /**
  * \brief Send a TERM event to the algorithm (to make it release its data from the
  *    memory and unregister this algorithm from the pt_loop_t.
@@ -8,7 +8,7 @@
 #include "../algorithm.h"  // algorithm_t
 #include "../common.h"     // MAX, ELEMENT_FREE
 #include "../options.h"    // option_t
-#include "../pt_loop.h"    // pt_send_probe
+#include "../pt_loop.h"    // pt_send_probes, pt_create_probe_template
 #include "../lattice.h"    // LATTICE_*
 #include "../probe.h"      // probe_t
 
@@ -170,6 +170,93 @@ ERR_LINK:
  * is done, its siblings are complete.
  */
 
+/**
+ * \struct mda_probe_mutator_data_t
+ * \brief Data passed to the mutators crafting the probes of mda_enumerate.
+ */
+
+typedef struct {
+    mda_data_t       * mda_data;  /**< Data attached to this instance of mda algorithm */
+    mda_interface_t  * interface; /**< The enumerated interface */
+    mda_ttl_flow_t  ** ttl_flows; /**< The (ttl, flow_id) tuples to send (see mda_probe_mutator_next_hop) */
+} mda_probe_mutator_data_t;
+
+/**
+ * \brief Retrieve the ttl of the i-th probe testing a new flow_id.
+ * \param interface The enumerated interface.
+ * \param i The index of this probe.
+ * \return The corresponding ttl.
+ */
+
+static inline uint8_t mda_testing_get_ttl(const mda_interface_t * interface, size_t i) {
+    return interface->ttl_set[i % interface->num_ttls]; // Vary ttl over all possible
+}
+
+/**
+ * \brief Craft a probe testing a new flow_id (see pt_send_probes).
+ *    The i-th probe uses the flow_id last_flow_id + i + 1. The flows are
+ *    registered by mda_send_testing_probes once the probes are queued.
+ * \param probe The probe cloned from the compiled skeleton.
+ * \param i The index of this probe.
+ * \param data A mda_probe_mutator_data_t instance.
+ * \return true iif successful
+ */
+
+static bool mda_probe_mutator_testing(probe_t * probe, size_t i, void * data)
+{
+    mda_probe_mutator_data_t * mutator_data = data;
+
+    return probe_rewrite_fields(probe, FIELD_I8("ttl", mda_testing_get_ttl(mutator_data->interface, i)), NULL)
+        && probe_rewrite_flow_id(probe, mutator_data->mda_data->last_flow_id + i + 1);
+}
+
+/**
+ * \brief Send probes testing new flow_ids, and register these flows
+ *    as MDA_FLOW_TESTING in the enumerated interface.
+ * \param mutator_data The data passed to mda_probe_mutator_testing.
+ * \param num_probes The number of probes to send.
+ * \return true iif successful
+ */
+
+static bool mda_send_testing_probes(mda_probe_mutator_data_t * mutator_data, size_t num_probes)
+{
+    mda_data_t      * mda_data = mutator_data->mda_data;
+    mda_interface_t * interface = mutator_data->interface;
+    uintmax_t         first_flow_id = mda_data->last_flow_id + 1;
+    size_t            i;
+
+    if (!pt_send_probes(mda_data->loop, mda_data->probe_template, num_probes, mda_probe_mutator_testing, mutator_data)) {
+        return false;
+    }
+
+    // These flow_ids are in flight, even if some of them cannot be registered
+    mda_data->last_flow_id += num_probes;
+    for (i = 0; i < num_probes; i++) {
+        if (!mda_interface_add_flow_id(mda_data->arena, interface, mda_testing_get_ttl(interface, i), first_flow_id + i, MDA_FLOW_TESTING)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief Craft a probe discovering the next hops of an interface
+ *    through an available flow_id (see pt_send_probes).
+ * \param probe The probe cloned from the compiled skeleton.
+ * \param i The index of this probe.
+ * \param data A mda_probe_mutator_data_t instance.
+ * \return true iif successful
+ */
+
+static bool mda_probe_mutator_next_hop(probe_t * probe, size_t i, void * data)
+{
+    mda_probe_mutator_data_t * mutator_data = data;
+    mda_ttl_flow_t           * mda_ttl_flow = mutator_data->ttl_flows[i];
+
+    return probe_rewrite_flow_id(probe, mda_ttl_flow->mda_flow->flow_id)
+        && probe_rewrite_fields(probe, FIELD_I8("ttl", mda_ttl_flow->ttl + 1), NULL);
+}
+
 /**
  * \brief Discover next hops of a given IP hop.
  * \param elt The current IP hop.
@@ -181,11 +268,13 @@ static lattice_return_t mda_enumerate(lattice_elt_t * elt, mda_data_t * mda_data
 {
     mda_interface_t * interface = lattice_elt_get_data(elt);
     mda_ttl_flow_t  * mda_ttl_flow;
+    mda_probe_mutator_data_t mutator_data = {
+        .mda_data  = mda_data,
+        .interface = interface,
+        .ttl_flows = NULL
+    };
     /* Number of interfaces at the same TTL */
     size_t    num_nexthops = 0;
-    probe_t * probe;
-    uintmax_t flow_id = 0;
-    uint8_t   ttl;
     int       i = 0;
     int       to_send = 0;
     int       num_flows_missing = 0;
@@ -227,20 +316,16 @@ static lattice_return_t mda_enumerate(lattice_elt_t * elt, mda_data_t * mda_data
             // potentially divided by num_siblings
             num_flows_testing = mda_interface_get_num_flows(interface, MDA_FLOW_TESTING);
             num_flows_missing = to_send - num_flows_avail - num_flows_testing;
-            for (i = 0; i < num_flows_missing; i++) {
-                /* Note: we are not sure all probes will go to the right interface, and
-                 * we might go though us, though it might alimentate other interfaces at
-                 * the same ttl... thus we need to share the probes in flight when we
-                 * explore hops at the same ttl : we should set one potential probe in
-                 * flight for each interface ? or multiply the number of probes in
-                 * flight by the number of interface (might overestimate ?)*/
-                ttl = interface->ttl_set[i % interface->num_ttls]; // Vary ttl over all possible
-                probe = probe_dup(mda_data->skel);
-                flow_id = ++mda_data->last_flow_id;
-                mda_interface_add_flow_id(interface, ttl, flow_id, MDA_FLOW_TESTING); // TODO control returned value
-                // I16 casts flow_id into a uint16_t before memcpy
-                probe_set_fields(probe, I8("ttl", ttl), I16("flow_id", flow_id), NULL); // TODO control returned value, free fields
-                pt_send_probe(mda_data->loop, probe); // TODO control returned value
+            /* Note: we are not sure all probes will go to the right interface, and
+             * we might go though us, though it might alimentate other interfaces at
+             * the same ttl... thus we need to share the probes in flight when we
+             * explore hops at the same ttl : we should set one potential probe in
+             * flight for each interface ? or multiply the number of probes in
+             * flight by the number of interface (might overestimate ?)*/
+            if (num_flows_missing > 0) {
+                if (!mda_send_testing_probes(&mutator_data, num_flows_missing)) {
+                    goto ERR_SEND_TESTING_PROBES;
+                }
             }
         }
     } else {
@@ -257,6 +342,14 @@ static lattice_return_t mda_enumerate(lattice_elt_t * elt, mda_data_t * mda_data
     // To discover the nexthop, we duplicate the corresponding probes with an
     // incremented TTL.
 
+    if (num_flows_avail <= 0) {
+        return LATTICE_INTERRUPT_NEXT;
+    }
+
+    if (!(mutator_data.ttl_flows = malloc(num_flows_avail * sizeof(mda_ttl_flow_t *)))) {
+        goto ERR_MALLOC;
+    }
+
     for (i = 0; i < num_flows_avail; i++) {
         // Get a new ttl flow_id tuple to send, or break/return
         // TODO manage properly break/return
@@ -266,21 +359,24 @@ static lattice_return_t mda_enumerate(lattice_elt_t * elt, mda_data_t * mda_data
             address_dump(interface->address);
             break;
         }
-        
-        flow_id = mda_ttl_flow->mda_flow->flow_id;
-        ttl     = mda_ttl_flow->ttl;
-        // Send corresponding probe with ttl + 1
-        if (!(probe = probe_dup(mda_data->skel))) {
-            goto ERR_PROBE_DUP;
+        mutator_data.ttl_flows[i] = mda_ttl_flow;
+    }
+
+    // Send the corresponding probes with ttl + 1
+    if (i > 0) {
+        if (!pt_send_probes(mda_data->loop, mda_data->probe_template, i, mda_probe_mutator_next_hop, &mutator_data)) {
+            goto ERR_PT_SEND_PROBES;
         }
-        probe_set_fields(probe, I16("flow_id", flow_id), I8("ttl", ttl + 1), NULL); // TODO control returned value, free fields
-        pt_send_probe(mda_data->loop, probe);
-        interface->sent++;
+        interface->sent += i;
     }
+    free(mutator_data.ttl_flows);
 
     return LATTICE_INTERRUPT_NEXT; // OK, but enumeration not complete, interrupt walk
 
-ERR_PROBE_DUP:
+ERR_PT_SEND_PROBES:
+    free(mutator_data.ttl_flows);
+ERR_MALLOC:
+ERR_SEND_TESTING_PROBES:
     return LATTICE_ERROR;
 }
 
@@ -431,7 +527,7 @@ static lattice_return_t mda_delete_flow(lattice_elt_t * elt, void * data)
                 mda_ttl_flow = dynarray_get_ith_element(interface->ttl_flows, j);
                 mda_flow     = mda_ttl_flow->mda_flow;
                 if ((mda_flow->flow_id == search->flow_id) && (mda_flow->state == MDA_FLOW_TESTING)) {
-                    dynarray_del_ith_element(interface->ttl_flows, j, (ELEMENT_FREE) mda_ttl_flow_free);
+                    dynarray_del_ith_element(interface->ttl_flows, j, NULL);
                     return LATTICE_INTERRUPT_ALL;
                 }
             }
@@ -515,6 +611,9 @@ static void mda_handler_init(pt_loop_t * loop, event_t * event, mda_data_t ** pd
     if (!(data = mda_data_create()))                    goto ERR_MDA_DATA_CREATE;
     if (!(probe_extract(skel, "dst_ip", data->dst_ip))) goto ERR_EXTRACT_DST_IP;
 
+    // Compile the skeleton once, each probe is then cloned from it
+    if (!(data->probe_template = pt_create_probe_template(loop, skel))) goto ERR_PROBE_TEMPLATE_CREATE;
+
     // Initialize algorithm's data
     data->skel = skel;
     data->loop = loop;
@@ -523,13 +622,14 @@ static void mda_handler_init(pt_loop_t * loop, event_t * event, mda_data_t ** pd
     // Create a dummy first hop, root of a lattice of discovered interfaces:
     // - not a tree since some interfaces might have several predecessors (diamonds)
     // - we assume the initial hop is not a load balancer
-    if (!lattice_add_element(data->lattice, NULL, mda_interface_create(NULL))) {
+    if (!lattice_add_element(data->lattice, NULL, mda_interface_create(data->arena, NULL))) {
         goto ERR_LATTICE_ADD_ELEMENT;
     }
 
     return;
 
 ERR_LATTICE_ADD_ELEMENT:
+ERR_PROBE_TEMPLATE_CREATE:
 ERR_EXTRACT_DST_IP:
     mda_data_free(data);
 ERR_MDA_DATA_CREATE:
@@ -566,9 +666,9 @@ static void mda_handler_reply(pt_loop_t * loop, event_t * event, mda_data_t * da
     probe = ((const probe_reply_t *) event->data)->probe;
     reply = ((const probe_reply_t *) event->data)->reply;
 
-    if (!(probe_extract(probe, "ttl",     &ttl)))         goto ERR_EXTRACT_TTL;
-    if (!(probe_extract(probe, "flow_id", &flow_id_u16))) goto ERR_EXTRACT_FLOW_ID;
-    if (!(probe_extract(reply, "src_ip",  &addr)))        goto ERR_EXTRACT_SRC_IP;
+    if (!(probe_extract_handle(probe, &data->ttl_handle, &ttl)))     goto ERR_EXTRACT_TTL;
+    if (!(probe_extract_flow_id(probe, &flow_id_u16)))                goto ERR_EXTRACT_FLOW_ID;
+    if (!(probe_extract_handle(reply, &data->src_ip_handle, &addr))) goto ERR_EXTRACT_SRC_IP;
 
     //printf("Probe reply received: %hhu %s [%ju]\n", ttl, addr, flow_id_u16);
 
@@ -594,7 +694,7 @@ static void mda_handler_reply(pt_loop_t * loop, event_t * event, mda_data_t * da
         dest_interface = lattice_elt_get_data(dest_elt);
     } else {
         dest_elt = NULL;
-        dest_interface = mda_interface_create(&addr);
+        dest_interface = mda_interface_create(data->arena, &addr);
         dest_interface->ttl_set[0] = ttl; // This interface's first ttl (messy way of doing it: 
                                        // create technically makes first ttl 0, this overwrites).
     }
@@ -663,11 +763,11 @@ static void mda_handler_reply(pt_loop_t * loop, event_t * event, mda_data_t * da
     }
 
     // Insert flow in the right interface
-    if (!(mda_flow = mda_flow_create(flow_id_u16, MDA_FLOW_AVAILABLE))) {
+    if (!(mda_flow = mda_flow_create(data->arena, flow_id_u16, MDA_FLOW_AVAILABLE))) {
         goto ERR_MDA_FLOW_CREATE;
     }
 
-    if (!(mda_ttl_flow = mda_ttl_flow_create(ttl, mda_flow))) {
+    if (!(mda_ttl_flow = mda_ttl_flow_create(data->arena, ttl, mda_flow))) {
         goto ERR_MDA_TTL_FLOW_CREATE;
     }
 
@@ -684,7 +784,6 @@ static void mda_handler_reply(pt_loop_t * loop, event_t * event, mda_data_t * da
     return;
 
 ERR_DYNARRAY_PUSH_ELEMENT:
-    mda_flow_free(mda_flow);
 ERR_MDA_TTL_FLOW_CREATE:
 ERR_MDA_FLOW_CREATE:
 ERR_MDA_EVENT_NEW_LINK:
@@ -709,8 +808,8 @@ static void mda_handler_timeout(pt_loop_t *loop, event_t *event, mda_data_t * da
 
     probe = event->data;
 
-    if (!(probe_extract(probe, "ttl",     &ttl)))     goto ERR_EXTRACT_TTL;
-    if (!(probe_extract(probe, "flow_id", &flow_id_u16))) goto ERR_EXTRACT_FLOW_ID;
+    if (!(probe_extract_handle(probe, &data->ttl_handle, &ttl))) goto ERR_EXTRACT_TTL;
+    if (!(probe_extract_flow_id(probe, &flow_id_u16)))           goto ERR_EXTRACT_FLOW_ID;
 
     search_ttl_flow.ttl = ttl - 1;
     search_ttl_flow.flow_id = flow_id_u16;
@@ -733,7 +832,7 @@ static void mda_handler_timeout(pt_loop_t *loop, event_t *event, mda_data_t * da
             // discovery at the next ttl. Currently, that supposes we have only
             // one interface...
             if (source_interface->num_stars < options->traceroute_options.max_undiscovered) {
-                mda_interface_t * new_iface = mda_interface_create(NULL);
+                mda_interface_t * new_iface = mda_interface_create(data->arena, NULL);
                 new_iface->ttl_set[0] = ttl; // This interface's first ttl (messy way of doing it: 
                                           // create technically makes first ttl 0, this overwrites).
 
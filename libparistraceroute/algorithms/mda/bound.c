@@ -350,6 +350,9 @@ void bound_free(bound_t * bound)
     }
 }
 
+// Standalone test of this module (build bound.c with -DBOUND_MAIN). It
+// must not end up in the library, which would then define main().
+#ifdef BOUND_MAIN
 int main(int argc, const char * argv[]) {
     long double confidence;
     size_t      interfaces;
@@ -366,4 +369,4 @@ int main(int argc, const char * argv[]) {
     bound_free(bound);
     return 0;
 }
-
+#endif
@@ -15,11 +15,17 @@ mda_data_t * mda_data_create()
         goto ERR_MALLOC;
     }
 
-    if (!(data->lattice = lattice_create())) {
+    // The lattice and everything it refers to is carved out of this
+    // arena, and released in one go by mda_data_free
+    if (!(data->arena = arena_create())) {
+        goto ERR_ARENA_CREATE;
+    }
+
+    if (!(data->lattice = lattice_create_in_arena(data->arena))) {
         goto ERR_LATTICE_CREATE;
     }
 
-    if (!(data->dst_ip = address_create())) {
+    if (!(data->dst_ip = arena_alloc(data->arena, sizeof(address_t)))) {
         goto ERR_ADDRESS_CREATE;
     }
 
@@ -36,13 +42,15 @@ mda_data_t * mda_data_create()
         goto ERR_BOUND_CREATE;
     }
 
+    field_handle_init(&data->ttl_handle,    "ttl",    0);
+    field_handle_init(&data->src_ip_handle, "src_ip", 0);
     return data;
 
 ERR_BOUND_CREATE:
-    address_free(data->dst_ip); 
 ERR_ADDRESS_CREATE:
-    lattice_free(data->lattice, (ELEMENT_FREE) mda_interface_free);
 ERR_LATTICE_CREATE:
+    arena_free(data->arena);
+ERR_ARENA_CREATE:
     free(data);
 ERR_MALLOC:
     return NULL;
@@ -51,8 +59,9 @@ ERR_MALLOC:
 void mda_data_free(mda_data_t * data)
 {
     if (data) {
-        lattice_free(data->lattice, (ELEMENT_FREE) mda_interface_free);
-        address_free(data->dst_ip);
+        probe_template_free(data->probe_template);
+        bound_free(data->bound);
+        arena_free(data->arena);
         free(data);
     }
 }
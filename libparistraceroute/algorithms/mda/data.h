@@ -3,17 +3,24 @@
 
 #include "bound.h"          // bound_t
 #include "../../address.h"  // address_t
+#include "../../arena.h"    // arena_t
 #include "../../lattice.h"  // lattice_t
 #include "../../pt_loop.h"  // pt_loop_t
 #include "../../probe.h"    // probe_t
+#include "../../probe_template.h" // probe_template_t
+#include "../../field_handle.h" // field_handle_t
 
 typedef struct {
-    lattice_t    * lattice;      /**< Root of the lattice storing the interfaces */
-    uintmax_t      last_flow_id;
-    address_t    * dst_ip;       /**< Destination IP */
-    pt_loop_t    * loop;         /**< Main loop */
-    probe_t      * skel;         /**< Probe skeleton */
-    bound_t      * bound;        /**< Bound on probes to send */
+    arena_t          * arena;          /**< Holds the lattice, its interfaces and their flows */
+    lattice_t        * lattice;        /**< Root of the lattice storing the interfaces */
+    uintmax_t          last_flow_id;
+    address_t        * dst_ip;         /**< Destination IP */
+    pt_loop_t        * loop;           /**< Main loop */
+    probe_t          * skel;           /**< Probe skeleton */
+    probe_template_t * probe_template; /**< Compiled probe skeleton, each probe is cloned from it */
+    bound_t          * bound;          /**< Bound on probes to send */
+    field_handle_t     ttl_handle;     /**< TTL of a probe */
+    field_handle_t     src_ip_handle;  /**< Source IP of a reply */
 } mda_data_t;
 
 /**
@@ -24,7 +31,8 @@ typedef struct {
 mda_data_t * mda_data_create();
 
 /**
- * \brief Release a mda_data_t structure from the memory
+ * \brief Release a mda_data_t structure from the memory, along with
+ *    its lattice, its interfaces and their flows (see arena_free).
  * \param A pointer to the mda_data_t instance
  */
 
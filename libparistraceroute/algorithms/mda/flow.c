@@ -1,12 +1,10 @@
 #include "flow.h"
 
-#include <stdlib.h>
-
-mda_flow_t * mda_flow_create(uintmax_t flow_id, mda_flow_state_t state)
+mda_flow_t * mda_flow_create(arena_t * arena, uintmax_t flow_id, mda_flow_state_t state)
 {
     mda_flow_t * mda_flow;
 
-    if ((mda_flow = malloc(sizeof(mda_flow_t)))) {
+    if ((mda_flow = arena_alloc(arena, sizeof(mda_flow_t)))) {
         mda_flow->flow_id = flow_id;
         mda_flow->state = state;
     }
@@ -14,11 +12,6 @@ mda_flow_t * mda_flow_create(uintmax_t flow_id, mda_flow_state_t state)
     return mda_flow;
 }
 
-void mda_flow_free(mda_flow_t * mda_flow)
-{
-    if (mda_flow) free(mda_flow);
-}
-
 char mda_flow_state_to_char(const mda_flow_t * mda_flow) {
     char c;
 
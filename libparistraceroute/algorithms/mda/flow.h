@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "../../arena.h"    // arena_t
+
 typedef enum {
     MDA_FLOW_AVAILABLE,
     MDA_FLOW_UNAVAILABLE,
@@ -21,20 +23,15 @@ typedef struct {
 } mda_flow_t;
 
 /**
- * \brief Allocate a mda_data_t structure
+ * \brief Allocate a mda_flow_t structure. It is released along
+ *    with its arena.
+ * \param arena The arena of the mda instance (see mda_data_t).
  * \param flow_id Flow identifier related to this flow
  * \param state Current state of this flow
- * \return A pointer to the mda_data_t structure, NULL otherwise
- */
-
-mda_flow_t * mda_flow_create(uintmax_t flow_id, mda_flow_state_t state);
-
-/**
- * \brief Release a mda_data_t structure from the memory
- * \param mda_flow A pointer to the mda_data_t instance
+ * \return A pointer to the mda_flow_t structure, NULL otherwise
  */
 
-void mda_flow_free(mda_flow_t * mda_flow);
+mda_flow_t * mda_flow_create(arena_t * arena, uintmax_t flow_id, mda_flow_state_t state);
 
 /**
  * \brief Convert a flow state in its corresponding character output.
@@ -6,21 +6,21 @@
 
 #include "../../common.h"   // ELEMENT_FREE 
 
-mda_interface_t * mda_interface_create(const address_t * address)
+mda_interface_t * mda_interface_create(arena_t * arena, const address_t * address)
 {
     mda_interface_t * mda_interface;
 
-    if (!(mda_interface = calloc(1, sizeof(mda_interface_t)))) {
+    if (!(mda_interface = arena_calloc(arena, sizeof(mda_interface_t)))) {
         goto ERR_INTERFACE;
     }
 
     if (address) {
-        if(!(mda_interface->address = address_dup(address))) {
+        if(!(mda_interface->address = arena_dup(arena, address, sizeof(address_t)))) {
             goto ERR_ADDRESS;
         }
     }
 
-    if (!(mda_interface->ttl_flows = dynarray_create())) {
+    if (!(mda_interface->ttl_flows = dynarray_create_in_arena(arena))) {
         goto ERR_FLOWS;
     }
 
@@ -30,33 +30,23 @@ mda_interface_t * mda_interface_create(const address_t * address)
     mda_interface->type = MDA_LB_TYPE_UNKNOWN;
     return mda_interface;
 
+    // The memory already allocated is released along with the arena
 ERR_FLOWS:
-    if (mda_interface->address) address_free(mda_interface->address);
 ERR_ADDRESS:
-    free(mda_interface);
 ERR_INTERFACE:
     return NULL;
 }
 
-void mda_interface_free(mda_interface_t * interface)
-{
-    if (interface) {
-        dynarray_free(interface->ttl_flows, (ELEMENT_FREE) mda_ttl_flow_free);
-        if (interface->address) address_free(interface->address);
-        free(interface);
-    }
-}
-
-bool mda_interface_add_flow_id(mda_interface_t * interface, uint8_t ttl, uintmax_t flow_id, mda_flow_state_t state)
+bool mda_interface_add_flow_id(arena_t * arena, mda_interface_t * interface, uint8_t ttl, uintmax_t flow_id, mda_flow_state_t state)
 {
     mda_flow_t     * mda_flow;
     mda_ttl_flow_t * mda_ttl_flow;
 
-    if (!(mda_flow = mda_flow_create(flow_id, state))) {
+    if (!(mda_flow = mda_flow_create(arena, flow_id, state))) {
         goto ERR_MDA_FLOW_CREATE;
     }
 
-    if (!(mda_ttl_flow = mda_ttl_flow_create(ttl, mda_flow))) {
+    if (!(mda_ttl_flow = mda_ttl_flow_create(arena, ttl, mda_flow))) {
         goto ERR_TTL_FLOW_CREATE;
     }
 
@@ -67,9 +57,7 @@ bool mda_interface_add_flow_id(mda_interface_t * interface, uint8_t ttl, uintmax
     return true;
 
 ERR_DYNARRAY_PUSH_ELEMENT:
-    mda_ttl_flow_free(mda_ttl_flow);
 ERR_TTL_FLOW_CREATE:
-    mda_flow_free(mda_flow);
 ERR_MDA_FLOW_CREATE:
     return false;
 }
@@ -118,7 +106,7 @@ mda_ttl_flow_t * mda_interface_get_available_flow_id(mda_interface_t * interface
 
         flow_id = ++data->last_flow_id; // mda_interface_get_new_flow_id(interface, data);
         ttl = interface->ttl_set[interface->num_ttls - 1];
-        if (!mda_interface_add_flow_id(interface, ttl, flow_id, MDA_FLOW_UNAVAILABLE)) {
+        if (!mda_interface_add_flow_id(data->arena, interface, ttl, flow_id, MDA_FLOW_UNAVAILABLE)) {
             return NULL; // error adding flow id to the list
         }
         return dynarray_get_ith_element(interface->ttl_flows, size);
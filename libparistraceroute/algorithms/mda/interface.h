@@ -8,6 +8,7 @@
 #include "flow.h"           // mda_flow_state_t
 #include "ttl_flow.h"       // mda_ttl_flow_t
 #include "../../address.h"  // address_t
+#include "../../arena.h"    // arena_t
 #include "../../dynarray.h" // dynarray_t
 
 typedef enum {
@@ -36,33 +37,27 @@ typedef struct {
 } mda_interface_t;
 
 
-void mda_ttl_flow_free(mda_ttl_flow_t * mda_ttl_flow);
-
 /**
  * \brief Allocate a new mda_interface_t instance, which corresponds to
- *    an IP hop discovered by mda.
+ *    an IP hop discovered by mda. The interface, its address and its
+ *    flows are released along with the arena.
+ * \param arena The arena of the mda instance (see mda_data_t).
  * \param addr The address of the discovered IP hop.
  * \return A pointer to the newly created mda_interface_t instance,
  *    NULL otherwise.
  */
 
-mda_interface_t * mda_interface_create(const address_t * address);
-
-/**
- * \brief Release a mda_interface_t instance from the memory.
- * \param interface a preallocated mda_interface_t instance.
- */
-
-void mda_interface_free(mda_interface_t * interface);
+mda_interface_t * mda_interface_create(arena_t * arena, const address_t * address);
 
 /**
  * \brief Allocate and attach a new mda_flow_t instance to a given
  *    mda_interface_t instance.
+ * \param arena The arena of the mda instance (see mda_data_t).
  * \param flow_id The new flow id.
  * \param flow_state The flow state.
  */
 
-bool mda_interface_add_flow_id(mda_interface_t * interface, uint8_t ttl, uintmax_t flow_id, mda_flow_state_t state);
+bool mda_interface_add_flow_id(arena_t * arena, mda_interface_t * interface, uint8_t ttl, uintmax_t flow_id, mda_flow_state_t state);
 
 /**
  * \brief Retrieve the number of flows having a given state.
@@ -1,32 +1,18 @@
 #include "ttl_flow.h"
 
-#include <stdlib.h>         // free
-
-#include "../../common.h"   // ELEMENT_FREE 
-
-mda_ttl_flow_t * mda_ttl_flow_create(uint8_t ttl, mda_flow_t * mda_flow) 
+mda_ttl_flow_t * mda_ttl_flow_create(arena_t * arena, uint8_t ttl, mda_flow_t * mda_flow)
 {
     mda_ttl_flow_t * mda_ttl_flow;
 
-    if (!(mda_ttl_flow = malloc(sizeof(mda_ttl_flow_t)))) {
-        goto ERR_MALLOC;
-    }    
+    if (!(mda_ttl_flow = arena_alloc(arena, sizeof(mda_ttl_flow_t)))) {
+        goto ERR_ARENA_ALLOC;
+    }
 
     mda_ttl_flow->ttl      = ttl;
     mda_ttl_flow->mda_flow = mda_flow;
 
     return mda_ttl_flow;
 
-ERR_MALLOC:
+ERR_ARENA_ALLOC:
     return NULL;
 }
-
-void mda_ttl_flow_free(mda_ttl_flow_t * mda_ttl_flow) 
-{
-    if (mda_ttl_flow) {
-        if (mda_ttl_flow->mda_flow) {
-            mda_flow_free(mda_ttl_flow->mda_flow);
-        }
-        free(mda_ttl_flow);
-    } 
-}
@@ -12,19 +12,14 @@ typedef struct {
 } mda_ttl_flow_t;
 
 /**
- * \brief Allocate new ttl/flow tuple
+ * \brief Allocate new ttl/flow tuple. It is released along
+ *    with its arena.
+ * \param arena The arena of the mda instance (see mda_data_t).
  * \param ttl The ttl for this tuple
  * \param mda_flow the flow for this tuple
  * \return A pointer to the ttl/flow tuple
  */
 
-mda_ttl_flow_t * mda_ttl_flow_create(uint8_t ttl, mda_flow_t * mda_flow);
-
-/**
- * \brief Free a given ttl/flow tuple
- * \param mda_ttl_flow The given tuple to free
- */
-
-void mda_ttl_flow_free(mda_ttl_flow_t * mda_ttl_flow);
+mda_ttl_flow_t * mda_ttl_flow_create(arena_t * arena, uint8_t ttl, mda_flow_t * mda_flow);
 
 #endif // LIBPT_ALGORITHMS_MDA_TTL_FLOW_H
@@ -423,30 +423,11 @@ static inline bool destination_reached(const address_t * dst_addr, const probe_t
  */
 
 static void double_free(double * double_to_delete) {
-    if (!double_to_delete) {
+    if (double_to_delete) {
         free(double_to_delete);
     }
 }
 
-/**
- * \brief duplicate a pointer to a double
- * \param double_to_duplicate the pointer to duplicated
- * \return a pointer to the copied double
- */
-
-static double * double_dup(double * double_to_duplicate) {
-    double * new_double = NULL;
-
-    if (double_to_duplicate == NULL) {
-        return new_double;
-    }
-    if (!(new_double = (double *) malloc(sizeof(double)))) {
-        return new_double;
-    }
-    *new_double = *double_to_duplicate;
-    return new_double;
-}
-
 //-----------------------------------------------------------------
 // Ping algorithm's data
 //-----------------------------------------------------------------
@@ -462,6 +443,7 @@ static ping_data_t * ping_data_create() {
 
     if (!(ping_data = calloc(1, sizeof(ping_data_t))))    goto ERR_MALLOC;
     if (!(ping_data->rtt_results = dynarray_create()))    goto ERR_RTT_RESULTS;
+    ping_data->num_refs = 1;
     return ping_data;
 
 ERR_RTT_RESULTS:
@@ -471,41 +453,24 @@ ERR_MALLOC:
 }
 
 /**
- * \brief duplicate an instance of ping_data_t
- * \param ping_data the instance to duplicate
- * \return a pointer to the copy of the instance
+ * \brief Take an additional reference to a ping_data_t instance
+ * \param ping_data The ping_data_t instance to share
+ * \return The ping_data_t instance
  */
 
-static ping_data_t * ping_data_dup(ping_data_t * ping_data) {
-    ping_data_t * new_ping_data = NULL;
-
-    if (ping_data == NULL) {
-        return new_ping_data;
-    }
-    if (!(new_ping_data = (ping_data_t *)malloc(sizeof(ping_data_t)))) {
-        return new_ping_data;
-    }
-    if (!(new_ping_data->rtt_results = dynarray_dup(ping_data->rtt_results,
-        (void * (*)(void *)) double_dup))) {
-        return NULL;
-    }
-    new_ping_data->num_replies = ping_data->num_replies;
-    new_ping_data->num_sent = ping_data->num_sent;
-    new_ping_data->num_losses = ping_data->num_losses;
-    new_ping_data->num_probes_in_flight = ping_data->num_probes_in_flight;
-    new_ping_data->start_time = ping_data->start_time;
-    new_ping_data->last_time = ping_data->last_time;
-
-    return new_ping_data;
+static ping_data_t * ping_data_ref(ping_data_t * ping_data) {
+    ping_data->num_refs++;
+    return ping_data;
 }
 
 /**
- * \brief Release a ping_data_t instance from the memory
+ * \brief Release a reference to a ping_data_t instance. The instance is
+ *    released from the memory along with its last reference.
  * \param ping_data The ping_data_t instance we want to release.
  */
 
 static void ping_data_free(ping_data_t * ping_data) {
-    if (ping_data) {
+    if (ping_data && --ping_data->num_refs == 0) {
         if (ping_data->rtt_results) {
             dynarray_free(ping_data->rtt_results, (ELEMENT_FREE) double_free);
         }
@@ -737,7 +702,6 @@ bool send_ping_probes(
 int ping_loop_handler(pt_loop_t * loop, event_t * event, void ** pdata, probe_t * probe_skel, void * opts)
 {
     ping_data_t          * data     = NULL;                // Current state of the algorithm instance
-    ping_data_t          * data_dup = NULL;                // Copy of the current stata
     probe_t              * probe    = NULL;                // Probe
     const probe_t        * reply;                          // Reply
     probe_reply_t        * probe_reply;                    // (Probe, Reply) pair
@@ -776,27 +740,27 @@ int ping_loop_handler(pt_loop_t * loop, event_t * event, void ** pdata, probe_t
 
             // Notify the caller we've got a response
             if (destination_reached(options->dst_addr, reply)) {
-                pt_raise_event(loop, event_create(PING_PROBE_REPLY, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                pt_raise_event(loop, event_create(PING_PROBE_REPLY, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
             } else {
                 ++(data->num_losses);
                 if (destination_network_unreachable(reply)) {
-                    pt_raise_event(loop, event_create(PING_DST_NET_UNREACHABLE, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_DST_NET_UNREACHABLE, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 } else if (destination_host_unreachable(reply)) {
-                    pt_raise_event(loop, event_create(PING_DST_HOST_UNREACHABLE, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_DST_HOST_UNREACHABLE, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 } else if (destination_protocol_unreachable(reply)) {
-                    pt_raise_event(loop, event_create(PING_DST_PROT_UNREACHABLE, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_DST_PROT_UNREACHABLE, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 } else if (destination_port_unreachable(reply)) {
-                    pt_raise_event(loop, event_create(PING_DST_PORT_UNREACHABLE, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_DST_PORT_UNREACHABLE, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 } else if (ttl_exceeded(reply)) {
-                    pt_raise_event(loop, event_create(PING_TTL_EXCEEDED_TRANSIT, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_TTL_EXCEEDED_TRANSIT, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 } else if (fragment_reassembly_time_exceeded(reply)) {
-                    pt_raise_event(loop, event_create(PING_TIME_EXCEEDED_REASSEMBLY, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_TIME_EXCEEDED_REASSEMBLY, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 } else if (redirect(reply)) {
-                    pt_raise_event(loop, event_create(PING_REDIRECT, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_REDIRECT, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 } else if (parameter_problem(reply)) {
-                    pt_raise_event(loop, event_create(PING_PARAMETER_PROBLEM, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_PARAMETER_PROBLEM, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 } else {
-                    pt_raise_event(loop, event_create(PING_GEN_ERROR, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+                    pt_raise_event(loop, event_create(PING_GEN_ERROR, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
                 }
             }
 
@@ -813,21 +777,19 @@ int ping_loop_handler(pt_loop_t * loop, event_t * event, void ** pdata, probe_t
             data->last_time = probe->sending_time + network_get_timeout(loop->network);
 
             // Notify the caller we've got a probe timeout
-            pt_raise_event(loop, event_create(PING_TIMEOUT, probe, NULL, (ELEMENT_FREE) probe_free));
+            pt_raise_event(loop, event_create(PING_TIMEOUT, probe_ref(probe), NULL, (ELEMENT_FREE) probe_free));
 
             num_probes_to_send = data->num_sent != options->count;
             break;
 
         case ALGORITHM_TERM:
             // The caller allows us to free ping's data
-            // We will copy ping's data in data_dup since the main program might
-            // desires to access the statistics that we will free. The duplicated
-            // data will be transparently freed once the main program handlers
-            // returns thanks to the ping_data_free callback.
+            // The main program may still access the statistics, so they are
+            // shared with the PING_PRINT_STATISTICS event, which releases them
+            // once the main program handler returns.
             data = *pdata;
-            data_dup = ping_data_dup(data);
-            pt_raise_event(loop, event_create(PING_PRINT_STATISTICS, data_dup, NULL, (ELEMENT_FREE) ping_data_free));
-            ping_data_free(*pdata);
+            pt_raise_event(loop, event_create(PING_PRINT_STATISTICS, ping_data_ref(data), NULL, (ELEMENT_FREE) ping_data_free));
+            ping_data_free(data);
             *pdata = NULL;
             has_terminated = true;
             goto HAS_TERMINATED;
@@ -854,9 +816,6 @@ int ping_loop_handler(pt_loop_t * loop, event_t * event, void ** pdata, probe_t
             pt_raise_terminated(loop);
         }
     }
-
-    // Handled event must always been freed when leaving the handler
-    event_free(event);
     return 0;
 
 HAS_TERMINATED:
@@ -866,15 +825,9 @@ HAS_TERMINATED:
     if (has_terminated) {
         pt_raise_terminated(loop);
     }
-
-    // Handled event must always been freed when leaving the handler
-    event_free(event);
     return 0;
 
 FAILURE:
-    // Handled event must always been freed when leaving the handler
-    event_free(event);
-
     // Sent to the current instance a ALGORITHM_FAILURE notification.
     // The caller has to free the data allocated by the algorithm.
     pt_raise_error(loop);
@@ -98,6 +98,7 @@ typedef struct {
     size_t       num_sent;             /**< The number of probes sent (== the sequence number of the next probe packet) */
     double       start_time;           /**< The date at which ping starts measurement (in microsecond) */
     double       last_time;            /**< The date at which the last reply or timeout have been handled (in microsecond) */
+    size_t       num_refs;             /**< Number of references to this instance (the algorithm and its pending events) */
 } ping_data_t;
 
 /**
@@ -108,26 +108,17 @@ static traceroute_data_t * traceroute_data_create() {
     traceroute_data_t * traceroute_data;
 
     if (!(traceroute_data = calloc(1, sizeof(traceroute_data_t)))) goto ERR_MALLOC;
-    if (!(traceroute_data->probes = dynarray_create()))            goto ERR_PROBES;
+    field_handle_init(&traceroute_data->ttl_handle,    "ttl",    0);
+    field_handle_init(&traceroute_data->src_ip_handle, "src_ip", 0);
     return traceroute_data;
 
-ERR_PROBES:
-    free(traceroute_data);
 ERR_MALLOC:
     return NULL;
 }
 
-/**
- * \brief Release a traceroute_data_t instance from the memory
- * \param traceroute_data The traceroute_data_t instance we want to release.
- */
-
-static void traceroute_data_free(traceroute_data_t * traceroute_data) {
+void traceroute_data_free(traceroute_data_t * traceroute_data) {
     if (traceroute_data) {
-        if (traceroute_data->probes) {
-            // TODO this will provoke a double free
-            // dynarray_free(traceroute_data->probes, (ELEMENT_FREE) probe_free);
-        }
+        probe_template_free(traceroute_data->probe_template);
         free(traceroute_data);
     }
 }
@@ -247,81 +238,58 @@ void traceroute_handler(
 
 /**
  * \brief Check whether the destination is reached.
+ * \param traceroute_data Data attached to this instance of traceroute algorithm
  * \param dst_addr The destination address of this traceroute instance.
+ * \param reply The reply we've received.
  * \return true iif the destination is reached.
  */
 
-static inline bool destination_reached(const address_t * dst_addr, const probe_t * reply) {
+static inline bool destination_reached(traceroute_data_t * traceroute_data, const address_t * dst_addr, const probe_t * reply) {
     bool        ret = false;
     address_t   discovered_addr;
 
-    if (probe_extract(reply, "src_ip", &discovered_addr)) {
+    if (probe_extract_handle(reply, &traceroute_data->src_ip_handle, &discovered_addr)) {
         ret = (address_compare(dst_addr, &discovered_addr) == 0);
     }
     return ret;
 }
 
 /**
- * \brief Send a traceroute probe packet
- * \param loop The main loop
- * \param traceroute_data Data attached to this instance of traceroute algorithm
- * \param probe_skel The probe skeleton used to craft the probe packet
- * \param ttl The TTL that we set for this packet
+ * \struct traceroute_probe_mutator_data_t
+ * \brief Data passed to traceroute_probe_mutator.
  */
 
-static bool send_traceroute_probe(
-    pt_loop_t         * loop,
-    traceroute_data_t * traceroute_data,
-    const probe_t     * probe_skel,
-    uint8_t             ttl,
-    size_t              i
-) {
-    probe_t * probe;
-    double    delay;
-    // a probe must never be altered, otherwise the network layer may
-    // manage corrupted probes.
-    if (!(probe = probe_dup(probe_skel)))                       goto ERR_PROBE_DUP;
-    if (probe_get_delay(probe) != DELAY_BEST_EFFORT) {
-        delay = i * probe_get_delay(probe_skel);
-        probe_set_delay(probe, DOUBLE("delay", delay));
-    }
-    if (!probe_set_fields(probe, I8("ttl", ttl), NULL))         goto ERR_PROBE_SET_FIELDS;
-    if (!dynarray_push_element(traceroute_data->probes, probe)) goto ERR_PROBE_PUSH_ELEMENT;
-
-    return pt_send_probe(loop, probe);
-
-ERR_PROBE_PUSH_ELEMENT:
-ERR_PROBE_SET_FIELDS:
-    probe_free(probe);
-ERR_PROBE_DUP:
-    fprintf(stderr, "Error in send_traceroute_probe\n");
-    return false;
-}
-/*
-static bool send_traceroute_probe_scheduled(
-    pt_loop_t         * loop,
-    traceroute_data_t * traceroute_data,
-    const probe_t     * probe_skel,
-    uint8_t             ttl
-) {
-    probe_t * probe;
+typedef struct {
+    traceroute_data_t * traceroute_data; /**< Data attached to this instance of traceroute algorithm */
+    const probe_t     * probe_skel;      /**< The probe skeleton used to craft the probe packets */
+    uint8_t             ttl;             /**< The TTL that we set for these packets */
+} traceroute_probe_mutator_data_t;
 
-    // a probe must never be altered, otherwise the network layer may
-    // manage corrupted probes.
-    if (!(probe = probe_dup(probe_skel)))                       goto ERR_PROBE_DUP;
-    if (!probe_set_field(probe, I8("ttl", ttl)))                goto ERR_PROBE_SET_FIELD;
-    if (!dynarray_push_element(traceroute_data->probes, probe)) goto ERR_PROBE_PUSH_ELEMENT;
+/**
+ * \brief Craft the i-th traceroute probe of a hop (see pt_send_probes).
+ * \param probe The probe cloned from the compiled skeleton.
+ * \param i The index of this probe.
+ * \param data A traceroute_probe_mutator_data_t instance.
+ * \return true iif successful
+ */
 
-    return pt_send_probe(loop, probe);
+static bool traceroute_probe_mutator(probe_t * probe, size_t i, void * data)
+{
+    traceroute_probe_mutator_data_t * mutator_data = data;
+    traceroute_data_t               * traceroute_data = mutator_data->traceroute_data;
+    double                            delay;
+    field_t                           field = {
+        .key        = "ttl",
+        .value.int8 = mutator_data->ttl,
+        .type       = TYPE_UINT8
+    };
 
-ERR_PROBE_PUSH_ELEMENT:
-ERR_PROBE_SET_FIELD:
-    probe_free(probe);
-ERR_PROBE_DUP:
-    fprintf(stderr, "Error in send_traceroute_probe\n");
-    return false;
+    if (probe_get_delay(probe) != DELAY_BEST_EFFORT) {
+        delay = (i + 1) * probe_get_delay(mutator_data->probe_skel);
+        probe_set_delay(probe, DOUBLE("delay", delay));
+    }
+    return probe_rewrite_field_handle(probe, &traceroute_data->ttl_handle, &field);
 }
-*/
 
 /**
  * \brief Send n traceroute probes toward a destination with a given TTL
@@ -339,14 +307,26 @@ bool send_traceroute_probes(
     size_t              num_probes,
     uint8_t             ttl
 ) {
-    size_t i;
+    traceroute_probe_mutator_data_t mutator_data = {
+        .traceroute_data = traceroute_data,
+        .probe_skel      = probe_skel,
+        .ttl             = ttl
+    };
 
-    for (i = 0; i < num_probes; ++i) {
-        if (!(send_traceroute_probe(loop, traceroute_data, probe_skel, ttl, i + 1))) {
-            return false;
-        }
+    // The skeleton is compiled once, then the probes are cloned from it.
+    if (!traceroute_data->probe_template
+    &&  !(traceroute_data->probe_template = pt_create_probe_template(loop, probe_skel))) goto ERR_PROBE_TEMPLATE_CREATE;
+
+    // The probes of this hop are cloned and sent at once.
+    if (!pt_send_probes(loop, traceroute_data->probe_template, num_probes, traceroute_probe_mutator, &mutator_data)) {
+        goto ERR_PT_SEND_PROBES;
     }
     return true;
+
+ERR_PT_SEND_PROBES:
+ERR_PROBE_TEMPLATE_CREATE:
+    fprintf(stderr, "Error in send_traceroute_probes\n");
+    return false;
 }
 
 /**
@@ -397,10 +377,11 @@ int traceroute_loop_handler(pt_loop_t * loop, event_t * event, void ** pdata, pr
             data->num_stars = 0;
             data->num_undiscovered = 0;
             ++(data->num_replies);
-            data->destination_reached |= destination_reached(options->dst_addr, reply);
+            data->destination_reached |= destination_reached(data, options->dst_addr, reply);
 
-            // Notify the caller we've discovered an IP address
-            pt_raise_event(loop, event_create(TRACEROUTE_PROBE_REPLY, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+            // Notify the caller we've discovered an IP address. The (probe, reply)
+            // pair is shared with the caller.
+            pt_raise_event(loop, event_create(TRACEROUTE_PROBE_REPLY, probe_reply_ref(probe_reply), NULL, (ELEMENT_FREE) probe_reply_free));
             break;
 
         case PROBE_TIMEOUT:
@@ -412,7 +393,7 @@ int traceroute_loop_handler(pt_loop_t * loop, event_t * event, void ** pdata, pr
             ++(data->num_replies);
 
             // Notify the caller we've got a probe timeout
-            pt_raise_event(loop, event_create(TRACEROUTE_STAR, probe, NULL, (ELEMENT_FREE) probe_free));
+            pt_raise_event(loop, event_create(TRACEROUTE_STAR, probe_ref(probe), NULL, (ELEMENT_FREE) probe_free));
             break;
 
         case ALGORITHM_TERM:
@@ -430,8 +411,8 @@ int traceroute_loop_handler(pt_loop_t * loop, event_t * event, void ** pdata, pr
             break;
     }
 
-    // Forward event to the caller
-    pt_throw(loop, loop->cur_instance->caller, event);
+    // Forward event to the caller (the loop releases our own reference)
+    pt_throw(loop, loop->cur_instance->caller, event_ref(event));
 
     // Explore next hop
     if ((data->num_replies % options->num_probes) == 0) {
@@ -475,15 +456,9 @@ HAS_TERMINATED:
     if (has_terminated) {
         pt_raise_terminated(loop);
     }
-
-    // Handled event must always been free when leaving the handler
-    event_free(event);
     return 0;
 
 FAILURE:
-    // Handled event must always been free when leaving the handler
-    event_free(event);
-
     // Sent to the current instance a ALGORITHM_FAILURE notification.
     // The caller has to free the data allocated by the algorithm.
     pt_raise_error(loop);
@@ -7,7 +7,8 @@
 
 #include "../address.h"  // address_t
 #include "../pt_loop.h"  // pt_loop_t
-#include "../dynarray.h" // dynarray_t
+#include "../probe_template.h" // probe_template_t
+#include "../field_handle.h" // field_handle_t
 #include "../options.h"  // option_t
 
 #define OPTIONS_TRACEROUTE_MIN_TTL_DEFAULT            1
@@ -114,14 +115,25 @@ typedef struct {
 } traceroute_event_t;
 
 typedef struct {
-    bool          destination_reached; /**< True iif the destination has been reached at least once for the current TTL */
-    uint8_t       ttl;                 /**< TTL currently explored                   */
-    size_t        num_replies;         /**< Total of probe sent for this instance    */
-    size_t        num_undiscovered;    /**< Number of consecutive undiscovered hops  */
-    size_t        num_stars;           /**< Number of probe lost for the current hop */
-    dynarray_t  * probes;              /**< Probe instances allocated by traceroute  */
+    bool               destination_reached; /**< True iif the destination has been reached at least once for the current TTL */
+    uint8_t            ttl;                 /**< TTL currently explored                   */
+    size_t             num_replies;         /**< Total of probe sent for this instance    */
+    size_t             num_undiscovered;    /**< Number of consecutive undiscovered hops  */
+    size_t             num_stars;           /**< Number of probe lost for the current hop */
+    probe_template_t * probe_template;      /**< Compiled probe skeleton (NULL until the first probe is sent) */
+    field_handle_t     ttl_handle;          /**< TTL of a probe */
+    field_handle_t     src_ip_handle;       /**< Source IP of a reply */
 } traceroute_data_t;
 
+/**
+ * \brief Release a traceroute_data_t instance from the memory. The caller
+ *    must only call this function if it deletes the instance before the
+ *    instance has handled its ALGORITHM_TERM event (see pt_del_instance).
+ * \param traceroute_data The traceroute_data_t instance we want to release.
+ */
+
+void traceroute_data_free(traceroute_data_t * traceroute_data);
+
 //-----------------------------------------------------------------
 // Traceroute default handler
 //-----------------------------------------------------------------
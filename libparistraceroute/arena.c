@@ -0,0 +1,105 @@
+#include "config.h"
+
+#include <stdlib.h>     // malloc, free
+#include <string.h>     // memcpy, memset
+
+#include "arena.h"
+
+// Size of a block (header included)
+#define ARENA_BLOCK_SIZE 16384
+
+// Alignment of the objects
+#define ARENA_ALIGN(size) (((size) + 15) & ~((size_t) 15))
+
+// Size of the header of a block (the address of the next block)
+#define ARENA_HEADER_SIZE ARENA_ALIGN(sizeof(void *))
+
+// Objects larger than this size get a dedicated block, so that the
+// free bytes of the current block are not wasted.
+#define ARENA_MAX_SHARED_SIZE (ARENA_BLOCK_SIZE / 4)
+
+/**
+ * \brief Allocate a new block in an arena.
+ * \param arena An arena_t instance.
+ * \param size The number of bytes usable in this block.
+ * \return The address of the first usable byte if successful, NULL otherwise.
+ */
+
+static char * arena_add_block(arena_t * arena, size_t size) {
+    void ** block;
+
+    if (!(block = malloc(ARENA_HEADER_SIZE + size))) return NULL;
+    *block = arena->blocks;
+    arena->blocks = block;
+    arena->num_blocks++;
+    return (char *) block + ARENA_HEADER_SIZE;
+}
+
+arena_t * arena_create() {
+    return calloc(1, sizeof(arena_t));
+}
+
+void arena_free(arena_t * arena) {
+    void * block, * next;
+
+    if (arena) {
+        for (block = arena->blocks; block; block = next) {
+            next = *(void **) block;
+            free(block);
+        }
+        free(arena);
+    }
+}
+
+void * arena_alloc(arena_t * arena, size_t size) {
+    char * object;
+
+    size = ARENA_ALIGN(size);
+
+    if (size > arena->num_left) {
+        if (size > ARENA_MAX_SHARED_SIZE) {
+            if (!(object = arena_add_block(arena, size))) return NULL;
+            arena->num_bytes += size;
+            return object;
+        }
+
+        // The free bytes of the current block (if any) are given up
+        if (!(arena->cur = arena_add_block(arena, ARENA_BLOCK_SIZE - ARENA_HEADER_SIZE))) {
+            arena->num_left = 0;
+            return NULL;
+        }
+        arena->num_left = ARENA_BLOCK_SIZE - ARENA_HEADER_SIZE;
+    }
+
+    object = arena->cur;
+    arena->cur += size;
+    arena->num_left -= size;
+    arena->num_bytes += size;
+    return object;
+}
+
+void * arena_calloc(arena_t * arena, size_t size) {
+    void * object;
+
+    if ((object = arena_alloc(arena, size))) {
+        memset(object, 0, size);
+    }
+    return object;
+}
+
+void * arena_dup(arena_t * arena, const void * object, size_t size) {
+    void * dup;
+
+    if ((dup = arena_alloc(arena, size))) {
+        memcpy(dup, object, size);
+    }
+    return dup;
+}
+
+size_t arena_get_num_bytes(const arena_t * arena) {
+    return arena->num_bytes;
+}
+
+size_t arena_get_num_blocks(const arena_t * arena) {
+    return arena->num_blocks;
+}
@@ -0,0 +1,90 @@
+#ifndef LIBPT_ARENA_H
+#define LIBPT_ARENA_H
+
+/**
+ * \file arena.h
+ * \brief Header file: bump allocator.
+ *
+ * An arena_t carves the objects it allocates out of large memory blocks,
+ * by bumping a pointer. Objects are never released individually: they
+ * are all released at once along with their arena (see arena_free).
+ * This suits the objects sharing the lifetime of an algorithm instance
+ * (e.g. the lattice discovered by MDA), which are numerous, small, and
+ * would otherwise be freed one by one.
+ */
+
+#include <stddef.h>  // size_t
+
+/**
+ * \struct arena_t
+ * \brief Structure representing a bump allocator.
+ */
+
+typedef struct {
+    void   * blocks;     /**< Allocated blocks (each one starts with the address of the next one) */
+    char   * cur;        /**< First free byte of the current block */
+    size_t   num_left;   /**< Number of free bytes in the current block */
+    size_t   num_blocks; /**< Number of allocated blocks */
+    size_t   num_bytes;  /**< Number of bytes handed out so far */
+} arena_t;
+
+/**
+ * \brief Create an empty arena.
+ * \return The newly allocated arena if successful, NULL otherwise.
+ */
+
+arena_t * arena_create();
+
+/**
+ * \brief Release an arena and every object allocated from it.
+ * \param arena An arena_t instance.
+ */
+
+void arena_free(arena_t * arena);
+
+/**
+ * \brief Allocate an object from an arena. The returned address
+ *    is suitably aligned for any type.
+ * \param arena An arena_t instance.
+ * \param size The size of the object.
+ * \return The address of the object if successful, NULL otherwise.
+ */
+
+void * arena_alloc(arena_t * arena, size_t size);
+
+/**
+ * \brief Allocate an object from an arena and set it to zero.
+ * \param arena An arena_t instance.
+ * \param size The size of the object.
+ * \return The address of the object if successful, NULL otherwise.
+ */
+
+void * arena_calloc(arena_t * arena, size_t size);
+
+/**
+ * \brief Copy an object into an arena.
+ * \param arena An arena_t instance.
+ * \param object The object to copy.
+ * \param size The size of the object.
+ * \return The address of the copy if successful, NULL otherwise.
+ */
+
+void * arena_dup(arena_t * arena, const void * object, size_t size);
+
+/**
+ * \brief Retrieve the number of bytes allocated from an arena.
+ * \param arena An arena_t instance.
+ * \return The corresponding number of bytes (alignment included).
+ */
+
+size_t arena_get_num_bytes(const arena_t * arena);
+
+/**
+ * \brief Retrieve the number of blocks allocated by an arena.
+ * \param arena An arena_t instance.
+ * \return The corresponding number of blocks (i.e. of calls to malloc).
+ */
+
+size_t arena_get_num_blocks(const arena_t * arena);
+
+#endif // LIBPT_ARENA_H
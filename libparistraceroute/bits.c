@@ -1,6 +1,5 @@
 #include "config.h"
 
-#include <assert.h> // assert
 #include <stdlib.h> // malloc, free
 #include <stdio.h>  // FILE *
 #include <string.h> // memcpy
@@ -133,60 +132,183 @@ void byte_dump(uint8_t byte) {
 
 //---------------------------------------------------------------------------
 // Bit-level operations on one or more bytes
+//
+// Bits are moved through 64-bit words: the bytes covering the relevant
+// bits are loaded in a big-endian word (the first bit of the sequence is
+// then the most significant one), shifted and masked, and stored back.
+// At most BITS_CHUNK_SIZE bits are moved per word, so that a chunk
+// starting at any bit of its first byte fits in the word.
 //---------------------------------------------------------------------------
 
+#define BITS_CHUNK_SIZE 56
+
+#define BITS_MOVE(p, offset, num_bits) \
+  p     += (offset + num_bits) >> 3; \
+  offset = (offset + num_bits) % 8
+
+/**
+ * \brief Convert a 64-bit word from the host-side endianness to the
+ *    big-endian order, and vice versa.
+ * \param word The word to convert.
+ * \return The converted word.
+ */
+
+static inline uint64_t bits_swap_word(uint64_t word) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return word;
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return __builtin_bswap64(word);
+#else
+#   error "bits.c: unsupported byte order"
+#endif
+}
+
+/**
+ * \brief Load up to 8 bytes in a word. The first byte is stored in the most
+ *    significant byte of the word and the missing bytes are set to 0.
+ *    When num_bytes == 8, this is a single (possibly unaligned) load.
+ * \param bytes The loaded bytes.
+ * \param num_bytes The number of bytes to load (<= 8).
+ * \return The corresponding word.
+ */
+
+static inline uint64_t bits_load(const uint8_t * bytes, size_t num_bytes) {
+    uint64_t word = 0;
+    size_t   i;
+
+    if (num_bytes == sizeof(uint64_t)) {
+        memcpy(&word, bytes, sizeof(uint64_t));
+        return bits_swap_word(word);
+    }
+
+    // Never read beyond the last relevant byte.
+    for (i = 0; i < num_bytes; i++) {
+        word |= (uint64_t) bytes[i] << (56 - 8 * i);
+    }
+    return word;
+}
+
+/**
+ * \brief Store the num_bytes most significant bytes of a word.
+ * \param bytes The output bytes.
+ * \param num_bytes The number of bytes to store (<= 8).
+ * \param word The stored word.
+ */
+
+static inline void bits_store(uint8_t * bytes, size_t num_bytes, uint64_t word) {
+    size_t i;
+
+    if (num_bytes == sizeof(uint64_t)) {
+        word = bits_swap_word(word);
+        memcpy(bytes, &word, sizeof(uint64_t));
+        return;
+    }
+
+    for (i = 0; i < num_bytes; i++) {
+        bytes[i] = word >> (56 - 8 * i);
+    }
+}
+
+/**
+ * \brief Copy a sequence of bits.
+ * \param out The output bytes (updated).
+ * \param offset_out The offset of the first bit written in out (< 8).
+ * \param in The input bytes.
+ * \param offset_in The offset of the first bit read in in (< 8).
+ * \param length_in_bits The number of bits to copy.
+ */
+
+static void bits_copy(
+    uint8_t       * out,
+    size_t          offset_out,
+    const uint8_t * in,
+    size_t          offset_in,
+    size_t          length_in_bits
+) {
+    uint64_t value, mask, word;
+    size_t   i, n, num_bytes_in, num_bytes_out;
+
+    // Byte-aligned sequences: copy the whole bytes, then merge the last bits.
+    if (!offset_in && !offset_out) {
+        n = length_in_bits >> 3;
+        if (n <= sizeof(uint64_t)) {
+            // Header fields: cheaper than a call to memcpy
+            for (i = 0; i < n; i++) out[i] = in[i];
+        } else {
+            memcpy(out, in, n);
+        }
+        if (length_in_bits % 8) {
+            mask = make_msb_mask(length_in_bits % 8);
+            out[n] = (out[n] & ~mask) | (in[n] & mask);
+        }
+        return;
+    }
+
+    for (; length_in_bits; length_in_bits -= n) {
+        n = MIN(length_in_bits, BITS_CHUNK_SIZE);
+        num_bytes_in  = (offset_in  + n + 7) >> 3;
+        num_bytes_out = (offset_out + n + 7) >> 3;
+
+        // Fetch n bits, right-aligned in value.
+        value = (bits_load(in, num_bytes_in) << offset_in) >> (64 - n);
+
+        // Update the n bits of the output word starting at offset_out.
+        mask = ((~(uint64_t) 0) >> (64 - n)) << (64 - offset_out - n);
+        word = bits_load(out, num_bytes_out);
+        word = (word & ~mask) | (value << (64 - offset_out - n));
+        bits_store(out, num_bytes_out, word);
+
+        BITS_MOVE(out, offset_out, n);
+        BITS_MOVE(in,  offset_in,  n);
+    }
+}
+
 uint8_t * bits_extract(
     const uint8_t * bytes,
     size_t          offset_in_bits,
     size_t          length_in_bits,
     uint8_t       * dest
 ) {
-    size_t  i          = offset_in_bits >> 3,
-            idest      = 0,
-            j,
-            num_bits   = length_in_bits % 8,  // Number of bits extracted from the first byte
-            num_bytes  = length_in_bits >> 3, // Number of complete byte to extract
-            offset     = (offset_in_bits + num_bits) % 8,
-            size       = num_bytes + (num_bits ? 1 : 0);
-    uint8_t msb, lsb;
-    bool    is_aligned = ((offset_in_bits + length_in_bits % 8) == 0);
+    uint64_t value;
+    size_t   i,
+             size = (length_in_bits + 7) >> 3,
+             pad  = 8 * size - length_in_bits;
 
     // Allocate the destination buffer
     if (!dest) {
         if (!(dest = calloc(1, size))) goto ERR_CALLOC;
     }
+    if (!size) return dest;
 
-    // Grab the n first bits from the first relevant byte (i)
-    // and store them in the 1st destination byte.
-    if (num_bits) {
-        dest[idest++] = byte_extract(bytes[i++], offset_in_bits, num_bits, 8 - num_bits);
-    }
+    bytes += offset_in_bits >> 3;
+    offset_in_bits %= 8;
 
-    // Retrieve the num_bytes remaining bytes to duplicate
-    // into dest.
-    for (j = 0; j < num_bytes; ++j, ++idest, ++i) {
-        if (is_aligned) {
-            dest[idest] = bytes[i];
+    if (!offset_in_bits && !pad) {
+        // Byte-aligned field
+        if (size <= sizeof(uint64_t)) {
+            for (i = 0; i < size; i++) dest[i] = bytes[i];
         } else {
-            // Fetch the 'idest'-th byte of 'dest'
-            // - its 'offset' most significant bits are in bytes[i-1]
-            // - its remaining less significant bits are in bytes[i]
-            msb = byte_extract(bytes[i - 1], offset, 8 - offset, 0);
-            lsb = byte_extract(bytes[i], 0, offset, 8 - offset);
-            dest[idest] = msb | lsb;
+            memcpy(dest, bytes, size);
+        }
+    } else if (length_in_bits <= BITS_CHUNK_SIZE) {
+        // Fetch the bits right-aligned in a word, then store its 'size'
+        // least significant bytes (big-endian) in dest.
+        value = (bits_load(bytes, (offset_in_bits + length_in_bits + 7) >> 3) << offset_in_bits) >> (64 - length_in_bits);
+        for (i = 0; i < size; i++) {
+            dest[i] = value >> (8 * (size - 1 - i));
         }
+    } else {
+        // The extracted bits are right-aligned in dest: its 'pad' most
+        // significant bits are set to 0.
+        if (pad) dest[0] = 0;
+        bits_copy(dest, pad, bytes, offset_in_bits, length_in_bits);
     }
-
     return dest;
 
 ERR_CALLOC:
     return NULL;
 }
 
-#define BITS_MOVE(p, offset, num_bits) \
-  p     += (offset + num_bits) >> 3; \
-  offset = (offset + num_bits) % 8
-
 bool bits_write(
     uint8_t       * out,
     const size_t    offset_in_bits_out,
@@ -194,120 +316,12 @@ bool bits_write(
     const size_t    offset_in_bits_in,
     size_t          length_in_bits
 ) {
-    bool success = true;
-
-    // Notations:
-    //   . bit not modified
-    //   X bit being updated (same for Y) at this step.
-    //   * bit to be update, but not in this step.
-    //   | corresponds to byte bounds in the output.
-    // Principle:
-    //   Writting .....**|********|** is achieved in three steps.
-    // Steps:
-    //   1) Write .....XX|********|**.....
-    //   2) Write .....**|XXXXXXXX|**....
-    //   3) Write .....**|********|XX....
-
-    size_t num_remaining_bits = length_in_bits;
-    size_t n;
-    size_t offset_out = offset_in_bits_out;
-    size_t offset_in  = offset_in_bits_in;
-
-    if (offset_in  >= 8) {
-        fprintf(stderr, "bits_write: offset_in (%zu) must be < 8\n", offset_in);
-        return false;
-    }
-    if (offset_out  >= 8) {
-        fprintf(stderr, "bits_write: offset_out (%zu) must be < 8\n", offset_out);
-        return false;
-    }
-
-    // 1st output (incomplete) byte:
-    if (offset_out) {
-
-        // Case 1:
-        //     in: |.....XXX|YY******|
-        //    out: |...XXXYY|********|
-        // Case 2:
-        //     in: |...XXX**|********|
-        //    out: |.....XXX|********|
-        // Case 3:
-        //     in: |XXX*****|
-        //    out: |.....XXX|
-
-        // Cases 1, 2, 3: Write XXX
-        n = MIN(8 - MAX(offset_in, offset_out), num_remaining_bits);
-        success &= byte_write_bits(out, offset_out, *in, offset_in, n);
-        num_remaining_bits -= n;
-        assert(success);
-        BITS_MOVE(out, offset_out, n);
-        BITS_MOVE(in,  offset_in,  n);
-
-        // If case 1: Write YY|
-        if (offset_out) {
-            n = MIN(8 - n - offset_out, num_remaining_bits);
-            success &= byte_write_bits(out, offset_out, *in, offset_in, n);
-            num_remaining_bits -= n;
-            assert(success);
-            BITS_MOVE(out, offset_out, n);
-            BITS_MOVE(in,  offset_in,  n);
-        }
-    }
-
-    // Full output bytes
-    assert(!offset_out);
-    if (!offset_in) {
-        n = num_remaining_bits >> 3;
-        memcpy(out, in, n);
-        num_remaining_bits -= n << 3;
-    } else {
-        for (; num_remaining_bits >= 8; num_remaining_bits -= 8) {
-            //  in: |***XXXXX|YYY.....
-            // out: |XXXXXYYY|
-
-            // Write |XXXXX***|
-            n = MIN(8 - offset_in, num_remaining_bits);
-            success &= byte_write_bits(out, offset_out, *in, offset_in, n);
-            assert(success);
-            BITS_MOVE(out, offset_out, n);
-            BITS_MOVE(in,  offset_in,  n);
-
-            // Write |*****YYY|
-            n = MIN(8 - n, num_remaining_bits);
-            success &= byte_write_bits(out, offset_out, *in, offset_in, n);
-            assert(success);
-            BITS_MOVE(out, offset_out, n);
-            BITS_MOVE(in,  offset_in,  n);
-        }
-    }
-
-    // Last byte
-    n = num_remaining_bits;
-    assert(n < 8);
-    assert(offset_out == 0);
-    if (n) {
-        // Case1:
-        //    in: |**XXX...|
-        //   out: |XXX.....|
-        // Case2:
-        //    in: |*****XXX|YY......
-        //   out: |XXXYY...|
-
-        // Case 1, 2: Write XXX
-        n = MIN(8 - offset_in, num_remaining_bits);
-        success &= byte_write_bits(out, offset_out, *in, offset_in, n);
-        num_remaining_bits -= n;
-        assert(success);
-
-        // Case 2: Write YY (if any)
-        if (num_remaining_bits) {
-            n = num_remaining_bits;
-            success &= byte_write_bits(out, 0, *in, offset_in, n);
-            assert(success);
-        }
-    }
-
-    return success;
+    bits_copy(
+        out + (offset_in_bits_out >> 3), offset_in_bits_out % 8,
+        in  + (offset_in_bits_in  >> 3), offset_in_bits_in  % 8,
+        length_in_bits
+    );
+    return true;
 }
 
 void bits_fprintf(FILE * out, const uint8_t * bytes, size_t num_bits, size_t offset_in_bits) {
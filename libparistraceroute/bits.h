@@ -106,10 +106,10 @@ uint8_t * bits_extract(
  *    of input bits.
  * \param out The address of the output sequence of bits
  * \param offset_in_bits_out The offset of the first bit we
- *    write in out.
+ *    write in out. It may exceed 7.
  * \param in The sequence of bits we read to update out.
- * \param offset_in_bits_out The offset of the first bit we
- *    read in the input bits.
+ * \param offset_in_bits_in The offset of the first bit we
+ *    read in the input bits. It may exceed 7.
  * \param size_in_bits The number of bits copied from
  *    in to out.
  * \return true iif successful
@@ -5,11 +5,12 @@
 #include <string.h>
 
 #include "buffer.h"
+#include "pool.h"       // pools_alloc, pool_release
 
 buffer_t * buffer_create() {
     buffer_t * buffer;
 
-    if ((buffer = malloc(sizeof(buffer_t)))) {
+    if ((buffer = pools_alloc(POOL_BUFFER))) {
         buffer->data = NULL;
         buffer->size = 0;
     }
@@ -28,7 +29,7 @@ buffer_t * buffer_dup(const buffer_t * buffer) {
     return ret;
 
 ERR_BUFFER_DATA:
-    free(ret);
+    pool_release(ret);
 ERR_BUFFER_CREATE:
 ERR_INVALID_PARAMETER:
     return NULL;
@@ -39,7 +40,7 @@ void buffer_free(buffer_t * buffer) {
         if (buffer->data) {
             free(buffer->data);
         }
-        free(buffer);
+        pool_release(buffer);
     }
 }
 
@@ -0,0 +1,351 @@
+#include "use.h"
+#include "config.h"
+
+#include <string.h>         // memcpy, strcmp
+
+#include "checksum.h"
+
+#ifdef USE_SIMD_CHECKSUM
+#  if defined(__x86_64__)
+#    include <immintrin.h>  // _mm*
+#  elif defined(__aarch64__)
+#    include <arm_neon.h>   // v*q_*
+#    include <sys/auxv.h>   // getauxval
+#  endif
+#endif
+
+/**
+ * \struct csum_impl_t
+ * \brief An implementation of the Internet checksum.
+ */
+
+typedef struct {
+    const char * name;                                                               /**< Name of the implementation */
+    bool     (* is_supported)();                                                     /**< Returns true iif the running CPU supports it */
+    uint32_t (* partial)(const void * bytes, size_t size, uint32_t sum);             /**< See csum_partial */
+    uint32_t (* partial_copy)(void * dst, const void * src, size_t size, uint32_t sum); /**< See csum_partial_copy */
+} csum_impl_t;
+
+//---------------------------------------------------------------------------
+// Portable implementation
+//---------------------------------------------------------------------------
+
+// A 32-bit word (resp. 64-bit) is congruent modulo 0xffff to the sum of its
+// 16-bit words, since 2^16 (resp. 2^32) is congruent to 1. The words may
+// thus be summed 32 bits at a time in a 64-bit accumulator, whatever the
+// byte order, and the accumulator is folded back to 32 bits at the end.
+
+static inline uint32_t csum_fold64(uint64_t sum) {
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    return (uint32_t) sum;
+}
+
+/**
+ * \brief Sum the bytes that remain once the vectorized loop has been
+ *    processed (see csum_partial).
+ * \param bytes Bytes to add.
+ * \param size Number of bytes to consider (less than 8).
+ * \param sum The partial sum.
+ * \return The updated partial sum.
+ */
+
+static inline uint64_t csum_tail(const uint8_t * bytes, size_t size, uint64_t sum) {
+    uint32_t word32;
+    uint16_t word16;
+
+    if (size >= sizeof(uint32_t)) {
+        memcpy(&word32, bytes, sizeof(uint32_t));
+        sum   += word32;
+        bytes += sizeof(uint32_t);
+        size  -= sizeof(uint32_t);
+    }
+    if (size >= sizeof(uint16_t)) {
+        memcpy(&word16, bytes, sizeof(uint16_t));
+        sum   += word16;
+        bytes += sizeof(uint16_t);
+        size  -= sizeof(uint16_t);
+    }
+
+    // As the former implementation, the odd trailing byte is summed as is
+    if (size) sum += *bytes;
+    return sum;
+}
+
+static bool csum_word_is_supported() {
+    return true;
+}
+
+static uint32_t csum_word_partial(const void * bytes, size_t size, uint32_t sum) {
+    const uint8_t * src = bytes;
+    uint64_t        acc = sum, word;
+
+    for (; size >= sizeof(uint64_t); src += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        memcpy(&word, src, sizeof(uint64_t));
+        acc += (word & 0xffffffff) + (word >> 32);
+    }
+    return csum_fold64(csum_tail(src, size, acc));
+}
+
+static uint32_t csum_word_partial_copy(void * dst, const void * src, size_t size, uint32_t sum) {
+    const uint8_t * s   = src;
+    uint8_t       * d   = dst;
+    uint64_t        acc = sum, word;
+
+    for (; size >= sizeof(uint64_t); s += sizeof(uint64_t), d += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        memcpy(&word, s, sizeof(uint64_t));
+        memcpy(d, &word, sizeof(uint64_t));
+        acc += (word & 0xffffffff) + (word >> 32);
+    }
+    memcpy(d, s, size);
+    return csum_fold64(csum_tail(s, size, acc));
+}
+
+//---------------------------------------------------------------------------
+// x86-64 implementations
+//---------------------------------------------------------------------------
+
+#if defined(USE_SIMD_CHECKSUM) && defined(__x86_64__)
+
+// The 16-bit words of each vector are zero-extended to 32 bits (even words
+// are masked, odd words are shifted) and accumulated in 32-bit lanes. Each
+// lane of an accumulator grows by at most 0xffff per vector, so accumulators
+// are flushed in a 64-bit sum every CSUM_MAX_VECTORS vectors.
+
+#define CSUM_MAX_VECTORS 0x8000
+
+static bool csum_sse2_is_supported() {
+    return true; // SSE2 is part of x86-64
+}
+
+static inline uint64_t csum_sse2_reduce(__m128i acc) {
+    uint32_t lanes[4];
+
+    _mm_storeu_si128((__m128i *) lanes, acc);
+    return (uint64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+static uint32_t csum_sse2_partial_impl(uint8_t * dst, const uint8_t * src, size_t size, uint32_t sum) {
+    const __m128i mask  = _mm_set1_epi32(0xffff);
+    uint64_t      total = sum;
+    size_t        num_vectors;
+    __m128i       acc0, acc1, v;
+
+    while (size >= sizeof(__m128i)) {
+        acc0 = acc1 = _mm_setzero_si128();
+        num_vectors = size / sizeof(__m128i);
+        if (num_vectors > CSUM_MAX_VECTORS) num_vectors = CSUM_MAX_VECTORS;
+        size -= num_vectors * sizeof(__m128i);
+
+        for (; num_vectors; num_vectors--, src += sizeof(__m128i)) {
+            v = _mm_loadu_si128((const __m128i *) src);
+            if (dst) {
+                _mm_storeu_si128((__m128i *) dst, v);
+                dst += sizeof(__m128i);
+            }
+            acc0 = _mm_add_epi32(acc0, _mm_and_si128(v, mask));
+            acc1 = _mm_add_epi32(acc1, _mm_srli_epi32(v, 16));
+        }
+        total += csum_sse2_reduce(acc0) + csum_sse2_reduce(acc1);
+    }
+    if (dst) memcpy(dst, src, size);
+
+    return csum_word_partial(src, size, csum_fold64(total));
+}
+
+static uint32_t csum_sse2_partial(const void * bytes, size_t size, uint32_t sum) {
+    return csum_sse2_partial_impl(NULL, bytes, size, sum);
+}
+
+static uint32_t csum_sse2_partial_copy(void * dst, const void * src, size_t size, uint32_t sum) {
+    return csum_sse2_partial_impl(dst, src, size, sum);
+}
+
+static bool csum_avx2_is_supported() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static uint32_t csum_avx2_partial_impl(uint8_t * dst, const uint8_t * src, size_t size, uint32_t sum) {
+    const __m256i mask  = _mm256_set1_epi32(0xffff);
+    uint64_t      total = sum;
+    size_t        num_vectors;
+    __m256i       acc0, acc1, v;
+
+    while (size >= sizeof(__m256i)) {
+        acc0 = acc1 = _mm256_setzero_si256();
+        num_vectors = size / sizeof(__m256i);
+        if (num_vectors > CSUM_MAX_VECTORS) num_vectors = CSUM_MAX_VECTORS;
+        size -= num_vectors * sizeof(__m256i);
+
+        for (; num_vectors; num_vectors--, src += sizeof(__m256i)) {
+            v = _mm256_loadu_si256((const __m256i *) src);
+            if (dst) {
+                _mm256_storeu_si256((__m256i *) dst, v);
+                dst += sizeof(__m256i);
+            }
+            acc0 = _mm256_add_epi32(acc0, _mm256_and_si256(v, mask));
+            acc1 = _mm256_add_epi32(acc1, _mm256_srli_epi32(v, 16));
+        }
+        total += csum_sse2_reduce(_mm256_castsi256_si128(acc0)) + csum_sse2_reduce(_mm256_extracti128_si256(acc0, 1))
+              +  csum_sse2_reduce(_mm256_castsi256_si128(acc1)) + csum_sse2_reduce(_mm256_extracti128_si256(acc1, 1));
+    }
+
+    // Avoid the AVX-SSE transition penalty, then process the remaining
+    // bytes (if any) with the SSE2 implementation
+    _mm256_zeroupper();
+    return csum_sse2_partial_impl(dst, src, size, csum_fold64(total));
+}
+
+static uint32_t csum_avx2_partial(const void * bytes, size_t size, uint32_t sum) {
+    return csum_avx2_partial_impl(NULL, bytes, size, sum);
+}
+
+static uint32_t csum_avx2_partial_copy(void * dst, const void * src, size_t size, uint32_t sum) {
+    return csum_avx2_partial_impl(dst, src, size, sum);
+}
+
+#endif
+
+//---------------------------------------------------------------------------
+// aarch64 implementation
+//---------------------------------------------------------------------------
+
+#if defined(USE_SIMD_CHECKSUM) && defined(__aarch64__)
+
+// Adjacent 16-bit words are summed and accumulated in 32-bit lanes
+// (vpadalq_u16). Each lane grows by at most 2 * 0xffff per vector, so the
+// accumulator is flushed in 64-bit lanes every CSUM_MAX_VECTORS vectors.
+
+#define CSUM_MAX_VECTORS 0x4000
+
+static bool csum_neon_is_supported() {
+#ifdef HWCAP_ASIMD
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#else
+    return true;
+#endif
+}
+
+static uint32_t csum_neon_partial_impl(uint8_t * dst, const uint8_t * src, size_t size, uint32_t sum) {
+    uint64x2_t total = vdupq_n_u64(0);
+    uint32x4_t acc;
+    uint8x16_t v;
+    size_t     num_vectors;
+
+    while (size >= sizeof(uint8x16_t)) {
+        acc = vdupq_n_u32(0);
+        num_vectors = size / sizeof(uint8x16_t);
+        if (num_vectors > CSUM_MAX_VECTORS) num_vectors = CSUM_MAX_VECTORS;
+        size -= num_vectors * sizeof(uint8x16_t);
+
+        for (; num_vectors; num_vectors--, src += sizeof(uint8x16_t)) {
+            v = vld1q_u8(src);
+            if (dst) {
+                vst1q_u8(dst, v);
+                dst += sizeof(uint8x16_t);
+            }
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(v));
+        }
+        total = vpadalq_u32(total, acc);
+    }
+    if (dst) memcpy(dst, src, size);
+
+    return csum_word_partial(src, size, csum_fold64(vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1) + sum));
+}
+
+static uint32_t csum_neon_partial(const void * bytes, size_t size, uint32_t sum) {
+    return csum_neon_partial_impl(NULL, bytes, size, sum);
+}
+
+static uint32_t csum_neon_partial_copy(void * dst, const void * src, size_t size, uint32_t sum) {
+    return csum_neon_partial_impl(dst, src, size, sum);
+}
+
+#endif
+
+//---------------------------------------------------------------------------
+// Runtime dispatch
+//---------------------------------------------------------------------------
+
+// Implementations, from the fastest to the slowest one
+static const csum_impl_t csum_impls[] = {
+#if defined(USE_SIMD_CHECKSUM) && defined(__x86_64__)
+    { "avx2", csum_avx2_is_supported, csum_avx2_partial, csum_avx2_partial_copy },
+    { "sse2", csum_sse2_is_supported, csum_sse2_partial, csum_sse2_partial_copy },
+#endif
+#if defined(USE_SIMD_CHECKSUM) && defined(__aarch64__)
+    { "neon", csum_neon_is_supported, csum_neon_partial, csum_neon_partial_copy },
+#endif
+    { "word", csum_word_is_supported, csum_word_partial, csum_word_partial_copy }
+};
+
+#define NUM_CSUM_IMPLS (sizeof(csum_impls) / sizeof(csum_impl_t))
+
+// Shorter sequences (headers, pseudo headers...) are summed faster
+// by the portable implementation.
+#define CSUM_MIN_VECTORIZED_SIZE 64
+
+// The last implementation is always supported
+static const csum_impl_t * csum_impl = &csum_impls[NUM_CSUM_IMPLS - 1];
+
+static void csum_init() __attribute__((constructor));
+
+static void csum_init() {
+    size_t i;
+
+    for (i = 0; i < NUM_CSUM_IMPLS; i++) {
+        if (csum_impls[i].is_supported()) {
+            csum_impl = &csum_impls[i];
+            break;
+        }
+    }
+}
+
+const char * csum_get_implementation() {
+    return csum_impl->name;
+}
+
+bool csum_set_implementation(const char * name) {
+    size_t i;
+
+    for (i = 0; i < NUM_CSUM_IMPLS; i++) {
+        if (strcmp(csum_impls[i].name, name) == 0) {
+            if (!csum_impls[i].is_supported()) break;
+            csum_impl = &csum_impls[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------
+// Public functions
+//---------------------------------------------------------------------------
+
+uint16_t csum(const uint16_t * bytes, size_t size) {
+    return (uint16_t) ~csum_fold(csum_partial(bytes, size, 0));
+}
+
+uint32_t csum_partial(const void * bytes, size_t size, uint32_t sum) {
+    return size < CSUM_MIN_VECTORIZED_SIZE ?
+        csum_word_partial(bytes, size, sum) :
+        csum_impl->partial(bytes, size, sum);
+}
+
+uint32_t csum_partial_copy(void * dst, const void * src, size_t size, uint32_t sum) {
+    return size < CSUM_MIN_VECTORIZED_SIZE ?
+        csum_word_partial_copy(dst, src, size, sum) :
+        csum_impl->partial_copy(dst, src, size, sum);
+}
+
+uint16_t csum_fold(uint32_t sum) {
+    sum  = (sum >> 16) + (sum & 0xffff);
+    sum += (sum >> 16);
+    return (uint16_t) sum;
+}
+
+uint16_t csum_adjust(uint16_t checksum, uint16_t old_sum, uint16_t new_sum) {
+    return (uint16_t) ~csum_fold((uint32_t) (uint16_t) ~checksum + (uint16_t) ~old_sum + new_sum);
+}
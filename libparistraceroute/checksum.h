@@ -0,0 +1,88 @@
+#ifndef LIBPT_CHECKSUM_H
+#define LIBPT_CHECKSUM_H
+
+/**
+ * \file checksum.h
+ * \brief Header file: Internet checksum (RFC 1071).
+ *
+ * The 16-bit words of the checksummed bytes are summed by the fastest
+ * implementation supported by the running CPU (AVX2 or SSE2 on x86-64,
+ * NEON on aarch64, 64-bit words otherwise). It is selected at runtime the
+ * first time a checksum is computed.
+ */
+
+#include <stdbool.h>  // bool
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint*_t
+
+/**
+ * \brief Calculate an Internet checksum.
+ * \param bytes Bytes used to compute the checksum
+ * \param size Number of bytes to consider
+ * \return The corresponding checksum
+ */
+
+uint16_t csum(const uint16_t * buf, size_t size);
+
+/**
+ * \brief Add the 16-bit words of a sequence of bytes to a
+ *    partial Internet checksum.
+ * \param bytes Bytes to add. If size is odd, the last byte is
+ *    padded with zeros.
+ * \param size Number of bytes to consider
+ * \param sum The partial sum (0 to start a new sum)
+ * \return The updated partial sum
+ */
+
+uint32_t csum_partial(const void * bytes, size_t size, uint32_t sum);
+
+/**
+ * \brief Copy a sequence of bytes and add its 16-bit words to a partial
+ *    Internet checksum in a single pass (see csum_partial).
+ * \param dst The address where the bytes are copied. The source and
+ *    the destination must not overlap.
+ * \param src Bytes to copy and to add.
+ * \param size Number of bytes to consider
+ * \param sum The partial sum (0 to start a new sum)
+ * \return The updated partial sum
+ */
+
+uint32_t csum_partial_copy(void * dst, const void * src, size_t size, uint32_t sum);
+
+/**
+ * \brief Fold a partial Internet checksum into 16 bits.
+ * \param sum A partial sum (see csum_partial)
+ * \return The corresponding one's complement sum. csum() returns its complement.
+ */
+
+uint16_t csum_fold(uint32_t sum);
+
+/**
+ * \brief Update an Internet checksum once some of the bytes it covers
+ *    have been modified (RFC 1624, eqn. 3).
+ * \param checksum The former checksum
+ * \param old_sum The folded sum of the modified words (former values)
+ * \param new_sum The folded sum of the modified words (new values)
+ * \return The updated checksum
+ */
+
+uint16_t csum_adjust(uint16_t checksum, uint16_t old_sum, uint16_t new_sum);
+
+/**
+ * \brief Retrieve the name of the implementation used to compute
+ *    the checksums ("avx2", "sse2", "neon" or "word").
+ * \return The corresponding name.
+ */
+
+const char * csum_get_implementation();
+
+/**
+ * \brief Force the implementation used to compute the checksums
+ *    (for instance to compare or to benchmark them).
+ * \param name The name of the implementation (see csum_get_implementation).
+ * \return true iif this implementation is supported by the running CPU.
+ */
+
+bool csum_set_implementation(const char * name);
+
+#endif // LIBPT_CHECKSUM_H
@@ -39,6 +39,12 @@
 
 #define ELEMENT_COMPARE int (*)(const void *, const void *)
 
+/**
+ * \brief Type related to a *_hash() function
+ */
+
+#define ELEMENT_HASH size_t (*)(const void *)
+
 //---------------------------------------------------------------------------
 // Misc
 //---------------------------------------------------------------------------
@@ -0,0 +1,310 @@
+#include "config.h"
+
+#include <stdlib.h>     // malloc, calloc, free
+#include <string.h>     // memcpy, memset
+#include <assert.h>     // assert
+
+#include "hashmap.h"
+
+// A map has at least 2^HASHMAP_MIN_SLOTS_BITS slots
+#define HASHMAP_MIN_SLOTS_BITS 4
+
+// Alignment of the keys and of the values in an entry
+#define HASHMAP_ALIGN(size) (((size) + 7) & ~((size_t) 7))
+
+/**
+ * \brief Fold a hash to 32 bits.
+ * \param hash The value returned by the hash callback.
+ * \return The folded hash.
+ */
+
+static inline uint32_t hashmap_fold(size_t hash) {
+    uint64_t h = hash;
+    return (uint32_t) (h ^ (h >> 32));
+}
+
+/**
+ * \brief Compute the home slot of a hash (Fibonacci hashing).
+ * \param map A hashmap_t instance.
+ * \param hash A folded hash.
+ * \return The index of the home slot.
+ */
+
+static inline size_t hashmap_home(const hashmap_t * map, uint32_t hash) {
+    return (uint32_t) (hash * 2654435761u) >> (32 - map->slots_bits);
+}
+
+static inline uint8_t * hashmap_entry(const hashmap_t * map, size_t i) {
+    return map->entries + i * map->entry_size;
+}
+
+/**
+ * \brief Allocate the slots and the entries of a map.
+ * \param map A hashmap_t instance.
+ * \param slots_bits log2 of the number of slots.
+ * \return true iif successful.
+ */
+
+static bool hashmap_alloc_slots(hashmap_t * map, size_t slots_bits) {
+    size_t num_slots = (size_t) 1 << slots_bits;
+
+    if (!(map->slots = calloc(num_slots, sizeof(hashmap_slot_t)))) goto ERR_CALLOC;
+    if (!(map->entries = malloc(num_slots * map->entry_size)))     goto ERR_MALLOC;
+    map->num_slots = num_slots;
+    map->slots_bits = slots_bits;
+    return true;
+
+ERR_MALLOC:
+    free(map->slots);
+ERR_CALLOC:
+    return false;
+}
+
+/**
+ * \brief Search a key in a map.
+ * \param map A hashmap_t instance.
+ * \param key The key we're looking for.
+ * \param hash The folded hash of the key.
+ * \param pi Address of a size_t. If the key is found, *pi is set
+ *    to its slot. Otherwise, *pi is set to the slot where it would
+ *    be inserted.
+ * \param ppsl Address of a uint32_t, set to the psl of the key in *pi.
+ * \return true iif the key has been found.
+ */
+
+static bool hashmap_locate(const hashmap_t * map, const void * key, uint32_t hash, size_t * pi, uint32_t * ppsl) {
+    const hashmap_slot_t * slot;
+    size_t                 mask = map->num_slots - 1,
+                           i    = hashmap_home(map, hash);
+    uint32_t               psl;
+
+    // The load factor is under 1, so that a free slot is always met
+    for (psl = 1; ; i = (i + 1) & mask, psl++) {
+        slot = &map->slots[i];
+        if (slot->psl < psl) {
+            // Free slot, or entry closer to its home slot than the key
+            // would be: the key is not in the map.
+            *pi = i;
+            *ppsl = psl;
+            return false;
+        }
+        if (slot->hash == hash && map->compare(key, hashmap_entry(map, i)) == 0) {
+            *pi = i;
+            *ppsl = psl;
+            return true;
+        }
+    }
+}
+
+/**
+ * \brief Store an entry in a map, starting from a given slot. An entry
+ *    closer to its home slot than the carried one is displaced, and then
+ *    carried in turn, until a free slot is met.
+ * \param map A hashmap_t instance.
+ * \param i The first slot where the entry may be stored.
+ * \param psl The psl of the entry in this slot.
+ * \param hash The folded hash of the entry.
+ * \param entry The entry to store (entry_size bytes). It must not
+ *    overlap the first half of the scratch buffer.
+ */
+
+static void hashmap_place(hashmap_t * map, size_t i, uint32_t psl, uint32_t hash, const void * entry) {
+    hashmap_slot_t   carried = { .hash = hash, .psl = psl },
+                     tmp;
+    uint8_t        * carry = map->scratch,
+                   * swap  = map->scratch + map->entry_size,
+                   * p;
+    size_t           mask  = map->num_slots - 1;
+
+    memcpy(carry, entry, map->entry_size);
+
+    for (; ; i = (i + 1) & mask, carried.psl++) {
+        if (map->slots[i].psl == 0) {
+            map->slots[i] = carried;
+            memcpy(hashmap_entry(map, i), carry, map->entry_size);
+            return;
+        }
+
+        if (map->slots[i].psl < carried.psl) {
+            tmp = map->slots[i];
+            map->slots[i] = carried;
+            carried = tmp;
+
+            memcpy(swap, hashmap_entry(map, i), map->entry_size);
+            memcpy(hashmap_entry(map, i), carry, map->entry_size);
+            p = carry;
+            carry = swap;
+            swap = p;
+        }
+    }
+}
+
+/**
+ * \brief Double the number of slots of a map.
+ * \param map A hashmap_t instance.
+ * \return true iif successful.
+ */
+
+static bool hashmap_grow(hashmap_t * map) {
+    hashmap_slot_t * old_slots       = map->slots;
+    uint8_t        * old_entries     = map->entries;
+    size_t           old_num_slots   = map->num_slots,
+                     old_slots_bits  = map->slots_bits,
+                     i;
+
+    if (!hashmap_alloc_slots(map, old_slots_bits + 1)) {
+        map->slots = old_slots;
+        map->entries = old_entries;
+        return false;
+    }
+
+    // The keys are not hashed again
+    for (i = 0; i < old_num_slots; i++) {
+        if (old_slots[i].psl) {
+            hashmap_place(
+                map,
+                hashmap_home(map, old_slots[i].hash), 1, old_slots[i].hash,
+                old_entries + i * map->entry_size
+            );
+        }
+    }
+
+    free(old_slots);
+    free(old_entries);
+    return true;
+}
+
+hashmap_t * hashmap_create_impl(
+    size_t    key_size,
+    size_t    value_size,
+    size_t (* hash)(const void * key),
+    int    (* compare)(const void * key1, const void * key2)
+) {
+    hashmap_t * map;
+
+    assert(key_size > 0);
+    assert(hash);
+    assert(compare);
+
+    if (!(map = calloc(1, sizeof(hashmap_t)))) goto ERR_CALLOC;
+
+    map->key_size     = key_size;
+    map->value_size   = value_size;
+    map->value_offset = value_size ? HASHMAP_ALIGN(key_size) : key_size;
+    map->entry_size   = HASHMAP_ALIGN(map->value_offset + value_size);
+    map->hash         = hash;
+    map->compare      = compare;
+
+    if (!(map->scratch = malloc(2 * map->entry_size)))           goto ERR_MALLOC;
+    if (!hashmap_alloc_slots(map, HASHMAP_MIN_SLOTS_BITS))        goto ERR_ALLOC_SLOTS;
+    return map;
+
+ERR_ALLOC_SLOTS:
+    free(map->scratch);
+ERR_MALLOC:
+    free(map);
+ERR_CALLOC:
+    return NULL;
+}
+
+void hashmap_free(hashmap_t * map) {
+    if (map) {
+        free(map->slots);
+        free(map->entries);
+        free(map->scratch);
+        free(map);
+    }
+}
+
+void hashmap_clear(hashmap_t * map) {
+    memset(map->slots, 0, map->num_slots * sizeof(hashmap_slot_t));
+    map->num_entries = 0;
+}
+
+size_t hashmap_get_size(const hashmap_t * map) {
+    return map->num_entries;
+}
+
+void * hashmap_find(const hashmap_t * map, const void * key) {
+    size_t   i;
+    uint32_t psl;
+
+    if (!hashmap_locate(map, key, hashmap_fold(map->hash(key)), &i, &psl)) return NULL;
+    return hashmap_entry(map, i) + map->value_offset;
+}
+
+void * hashmap_insert(hashmap_t * map, const void * key, bool * pinserted) {
+    uint8_t  * entry;
+    size_t     i;
+    uint32_t   hash = hashmap_fold(map->hash(key)),
+               psl;
+    bool       found;
+
+    if (!(found = hashmap_locate(map, key, hash, &i, &psl))) {
+        // Keep the load factor of the map under 3/4
+        if (4 * (map->num_entries + 1) > 3 * map->num_slots) {
+            if (!hashmap_grow(map)) goto ERR_HASHMAP_GROW;
+            hashmap_locate(map, key, hash, &i, &psl);
+        }
+
+        // Build the entry in the second half of the scratch buffer
+        entry = map->scratch + map->entry_size;
+        memcpy(entry, key, map->key_size);
+        memset(entry + map->value_offset, 0, map->value_size);
+
+        // The new entry lands in slot i, the displaced ones move forward
+        hashmap_place(map, i, psl, hash, entry);
+        map->num_entries++;
+    }
+
+    if (pinserted) *pinserted = !found;
+    return hashmap_entry(map, i) + map->value_offset;
+
+ERR_HASHMAP_GROW:
+    return NULL;
+}
+
+bool hashmap_update(hashmap_t * map, const void * key, const void * value) {
+    void * pvalue;
+
+    if (!(pvalue = hashmap_insert(map, key, NULL))) return false;
+    memcpy(pvalue, value, map->value_size);
+    return true;
+}
+
+bool hashmap_erase(hashmap_t * map, const void * key) {
+    size_t   i, next,
+             mask = map->num_slots - 1;
+    uint32_t psl;
+
+    if (!hashmap_locate(map, key, hashmap_fold(map->hash(key)), &i, &psl)) return false;
+
+    // Shift the following entries backward until one is in its home slot
+    for (next = (i + 1) & mask; map->slots[next].psl > 1; i = next, next = (next + 1) & mask) {
+        map->slots[i].hash = map->slots[next].hash;
+        map->slots[i].psl  = map->slots[next].psl - 1;
+        memcpy(hashmap_entry(map, i), hashmap_entry(map, next), map->entry_size);
+    }
+    map->slots[i].psl = 0;
+    map->num_entries--;
+    return true;
+}
+
+void * hashmap_get_key(const hashmap_t * map, const void * value) {
+    return (uint8_t *) value - map->value_offset;
+}
+
+bool hashmap_next(const hashmap_t * map, size_t * pi, void ** pkey, void ** pvalue) {
+    size_t i;
+
+    for (i = *pi; i < map->num_slots; i++) {
+        if (map->slots[i].psl) {
+            if (pkey)   *pkey   = hashmap_entry(map, i);
+            if (pvalue) *pvalue = hashmap_entry(map, i) + map->value_offset;
+            *pi = i + 1;
+            return true;
+        }
+    }
+    *pi = i;
+    return false;
+}
@@ -0,0 +1,181 @@
+#ifndef LIBPT_CONTAINER_HASHMAP_H
+#define LIBPT_CONTAINER_HASHMAP_H
+
+/**
+ * \file hashmap.h
+ * \brief Header file: open-addressing hash map.
+ *
+ * A hashmap_t stores fixed-size key-value pairs inline, in a single
+ * array of entries: inserting a pair copies its key (e.g. an address_t)
+ * and its value into the map, and does not allocate anything unless the
+ * map has to grow. Keys are hashed and compared by caller-supplied
+ * callbacks.
+ *
+ * Collisions are resolved by linear probing with Robin Hood hashing:
+ * an entry far from its home slot takes the place of an entry closer to
+ * its own, which keeps the probe sequences short and allows a lookup to
+ * stop as soon as it meets an entry closer to its home slot than the
+ * searched key would be. Erasing an entry shifts the following entries
+ * backward, so that no tombstone is needed.
+ *
+ * A set is a hashmap_t whose values are empty (value_size == 0).
+ *
+ * The addresses returned by hashmap_find and hashmap_insert remain valid
+ * until the next insertion or erasure.
+ */
+
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint8_t, uint32_t
+#include <stdbool.h> // bool
+
+#include "common.h"  // ELEMENT_HASH, ELEMENT_COMPARE
+
+/**
+ * \struct hashmap_slot_t
+ * \brief Metadata of an entry of a hashmap_t.
+ */
+
+typedef struct {
+    uint32_t hash; /**< Hash of the key (folded to 32 bits) */
+    uint32_t psl;  /**< 0 if the slot is free, 1 + distance to the home slot otherwise */
+} hashmap_slot_t;
+
+/**
+ * \struct hashmap_t
+ * \brief Structure representing an open-addressing hash map.
+ */
+
+typedef struct {
+    hashmap_slot_t * slots;        /**< Metadata of each entry */
+    uint8_t        * entries;      /**< The entries (key then value) */
+    uint8_t        * scratch;      /**< Room for two entries, used to swap entries */
+    size_t           key_size;     /**< Size of a key */
+    size_t           value_size;   /**< Size of a value */
+    size_t           value_offset; /**< Offset of the value in an entry */
+    size_t           entry_size;   /**< Size of an entry, padding included */
+    size_t           num_slots;    /**< Number of slots (a power of 2) */
+    size_t           slots_bits;   /**< log2(num_slots) */
+    size_t           num_entries;  /**< Number of stored entries */
+
+    // Callbacks related to stored keys.
+    size_t (* hash)(const void * key);
+    int    (* compare)(const void * key1, const void * key2);
+} hashmap_t;
+
+/**
+ * \brief Create an empty hash map.
+ * \param key_size The size of a key.
+ * \param value_size The size of a value (0 to make a set).
+ * \param hash Callback used to hash a key (mandatory).
+ * \param compare Callback used to compare keys (mandatory). It must
+ *    return 0 iif both keys are equal, and equal keys must have the
+ *    same hash.
+ * \return The newly allocated hash map if successful, NULL otherwise.
+ */
+
+hashmap_t * hashmap_create_impl(
+    size_t    key_size,
+    size_t    value_size,
+    size_t (* hash)(const void * key),
+    int    (* compare)(const void * key1, const void * key2)
+);
+
+#define hashmap_create(key_size, value_size, hash, compare) hashmap_create_impl(\
+    key_size, \
+    value_size, \
+    (ELEMENT_HASH) hash, \
+    (ELEMENT_COMPARE) compare \
+)
+
+/**
+ * \brief Release a hash map from the memory. The keys and the values
+ *    are stored inline, so anything they point to must be released
+ *    beforehand (see hashmap_next).
+ * \param map A hashmap_t instance.
+ */
+
+void hashmap_free(hashmap_t * map);
+
+/**
+ * \brief Remove every entry from a hash map.
+ * \param map A hashmap_t instance.
+ */
+
+void hashmap_clear(hashmap_t * map);
+
+/**
+ * \brief Retrieve the number of entries stored in a hash map.
+ * \param map A hashmap_t instance.
+ * \return The number of entries.
+ */
+
+size_t hashmap_get_size(const hashmap_t * map);
+
+/**
+ * \brief Search a key in a hash map.
+ * \param map A hashmap_t instance.
+ * \param key The key we're looking for.
+ * \return The address of the value related to this key if found,
+ *    NULL otherwise.
+ */
+
+void * hashmap_find(const hashmap_t * map, const void * key);
+
+/**
+ * \brief Search a key in a hash map, and insert it if not found.
+ *    The value of a newly inserted key is set to zero.
+ * \param map A hashmap_t instance.
+ * \param key The key.
+ * \param pinserted Pass the address of a bool, or NULL. *pinserted
+ *    is set to true iif the key was not yet in the map.
+ * \return The address of the value related to this key if successful,
+ *    NULL otherwise.
+ */
+
+void * hashmap_insert(hashmap_t * map, const void * key, bool * pinserted);
+
+/**
+ * \brief Insert a key-value pair in a hash map. If the key already
+ *    exists in the map, its value is overwritten.
+ * \param map A hashmap_t instance.
+ * \param key The key.
+ * \param value The value (value_size bytes are copied).
+ * \return true iif successful.
+ */
+
+bool hashmap_update(hashmap_t * map, const void * key, const void * value);
+
+/**
+ * \brief Remove a key (and its value) from a hash map.
+ * \param map A hashmap_t instance.
+ * \param key The key we want to remove.
+ * \return true iif the key has been found and removed.
+ */
+
+bool hashmap_erase(hashmap_t * map, const void * key);
+
+/**
+ * \brief Retrieve the key stored along with a value.
+ * \param map A hashmap_t instance.
+ * \param value An address returned by hashmap_find or hashmap_insert.
+ * \return The address of the key stored in the map.
+ */
+
+void * hashmap_get_key(const hashmap_t * map, const void * value);
+
+/**
+ * \brief Iterate over the entries of a hash map (in no particular order).
+ *    The map must not be modified during the iteration.
+ * \param map A hashmap_t instance.
+ * \param pi Address of the iterator, which must be set to 0
+ *    before the first call.
+ * \param pkey Pass the address of a pointer, or NULL. *pkey is set
+ *    to the address of the next key.
+ * \param pvalue Pass the address of a pointer, or NULL. *pvalue is set
+ *    to the address of the next value.
+ * \return true iif an entry has been found, false at the end of the map.
+ */
+
+bool hashmap_next(const hashmap_t * map, size_t * pi, void ** pkey, void ** pvalue);
+
+#endif // LIBPT_CONTAINER_HASHMAP_H
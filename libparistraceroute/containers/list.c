@@ -45,21 +45,13 @@ ERR_CALLOC:
 
 void list_free(list_t * list) {
     list_cell_t * list_cell,
-                * prev_cell = NULL;
+                * next_cell;
 
     if (list) {
-        for (list_cell = list->head; list_cell; list_cell = list_cell->next) {
-            // Free the previous cell (if any)
-            if (prev_cell && list->element_free) {
-                list_cell_free(prev_cell, list->element_free);
-            }
-
-            // Update the pointer to the previous cell
-            prev_cell = list_cell;
-        }
-
-        if (prev_cell && list->element_free) {
-            list_cell_free(prev_cell, list->element_free);
+        // The cells are freed even if the elements are not (element_free == NULL)
+        for (list_cell = list->head; list_cell; list_cell = next_cell) {
+            next_cell = list_cell->next;
+            list_cell_free(list_cell, list->element_free);
         }
 
         free(list);
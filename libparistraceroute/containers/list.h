@@ -73,9 +73,9 @@ list_t * list_create_impl(
 )
 
 /**
- * \brief Delete a list
+ * \brief Delete a list and its cells. The elements are released by
+ *    the element_free callback passed to list_create, if any.
  * \param list Pointer to the list to be deleted
- * \param element_free Pointer to a function to delete the elements contained within the list element structures that make up the list
  */
 
 //void list_free(list_t * list, void (*element_free)(void * element));
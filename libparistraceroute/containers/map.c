@@ -1,20 +1,90 @@
 #include "config.h"
 
+#include "os/search.h"       // tsearch, tfind, tdelete, twalk
 #include <stdlib.h>          // malloc
+#include <stddef.h>          // offsetof
+#include <stdio.h>           // printf
 #include <assert.h>          // assert
 
 #include "containers/map.h"  // map_t
-#include "containers/pair.h" // pair_t
-
-static int map_pair_compare(const pair_t * pair1, const pair_t * pair2) {
-    assert(pair1 && pair1->first);
-    assert(pair2 && pair2->first);
-    assert(pair1->first->compare == pair2->first->compare);
-    
-    return pair1->first->compare(
-        pair1->first->element,
-        pair2->first->element
-    );
+
+/**
+ * A key-value pair stored in the tree of a map_t whose keys are not hashed.
+ * The key comes first so that a map_entry_t can be compared as an
+ * object_key_t.
+ */
+
+typedef struct {
+    object_key_t   key;
+    void         * data;
+} map_entry_t;
+
+static inline map_entry_t * map_entry_from_data(void ** pdata) {
+    return (map_entry_t *) ((char *) pdata - offsetof(map_entry_t, data));
+}
+
+/**
+ * \brief Search a key in a map, and insert it if not found.
+ * \param map A map_t instance.
+ * \param search The searched key.
+ * \param pinserted Address of a bool, set to true iif the key was not
+ *    yet in the map. The data of a newly inserted key is set to NULL.
+ * \return The address of the data related to this key if successful,
+ *    NULL otherwise.
+ */
+
+static void ** map_insert_key(map_t * map, const object_key_t * search, bool * pinserted) {
+    map_entry_t  * entry;
+    map_entry_t ** node;
+
+    if (map->map) return hashmap_insert(map->map, search, pinserted);
+
+    if (!(entry = malloc(sizeof(map_entry_t)))) goto ERR_MALLOC;
+    entry->key = *search;
+    entry->data = NULL;
+    if (!(node = tsearch(entry, &map->root, (ELEMENT_COMPARE) object_key_compare))) goto ERR_TSEARCH;
+
+    // This key was already in the map
+    if (*node != entry) free(entry);
+    *pinserted = (*node == entry);
+    return &(*node)->data;
+
+ERR_TSEARCH:
+    free(entry);
+ERR_MALLOC:
+    return NULL;
+}
+
+/**
+ * \brief Retrieve the key stored along with a data.
+ * \param map A map_t instance.
+ * \param pdata An address returned by map_insert_key.
+ * \return The address of the key stored in the map.
+ */
+
+static object_key_t * map_get_key(const map_t * map, void ** pdata) {
+    return map->map ?
+        hashmap_get_key(map->map, pdata) :
+        &map_entry_from_data(pdata)->key;
+}
+
+/**
+ * \brief Remove a key (and its data) from a map. The key and the data
+ *    themselves are not released.
+ * \param map A map_t instance.
+ * \param pdata An address returned by map_insert_key.
+ */
+
+static void map_erase_key(map_t * map, void ** pdata) {
+    map_entry_t * entry;
+
+    if (map->map) {
+        hashmap_erase(map->map, hashmap_get_key(map->map, pdata));
+    } else {
+        entry = map_entry_from_data(pdata);
+        tdelete(entry, &map->root, (ELEMENT_COMPARE) object_key_compare);
+        free(entry);
+    }
 }
 
 map_t * map_create_impl(
@@ -26,19 +96,12 @@ map_t * map_create_impl(
     void   (*data_free)(void * data),
     void   (*data_dump)(const void * data)
 ) {
-    map_t    * map;
-    pair_t   * pair;
+    map_t    * map = NULL;
     object_t * dummy_key,
-             * dummy_data,
-             * dummy_pair;
+             * dummy_data;
 
     assert(key_compare);
 
-    // TODO Avoid this useless duplicate/free by improving set_t and pair_t
-    if (!(map = malloc(sizeof(map_t)))) {
-        goto ERR_MALLOC;
-    }
-
     if (!(dummy_key = object_create(NULL, key_dup,  key_free,  key_dump,  key_compare))) {
         goto ERR_OBJECT_CREATE_KEY;
     }
@@ -47,120 +110,177 @@ map_t * map_create_impl(
         goto ERR_OBJECT_CREATE_DATA;
     }
 
-    if (!(pair = pair_create(dummy_key, dummy_data))) {
-        goto ERR_PAIR_CREATE;
-    }
-    object_free(dummy_key);
-    object_free(dummy_data);
-
-    if (!(dummy_pair = object_create(NULL, pair_dup, pair_free, pair_dump, map_pair_compare))) {
-        goto ERR_OBJECT_CREATE_PAIR;
-    }
-    dummy_pair->element = pair;
-
-    if (!(map->set = make_set(dummy_pair))) {
-        goto ERR_SET_CREATE;
-    }
-    object_free(dummy_pair);
-
-    return map;
-
-ERR_SET_CREATE:
-    object_free(dummy_pair);
-ERR_OBJECT_CREATE_PAIR:
-    pair_free(pair);
-ERR_PAIR_CREATE:
+    map = make_map(dummy_key, dummy_data);
     object_free(dummy_data);
 ERR_OBJECT_CREATE_DATA:
     object_free(dummy_key);
 ERR_OBJECT_CREATE_KEY:
-    free(map);
-ERR_MALLOC:
-    return NULL;
-
+    return map;
 }
 
 map_t * make_map(const object_t * dummy_key, const object_t * dummy_data) {
-    map_t    * map;
-    pair_t   * pair;
-    object_t * dummy_pair;
+    map_t * map;
 
     assert(dummy_key && dummy_key->compare);
     assert(dummy_data);
 
-    if (!(map = malloc(sizeof(map_t))))               goto ERR_MALLOC;
-    if (!(pair = pair_create(dummy_key, dummy_data))) goto ERR_PAIR_CREATE;
-    if (!(dummy_pair = object_create(NULL, pair_dup, pair_free, pair_dump, map_pair_compare))) goto ERR_OBJECT_CREATE;
-    dummy_pair->element = pair;
-
-    // TODO Avoid this useless malloc/free by improving set_t
-    if (!(map->set = make_set(dummy_pair))) goto ERR_SET_CREATE;
-    object_free(dummy_pair);
+    if (!(map = malloc(sizeof(map_t))))                goto ERR_MALLOC;
+    if (!(map->dummy_key = object_dup(dummy_key)))     goto ERR_OBJECT_DUP_KEY;
+    if (!(map->dummy_data = object_dup(dummy_data)))   goto ERR_OBJECT_DUP_DATA;
+    map->root = NULL;
+    map->map  = NULL;
 
+    // Keys which cannot be hashed are stored in a tree
+    if (dummy_key->hash) {
+        if (!(map->map = hashmap_create(sizeof(object_key_t), sizeof(void *), object_key_hash, object_key_compare))) goto ERR_HASHMAP_CREATE;
+    }
     return map;
 
-ERR_SET_CREATE:
-    object_free(dummy_pair);
-ERR_OBJECT_CREATE:
-    pair_free(pair);
-ERR_PAIR_CREATE:
+ERR_HASHMAP_CREATE:
+    object_free(map->dummy_data);
+ERR_OBJECT_DUP_DATA:
+    object_free(map->dummy_key);
+ERR_OBJECT_DUP_KEY:
     free(map);
 ERR_MALLOC:
     return NULL;
 }
 
 bool map_update_impl(map_t * map, const void * key, const void * data) {
-    pair_t * pair;
-    pair_t * pair_in_set;
-    void   * swap;
-
-    if (!(pair = make_pair_impl((const pair_t *) map->set->dummy_element->element, key, data))) goto ERR_MAKE_PAIR;
-    if (!(set_insert(map->set, pair))) {
-        pair_in_set = (pair_t *) set_find(map->set, pair);
-        assert(pair_in_set);
-        swap = pair_in_set->second;
-        pair_in_set->second = pair->second;
-        pair->second = swap;
+    object_key_t    search = {
+        .object  = map->dummy_key,
+        .element = (void *) key
+    };
+    void         ** pdata,
+                  * data_dup = (void *) data,
+                  * key_dup;
+    bool            inserted;
+
+    if (data && map->dummy_data->dup) {
+        if (!(data_dup = map->dummy_data->dup(data))) goto ERR_DATA_DUP;
     }
-    pair_free(pair);
+
+    if (!(pdata = map_insert_key(map, &search, &inserted))) goto ERR_INSERT_KEY;
+
+    if (inserted) {
+        // The map must own its key: replace the searched key by a copy
+        if (map->dummy_key->dup) {
+            if (!(key_dup = map->dummy_key->dup(key))) goto ERR_KEY_DUP;
+            map_get_key(map, pdata)->element = key_dup;
+        }
+    } else if (*pdata && *pdata != data_dup && map->dummy_data->free) {
+        map->dummy_data->free(*pdata);
+    }
+
+    *pdata = data_dup;
     return true;
 
-ERR_MAKE_PAIR:
+ERR_KEY_DUP:
+    map_erase_key(map, pdata);
+ERR_INSERT_KEY:
+    if (data_dup != data && map->dummy_data->free) {
+        map->dummy_data->free(data_dup);
+    }
+ERR_DATA_DUP:
     return false;
 }
 
-#include <stdio.h> // DEBUG
 bool map_find_impl(const map_t * map, const void * key, const void ** pdata) {
-    pair_t       * pair,
-                 * search;
-    const pair_t * dummy_pair;
-
-    *pdata = NULL;
-    dummy_pair = (const pair_t *) ((const object_t *) map->set->dummy_element)->element;
-
-    if (!(search = make_pair_impl(dummy_pair, (const void *) key, NULL))) {
-        goto ERR_MAKE_PAIR; 
+    object_key_t    search = {
+        .object  = map->dummy_key,
+        .element = (void *) key
+    };
+    map_entry_t   ** node;
+    void         ** pfound = NULL;
+
+    if (map->map) {
+        pfound = hashmap_find(map->map, &search);
+    } else if ((node = tfind(&search, &map->root, (ELEMENT_COMPARE) object_key_compare))) {
+        pfound = &(*node)->data;
     }
 
-    if ((pair = set_find(map->set, search))) {
-        *pdata = pair->second->element;
+    if (pfound) {
+        *pdata = *pfound;
+    } else {
+        *pdata = NULL;
     }
+    return (pfound != NULL);
+}
 
-    pair_free(search);
-    return (pair != NULL);
-
-ERR_MAKE_PAIR:
-    return false;
+static void map_free_key_data(const map_t * map, object_key_t * key, void * data) {
+    if (map->dummy_key->free) map->dummy_key->free(key->element);
+    if (data && map->dummy_data->free) map->dummy_data->free(data);
 }
 
 void map_free(map_t * map) {
+    object_key_t  * key;
+    map_entry_t   * entry;
+    void         ** pdata;
+    size_t          i = 0;
+
     if (map) {
-        if (map->set) set_free(map->set);
+        if (map->map) {
+            while (hashmap_next(map->map, &i, (void **) &key, (void **) &pdata)) {
+                map_free_key_data(map, key, *pdata);
+            }
+            hashmap_free(map->map);
+        } else {
+            // Remove the root until the tree is empty
+            while (map->root) {
+                entry = *(map_entry_t **) map->root;
+                tdelete(entry, &map->root, (ELEMENT_COMPARE) object_key_compare);
+                map_free_key_data(map, &entry->key, entry->data);
+                free(entry);
+            }
+        }
+        object_free(map->dummy_data);
+        object_free(map->dummy_key);
         free(map);
     }
 }
 
-void map_dump(const map_t * map) {
-    set_dump(map->set);
+static const map_t * s_map;
+
+static void map_dump_key_data(const map_t * map, const object_key_t * key, const void * data) {
+    printf(" (");
+    if (map->dummy_key->dump) {
+        map->dummy_key->dump(key->element);
+    } else printf("?");
+    printf(", ");
+    if (data && map->dummy_data->dump) {
+        map->dummy_data->dump(data);
+    } else printf("?");
+    printf(")");
 }
 
+static void callback_map_dump(const void * node, VISIT visit, int level) {
+    const map_entry_t * entry;
+
+    switch (visit) {
+        case leaf:      // 1st visit (leaf)
+        case postorder: // 3rd visit
+            entry = *((map_entry_t * const *) node);
+            map_dump_key_data(s_map, &entry->key, entry->data);
+            break;
+        case preorder:  // 1st visit (not leaf)
+        case endorder:  // 2nd visit
+            break;
+    }
+}
+
+void map_dump(const map_t * map) {
+    object_key_t  * key;
+    void         ** pdata;
+    size_t          i = 0;
+
+    printf("{");
+    if (map->map) {
+        while (hashmap_next(map->map, &i, (void **) &key, (void **) &pdata)) {
+            map_dump_key_data(map, key, *pdata);
+        }
+    } else {
+        s_map = map;
+        twalk(map->root, callback_map_dump);
+    }
+    printf(" }");
+}
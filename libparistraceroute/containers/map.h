@@ -2,21 +2,27 @@
 #define LIBPT_CONTAINER_MAP_H
 
 #include <stdbool.h>
-#include "containers/set.h" // set_t
+#include "containers/object.h"  // object_t
+#include "containers/hashmap.h" // hashmap_t
 
 /**
  * map_t allows to store for each key a given data.
- * Two keys are said to be equal if they verify key1 <= key2 and key2 <= key1,
- * where <= corresponds to the key_compare callback (see map_create_impl).
+ * Two keys are said to be equal if key_compare returns 0 (see map_create_impl).
  *
- * TODO: This implementation is not very efficient.
- * So far, a map_t instance manages a set of pair<object<key>, object<data> >.
- * It would be nice to manage a set of pair<key, value> to reduce the
- * memory consumption.
+ * If the object_t describing the keys passed to make_map carries a hash
+ * callback, map_t is a thin layer over a hashmap_t whose keys are
+ * object_key_t instances and whose values are the addresses of the data.
+ * Otherwise (in particular with map_create), the key-value pairs are
+ * stored in a binary search tree (see tsearch) ordered by key_compare.
+ * New code should rather directly use a hashmap_t, which stores keys and
+ * values inline (see containers/hashmap.h).
  */
 
 typedef struct {
-    set_t * set; /**< The key-value pairs stored in the map */
+    hashmap_t * map;        /**< hashmap<object_key_t, void *> if the keys are hashed, NULL otherwise */
+    void      * root;       /**< tree of key-value pairs if the keys are not hashed */
+    object_t  * dummy_key;  /**< object_t<key> */
+    object_t  * dummy_data; /**< object_t<data> */
 } map_t;
 
 /**
@@ -74,7 +80,8 @@ void map_free(map_t * map);
 
 /**
  * \brief Print a map_t instance in the standard output.
- * \param set A map_t instance.
+ *    The hashed key-value pairs are printed in no particular order.
+ * \param map A map_t instance.
  * \warning This function uses a static variable and is not thread-safe.
  */
 
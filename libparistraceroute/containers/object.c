@@ -24,6 +24,7 @@ object_t * object_create_impl(
     object->free    = element_free;
     object->dump    = element_dump;
     object->compare = element_compare;
+    object->hash    = NULL;
     return object;
 
 ERR_ELEMENT_DUP:
@@ -44,13 +45,18 @@ object_t * make_object(
     const object_t * dummy_element,
     const void     * element
 ) {
-    return object_create(
+    object_t * object;
+
+    if ((object = object_create(
         element,
         dummy_element->dup,
         dummy_element->free,
         dummy_element->dump,
         dummy_element->compare
-    );
+    ))) {
+        object->hash = dummy_element->hash;
+    }
+    return object;
 }
 
 object_t * object_dup(const object_t * object) {
@@ -92,4 +98,12 @@ void object_dump(const object_t * object) {
     object->dump(object->element);
 }
 
+size_t object_key_hash(const object_key_t * key) {
+    return key->object->hash ? key->object->hash(key->element) : 0;
+}
+
+int object_key_compare(const object_key_t * key1, const object_key_t * key2) {
+    return key1->object->compare(key1->element, key2->element);
+}
+
 
@@ -14,10 +14,40 @@ typedef struct {
     void   (*free)(void * element);
     void   (*dump)(const void * element);
     int    (*compare)(const void * element1, const void * element2);
+    size_t (*hash)(const void * element); /**< May be NULL (see object_key_hash) */
 
     void   * element;
 } object_t;
 
+/**
+ * object_key_t is the key stored by set_t and map_t: an element along
+ * with the object_t carrying its callbacks.
+ */
+
+typedef struct {
+    const object_t * object;  /**< Callbacks related to the element */
+    void           * element; /**< The element */
+} object_key_t;
+
+/**
+ * \brief Hash an object_key_t instance.
+ * \param key An object_key_t instance.
+ * \return The hash of the element, or 0 if its object_t has no hash
+ *    callback. Such keys would all collide, this is why set_t and map_t
+ *    store them in a tree instead.
+ */
+
+size_t object_key_hash(const object_key_t * key);
+
+/**
+ * \brief Compare two object_key_t instances.
+ * \param key1 An object_key_t instance.
+ * \param key2 An object_key_t instance.
+ * \return The value returned by the compare callback of the elements.
+ */
+
+int object_key_compare(const object_key_t * key1, const object_key_t * key2);
+
 object_t * object_create_impl(
     const void * element,
     void * (*element_dup)(const void * element),
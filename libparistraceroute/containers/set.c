@@ -1,33 +1,30 @@
 #include "config.h"
 
-#include "os/search.h"  // tsearch, twalk, tdestroy, tdelete
+#include "os/search.h"  // tsearch, tfind, tdelete, twalk
 #include <stdlib.h>     // malloc, free
 #include <stdio.h>      // printf
 #include <assert.h>     // assert
 
 #include "set.h"    // set_t
 
-static void nothing_to_free() {}
-
 set_t * set_create_impl(
     void * (*element_dup)(const void * element),
     void   (*element_free)(void * element),
     void   (*element_dump)(const void * element),
     int    (*element_compare)(const void * element1, const void * element2)
 ) {
-    set_t * set;
+    set_t    * set;
+    object_t * dummy_element;
 
     assert(element_compare);
     assert(element_dup);
 
-    if (!(set = malloc(sizeof(set_t)))) goto ERR_MALLOC;
-    if (!(set->dummy_element = object_create(NULL, element_dup, element_free, element_dump, element_compare))) goto ERR_OBJECT_CREATE;
-    set->root = NULL;
+    if (!(dummy_element = object_create(NULL, element_dup, element_free, element_dump, element_compare))) goto ERR_OBJECT_CREATE;
+    set = make_set(dummy_element);
+    object_free(dummy_element);
     return set;
 
 ERR_OBJECT_CREATE:
-    free(set);
-ERR_MALLOC:
     return NULL;
 }
 
@@ -41,8 +38,16 @@ set_t * make_set(const object_t * dummy_element) {
     if (!(set = malloc(sizeof(set_t))))                    goto ERR_MALLOC;
     if (!(set->dummy_element = object_dup(dummy_element))) goto ERR_OBJECT_DUP;
     set->root = NULL;
+    set->map  = NULL;
+
+    // Elements which cannot be hashed are stored in a tree
+    if (dummy_element->hash) {
+        if (!(set->map = hashmap_create(sizeof(object_key_t), 0, object_key_hash, object_key_compare))) goto ERR_HASHMAP_CREATE;
+    }
     return set;
 
+ERR_HASHMAP_CREATE:
+    object_free(set->dummy_element);
 ERR_OBJECT_DUP:
     free(set);
 ERR_MALLOC:
@@ -55,71 +60,108 @@ set_t * set_dup(const set_t * set) {
 }
 
 void set_free(set_t * set) {
+    object_key_t * key;
+    void         * element;
+    size_t         i = 0;
+
     if (set) {
-#ifdef _GNU_SOURCE
-        tdestroy(set->root, set->dummy_element->free ? set->dummy_element->free : nothing_to_free);
-#else
-#    warning set_free cannot call tdestroy()
-#endif
+        if (set->map) {
+            while (hashmap_next(set->map, &i, (void **) &key, NULL)) {
+                if (set->dummy_element->free) set->dummy_element->free(key->element);
+            }
+            hashmap_free(set->map);
+        } else {
+            // Remove the root until the tree is empty
+            while (set->root) {
+                element = *(void **) set->root;
+                tdelete(element, &set->root, set->dummy_element->compare);
+                if (set->dummy_element->free) set->dummy_element->free(element);
+            }
+        }
         object_free(set->dummy_element);
         free(set);
     }
 }
 
 void * set_find(const set_t * set, const void * element) {
-    void ** search = tfind(element, &set->root, set->dummy_element->compare);
-    return search ? *search : NULL;
+    object_key_t   search = {
+        .object  = set->dummy_element,
+        .element = (void *) element
+    };
+    void         * value,
+                ** node;
+
+    if (!set->map) {
+        node = tfind(element, &set->root, set->dummy_element->compare);
+        return node ? *node : NULL;
+    }
+
+    if (!(value = hashmap_find(set->map, &search))) return NULL;
+    return ((object_key_t *) hashmap_get_key(set->map, value))->element;
 }
 
 bool set_insert(set_t * set, void * element) {
-    void * element_dup;
-    bool   inserted;
+    object_key_t key = {
+        .object  = set->dummy_element,
+        .element = element
+    };
+
+    if (set_find(set, element)) {
+        // This element is already in the set
+        return false;
+    }
 
     if (set->dummy_element->dup) {
-        if (!(element_dup = set->dummy_element->dup(element))) goto ERR_ELEMENT_DUP;
-    } else {
-        element_dup = element;
+        if (!(key.element = set->dummy_element->dup(element))) goto ERR_ELEMENT_DUP;
     }
 
-    inserted = (* (void **) tsearch(element_dup, &set->root, set->dummy_element->compare) == element_dup);
-
-    if (!inserted && set->dummy_element->dup) {
-        // This element is already in the tree, remove the duplicate
-        set->dummy_element->free(element_dup);
+    if (set->map) {
+        if (!hashmap_insert(set->map, &key, NULL)) goto ERR_INSERT;
+    } else {
+        if (!tsearch(key.element, &set->root, set->dummy_element->compare)) goto ERR_INSERT;
     }
+    return true;
 
-    return inserted;
-
+ERR_INSERT:
+    if (set->dummy_element->dup && set->dummy_element->free) {
+        set->dummy_element->free(key.element);
+    }
 ERR_ELEMENT_DUP:
-    return NULL;
+    return false;
 }
 
 bool set_erase(set_t * set, const void * element) {
-    void ** search;
-    void *  element_to_delete;
+    object_key_t   search = {
+        .object  = set->dummy_element,
+        .element = (void *) element
+    };
+    void         * element_to_delete;
 
-    if ((search = tfind(element, &set->root, set->dummy_element->compare))) {
-        element_to_delete = *(void **) search;
-        search = tdelete(element, &set->root, set->dummy_element->compare);
-        set->dummy_element->free(element_to_delete);
-    }
+    if (!(element_to_delete = set_find(set, element))) return false;
 
-    return search != NULL;
+    if (set->map) {
+        hashmap_erase(set->map, &search);
+    } else {
+        tdelete(element, &set->root, set->dummy_element->compare);
+    }
+    if (set->dummy_element->free) set->dummy_element->free(element_to_delete);
+    return true;
 }
 
 static const object_t * s_dummy_element;
 
-static void callback_set_dump(const void * node, VISIT visit, int level) {
-    const void * element;
+static void set_dump_element(const object_t * dummy_element, const void * element) {
+    printf(" ");
+    if (dummy_element->dump) {
+        dummy_element->dump(element);
+    } else printf("?");
+}
 
+static void callback_set_dump(const void * node, VISIT visit, int level) {
     switch (visit) {
         case leaf:      // 1st visit (leaf)
         case postorder: // 3rd visit
-            printf(" ");
-            element = *((void * const *) node);
-            if (s_dummy_element->dump) {
-                s_dummy_element->dump(element);
-            } else printf("?");
+            set_dump_element(s_dummy_element, *((void * const *) node));
             break;
         case preorder:  // 1st visit (not leaf)
         case endorder:  // 2nd visit
@@ -128,8 +170,17 @@ static void callback_set_dump(const void * node, VISIT visit, int level) {
 }
 
 void set_dump(const set_t * set) {
+    object_key_t * key;
+    size_t         i = 0;
+
     printf("{");
-    s_dummy_element = set->dummy_element;
-    twalk(set->root, callback_set_dump);
+    if (set->map) {
+        while (hashmap_next(set->map, &i, (void **) &key, NULL)) {
+            set_dump_element(set->dummy_element, key->element);
+        }
+    } else {
+        s_dummy_element = set->dummy_element;
+        twalk(set->root, callback_set_dump);
+    }
     printf(" }");
 }
@@ -3,10 +3,20 @@
 
 #include <stdbool.h>
 #include "containers/object.h"
+#include "containers/hashmap.h"
+
+/**
+ * If the object_t passed to make_set carries a hash callback, set_t is a
+ * thin layer over a hashmap_t whose keys are object_key_t instances.
+ * Otherwise (in particular with set_create), the elements are stored in
+ * a binary search tree (see tsearch) ordered by the compare callback.
+ * New code should rather directly use a hashmap_t (see containers/hashmap.h).
+ */
 
 typedef struct {
-    void     * root;          /**< tree of element   */
-    object_t * dummy_element; /**< object_t<element> */
+    hashmap_t * map;           /**< hashmap<object_key_t, -> if the elements are hashed, NULL otherwise */
+    void      * root;          /**< tree of elements if the elements are not hashed */
+    object_t  * dummy_element; /**< object_t<element> */
 } set_t;
 
 /**
@@ -37,7 +47,9 @@ set_t * set_create_impl(
 
 /**
  * \brief Create a set of element.
- * \param object
+ * \param object The object_t instance carrying the callbacks used by
+ *    the set to manage its elements (including the hash callback).
+ * \return The newly allocated set_t instance if successful, NULL otherwise.
  */
 
 set_t * make_set(const object_t * object);
@@ -59,6 +71,7 @@ void set_free(set_t * set);
 
 /**
  * \brief Print a set_t instance in the standard output.
+ *    The hashed elements are printed in no particular order.
  * \param set A set_t instance.
  * \warning This function uses a static variable and is not thread-safe.
  */
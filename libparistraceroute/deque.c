@@ -0,0 +1,150 @@
+#include "config.h"
+
+#include <stdlib.h>     // malloc, free
+
+#include "deque.h"
+
+#define DEQUE_MAX_CELLS_INIT 16
+
+/**
+ * \brief Retrieve the address of a cell of a deque.
+ * \param deque A deque_t instance.
+ * \param i The index of the cell (0 is the oldest cell).
+ * \return The address of the cell.
+ */
+
+static inline void ** deque_get_cell(const deque_t * deque, size_t i) {
+    return &deque->cells[(deque->first + i) & (deque->max_cells - 1)];
+}
+
+/**
+ * \brief Move the elements of a deque into a new circular buffer,
+ *    starting from its first cell. Tombstones are dropped.
+ * \param deque A deque_t instance.
+ * \param max_cells The size of the new buffer (a power of 2, greater
+ *    or equal to the number of elements).
+ * \return true iif successful.
+ */
+
+static bool deque_resize(deque_t * deque, size_t max_cells) {
+    void   ** cells, * element;
+    size_t    i, j;
+
+    if (!(cells = malloc(max_cells * sizeof(void *)))) return false;
+
+    for (i = 0, j = 0; i < deque->num_cells; i++) {
+        if ((element = *deque_get_cell(deque, i))) {
+            cells[j++] = element;
+        }
+    }
+
+    free(deque->cells);
+    deque->cells          = cells;
+    deque->first          = 0;
+    deque->num_cells      = j;
+    deque->max_cells      = max_cells;
+    deque->num_tombstones = 0;
+    return true;
+}
+
+deque_t * deque_create() {
+    deque_t * deque;
+
+    if (!(deque = malloc(sizeof(deque_t)))) goto ERR_MALLOC;
+    if (!(deque->cells = malloc(DEQUE_MAX_CELLS_INIT * sizeof(void *)))) goto ERR_MALLOC_CELLS;
+    deque->first          = 0;
+    deque->num_cells      = 0;
+    deque->max_cells      = DEQUE_MAX_CELLS_INIT;
+    deque->num_tombstones = 0;
+    return deque;
+
+ERR_MALLOC_CELLS:
+    free(deque);
+ERR_MALLOC:
+    return NULL;
+}
+
+void deque_free(deque_t * deque, void (*element_free)(void * element)) {
+    void  * element;
+    size_t  i;
+
+    if (deque) {
+        if (element_free) {
+            for (i = 0; i < deque->num_cells; i++) {
+                if ((element = *deque_get_cell(deque, i))) {
+                    element_free(element);
+                }
+            }
+        }
+        free(deque->cells);
+        free(deque);
+    }
+}
+
+bool deque_push_back(deque_t * deque, void * element) {
+    if (deque->num_cells == deque->max_cells) {
+        // Reclaim the tombstones if they fill at least half of the
+        // buffer, otherwise double its size.
+        if (!deque_resize(deque, 2 * deque->num_tombstones >= deque->max_cells ? deque->max_cells : 2 * deque->max_cells)) {
+            return false;
+        }
+    }
+
+    *deque_get_cell(deque, deque->num_cells++) = element;
+    return true;
+}
+
+void * deque_front(const deque_t * deque) {
+    void   * element = NULL;
+    size_t   i;
+
+    // Skip the tombstones not yet trimmed
+    for (i = 0; i < deque->num_cells && !(element = *deque_get_cell(deque, i)); i++);
+    return element;
+}
+
+void * deque_pop_front(deque_t * deque) {
+    void * element;
+
+    deque_trim(deque);
+    if ((element = deque_del_ith_cell(deque, 0))) {
+        deque_trim(deque);
+    }
+    return element;
+}
+
+size_t deque_get_size(const deque_t * deque) {
+    return deque->num_cells - deque->num_tombstones;
+}
+
+size_t deque_get_num_cells(const deque_t * deque) {
+    return deque->num_cells;
+}
+
+void * deque_get_ith_cell(const deque_t * deque, size_t i) {
+    return i < deque->num_cells ? *deque_get_cell(deque, i) : NULL;
+}
+
+void * deque_del_ith_cell(deque_t * deque, size_t i) {
+    void ** cell, * element;
+
+    if (i >= deque->num_cells || !(element = *(cell = deque_get_cell(deque, i)))) {
+        return NULL;
+    }
+
+    *cell = NULL;
+    deque->num_tombstones++;
+    return element;
+}
+
+void deque_trim(deque_t * deque) {
+    while (deque->num_cells && !*deque_get_cell(deque, 0)) {
+        deque->first = (deque->first + 1) & (deque->max_cells - 1);
+        deque->num_cells--;
+        deque->num_tombstones--;
+    }
+    while (deque->num_cells && !*deque_get_cell(deque, deque->num_cells - 1)) {
+        deque->num_cells--;
+        deque->num_tombstones--;
+    }
+}
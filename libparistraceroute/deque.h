@@ -0,0 +1,122 @@
+#ifndef LIBPT_DEQUE_H
+#define LIBPT_DEQUE_H
+
+/**
+ * \file deque.h
+ * \brief Header file: double-ended queue.
+ *
+ * deque_t stores elements in a growable circular buffer, from the oldest
+ * to the youngest one. Elements are appended at the back and popped from
+ * the front in O(1). An element can also be removed from the middle of
+ * the deque in O(1): its cell is then left empty (a tombstone), so that
+ * the indexes of the other cells remain unchanged until the deque is
+ * trimmed (see deque_trim). Elements must not be NULL.
+ */
+
+#include <stddef.h>  // size_t
+#include <stdbool.h> // bool
+
+/**
+ * \struct deque_t
+ * \brief Structure representing a double-ended queue.
+ */
+
+typedef struct {
+    void   ** cells;          /**< Circular buffer (a tombstone is a NULL cell) */
+    size_t    first;          /**< Index of the first cell in cells */
+    size_t    num_cells;      /**< Number of cells in use, including the tombstones */
+    size_t    max_cells;      /**< Number of cells allocated (a power of 2) */
+    size_t    num_tombstones; /**< Number of tombstones */
+} deque_t;
+
+/**
+ * \brief Create an empty deque.
+ * \return The newly allocated deque if successful, NULL otherwise.
+ */
+
+deque_t * deque_create();
+
+/**
+ * \brief Release a deque from the memory.
+ * \param deque A deque_t instance.
+ * \param element_free Function called on each element still stored in
+ *    the deque (may be NULL).
+ */
+
+void deque_free(deque_t * deque, void (*element_free)(void * element));
+
+/**
+ * \brief Append an element at the back of a deque.
+ * \param deque A deque_t instance.
+ * \param element The element (not NULL).
+ * \return true iif successful.
+ */
+
+bool deque_push_back(deque_t * deque, void * element);
+
+/**
+ * \brief Retrieve the oldest element of a deque. The tombstones
+ *    located at the front of the deque (if any) are skipped.
+ * \param deque A deque_t instance.
+ * \return The corresponding element, NULL if the deque is empty.
+ */
+
+void * deque_front(const deque_t * deque);
+
+/**
+ * \brief Remove the oldest element of a deque.
+ * \param deque A deque_t instance.
+ * \return The removed element, NULL if the deque is empty.
+ */
+
+void * deque_pop_front(deque_t * deque);
+
+/**
+ * \brief Retrieve the number of elements stored in a deque.
+ * \param deque A deque_t instance.
+ * \return The number of elements (tombstones excluded).
+ */
+
+size_t deque_get_size(const deque_t * deque);
+
+/**
+ * \brief Retrieve the number of cells of a deque, including the
+ *    tombstones. Cells are indexed from 0 (the oldest) to
+ *    deque_get_num_cells() - 1 (the youngest).
+ * \param deque A deque_t instance.
+ * \return The number of cells.
+ */
+
+size_t deque_get_num_cells(const deque_t * deque);
+
+/**
+ * \brief Retrieve the element stored in a cell of a deque.
+ * \param deque A deque_t instance.
+ * \param i The index of the cell (see deque_get_num_cells).
+ * \return The corresponding element, NULL if this cell is a tombstone
+ *    or if i is out of range.
+ */
+
+void * deque_get_ith_cell(const deque_t * deque, size_t i);
+
+/**
+ * \brief Remove the element stored in a cell of a deque. The cell
+ *    becomes a tombstone, so that the indexes of the other cells
+ *    remain unchanged.
+ * \param deque A deque_t instance.
+ * \param i The index of the cell (see deque_get_num_cells).
+ * \return The removed element, NULL if this cell is a tombstone
+ *    or if i is out of range.
+ */
+
+void * deque_del_ith_cell(deque_t * deque, size_t i);
+
+/**
+ * \brief Drop the tombstones located at the front and at the back of
+ *    a deque. The indexes of the remaining cells may change.
+ * \param deque A deque_t instance.
+ */
+
+void deque_trim(deque_t * deque);
+
+#endif // LIBPT_DEQUE_H
@@ -6,15 +6,15 @@
 #include <stdbool.h>
 
 #include "dynarray.h"
+#include "pool.h"      // pools_alloc, pool_release
 
 #define DYNARRAY_SIZE_INIT  5
-#define DYNARRAY_SIZE_INC   5
 
 dynarray_t * dynarray_create()
 {
     dynarray_t * dynarray;
 
-    if (!(dynarray = malloc(sizeof(dynarray_t)))) {
+    if (!(dynarray = pools_alloc(POOL_DYNARRAY))) {
         goto ERR_MALLOC;
     }
 
@@ -24,15 +24,39 @@ dynarray_t * dynarray_create()
 
     dynarray->size = 0;
     dynarray->max_size = DYNARRAY_SIZE_INIT;
+    dynarray->arena = NULL;
 
     return dynarray;
 
 ERR_CALLOC:
-    free(dynarray);
+    pool_release(dynarray);
 ERR_MALLOC:
     return NULL;
 }
 
+dynarray_t * dynarray_create_in_arena(arena_t * arena)
+{
+    dynarray_t * dynarray;
+
+    if (!(dynarray = arena_alloc(arena, sizeof(dynarray_t)))) {
+        goto ERR_ARENA_ALLOC;
+    }
+
+    if (!(dynarray->elements = arena_calloc(arena, DYNARRAY_SIZE_INIT * sizeof(void *)))) {
+        goto ERR_ARENA_CALLOC;
+    }
+
+    dynarray->size = 0;
+    dynarray->max_size = DYNARRAY_SIZE_INIT;
+    dynarray->arena = arena;
+
+    return dynarray;
+
+ERR_ARENA_CALLOC:
+ERR_ARENA_ALLOC:
+    return NULL;
+}
+
 dynarray_t * dynarray_dup(const dynarray_t * dynarray, void * (*element_dup)(void *))
 {
     dynarray_t   * dynarray_dup;
@@ -67,27 +91,36 @@ void dynarray_free(dynarray_t * dynarray, void (*element_free)(void *element)) {
                     }
                 }
             }
-            free(dynarray->elements);
+            if (!dynarray->arena) free(dynarray->elements);
         }
-        free(dynarray);
+        if (!dynarray->arena) pool_release(dynarray);
     }
 }
 
 bool dynarray_push_element(dynarray_t * dynarray, void * element)
 {
-    // If the dynarray is full, allocate DYNARRAY_SIZE_INC
-    // cells in the dynarray
+    void   ** elements;
+    size_t    max_size;
+
+    // If the dynarray is full, double its size, so that pushing
+    // n elements costs O(n) copies.
     if (dynarray->size == dynarray->max_size) {
-        dynarray->elements = realloc(
-            dynarray->elements,
-            (dynarray->size + DYNARRAY_SIZE_INC) * sizeof(void *)
-        );
-        if (!dynarray->elements) return false;
+        max_size = dynarray->max_size < DYNARRAY_SIZE_INIT ? DYNARRAY_SIZE_INIT : 2 * dynarray->max_size;
+        if (dynarray->arena) {
+            // The previous buffer is given up until the arena is released
+            if (!(elements = arena_alloc(dynarray->arena, max_size * sizeof(void *)))) {
+                return false;
+            }
+            memcpy(elements, dynarray->elements, dynarray->size * sizeof(void *));
+        } else if (!(elements = realloc(dynarray->elements, max_size * sizeof(void *)))) {
+            return false;
+        }
         memset(
-            dynarray->elements + dynarray->size, 0,
-            DYNARRAY_SIZE_INC * sizeof(void *)
+            elements + dynarray->size, 0,
+            (max_size - dynarray->size) * sizeof(void *)
         );
-        dynarray->max_size += DYNARRAY_SIZE_INC;
+        dynarray->elements = elements;
+        dynarray->max_size = max_size;
     }
 
     // Add the new element and update exposed size
@@ -129,10 +162,10 @@ void dynarray_clear(dynarray_t * dynarray, void (*element_free)(void * element))
                 element_free(dynarray->elements[i]);
             }
         }
-        dynarray->elements = realloc(dynarray->elements, DYNARRAY_SIZE_INIT * sizeof(void *)); // XXX
-        memset(dynarray->elements, 0, DYNARRAY_SIZE_INIT * sizeof(void *));
+        // The buffer is kept as is, so that refilling the dynarray
+        // does not reallocate it.
+        memset(dynarray->elements, 0, size * sizeof(void *));
         dynarray->size = 0;
-        dynarray->max_size = DYNARRAY_SIZE_INIT;
     }
 }
 
@@ -4,13 +4,19 @@
 #include <stddef.h>  // size_t
 #include <stdbool.h> // bool
 
+#include "arena.h"   // arena_t
+
 /**
  * \file dynarray.h
  * \brief Header file: dynamic array structure
  *
- * dynarray_t manages a dynamic array of potentially infinite size, by
- * allocating memory in a chunk-by-chunk fashion. An initial memory_size is
- * allocated, and this size is increased by a given amount when needed.
+ * dynarray_t manages a dynamic array of potentially infinite size. An
+ * initial memory_size is allocated, and this size is doubled when needed.
+ * Clearing a dynarray keeps its buffer.
+ *
+ * A dynarray may also be allocated from an arena (see
+ * dynarray_create_in_arena): its buffers are then carved out of this
+ * arena, and released along with it.
  */
 
 /**
@@ -22,6 +28,7 @@ typedef struct {
     void   ** elements;  /**< Pointer to the array of elements */
     size_t    size;      /**< Size of the array (in bytes) (should be always <= to max_size) */
     size_t    max_size;  /**< Size of the allocated buffer (in bytes) */
+    arena_t * arena;     /**< Arena holding this dynarray and its buffer, NULL if allocated by malloc */
 } dynarray_t;
 
 /**
@@ -31,6 +38,16 @@ typedef struct {
 
 dynarray_t * dynarray_create();
 
+/**
+ * \brief Create a dynamic array structure in an arena. The dynarray
+ *    and its successive buffers are released along with the arena:
+ *    dynarray_free only releases its elements.
+ * \param arena An arena_t instance.
+ * \return A dynarray_t structure representing an empty dynamic array
+ */
+
+dynarray_t * dynarray_create_in_arena(arena_t * arena);
+
 /**
  * \brief Duplicate a dynarray
  * \param dynarray The dynarray to duplicate
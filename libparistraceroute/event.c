@@ -1,8 +1,7 @@
 #include "config.h"
 
-#include <stdlib.h> // malloc
-
 #include "event.h"
+#include "pool.h"   // pools_alloc
 
 event_t * event_create(
     event_type_t type,
@@ -11,22 +10,27 @@ event_t * event_create(
     void (*data_free) (void * data)
 ) {
     event_t * event;
-    if ((event = malloc(sizeof(event_t)))) {
+    if ((event = pools_alloc(POOL_EVENT))) {
         event->type = type;
         event->data = data;
         event->issuer = issuer;
         event->data_free = data_free;
+        event->num_refs = 1;
     }
     return event;
 }
 
+event_t * event_ref(event_t * event) {
+    event->num_refs++;
+    return event;
+}
+
 void event_free(event_t * event)
 {
-    if (event) {
+    if (event && --event->num_refs == 0) {
         if (event->data && event->data_free) {
             event->data_free(event->data);
         }
-        // TODO: trigger a double free. Ex: paris-traceroute -n 8.8.8.8
-        // free(event);
+        pool_release(event);
     }
 }
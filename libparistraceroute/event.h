@@ -1,6 +1,8 @@
 #ifndef LIBPT_EVENT_H
 #define LIBPT_EVENT_H
 
+#include <stddef.h> // size_t
+
 // Do not include "algorithm.h" to avoid mutual inclusion
 
 /**
@@ -15,6 +17,14 @@
  *   does the algorithm.
  *
  *   Specific-algorithm event are nested in a ALGORITHM_ANSWER event.
+ *
+ *   Events are reference counted. The queue an event is thrown to
+ *   (see pt_throw) owns the reference passed by the thrower, and
+ *   releases it once the event has been handled: a handler must not
+ *   release the event it handles, and must take an additional
+ *   reference (see event_ref) to throw it again. Likewise, the data
+ *   carried by an event (e.g. a probe_reply_t) is shared by taking a
+ *   reference to it rather than by duplicating it.
  */
 
 /**
@@ -48,12 +58,15 @@ typedef struct {
     void                        * data;               /**< Data carried by the event */
     void                       (* data_free)(void *); /**< Called in event_free to release data. Ignored if NULL. */
     struct algorithm_instance_s * issuer;             /**< Instance which has raised the event. NULL if raised by pt_loop. */
+    size_t                        num_refs;           /**< Number of references to this event (see event_ref) */
 } event_t;
 
 /**
- * \brief Create a new event structure
+ * \brief Create a new event structure. The caller holds the only
+ *    reference to this event.
  * \param type Event type
- * \param data Data that must be carried by this event
+ * \param data Data that must be carried by this event. Its reference
+ *    is handed over to the event, which releases it thanks to data_free.
  * \param issuer
  * \return Newly created event structure
  */
@@ -66,7 +79,17 @@ event_t * event_create(
 );
 
 /**
- * \brief Release an event when done
+ * \brief Take an additional reference to an event, e.g. to throw an
+ *    event handled by an algorithm to its caller.
+ * \param event An event_t instance.
+ * \return The event.
+ */
+
+event_t * event_ref(event_t * event);
+
+/**
+ * \brief Release a reference to an event. The event and its data are
+ *    released along with its last reference.
  * \param event The event to destroy
  */
 
@@ -171,6 +171,51 @@ field_t * field_create_generator(const char * key, struct generator_s * value) {
     return field_create(TYPE_GENERATOR, key, value);
 }
 
+field_t * field_init_uint8(field_t * field, const char * key, uint8_t value) {
+    field->key        = key;
+    field->type       = TYPE_UINT8;
+    field->value.int8 = value;
+    return field;
+}
+
+field_t * field_init_uint16(field_t * field, const char * key, uint16_t value) {
+    field->key         = key;
+    field->type        = TYPE_UINT16;
+    field->value.int16 = value;
+    return field;
+}
+
+field_t * field_init_uint32(field_t * field, const char * key, uint32_t value) {
+    field->key         = key;
+    field->type        = TYPE_UINT32;
+    field->value.int32 = value;
+    return field;
+}
+
+field_t * field_init_address(field_t * field, const char * key, const address_t * address) {
+    field->key = key;
+
+    switch (address->family) {
+#ifdef USE_IPV4
+        case AF_INET:
+            field->type       = TYPE_IPV4;
+            field->value.ipv4 = address->ip.ipv4;
+            break;
+#endif
+#ifdef USE_IPV6
+        case AF_INET6:
+            field->type       = TYPE_IPV6;
+            field->value.ipv6 = address->ip.ipv6;
+            break;
+#endif
+        default:
+            fprintf(stderr, "field_init_address: Invalid family address (family = %d)\n", address->family);
+            return NULL;
+    }
+
+    return field;
+}
+
 field_t * field_dup(const field_t * field) {
     const char * key_dup;
 
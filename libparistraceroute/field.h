@@ -272,6 +272,52 @@ void field_free(field_t * field);
 
 field_t * field_dup(const field_t * field);
 
+/**
+ * \brief Initialize a field_t instance allocated by the caller (for
+ *    instance on the stack) to hold an 8 bit integer value. Unlike
+ *    field_create_uint8, nothing is allocated, so the field must not
+ *    be passed to field_free.
+ * \param field The field to initialize
+ * \param key The name which identify the field
+ * \param value Value to store in the field
+ * \return The initialized field
+ */
+
+field_t * field_init_uint8(field_t * field, const char * key, uint8_t value);
+
+/**
+ * \brief Initialize a field_t instance allocated by the caller
+ *    to hold a 16 bit integer value (see field_init_uint8).
+ * \param field The field to initialize
+ * \param key The name which identify the field
+ * \param value Value to store in the field
+ * \return The initialized field
+ */
+
+field_t * field_init_uint16(field_t * field, const char * key, uint16_t value);
+
+/**
+ * \brief Initialize a field_t instance allocated by the caller
+ *    to hold a 32 bit integer value (see field_init_uint8).
+ * \param field The field to initialize
+ * \param key The name which identify the field
+ * \param value Value to store in the field
+ * \return The initialized field
+ */
+
+field_t * field_init_uint32(field_t * field, const char * key, uint32_t value);
+
+/**
+ * \brief Initialize a field_t instance allocated by the caller
+ *    to hold an address (see field_init_uint8).
+ * \param field The field to initialize
+ * \param key The name which identify the field
+ * \param address Address to copy in the field
+ * \return The initialized field, NULL if the address family is not supported
+ */
+
+field_t * field_init_address(field_t * field, const char * key, const address_t * address);
+
 #ifdef USE_IPV4
 /**
  * \brief Macro shorthand for field_create_ipv4
@@ -388,6 +434,47 @@ field_t * field_dup(const field_t * field);
 
 #define GENERATOR(x, y) field_create_generator(x, y)
 
+// The following macros build fields on the stack: they remain valid until
+// the end of the enclosing block and must not be freed. For instance:
+//
+//   probe_set_field_values(probe, FIELD_I8("ttl", ttl), FIELD_I16("flow_id", id), NULL);
+
+/**
+ * \brief Macro shorthand for field_init_uint8
+ * \param x Pointer to a char * key to identify the field
+ * \param y Value to store in the field
+ * \return The address of a field allocated on the stack
+ */
+
+#define FIELD_I8(x, y)  field_init_uint8(&(field_t) { .key = NULL }, x, (uint8_t) (y))
+
+/**
+ * \brief Macro shorthand for field_init_uint16
+ * \param x Pointer to a char * key to identify the field
+ * \param y Value to store in the field
+ * \return The address of a field allocated on the stack
+ */
+
+#define FIELD_I16(x, y) field_init_uint16(&(field_t) { .key = NULL }, x, (uint16_t) (y))
+
+/**
+ * \brief Macro shorthand for field_init_uint32
+ * \param x Pointer to a char * key to identify the field
+ * \param y Value to store in the field
+ * \return The address of a field allocated on the stack
+ */
+
+#define FIELD_I32(x, y) field_init_uint32(&(field_t) { .key = NULL }, x, (uint32_t) (y))
+
+/**
+ * \brief Macro shorthand for field_init_address
+ * \param x Pointer to a char * key to identify the field
+ * \param y Address (address_t *) to store in the field
+ * \return The address of a field allocated on the stack
+ */
+
+#define FIELD_ADDRESS(x, y) field_init_address(&(field_t) { .key = NULL }, x, y)
+
 /**
  * \brief Return the size (in bytes) related to a field type
  * \param type A field type
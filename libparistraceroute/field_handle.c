@@ -0,0 +1,37 @@
+#include "config.h"
+
+#include "field_handle.h"
+
+void field_handle_init(field_handle_t * handle, const char * name, size_t layer) {
+    handle->name           = name;
+    handle->layer          = layer;
+    handle->protocol       = NULL;
+    handle->protocol_field = NULL;
+}
+
+bool field_handle_resolve(field_handle_t * handle, const protocol_t * protocol)
+{
+    const protocol_field_t * protocol_field;
+
+    // The payload carries no field
+    if (!protocol) return false;
+
+    // The (possibly negative) lookup performed for this protocol is cached
+    if (protocol == handle->protocol) return handle->protocol_field != NULL;
+
+    handle->protocol       = protocol;
+    handle->protocol_field = protocol_field = protocol_get_field(protocol, handle->name);
+    if (!protocol_field) return false;
+
+    handle->type           = protocol_field->type;
+    handle->offset         = protocol_field->offset;
+#ifdef USE_BITS
+    handle->offset_in_bits = protocol_field->offset_in_bits;
+#endif
+    handle->size_in_bits   = protocol_field_get_size_in_bits(protocol_field);
+    return true;
+}
+
+size_t field_handle_get_size(const field_handle_t * handle) {
+    return handle->size_in_bits / 8 + (handle->size_in_bits % 8 ? 1 : 0);
+}
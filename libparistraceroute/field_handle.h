@@ -0,0 +1,89 @@
+#ifndef LIBPT_FIELD_HANDLE_H
+#define LIBPT_FIELD_HANDLE_H
+
+/**
+ * \file field_handle.h
+ * \brief Header file: pre-resolved field identifiers.
+ *
+ * Accessing a field by name (see probe_extract, probe_set_field)
+ * requires to compare this name with the name of each field of each
+ * traversed layer. A field_handle_t identifies a field by the index
+ * of the layer carrying it and by its name, and caches the location of
+ * this field (offset, width and type) once resolved in the protocol of
+ * this layer, so that hot paths access the field without any lookup
+ * (see probe_extract_handle, probe_set_field_handle).
+ *
+ * A handle is resolved lazily, and resolved again if it is applied to
+ * a layer whose protocol differs from the one it has been resolved in
+ * (for instance the transport layer of an UDP probe, then of an ICMP
+ * probe).
+ */
+
+#include <stdbool.h>        // bool
+#include <stddef.h>         // size_t
+
+#include "use.h"            // USE_BITS
+#include "field.h"          // fieldtype_t
+#include "protocol.h"       // protocol_t
+#include "protocol_field.h" // protocol_field_t
+
+/**
+ * \struct field_handle_t
+ * \brief A field of a given layer.
+ */
+
+typedef struct {
+    // Set by field_handle_init
+    const char             * name;           /**< Name of the field */
+    size_t                   layer;          /**< Index of the layer carrying the field */
+
+    // Set by field_handle_resolve
+    const protocol_t       * protocol;       /**< Protocol in which the handle has been resolved (NULL if unresolved) */
+    const protocol_field_t * protocol_field; /**< The field in this protocol (NULL if this protocol has no such field) */
+    fieldtype_t              type;           /**< Type of the field */
+    size_t                   offset;         /**< Offset (in bytes) of the field in the segment of the layer */
+#ifdef USE_BITS
+    size_t                   offset_in_bits; /**< Additional offset (in bits) */
+#endif
+    size_t                   size_in_bits;   /**< Width (in bits) of the field */
+} field_handle_t;
+
+/**
+ * \brief Static initializer of an unresolved field_handle_t instance.
+ * \param name The name of the field.
+ * \param layer The index of the layer carrying the field.
+ */
+
+#define FIELD_HANDLE(name, layer) { (name), (layer), NULL, NULL }
+
+/**
+ * \brief Initialize an unresolved field_handle_t instance.
+ * \param handle The handle to initialize.
+ * \param name The name of the field. The string must remain
+ *    allocated as long as the handle is used.
+ * \param layer The index of the layer carrying the field (0
+ *    corresponds to the first layer).
+ */
+
+void field_handle_init(field_handle_t * handle, const char * name, size_t layer);
+
+/**
+ * \brief Resolve a handle in a given protocol. Nothing is done
+ *    if the handle is already resolved in this protocol.
+ * \param handle The handle.
+ * \param protocol The protocol of the layer the handle is applied to.
+ *    Pass NULL for a payload layer.
+ * \return true iif this protocol has such a field.
+ */
+
+bool field_handle_resolve(field_handle_t * handle, const protocol_t * protocol);
+
+/**
+ * \brief Retrieve the size (in bytes) of the field identified by a handle.
+ * \param handle A handle previously resolved.
+ * \return The corresponding size (rounded up to the next byte).
+ */
+
+size_t field_handle_get_size(const field_handle_t * handle);
+
+#endif // LIBPT_FIELD_HANDLE_H
@@ -1,40 +1,13 @@
 #include "config.h"
 #include "use.h"    // USE_*
 
-#include <assert.h> // assert
 #include <stdarg.h> // va_*
 #include <stdlib.h> // malloc, free
-#include <string.h> // strcmp
+#include <string.h> // memcpy
 
 #include "bits.h"   // bits_*
 #include "filter.h" // filter_t
 
-filter_t * filter_create(const char * expr1, ...) {
-    const char * expr;
-    filter_t   * filter;
-    va_list      args;
-
-    if (!(filter = list_create(NULL, fprintf))) goto ERR_MALLOC;
-
-    va_start(args, expr1);
-    for (expr = expr1; expr; expr = va_arg(args, const char *)) {
-        if (!list_push_element(filter, (char *) expr)) {
-            goto ERR_LIST_PUSH_ELEMENT;
-        }
-    }
-    va_end(args);
-    return filter;
-
-ERR_LIST_PUSH_ELEMENT:
-    filter_free(filter);
-ERR_MALLOC:
-    return filter;
-}
-
-void filter_free(filter_t * filter) {
-    list_free(filter);
-}
-
 static bool filter_parse_fieldname(
     const char * fieldname,
     char       * buffer_protocol,
@@ -69,6 +42,116 @@ static bool filter_parse_fieldname(
     return true;
 }
 
+/**
+ * \brief Resolve a "protocol.fieldname" expression.
+ * \param field The filter_field_t instance to set.
+ * \param expr The expression (e.g. "ipv4.src_ip").
+ * \return true iff successful.
+ */
+
+static bool filter_field_resolve(filter_field_t * field, const char * expr) {
+    char protocol_name[20];
+    char field_name[20];
+
+    // e.g. "ipv4.src_ip" --> "ipv4" "src_ip"
+    if (!filter_parse_fieldname(
+        expr,
+        protocol_name, sizeof(protocol_name),
+        field_name,    sizeof(field_name)
+    )) {
+        fprintf(stderr, "filter_create: cannot parse '%s'\n", expr);
+        return false;
+    }
+
+    if (!(field->protocol = protocol_search(protocol_name))) {
+        fprintf(stderr, "filter_create: unknown protocol '%s'\n", protocol_name);
+        return false;
+    }
+
+    if (!(field->protocol_field = protocol_get_field(field->protocol, field_name))) {
+        fprintf(stderr, "filter_create: '%s' protocol does not have field name '%s'\n", protocol_name, field_name);
+        return false;
+    }
+
+    field->offset_in_bits = 8 * field->protocol_field->offset;
+#ifdef USE_BITS
+    if (field->protocol_field->type == TYPE_BITS) {
+        field->offset_in_bits += field->protocol_field->offset_in_bits;
+    }
+#endif
+    field->size_in_bits = protocol_field_get_size_in_bits(field->protocol_field);
+    return true;
+}
+
+filter_t * filter_create(const char * expr1, ...) {
+    const char * expr;
+    filter_t   * filter;
+    va_list      args;
+
+    if (!(filter = malloc(sizeof(filter_t))))            goto ERR_MALLOC;
+    if (!(filter->exprs = list_create(NULL, fprintf)))   goto ERR_LIST_CREATE;
+    filter->num_fields = 0;
+    filter->size_in_bits = 0;
+
+    va_start(args, expr1);
+    for (expr = expr1; expr; expr = va_arg(args, const char *)) {
+        if (filter->num_fields == FILTER_MAX_FIELDS) {
+            fprintf(stderr, "filter_create: too many expressions (maximum: %d)\n", FILTER_MAX_FIELDS);
+            goto ERR_FILTER_FIELD;
+        }
+        if (!filter_field_resolve(&filter->fields[filter->num_fields], expr)) {
+            goto ERR_FILTER_FIELD;
+        }
+        filter->size_in_bits += filter->fields[filter->num_fields++].size_in_bits;
+        if (!list_push_element(filter->exprs, (char *) expr)) {
+            goto ERR_LIST_PUSH_ELEMENT;
+        }
+    }
+    va_end(args);
+    return filter;
+
+ERR_LIST_PUSH_ELEMENT:
+ERR_FILTER_FIELD:
+    va_end(args);
+    list_free(filter->exprs);
+ERR_LIST_CREATE:
+    free(filter);
+ERR_MALLOC:
+    return NULL;
+}
+
+void filter_free(filter_t * filter) {
+    if (filter) {
+        list_free(filter->exprs);
+        free(filter);
+    }
+}
+
+bool filter_compile(const filter_t * filter, const probe_t * probe, filter_op_t * ops) {
+    const filter_field_t * field;
+    const layer_t        * layer;
+    size_t                 i, depth = 0;
+
+    for (i = 0; i < filter->num_fields; i++) {
+        field = &filter->fields[i];
+
+        // Find the corresponding layer, if any. Fieldnames appear in the
+        // same order in the packet and in the filters.
+        for (; (layer = probe_get_layer(probe, depth)); depth++) {
+            if (layer->protocol == field->protocol) break;
+        }
+
+        if (!layer || field->offset_in_bits + field->size_in_bits > 8 * layer->segment_size) {
+            return false;
+        }
+
+        ops[i].layer          = depth;
+        ops[i].offset_in_bits = field->offset_in_bits;
+        ops[i].size_in_bits   = field->size_in_bits;
+    }
+    return filter->num_fields > 0;
+}
+
 bool filter_iter(
     const filter_t * filter,
     const probe_t  * probe,
@@ -81,85 +164,28 @@ bool filter_iter(
    ),
    void * user_data
 ) {
-    list_cell_t * cur;
-    const char  * fieldname;
-    char          protocol_name[20];
-    char          field_name[20];
-    layer_t     * layer;
-    size_t        i,
-                  depth = 0,
-                  num_layers = probe_get_num_layers(probe);
-
-    for (cur = filter->head; cur; cur = cur->next) {
-        // Extract from the current peace of filter the protocol and the fieldname
-        // e.g. "ipv4.icmpv4" --> "ipv4" "icmpv4"
-        fieldname = cur->element;
-        if (!filter_parse_fieldname(
-            fieldname,
-            protocol_name, sizeof(protocol_name),
-            field_name,    sizeof(field_name)
-        )) {
-            fprintf(stderr, "filter_iter: cannot parse '%s'\n", fieldname);
-        }
+    filter_op_t ops[FILTER_MAX_FIELDS];
+    size_t      i;
 
-        // Find the corresponding layer, if any.
-        layer = NULL;
-        for (i = depth; i < num_layers; i++) {
-            if (!strcmp(probe_get_protocol_name(probe, i), protocol_name)) {
-                layer = probe_get_layer(probe, i);
-                break;
-            }
-        }
+    if (!filter_compile(filter, probe, ops)) return false; // abort
 
-        if (!layer) {
-            //fprintf(stderr, "filter_get_matching_size_in_bits: '%s' not found in this probe:\n", protocol_name);
-            //probe_fprintf(stderr, probe);
-            return false; // abort
-        }
-
-        // Fieldnames appear in the same order in the packet and in the filters.
-        depth = i;
-
-        // Find the field, if any.
-        const protocol_field_t * protocol_field = layer_get_protocol_field(layer, field_name);
-        if (!protocol_field) {
-            //fprintf(stderr, "filter_get_matching_size_in_bits: '%s' protocol does not have field name '%s'\n", protocol_name, field_name);
-            return false; // abort
-        } else {
-            if (!callback(filter, probe, layer, protocol_field, user_data)) break;
-        }
+    for (i = 0; i < filter->num_fields; i++) {
+        if (!callback(filter, probe, probe_get_layer(probe, ops[i].layer), filter->fields[i].protocol_field, user_data)) break;
     }
     return true;
 }
 
 void filter_dump(const filter_t * filter) {
-    list_dump(filter);
+    list_dump(filter->exprs);
 }
 
 void filter_fprintf(FILE * out, const filter_t * filter) {
-    list_fprintf(out, filter);
-}
-
-//---------------------------------------------------------------------------
-// filter_get_matching_size_in_bits
-//---------------------------------------------------------------------------
-
-static bool filter_size_in_bits_callback(
-    const filter_t         * filter,
-    const probe_t          * probe,
-    const layer_t          * layer,
-    const protocol_field_t * protocol_field,
-    void                   * _user_data
-) {
-    size_t * user_data = (size_t *) _user_data;
-    *user_data += protocol_field_get_size_in_bits(protocol_field);
-    return true; // continue until having processed each field of the metafield.
+    list_fprintf(out, filter->exprs);
 }
 
 size_t filter_get_matching_size_in_bits(const filter_t * filter, const probe_t * probe) {
-    size_t size_in_bits = 0;
-    return filter_iter(filter, probe, filter_size_in_bits_callback, &size_in_bits) ?
-        size_in_bits : 0;
+    filter_op_t ops[FILTER_MAX_FIELDS];
+    return filter_compile(filter, probe, ops) ? filter->size_in_bits : 0;
 }
 
 bool filter_matches(const filter_t * filter, const probe_t * probe) {
@@ -167,192 +193,108 @@ bool filter_matches(const filter_t * filter, const probe_t * probe) {
 }
 
 //---------------------------------------------------------------------------
-// filter_read
-// TODO: factorize filter_{read|write}_callback
+// filter_read, filter_write
 //---------------------------------------------------------------------------
 
-typedef struct filter_read_data_s {
-    // Input buffer
-    size_t    num_bits_processed;
-
-    // Output buffer
-    size_t    num_bits_available;
-    uint8_t * output_buffer;
-
-#ifdef USE_BITS
-    uint8_t   input_offset;
-    uint8_t   output_offset;
-#endif
-} filter_read_data_t;
-
-static bool filter_read_callback(
-    const filter_t         * filter,
-    const probe_t          * probe,
-    const layer_t          * layer,
-    const protocol_field_t * protocol_field,
-    void                   * _user_data
+/**
+ * \brief Copy a sequence of bits.
+ * \param out The output buffer.
+ * \param offset_in_bits_out The offset (in bits) of the first bit written in out.
+ * \param in The input buffer.
+ * \param offset_in_bits_in The offset (in bits) of the first bit read in in.
+ * \param size_in_bits The number of bits to copy.
+ * \return true iff successful.
+ */
+
+static bool filter_copy_bits(
+    uint8_t       * out,
+    size_t          offset_in_bits_out,
+    const uint8_t * in,
+    size_t          offset_in_bits_in,
+    size_t          size_in_bits
 ) {
-    bool                 no_offset = true;
-    size_t               field_segment_size_in_bits;
-    uint8_t            * field_segment;
-    filter_read_data_t * user_data = (filter_read_data_t *) _user_data;
-
-    if (!(field_segment = layer_get_field_segment(layer, protocol_field->key))) {
-        fprintf(
-            stderr,
-            "filter_read_callback: in layer '%s': cannot find '%s' field\n",
-            layer->protocol->name,
-            protocol_field->key
-        );
-        return false;
-    }
+    out += offset_in_bits_out / 8;
+    in  += offset_in_bits_in  / 8;
 
-    field_segment_size_in_bits = protocol_field_get_size_in_bits(protocol_field);
-    assert(field_segment_size_in_bits <= user_data->num_bits_available);
-    if (no_offset && (field_segment_size_in_bits % 8 == 0)) {
-        memcpy(user_data->output_buffer, field_segment, field_segment_size_in_bits / 8);
-        user_data->num_bits_processed += field_segment_size_in_bits;
-        user_data->num_bits_available -= field_segment_size_in_bits;
-        user_data->output_buffer      += field_segment_size_in_bits / 8;
-    } else {
-        fprintf(stderr, "filter_read_callback: unaligned field: not yet implemented\n");
+    if (offset_in_bits_out % 8 == 0 && offset_in_bits_in % 8 == 0 && size_in_bits % 8 == 0) {
+        memcpy(out, in, size_in_bits / 8);
+        return true;
     }
 
-    return true; // continue until having processed each field of the filter.
+#ifdef USE_BITS
+    return bits_write(out, offset_in_bits_out % 8, in, offset_in_bits_in % 8, size_in_bits);
+#else
+    fprintf(stderr, "filter_copy_bits: unaligned field: not supported\n");
+    return false;
+#endif
 }
 
-bool filter_read(const filter_t * filter, const probe_t * probe, uint8_t * output_buffer, size_t num_bits) {
-    bool success;
-    size_t filter_size_in_bits;
-    filter_read_data_t user_data = {
-        .num_bits_processed = 0,
-        .num_bits_available = num_bits,
-        .output_buffer      = output_buffer,
-
-    };
-
-    // The probe does not match any filter supplied by the filter.
-    if (!filter) return false;
+bool filter_read_ops(const filter_t * filter, const probe_t * probe, const filter_op_t * ops, uint8_t * output_buffer, size_t num_bits) {
+    size_t i, offset_in_bits = 0;
 
     // Check whether the buffer is large enough to store the data.
-    filter_size_in_bits = filter_get_matching_size_in_bits(filter, probe);
-    if (filter_size_in_bits > num_bits) {
-        fprintf(stderr, "filter_read: buffer too small (size in bits: %zu, required: %zu)\n", num_bits, filter_size_in_bits);
+    if (filter->size_in_bits > num_bits) {
+        fprintf(stderr, "filter_read: buffer too small (size in bits: %zu, required: %zu)\n", num_bits, filter->size_in_bits);
         return false;
     }
 
     // Extract
-    success = filter_iter(filter, probe, filter_read_callback, &user_data);
-    assert(success);
+    for (i = 0; i < filter->num_fields; i++) {
+        if (!filter_copy_bits(
+            output_buffer, offset_in_bits,
+            probe_get_layer(probe, ops[i].layer)->segment, ops[i].offset_in_bits,
+            ops[i].size_in_bits
+        )) {
+            return false;
+        }
+        offset_in_bits += ops[i].size_in_bits;
+    }
 
     return true;
 }
 
-//---------------------------------------------------------------------------
-// filter_write
-//---------------------------------------------------------------------------
+bool filter_read(const filter_t * filter, const probe_t * probe, uint8_t * output_buffer, size_t num_bits) {
+    filter_op_t ops[FILTER_MAX_FIELDS];
 
-typedef struct filter_write_data_s {
-    // Input buffer
-    size_t          num_bits_processed;
-    const uint8_t * input_buffer;
+    // The probe does not match any filter supplied by the filter.
+    if (!filter || !filter_compile(filter, probe, ops)) return false;
 
-    // Output (metafield bits)
-    size_t          num_bits_available;
+    return filter_read_ops(filter, probe, ops, output_buffer, num_bits);
+}
 
-#ifdef USE_BITS
-    uint8_t         input_offset;
-    uint8_t         output_offset;
-#endif
-} filter_write_data_t;
-
-static bool filter_write_callback(
-    const filter_t         * filter,
-    const probe_t          * probe,
-    const layer_t          * layer,
-    const protocol_field_t * protocol_field,
-    void                   * _user_data
-) {
-    bool                  no_offset = true;
-    size_t                field_segment_size_in_bits;
-    uint8_t             * field_segment;
-    filter_write_data_t * user_data = (filter_write_data_t *) _user_data;
-
-    if (!(field_segment = layer_get_field_segment(layer, protocol_field->key))) {
-        fprintf(
-            stderr,
-            "filter_write_callback: in layer '%s': cannot find '%s' field\n",
-            layer->protocol->name,
-            protocol_field->key
-        );
+bool filter_write_ops(const filter_t * filter, const probe_t * probe, const filter_op_t * ops, const uint8_t * input_buffer, size_t num_bits) {
+    size_t i, offset_in_bits = 0;
+
+    // Check whether the packet is large enough to store the data.
+    if (num_bits > filter->size_in_bits) {
+        fprintf(stderr, "filter_write: buffer too large (size in bits: %zu, maximum size: %zu)\n", num_bits, filter->size_in_bits);
         return false;
     }
 
-    field_segment_size_in_bits = protocol_field_get_size_in_bits(protocol_field);
-    if (no_offset && (field_segment_size_in_bits % 8 == 0)) {
-        assert(field_segment_size_in_bits <= user_data->num_bits_available);
-        memcpy(field_segment, user_data->input_buffer, field_segment_size_in_bits / 8);
-    } else {
-        if (!(bits_write(
-            field_segment,              user_data->output_offset,
-            user_data->input_buffer,    user_data->input_offset,
-            field_segment_size_in_bits
-        ))) {
-            fprintf(stderr, "filter_write_callback: bits_write failed");
+    // Each field is entirely written.
+    if (num_bits < filter->size_in_bits) return false;
+
+    // Write
+    for (i = 0; i < filter->num_fields; i++) {
+        if (!filter_copy_bits(
+            probe_get_layer(probe, ops[i].layer)->segment, ops[i].offset_in_bits,
+            input_buffer, offset_in_bits,
+            ops[i].size_in_bits
+        )) {
+            fprintf(stderr, "filter_write: bits_write failed\n");
             return false;
         }
+        offset_in_bits += ops[i].size_in_bits;
     }
 
-    // Update stats
-    user_data->num_bits_processed += field_segment_size_in_bits;
-    user_data->num_bits_available -= field_segment_size_in_bits;
-
-    // Update pointers and offsets
-#ifdef USE_BITS
-    user_data->input_offset += field_segment_size_in_bits;
-    if (user_data->input_offset >= 8) {
-        user_data->input_buffer += user_data->input_offset / 8;
-        user_data->input_offset %= 8;
-    }
-
-    user_data->output_offset += field_segment_size_in_bits;
-    if (user_data->output_offset >= 8) {
-        user_data->output_offset %= 8;
-    }
-#else
-    user_data->input_buffer += field_segment_size_in_bits / 8;
-#endif
-
-    return true; // continue until having processed each field of the filter.
+    return true;
 }
 
 bool filter_write(const filter_t * filter, const probe_t * probe, const uint8_t * input_buffer, size_t num_bits) {
-    bool success;
-    size_t filter_size_in_bits;
-    filter_write_data_t user_data = {
-        .num_bits_processed = 0,
-        .num_bits_available = num_bits,
-#ifdef USE_BITS
-        .input_offset       = 0,
-        .output_offset      = 0,
-#endif
-        .input_buffer       = input_buffer,
-    };
+    filter_op_t ops[FILTER_MAX_FIELDS];
 
     // The probe does not match any filter supplied by the filter.
-    if (!filter) return false;
-
-    // Check whether the packet is large enough to store the data.
-    filter_size_in_bits = filter_get_matching_size_in_bits(filter, probe);
-    if (num_bits > filter_size_in_bits) {
-        fprintf(stderr, "filter_write: buffer too large (size in bits: %zu, maximum size: %zu)\n", num_bits, filter_size_in_bits);
-        return false;
-    }
-
-    // Write
-    success = filter_iter(filter, probe, filter_write_callback, &user_data);
-    assert(success);
+    if (!filter || !filter_compile(filter, probe, ops)) return false;
 
-    return user_data.num_bits_processed == num_bits;
+    return filter_write_ops(filter, probe, ops, input_buffer, num_bits);
 }
-
@@ -27,15 +27,55 @@
 #include "containers/list.h"    // list_t
 #include "layer.h"              // layer_t
 #include "probe.h"              // probe_t
+#include "protocol.h"           // protocol_t
 #include "protocol_field.h"     // protocol_field_t
 
-typedef list_t filter_t;
+// Maximum number of expressions involved in a filter
+#define FILTER_MAX_FIELDS 8
+
+/**
+ * \struct filter_field_t
+ * \brief A "protocol.fieldname" expression resolved by filter_create.
+ */
+
+typedef struct {
+    const protocol_t       * protocol;       /**< Protocol carrying the field (e.g. ipv4) */
+    const protocol_field_t * protocol_field; /**< The field in this protocol (e.g. src_ip) */
+    size_t                   offset_in_bits; /**< Offset (in bits) of the field in the segment of the layer */
+    size_t                   size_in_bits;   /**< Width (in bits) of the field */
+} filter_field_t;
+
+/**
+ * \struct filter_op_t
+ * \brief Location of a field of a filter in a given probe (see filter_compile).
+ */
+
+typedef struct {
+    size_t layer;          /**< Index of the layer carrying the field */
+    size_t offset_in_bits; /**< Offset (in bits) of the field in the segment of this layer */
+    size_t size_in_bits;   /**< Width (in bits) of the field */
+} filter_op_t;
+
+/**
+ * \struct filter_t
+ * \brief A filter. The expressions are parsed once by filter_create, so that
+ *    a filter is applied to a probe without any string handling.
+ */
+
+typedef struct filter_s {
+    list_t         * exprs;                     /**< The "protocol.fieldname" expressions. list<char *> */
+    filter_field_t   fields[FILTER_MAX_FIELDS]; /**< The resolved expressions */
+    size_t           num_fields;                /**< Number of expressions */
+    size_t           size_in_bits;              /**< Sum of the widths of the fields */
+} filter_t;
 
 /**
  * \brief Create a filter_t instance.
  * \param expr1 Describe the "protocol.name" expressions describing
- *   the filters to consider. Example: "ipv4.src_ip".
- * \return The address of the filter_t if successful, NULL otherwise.
+ *   the filters to consider. Example: "ipv4.src_ip". The list of
+ *   expressions must be terminated by NULL.
+ * \return The address of the filter_t if successful, NULL otherwise
+ *   (in particular if an expression cannot be resolved).
  */
 
 filter_t * filter_create(const char * expr1, ...);
@@ -47,6 +87,21 @@ filter_t * filter_create(const char * expr1, ...);
 
 void filter_free(filter_t * filter);
 
+/**
+ * \brief Locate in a probe each field involved in a filter. Layers are
+ *    matched by comparing their protocol with the ones resolved by
+ *    filter_create, and the fields appear in the same order in the
+ *    packet and in the filter.
+ * \param filter A filter_t instance.
+ * \param probe A probe_t instance.
+ * \param ops A pre-allocated array of at least FILTER_MAX_FIELDS
+ *    filter_op_t. Its filter->num_fields first cells are set if
+ *    successful.
+ * \return true iff the filter matches the probe.
+ */
+
+bool filter_compile(const filter_t * filter, const probe_t * probe, filter_op_t * ops);
+
 /**
  * \brief Iterate over a probe according to a filter_t.
  * \param filter A filter_t instance.
@@ -129,5 +184,32 @@ bool filter_read(const filter_t * filter, const probe_t * probe, uint8_t * outpu
 
 bool filter_write(const filter_t * filter, const probe_t * probe, const uint8_t * input_buffer, size_t num_bits);
 
+/**
+ * \brief Same as filter_read, once the filter has been compiled
+ *    for this probe (see filter_compile).
+ * \param filter_t A filter_t instance.
+ * \param probe A probe_t instance.
+ * \param ops The operations returned by filter_compile.
+ * \param output_buffer The pre-allocated buffer where the bits from the
+ *    packet read are written.
+ * \param num_bits The number of bits available in output_buffer.
+ * \return true iff successful.
+ */
+
+bool filter_read_ops(const filter_t * filter, const probe_t * probe, const filter_op_t * ops, uint8_t * output_buffer, size_t num_bits);
+
+/**
+ * \brief Same as filter_write, once the filter has been compiled
+ *    for this probe (see filter_compile).
+ * \param filter_t A filter_t instance.
+ * \param probe A probe_t instance.
+ * \param ops The operations returned by filter_compile.
+ * \param input_buffer The buffer where the bits to write into the packet are read.
+ * \param num_bits The number of bits to write.
+ * \return true iff successful.
+ */
+
+bool filter_write_ops(const filter_t * filter, const probe_t * probe, const filter_op_t * ops, const uint8_t * input_buffer, size_t num_bits);
+
 #endif
 
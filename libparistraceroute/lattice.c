@@ -33,6 +33,25 @@ ERR_MALLOC:
     return NULL;
 }
 
+lattice_elt_t * lattice_elt_create_in_arena(arena_t * arena, void * data)
+{
+    lattice_elt_t * elt;
+
+    if (!(elt = arena_alloc(arena, sizeof(lattice_elt_t))))     goto ERR_ARENA_ALLOC;
+    if (!(elt->next = dynarray_create_in_arena(arena)))         goto ERR_DYNARRAY_CREATE;
+    if (!(elt->siblings = dynarray_create_in_arena(arena)))     goto ERR_DYNARRAY_CREATE2;
+    if (!dynarray_push_element(elt->siblings, elt))             goto ERR_DYNARRAY_PUSH_ELEMENT;
+    elt->data = data;
+
+    return elt;
+
+ERR_DYNARRAY_PUSH_ELEMENT:
+ERR_DYNARRAY_CREATE2:
+ERR_DYNARRAY_CREATE:
+ERR_ARENA_ALLOC:
+    return NULL;
+}
+
 void lattice_elt_free(lattice_elt_t * elt) {
     // TODO element_free
     dynarray_free(elt->siblings, NULL);
@@ -69,6 +88,19 @@ ERR_MALLOC:
     return NULL;
 }
 
+lattice_t * lattice_create_in_arena(arena_t * arena) {
+    lattice_t * lattice;
+
+    if (!(lattice = arena_calloc(arena, sizeof(lattice_t))))  goto ERR_ARENA_CALLOC;
+    if (!(lattice->roots = dynarray_create_in_arena(arena))) goto ERR_DYNARRAY_CREATE;
+    lattice->arena = arena;
+
+    return lattice;
+ERR_DYNARRAY_CREATE:
+ERR_ARENA_CALLOC:
+    return NULL;
+}
+
 void lattice_free(lattice_t * lattice, void (*lattice_element_free)(void *element))
 {
     /* TODO Free elements and data if needed ? */
@@ -209,7 +241,10 @@ bool lattice_add_element(lattice_t * lattice, lattice_elt_t * predecessor, void
 {
     lattice_elt_t * elt;
    
-    if (!(elt = lattice_elt_create(data))) goto ERR_LATTICE_ELT_CREATE;
+    elt = lattice->arena ?
+        lattice_elt_create_in_arena(lattice->arena, data) :
+        lattice_elt_create(data);
+    if (!elt) goto ERR_LATTICE_ELT_CREATE;
 
     if (!predecessor) {
         // No predecessors, so the new node is stored as a new root.
@@ -227,7 +262,8 @@ bool lattice_add_element(lattice_t * lattice, lattice_elt_t * predecessor, void
 
 ERR_LATTICE_CONNECT:
 ERR_DYNARRAY_PUSH_ELEMENT:
-    lattice_elt_free(elt);
+    // A node allocated in an arena is released along with the arena
+    if (!lattice->arena) lattice_elt_free(elt);
 ERR_LATTICE_ELT_CREATE:
     return false;
 }
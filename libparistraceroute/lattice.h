@@ -2,6 +2,7 @@
 #define LIBPT_LATTICE_H
 
 #include "dynarray.h"
+#include "arena.h"
 
 typedef enum {
     LATTICE_DONE,
@@ -35,6 +36,18 @@ typedef struct {
 
 lattice_elt_t * lattice_elt_create(void * data);
 
+/**
+ * \brief Allocate a lattice_elt_t instance (lattice node) in an arena.
+ *    It is released along with the arena and must not be passed to
+ *    lattice_elt_free.
+ * \param arena An arena_t instance.
+ * \param data This address is stored in the newly allocated node.
+ * \return The newly allocated lattice_elt_t instance if successful,
+ *    NULL otherwise.
+ */
+
+lattice_elt_t * lattice_elt_create_in_arena(arena_t * arena, void * data);
+
 /**
  * \brief Release a lattice_elt_t instance from the memory.
  * \param elt A lattice_elt_t instance.
@@ -52,6 +65,7 @@ typedef struct {
     //lattice_elt_t *root;
     dynarray_t * roots;
     int       (* cmp)(const void *, const void *);
+    arena_t    * arena; /**< Arena holding this lattice and its nodes, NULL if allocated by malloc */
 } lattice_t;
 
 /**
@@ -63,6 +77,17 @@ typedef struct {
 
 lattice_t * lattice_create();
 
+/**
+ * \brief Allocate a lattice_t instance in an arena. The lattice and
+ *    each node added later are released along with the arena, so it
+ *    must not be passed to lattice_free.
+ * \param arena An arena_t instance.
+ * \return The newly allocated lattice_t instance if successful,
+ *    NULL otherwise.
+ */
+
+lattice_t * lattice_create_in_arena(arena_t * arena);
+
 /**
  * \brief Release a lattice_t instance from the memory.
  * \param lattice A lattice_t instance.
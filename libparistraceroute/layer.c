@@ -9,13 +9,14 @@
 
 #include "layer.h"
 #include "common.h"
+#include "pool.h"   // pools_calloc, pool_release
 
 #ifdef USE_BITS
 #    include "bits.h"
 #endif
 
 layer_t * layer_create() {
-    layer_t * layer = calloc(1, sizeof(layer_t));
+    layer_t * layer = pools_calloc(POOL_LAYER);
     if (!layer) goto ERR_CALLOC;
     layer->mask = NULL;
     return layer;
@@ -26,7 +27,7 @@ ERR_CALLOC:
 
 void layer_free(layer_t * layer) {
     if (layer) {
-        free(layer);
+        pool_release(layer);
     }
 }
 
@@ -130,9 +131,22 @@ bool layer_set_field(layer_t * layer, const field_t * field) {
         goto ERR_LAYER_GET_PROTOCOL_FIELD;
     }
 
+    return layer_set_protocol_field(layer, protocol_field, field);
+
+ERR_LAYER_GET_PROTOCOL_FIELD:
+ERR_INVALID_FIELD:
+    return false;
+}
+
+bool layer_set_protocol_field(layer_t * layer, const protocol_field_t * protocol_field, const field_t * field) {
+    if (!field || field->type == TYPE_GENERATOR) {
+        fprintf(stderr, "layer_set_protocol_field: invalid field\n");
+        goto ERR_INVALID_FIELD;
+    }
+
     if (protocol_field->type != field->type) {
         fprintf(stderr, "layer_set_field: '%s' field has not the right type (%s instead of %s) (layer %s)\n",
-            field->key,
+            protocol_field->key,
             field_type_to_string(field->type),
             field_type_to_string(protocol_field->type),
             layer->protocol->name
@@ -145,7 +159,7 @@ bool layer_set_field(layer_t * layer, const field_t * field) {
     if ((protocol_field->set && !protocol_field->set(layer->segment, field))
     || (!protocol_field->set && !protocol_field_set(protocol_field, layer->segment, field))
     ) {
-        fprintf(stderr, "layer_set_field: can't set field '%s' (layer %s)\n", field->key, layer->protocol->name);
+        fprintf(stderr, "layer_set_field: can't set field '%s' (layer %s)\n", protocol_field->key, layer->protocol->name);
         goto ERR_PROTOCOL_FIELD_SET;
     }
 
@@ -155,7 +169,6 @@ bool layer_set_field(layer_t * layer, const field_t * field) {
 
 ERR_PROTOCOL_FIELD_SET:
 ERR_INVALID_FIELD_TYPE:
-ERR_LAYER_GET_PROTOCOL_FIELD:
 ERR_INVALID_FIELD:
     return false;
 }
@@ -308,8 +321,6 @@ static bool value_htons(void * value, fieldtype_t type) {
 
 bool layer_extract(const layer_t * layer, const char * key, void * value) {
     const protocol_field_t * protocol_field;
-    field_t                * field;
-    bool                     ret;
 
     if (!(layer && layer->protocol)) {
         goto ERR_INVALID_LAYER;
@@ -319,6 +330,17 @@ bool layer_extract(const layer_t * layer, const char * key, void * value) {
         goto ERR_PROTOCOL_GET_FIELD;
     }
 
+    return layer_extract_protocol_field(layer, protocol_field, value);
+
+ERR_PROTOCOL_GET_FIELD:
+ERR_INVALID_LAYER:
+    return false;
+}
+
+bool layer_extract_protocol_field(const layer_t * layer, const protocol_field_t * protocol_field, void * value) {
+    field_t * field;
+    bool      ret;
+
     if (protocol_field->get) {
         // TYPE_BITS fields typically rely on dedicated callbacks
         if (!(field = protocol_field->get(layer->segment))) {
@@ -350,8 +372,6 @@ bool layer_extract(const layer_t * layer, const char * key, void * value) {
     return ret;
 
 ERR_PROTOCOL_FIELD_GET:
-ERR_PROTOCOL_GET_FIELD:
-ERR_INVALID_LAYER:
     return false;
 }
 
@@ -82,34 +82,40 @@ bool metafield_add_filter(metafield_t * metafield, filter_t * filter) {
     return list_push_element(metafield->filters, filter);
 }
 
-filter_t * metafield_find_filter(const metafield_t * metafield, const probe_t * probe) {
+const filter_t * metafield_compile(const metafield_t * metafield, const probe_t * probe, filter_op_t * ops) {
     const filter_t * filter;
     list_cell_t    * cur;
 
     for (cur = metafield->filters->head; cur; cur = cur->next) {
         filter = cur->element;
-        if (filter_matches(filter, probe)) break;
+        if (filter_compile(filter, probe, ops)) return filter;
     }
 
-    return cur ? cur->element : NULL;
+    return NULL;
+}
+
+filter_t * metafield_find_filter(const metafield_t * metafield, const probe_t * probe) {
+    filter_op_t ops[FILTER_MAX_FIELDS];
+    return (filter_t *) metafield_compile(metafield, probe, ops);
 }
 
 size_t metafield_get_matching_size_in_bits(const metafield_t * metafield, const probe_t * probe) {
     const filter_t * filter = metafield_find_filter(metafield, probe);
-    return filter ? filter_get_matching_size_in_bits(filter, probe) : 0;
+    return filter ? filter->size_in_bits : 0;
 }
 
 bool metafield_read(const metafield_t * metafield, const probe_t * probe, uint8_t * buffer, size_t num_bits) {
-    const filter_t * filter = metafield_find_filter(metafield, probe);
-    return filter ? filter_read(filter, probe, buffer, num_bits) : false;
+    filter_op_t      ops[FILTER_MAX_FIELDS];
+    const filter_t * filter = metafield_compile(metafield, probe, ops);
+    return filter ? filter_read_ops(filter, probe, ops, buffer, num_bits) : false;
 }
 
 bool metafield_write(const metafield_t * metafield, const probe_t * probe, uint8_t * buffer, size_t num_bits) {
-    const filter_t * filter = metafield_find_filter(metafield, probe);
-    return filter ? filter_write(filter, probe, buffer, num_bits) : false;
+    filter_op_t      ops[FILTER_MAX_FIELDS];
+    const filter_t * filter = metafield_compile(metafield, probe, ops);
+    return filter ? filter_write_ops(filter, probe, ops, buffer, num_bits) : false;
 }
 
-
 //---------------------------------------------------------------------------
 // flow_id
 //---------------------------------------------------------------------------
@@ -54,6 +54,18 @@ void metafield_dump(const metafield_t * metafield);
 
 bool metafield_add_filter(metafield_t * metafield, filter_t * filter);
 
+/**
+ * \brief Compile the first filter_t instance involved in a metafield
+ *    matching a probe_t (see filter_compile).
+ * \param metafield A metafield_t instance.
+ * \param probe A probe_t instance.
+ * \param ops A pre-allocated array of at least FILTER_MAX_FIELDS
+ *    filter_op_t, set if a filter matches the probe.
+ * \return The address of the matching filter_t (if any), NULL otherwise.
+ */
+
+const filter_t * metafield_compile(const metafield_t * metafield, const probe_t * probe, filter_op_t * ops);
+
 /**
  * \brief Find the first filter_t instance involved in a metafield matching
  *    a probe_t.
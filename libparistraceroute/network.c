@@ -9,6 +9,11 @@
 #include "os/sys/timerfd.h" // timerfd_create, timerfd_settime
 #include <arpa/inet.h>      // htons
 #include <limits.h>         // INT_MAX
+#include <stdint.h>         // uintptr_t
+#include "os/netinet/ip.h"       // iphdr
+#include "os/netinet/ip6.h"      // ip6_hdr
+#include "os/netinet/ip_icmp.h"  // icmphdr, ICMP_DEST_UNREACH, ICMP_TIME_EXCEEDED
+#include "os/netinet/icmp6.h"    // icmp6_hdr, ICMP6_DST_UNREACH, ICMP6_TIME_EXCEEDED
 
 #include "protocol.h"       // struct probe_s
 #include "network.h"
@@ -19,19 +24,42 @@
 #include "probe.h"          // probe_extract_ext, probe_set_field_ext
 #include "algorithm.h"      // pt_algorithm_throw
 
-// TODO static variable as timeout. Control extra_delay and timeout values consistency
-#define EXTRA_DELAY 0.01 // this extra delay provokes a probe timeout event if a probe will expires in less than EXTRA_DELAY seconds. Must be less than network->timeout.
+// Minimal delay used to arm network->timerfd (a null delay would disarm it)
+#define NETWORK_MIN_TIMER_DELAY 0.000001
 
 
 //---------------------------------------------------------------------------
 // Network options
 //---------------------------------------------------------------------------
 
-static double timeout[3] = OPTIONS_NETWORK_WAIT;
+static double timeout[3]    = OPTIONS_NETWORK_WAIT;
+static int    send_batch[3] = OPTIONS_NETWORK_SEND_BATCH;
+static int    wide_tags     = 0;
+static double pps[3]        = OPTIONS_NETWORK_PPS;
+static double dst_pps[3]    = OPTIONS_NETWORK_DST_PPS;
+static double prefix_pps[3] = OPTIONS_NETWORK_PREFIX_PPS;
+static int    burst[3]      = OPTIONS_NETWORK_BURST;
+static struct opt_str sniffer_interface = {NULL, 0};
+
+static const char * sniffer_names[] = {
+    "raw",
+#ifdef USE_PACKET_RING
+    "ring",
+#endif
+    NULL
+};
 
 static option_t network_options[] = {
-    // action              short long          metavar         help    variable
-    {opt_store_double_lim, "w",  "--wait",     "TIMEOUT",      HELP_w, timeout},
+    // action              short      long            metavar         help                 variable
+    {opt_store_double_lim, "w",       "--wait",       "TIMEOUT",      HELP_w,              timeout},
+    {opt_store_int_lim,    OPT_NO_SF, "--send-batch", "NUM_PROBES",   HELP_send_batch,     send_batch},
+    {opt_store_1,          OPT_NO_SF, "--wide-tags",  OPT_NO_METAVAR, HELP_wide_tags,      &wide_tags},
+    {opt_store_double_lim, OPT_NO_SF, "--pps",        "RATE",         HELP_pps,            pps},
+    {opt_store_double_lim, OPT_NO_SF, "--dst-pps",    "RATE",         HELP_dst_pps,        dst_pps},
+    {opt_store_double_lim, OPT_NO_SF, "--prefix-pps", "RATE",         HELP_prefix_pps,     prefix_pps},
+    {opt_store_int_lim,    OPT_NO_SF, "--burst",      "NUM_PROBES",   HELP_burst,          burst},
+    {opt_store_choice,     OPT_NO_SF, "--capture",    "BACKEND",      HELP_capture,        sniffer_names},
+    {opt_store_str,        OPT_NO_SF, "--listen-interface", "IFNAME", HELP_listen_interface, &sniffer_interface},
     END_OPT_SPECS
 };
 
@@ -43,13 +71,45 @@ double options_network_get_timeout() {
     return timeout[0];
 }
 
+size_t options_network_get_send_batch_size() {
+    return send_batch[0];
+}
+
+bool options_network_get_wide_tags() {
+    return wide_tags;
+}
+
+void options_network_get_pacing(double * prate, double * pdst_rate, double * pprefix_rate, double * pburst) {
+    *prate        = pps[0];
+    *pdst_rate    = dst_pps[0];
+    *pprefix_rate = prefix_pps[0];
+    *pburst       = burst[0];
+}
+
+sniffer_backend_t options_network_get_sniffer_backend() {
+#ifdef USE_PACKET_RING
+    if (strcmp(sniffer_names[0], "ring") == 0) return SNIFFER_BACKEND_RING;
+#endif
+    return SNIFFER_BACKEND_RAW;
+}
+
+const char * options_network_get_sniffer_interface() {
+    return sniffer_interface.s;
+}
+
 void network_set_is_verbose(network_t * network, bool verbose) {
      network->is_verbose = verbose;
 }
 
 void options_network_init(network_t * network, bool verbose) {
+    double rate, dst_rate, prefix_rate, burst_size;
+
+    options_network_get_pacing(&rate, &dst_rate, &prefix_rate, &burst_size);
     network_set_is_verbose(network, verbose);
     network_set_timeout(network, options_network_get_timeout());
+    network_set_send_batch_size(network, options_network_get_send_batch_size());
+    network_set_wide_tags(network, options_network_get_wide_tags());
+    network_set_pacing(network, rate, dst_rate, prefix_rate, burst_size);
 }
 
 //---------------------------------------------------------------------------
@@ -58,63 +118,189 @@ void options_network_init(network_t * network, bool verbose) {
 
 /**
  * \brief Extract the probe ID (tag) from a probe
+ * \param network The network layer
  * \param probe The queried probe
  * \param ptag_probe Address of an uint16_t in which we will write the tag
  * \return true iif successful
  */
 
-static inline bool probe_extract_tag(const probe_t * probe, uint16_t * ptag_probe) {
-    return probe_extract_ext(probe, "checksum", 1, ptag_probe);
+static inline bool probe_extract_tag(network_t * network, const probe_t * probe, uint16_t * ptag_probe) {
+    return probe_extract_handle(probe, &network->probe_tag, ptag_probe);
 }
 
 /**
  * \brief Extract the probe ID (tag) from a reply
+ * \param network The network layer
  * \param reply The queried reply
  * \param ptag_reply Address of the uint16_t in which the tag is written
  * \return true iif successful
  */
 
-static inline bool reply_extract_tag(const probe_t * reply, uint16_t * ptag_reply) {
-    return probe_extract_ext(reply, "checksum", 3, ptag_reply);
+static inline bool reply_extract_tag(network_t * network, const probe_t * reply, uint16_t * ptag_reply) {
+    return probe_extract_handle(reply, &network->reply_tag, ptag_reply);
 }
 
 /**
  * \brief Set the probe ID (tag) from a probe
+ * \param network The network layer
  * \param probe The probe we want to update
  * \param tag_probe The tag we're assigning to the probe (host-side endianness)
  * \return true iif successful
  */
 
-static bool probe_set_tag(probe_t * probe, uint16_t tag_probe) {
-    bool      ret = false;
-    field_t * field;
+static bool probe_set_tag(network_t * network, probe_t * probe, uint16_t tag_probe) {
+    field_t field = {
+        .key         = "checksum",
+        .value.int16 = tag_probe,
+        .type        = TYPE_UINT16
+    };
+
+    return probe_set_field_handle(probe, &network->probe_tag, &field);
+}
+
+/**
+ * \brief Check whether a probe (or a reply) is an IPv4 packet.
+ * \param probe The queried probe
+ * \return true iif the first layer of the probe is an IPv4 layer
+ */
+
+static inline bool probe_is_ipv4(const probe_t * probe) {
+    const layer_t * layer = probe_get_layer(probe, 0);
+    return layer && layer->protocol && strcmp(layer->protocol->name, "ipv4") == 0;
+}
+
+/**
+ * \brief Notify the sniffer of the signature (transport protocol and
+ *    destination port) of a probe about to be sent, so that the ICMP
+ *    errors quoting this probe pass the kernel filter.
+ * \param network The network layer
+ * \param probe The probe
+ * \return true iif successful
+ */
+
+static bool network_add_probe_signature(network_t * network, const probe_t * probe) {
+    const layer_t * layer;
+    uint16_t        dst_port = 0;
+
+    if (!(layer = probe_get_layer(probe, 1)) || !layer->protocol) return false;
+
+    switch (layer->protocol->protocol) {
+        case IPPROTO_UDP:
+        case IPPROTO_TCP:
+            if (!probe_extract_ext(probe, "dst_port", 1, &dst_port)) return false;
+            break;
+        default:
+            break;
+    }
+
+    return sniffer_add_signature(
+        network->sniffer,
+        probe_is_ipv4(probe) ? IPPROTO_ICMP : IPPROTO_ICMPV6,
+        layer->protocol->protocol,
+        dst_port
+    );
+}
+
+/**
+ * \brief Write the 16 most significant bits of a wide tag in a probe.
+ *    IPv4 probes carry them in the IP identification field, IPv6 probes
+ *    in the payload, right after the 2 bytes used to fix the checksum
+ *    (the payload is enlarged to 4 bytes if needed).
+ * \param network The network layer
+ * \param probe The probe we want to update
+ * \param tag_high The 16 most significant bits of the tag (host-side endianness)
+ * \return true iif successful
+ */
+
+static bool probe_set_tag_high(network_t * network, probe_t * probe, uint16_t tag_high) {
+    bool    ret = false;
+    field_t field = {
+        .key         = "identification",
+        .value.int16 = tag_high,
+        .type        = TYPE_UINT16
+    };
 
-    if ((field = I16("checksum", tag_probe))) {
-        ret = probe_set_field_ext(probe, 1, field);
-        field_free(field);
+    if (probe_is_ipv4(probe)) {
+        ret = probe_rewrite_field_handle(probe, &network->probe_tag_high, &field);
+    } else {
+        // The payload is enlarged if it cannot store both the checksum fix and tag_high
+        if (probe_get_payload_size(probe) < 2 * sizeof(uint16_t)
+        && !probe_payload_resize(probe, 2 * sizeof(uint16_t))) {
+            return false;
+        }
+        tag_high = htons(tag_high);
+        ret = probe_rewrite_bytes(probe, probe_get_num_layers(probe) - 1, sizeof(uint16_t), &tag_high, sizeof(uint16_t));
     }
 
     return ret;
 }
 
 /**
- * \brief Handler called by the sniffer to allow the network layer
- *    to process sniffed packets.
+ * \brief Extract the 16 most significant bits of a wide tag from a reply.
  * \param network The network layer
- * \param packet The sniffed packet
+ * \param reply The queried reply
+ * \param ptag_high Address of the uint16_t in which the bits are written
+ * \return true iif successful
+ */
+
+static bool reply_extract_tag_high(network_t * network, const probe_t * reply, uint16_t * ptag_high) {
+    const uint8_t * payload;
+
+    // The IP layer quoted in the ICMP reply
+    if (probe_is_ipv4(reply)) {
+        return probe_extract_handle(reply, &network->reply_tag_high, ptag_high);
+    }
+
+    if (probe_get_payload_size(reply) < 2 * sizeof(uint16_t)) return false;
+    payload = probe_get_payload(reply);
+    *ptag_high = (payload[2] << 8) | payload[3];
+    return true;
+}
+
+/**
+ * \brief Check whether a tag can be carried by a probe.
+ *   The 16 least significant bits are stored in the transport checksum
+ *   and must not be 0 (this means "no checksum" in UDP). Likewise, the
+ *   16 most significant bits of a wide tag are stored in the IPv4
+ *   identification field which is overwritten by the kernel if set to 0.
+ * \param network The network layer
+ * \param tag A tag
+ * \return true iif the tag is valid
  */
 
-static bool network_sniffer_callback(packet_t * packet, void * recvq) {
-    return queue_push_element((queue_t *) recvq, packet);
+static inline bool network_is_valid_tag(const network_t * network, uint32_t tag) {
+    return (tag & 0xffff) && (!network->use_wide_tags || (tag >> 16));
 }
 
 /**
- * \brief Retrieve a tag (probe ID) not yet used.
- * \return An available tag
+ * \brief Retrieve a tag (probe ID) not yet used. Tags are allocated in a
+ *   round-robin fashion and a tag is available again as soon as the
+ *   probe carrying it is matched or expires, so that the most recently
+ *   released tags are the last ones to be reused.
+ * \param network The network layer
+ * \param ptag Address of the uint32_t in which the tag is written
+ * \return true iif successful, false if every tag is in use
  */
 
-static uint16_t network_get_available_tag(network_t * network) {
-    return ++network->last_tag;
+static bool network_get_available_tag(network_t * network, uint32_t * ptag) {
+    uint32_t tag  = network->last_tag,
+             mask = network->use_wide_tags ? UINT32_MAX : UINT16_MAX;
+    size_t   num_tags = network->use_wide_tags ?
+                 (size_t) UINT16_MAX * UINT16_MAX :
+                 (size_t) UINT16_MAX;
+
+    if (probe_table_get_size(network->probes) >= num_tags) {
+        fprintf(stderr, "network_get_available_tag: every tag is in use\n");
+        return false;
+    }
+
+    // There is at least one free tag, thus this loop terminates.
+    do {
+        tag = (tag + 1) & mask;
+    } while (!network_is_valid_tag(network, tag) || probe_table_get(network->probes, tag));
+
+    *ptag = network->last_tag = tag;
+    return true;
 }
 
 /**
@@ -123,41 +309,229 @@ static uint16_t network_get_available_tag(network_t * network) {
  */
 
 static void network_flying_probes_dump(network_t * network) {
-    size_t     i, num_flying_probes = dynarray_get_size(network->probes);
-    uint16_t   tag_probe;
-    probe_t  * probe;
+    probe_table_dump(network->probes);
+}
+
+//---------------------------------------------------------------------------
+// Reply classification
+//---------------------------------------------------------------------------
+
+/**
+ * \struct network_reply_summary_t
+ * \brief What the network layer needs to know about an ICMP error
+ *    quoting one of its probes.
+ */
+
+typedef struct {
+    uint32_t  tag;        /**< Tag of the quoted probe */
+    uint8_t   icmp_type;  /**< Type of the ICMP error */
+    uint8_t   icmp_code;  /**< Code of the ICMP error */
+    address_t quoted_dst; /**< Destination of the quoted probe */
+} network_reply_summary_t;
+
+/**
+ * \brief Extract the tag from the transport header quoted in an ICMP
+ *    error. The tag is read at the same place as network->reply_tag
+ *    would be read in the corresponding reply.
+ * \param network The network layer
+ * \param bytes The bytes of the reply
+ * \param size The size of the reply
+ * \param offset The offset of the quoted transport header
+ * \param protocol_id The protocol of the quoted transport header
+ * \param summary The summary in which the tag is written
+ * \param pheader_size Address of the size_t in which the size of the
+ *    quoted transport header is written
+ * \return true iif successful
+ */
+
+static bool network_classify_quoted_transport(
+    network_t               * network,
+    const uint8_t           * bytes,
+    size_t                    size,
+    size_t                    offset,
+    uint8_t                   protocol_id,
+    network_reply_summary_t * summary,
+    size_t                  * pheader_size
+) {
+    const protocol_t * protocol;
+    uint16_t           tag;
+
+    // The quoted transport header must be complete, so that the tag
+    // is read exactly as it would be in the dissected reply.
+    if (!(protocol = protocol_search_by_id(protocol_id))
+    ||  offset + protocol->write_default_header(NULL) > size
+    ||  !field_handle_resolve(&network->reply_tag, protocol)
+    ||  network->reply_tag.type != TYPE_UINT16) {
+        return false;
+    }
+
+    memcpy(&tag, bytes + offset + network->reply_tag.offset, sizeof(uint16_t));
+    summary->tag = ntohs(tag);
+    *pheader_size = protocol->get_header_size(bytes + offset);
+    return true;
+}
+
+#ifdef USE_IPV4
+/**
+ * \brief Classify an IPv4 / ICMPv4 / IPv4 / * reply (see network_classify_reply).
+ */
+
+static bool network_classify_reply_ipv4(network_t * network, const uint8_t * bytes, size_t size, network_reply_summary_t * summary)
+{
+    const struct iphdr   * ip_header;
+    const struct icmphdr * icmp_header;
+    const struct iphdr   * quoted_ip_header;
+    size_t                 icmp_offset, quoted_ip_offset, transport_offset, transport_size;
+    uint16_t               tag_high;
+
+    // Outer IPv4 header
+    ip_header = (const struct iphdr *) bytes;
+    icmp_offset = 4 * ip_header->ihl;
+    if (size < sizeof(struct iphdr)
+    ||  icmp_offset < sizeof(struct iphdr)
+    ||  ip_header->protocol != IPPROTO_ICMP) {
+        return false;
+    }
+
+    // ICMPv4 error
+    quoted_ip_offset = icmp_offset + sizeof(struct icmphdr);
+    if (quoted_ip_offset + sizeof(struct iphdr) > size) return false;
+    icmp_header = (const struct icmphdr *) (bytes + icmp_offset);
+    switch (icmp_header->ICMPV4_TYPE) {
+        case ICMP_DEST_UNREACH:
+        case ICMP_TIME_EXCEEDED:
+            break;
+        default:
+            return false;
+    }
+
+    // Quoted IPv4 header
+    quoted_ip_header = (const struct iphdr *) (bytes + quoted_ip_offset);
+    transport_offset = quoted_ip_offset + 4 * quoted_ip_header->ihl;
+    if (quoted_ip_header->version != 4 || transport_offset < quoted_ip_offset + sizeof(struct iphdr)) {
+        return false;
+    }
+
+    // Quoted transport header
+    if (!network_classify_quoted_transport(network, bytes, size, transport_offset, quoted_ip_header->protocol, summary, &transport_size)) {
+        return false;
+    }
+
+    // The 16 most significant bits of a wide tag are in the quoted IPv4 header
+    if (network->use_wide_tags) {
+        if (!field_handle_resolve(&network->reply_tag_high, network->ipv4)
+        ||  network->reply_tag_high.type != TYPE_UINT16) {
+            return false;
+        }
+        memcpy(&tag_high, bytes + quoted_ip_offset + network->reply_tag_high.offset, sizeof(uint16_t));
+        summary->tag |= (uint32_t) ntohs(tag_high) << 16;
+    }
+
+    summary->icmp_type = icmp_header->ICMPV4_TYPE;
+    summary->icmp_code = icmp_header->ICMPV4_CODE;
+    summary->quoted_dst.family = AF_INET;
+    memcpy(&summary->quoted_dst.ip.ipv4, &quoted_ip_header->daddr, sizeof(ipv4_t));
+    return true;
+}
+#endif
+
+#ifdef USE_IPV6
+/**
+ * \brief Classify an IPv6 / ICMPv6 / IPv6 / * reply (see network_classify_reply).
+ */
+
+static bool network_classify_reply_ipv6(network_t * network, const uint8_t * bytes, size_t size, network_reply_summary_t * summary)
+{
+    const struct ip6_hdr   * ip_header;
+    const struct icmp6_hdr * icmp_header;
+    const struct ip6_hdr   * quoted_ip_header;
+    size_t                   icmp_offset = sizeof(struct ip6_hdr),
+                             quoted_ip_offset = icmp_offset + sizeof(struct icmp6_hdr),
+                             transport_offset = quoted_ip_offset + sizeof(struct ip6_hdr),
+                             transport_size, payload_offset;
+
+    // Outer IPv6 header and ICMPv6 error
+    if (transport_offset > size) return false;
+    ip_header = (const struct ip6_hdr *) bytes;
+    icmp_header = (const struct icmp6_hdr *) (bytes + icmp_offset);
+    if (ip_header->ip6_nxt != IPPROTO_ICMPV6) return false;
+    switch (icmp_header->icmp6_type) {
+        case ICMP6_DST_UNREACH:
+        case ICMP6_TIME_EXCEEDED:
+            break;
+        default:
+            return false;
+    }
+
+    // Quoted IPv6 header and transport header
+    quoted_ip_header = (const struct ip6_hdr *) (bytes + quoted_ip_offset);
+    if ((bytes[quoted_ip_offset] >> 4) != 6
+    ||  !network_classify_quoted_transport(network, bytes, size, transport_offset, quoted_ip_header->ip6_nxt, summary, &transport_size)) {
+        return false;
+    }
 
-    printf("\n%u flying probe(s) :\n", (unsigned int)num_flying_probes);
-    for (i = 0; i < num_flying_probes; i++) {
-        probe = dynarray_get_ith_element(network->probes, i);
-        probe_extract_tag(probe, &tag_probe) ?
-            printf(" 0x%x", tag_probe):
-            printf(" (invalid tag)");
-        printf("\n");
+    // The 16 most significant bits of a wide tag follow the 2 bytes
+    // used to fix the checksum at the begining of the quoted payload.
+    if (network->use_wide_tags) {
+        payload_offset = transport_offset + transport_size;
+        if (payload_offset + 2 * sizeof(uint16_t) > size) return false;
+        summary->tag |= (uint32_t) ((bytes[payload_offset + 2] << 8) | bytes[payload_offset + 3]) << 16;
     }
+
+    summary->icmp_type = icmp_header->icmp6_type;
+    summary->icmp_code = icmp_header->icmp6_code;
+    summary->quoted_dst.family = AF_INET6;
+    memcpy(&summary->quoted_dst.ip.ipv6, &quoted_ip_header->ip6_dst, sizeof(ipv6_t));
+    return true;
 }
+#endif
 
 /**
- * \brief Get the oldest probe in network
- * \param network Pointer to network instance
- * \return A pointer to oldest probe if any, NULL otherwise
+ * \brief Classify a sniffed packet straight from its bytes, without
+ *    dissecting it. Only the ICMP errors quoting a whole transport header
+ *    (IPv4 / ICMPv4 / IPv4 / * and IPv6 / ICMPv6 / IPv6 / *) are
+ *    recognized, the other packets must be dissected (see probe_wrap_packet).
+ * \param network The network layer
+ * \param packet The sniffed packet
+ * \param summary The summary of the reply (set if successful)
+ * \return true iif the packet has been recognized.
  */
 
-static probe_t * network_get_oldest_probe(const network_t * network) {
-    return dynarray_get_ith_element(network->probes, 0);
+static bool network_classify_reply(network_t * network, const packet_t * packet, network_reply_summary_t * summary)
+{
+    const uint8_t * bytes = packet_get_bytes(packet);
+    size_t          size = packet_get_size(packet);
+
+    if (size == 0) return false;
+
+    switch (bytes[0] >> 4) {
+#ifdef USE_IPV4
+        case 4:
+            return network_classify_reply_ipv4(network, bytes, size, summary);
+#endif
+#ifdef USE_IPV6
+        case 6:
+            return network_classify_reply_ipv6(network, bytes, size, summary);
+#endif
+        default:
+            return false;
+    }
 }
 
+
 /**
  * \brief Compute when a probe expires
  * \param network The network layer
  * \param probe A probe instance. Its sending time must be set.
- * \return The timeout of the probe. This value may be negative. If so,
- *    it means that this probe has already expired and a PROBE_TIMEOUT
- *    should be raised.
+ * \return The timestamp at which a PROBE_TIMEOUT must be raised for
+ *    this probe. It depends on the timeout of the probe if set, on the
+ *    timeout of the network layer otherwise.
  */
 
-static double network_get_probe_timeout(const network_t * network, const probe_t * probe) {
-    return network_get_timeout(network) - (get_timestamp() - probe_get_sending_time(probe));
+static double network_get_probe_deadline(const network_t * network, const probe_t * probe) {
+    double timeout = probe_get_timeout(probe);
+
+    return probe_get_sending_time(probe) + (timeout > 0 ? timeout : network_get_timeout(network));
 }
 
 /**
@@ -170,7 +544,7 @@ static void itimerspec_set_delay(struct itimerspec * timer, double delay) {
     time_t delay_sec = (time_t) delay;
 
     timer->it_value.tv_sec     = delay_sec;
-    timer->it_value.tv_nsec    = 1000000 * (delay - delay_sec);
+    timer->it_value.tv_nsec    = 1000000000 * (delay - delay_sec);
     timer->it_interval.tv_sec  = 0;
     timer->it_interval.tv_nsec = 0;
 }
@@ -178,7 +552,7 @@ static void itimerspec_set_delay(struct itimerspec * timer, double delay) {
 /**
  * \brief Update a timer in order to expire at a given moment .
  * \param timerfd The file descriptor related to the timer.
- * \param delay The delay (in micro seconds).
+ * \param delay The delay (in seconds). 0 disarms the timer.
  * \return true iif successful.
  */
 
@@ -201,23 +575,71 @@ ERR_INVALID_DELAY:
 
 /**
  * \brief Update network->timerfd file descriptor to make it activated
- *   if a timeout occurs for oldest probe.
+ *   at the next deadline stored in network->timeouts. To spare system
+ *   calls, the timer is not re-armed if it is already armed at this
+ *   deadline or earlier (the timer then fires a bit too early, which
+ *   is harmless), unless force is set.
  * \param network The updated network layer.
+ * \param force Pass true if network->timerfd has just fired.
  * \return true iif successful
  */
 
-static bool network_update_next_timeout(network_t * network)
+static bool network_update_timer(network_t * network, bool force)
+{
+    double deadline, delay;
+
+    if (!timing_wheel_get_next_deadline(network->timeouts, &deadline)) {
+        // No more flying probe. A pending activation is harmless.
+        if (!force) return true;
+        network->next_deadline = 0;
+        return update_timer(network->timerfd, 0);
+    }
+
+    if (!force && network->next_deadline > 0 && network->next_deadline <= deadline) {
+        return true;
+    }
+
+    network->next_deadline = deadline;
+    delay = deadline - get_timestamp();
+    return update_timer(network->timerfd, delay > NETWORK_MIN_TIMER_DELAY ? delay : NETWORK_MIN_TIMER_DELAY);
+}
+
+/**
+ * \brief Give up a probe: raise a PROBE_TIMEOUT event to the instance
+ *    which has sent it. This is used for the probes which have expired,
+ *    but also for the probes which cannot be sent, so that the caller
+ *    is always notified.
+ * \param network The network layer.
+ * \param probe The probe. The reference held by the network layer is
+ *    handed over to the event.
+ */
+
+static void network_drop_probe(network_t * network, probe_t * probe)
+{
+    event_t * event;
+
+    if (!(event = event_create(PROBE_TIMEOUT, probe, NULL, (ELEMENT_FREE) probe_free))) {
+        fprintf(stderr, "Can't notify the timeout of a probe\n");
+        probe_free(probe);
+        return;
+    }
+    pt_throw(NULL, probe->caller, event);
+}
+
+/**
+ * \brief Raise a PROBE_TIMEOUT event for a probe which has expired.
+ *    This is the callback of timing_wheel_advance.
+ * \param element The tag of the expired probe.
+ * \param network The network layer.
+ */
+
+static void network_expire_probe(void * element, void * network)
 {
     probe_t * probe;
-    double    next_timeout;
 
-    if ((probe = network_get_oldest_probe(network))) {
-        next_timeout = network_get_probe_timeout(network, probe);
-    } else {
-        // The timer will be disarmed since there is no more flying probes
-        next_timeout = 0;
+    if ((probe = probe_table_pop(((network_t *) network)->probes, (uint32_t) (uintptr_t) element))) {
+        network_drop_probe(network, probe);
     }
-    return update_timer(network->timerfd, next_timeout);
 }
 
 /**
@@ -261,7 +683,50 @@ bool probe_match(const struct probe_s * probe, const struct probe_s * reply)
     return true;
 }
 
-static probe_t * network_get_matching_probe(network_t * network, const probe_t * reply)
+/**
+ * \brief Retrieve the flying probe carrying a given tag.
+ * \param network The network layer
+ * \param tag The tag of the probe
+ * \return The corresponding probe, NULL if not found.
+ */
+
+static probe_t * network_get_flying_probe(network_t * network, uint32_t tag)
+{
+    probe_t * probe;
+
+    // In our probe packet, the probe ID is stored in the checksum of the
+    // (first) IP layer, and network->probes is indexed by this tag.
+    if (!(probe = probe_table_get(network->probes, tag))) {
+        if (network->is_verbose) {
+            fprintf(stderr, "network_get_matching_probe: This reply has been discarded: tag = 0x%x.\n", tag);
+            network_flying_probes_dump(network);
+        }
+    }
+    return probe;
+}
+
+/**
+ * \brief Remove a probe which has been answered from the flying probes.
+ * \param network The network layer
+ * \param probe The probe
+ * \param tag The tag of the probe
+ */
+
+static void network_pop_flying_probe(network_t * network, probe_t * probe, uint32_t tag)
+{
+    // We delete the corresponding probe
+
+    // TODO: ... but it should be kept, for archive purposes, and to match for duplicates...
+    // But we cannot reenable it until we set the probe ID into the
+    // checksum, since probes with same flow_id and different TTL have the
+    // same checksum
+
+    // network->timerfd is left as is: at worst it fires once for nothing.
+    probe_table_pop(network->probes, tag);
+    timing_wheel_del(network->timeouts, &probe->timer);
+}
+
+static probe_t * network_get_matching_probe(network_t * network, const probe_t * reply, uint32_t * ptag)
 {
 
     // Suppose we perform a traceroute measurement thanks to IPv4/UDP packet
@@ -271,72 +736,135 @@ static probe_t * network_get_matching_probe(network_t * network, const probe_t *
     // retrieve the checksum (= our probe ID) of the second IP layer, which
     // corresponds to the 3rd checksum field of our probe.
 
-    uint16_t   tag_probe, tag_reply;
-    probe_t  * probe;
-    size_t     i, num_flying_probes;
-
-    // XXX
+    uint16_t   tag_reply, tag_reply_high;
+    uint32_t   tag;
 
     // Fetch the tag from the reply. Its the 3rd checksum field.
-    if (!(reply_extract_tag(reply, &tag_reply))) {
+    if (!(reply_extract_tag(network, reply, &tag_reply))) {
         // This is not an IP / ICMP / IP / * reply :(
         if (network->is_verbose) fprintf(stderr, "Can't retrieve tag from reply\n");
         return NULL;
     }
+    tag = tag_reply;
 
-    num_flying_probes = dynarray_get_size(network->probes);
-    for (i = 0; i < num_flying_probes; i++) {
-        probe = dynarray_get_ith_element(network->probes, i);
-
-        // Reply / probe comparison. In our probe packet, the probe ID
-        // is stored in the checksum of the (first) IP layer.
-        if (probe_extract_tag(probe, &tag_probe)) {
-            if (tag_reply == tag_probe) break;
+    if (network->use_wide_tags) {
+        if (!(reply_extract_tag_high(network, reply, &tag_reply_high))) {
+            if (network->is_verbose) fprintf(stderr, "Can't retrieve wide tag from reply\n");
+            return NULL;
         }
+        tag |= (uint32_t) tag_reply_high << 16;
     }
 
-/*
-    // XXX BEGIN Harcoded ICMP response (JA 17/07/2014)
-    tag_reply = 0; tag_probe = 0; tag_probe++; tag_reply++;
+    *ptag = tag;
+    return network_get_flying_probe(network, tag);
+}
 
-    num_flying_probes = dynarray_get_size(network->probes);
-    for (i = 0; i < num_flying_probes; i++) {
-        probe = dynarray_get_ith_element(network->probes, i);
+/**
+ * \brief Process a received packet: match it with a flying probe and
+ *    notify the instance which has sent this probe, or discard it.
+ *    The common ICMP errors are matched straight from their bytes (see
+ *    network_classify_reply), so that only the matched ones are wrapped
+ *    in a probe_t instance. The other packets are wrapped first.
+ * \param network The network layer
+ * \param packet The received packet
+ * \return true iif the packet has been matched
+ */
 
-        // Reply / probe comparison. In our probe packet, the probe ID
-        // is stored in the checksum of the (first) IP layer.
-        if (probe_match((const struct probe_s *)probe, (const struct probe_s *)reply))
-            break;
-    }
-    // XXX END Hardcoded ICMP response
-*/
-    // No match found if we reached the end of the array
-    if (i == num_flying_probes) {
-        if (network->is_verbose) {
-            fprintf(stderr, "network_get_matching_probe: This reply has been discarded: tag = 0x%x.\n", tag_reply);
-            network_flying_probes_dump(network);
+static bool network_process_packet(network_t * network, packet_t * packet)
+{
+    probe_t                 * probe,
+                            * reply;
+    probe_reply_t           * probe_reply;
+    network_reply_summary_t   summary;
+    uint32_t                  tag;
+    double                    recv_time = get_timestamp();
+
+    if (network_classify_reply(network, packet, &summary)) {
+        network->num_fast_path_hits++;
+
+        if (!(probe = network_get_flying_probe(network, summary.tag))) {
+            if (network->is_verbose) {
+                fprintf(stderr, "ICMP type %d code %d quoting a probe sent to ", summary.icmp_type, summary.icmp_code);
+                address_fprintf(stderr, &summary.quoted_dst);
+                fprintf(stderr, "\n");
+            }
+            packet_free(packet);
+            goto ERR_PROBE_DISCARDED_FAST_PATH;
         }
-        return NULL;
-    }
+        tag = summary.tag;
 
-    // We delete the corresponding probe
+        // Only the matched replies are wrapped in a probe_t instance
+        if (!(reply = probe_wrap_packet(packet))) {
+            goto ERR_PROBE_WRAP_PACKET;
+        }
+        probe_set_recv_time(reply, recv_time);
 
-    // TODO: ... but it should be kept, for archive purposes, and to match for duplicates...
-    // But we cannot reenable it until we set the probe ID into the
-    // checksum, since probes with same flow_id and different TTL have the
-    // same checksum
+        if (network->is_verbose) {
+            printf("Got reply:\n");
+            probe_dump(reply);
+        }
+    } else {
+        network->num_fast_path_misses++;
+
+        // Transform the reply into a probe_t instance
+        if(!(reply = probe_wrap_packet(packet))) {
+            goto ERR_PROBE_WRAP_PACKET;
+        }
+        probe_set_recv_time(reply, recv_time);
 
-    dynarray_del_ith_element(network->probes, i, NULL);
+        if (network->is_verbose) {
+            printf("Got reply:\n");
+            probe_dump(reply);
+        }
 
-    // The matching probe is the oldest one and there are other probes, update
-    // the timer according to the next unexpired probe timeout.
-    if (i == 0) {
-        if (!(network_update_next_timeout(network))) {
-            fprintf(stderr, "Error while updating timeout\n");
+        // Find the probe corresponding to this reply
+        if (!(probe = network_get_matching_probe(network, reply, &tag))) {
+            goto ERR_PROBE_DISCARDED;
         }
     }
 
-    return probe;
+    // Build a pair made of the probe and its corresponding reply
+    if (!(probe_reply = probe_reply_create())) {
+        goto ERR_PROBE_REPLY_CREATE;
+    }
+
+    // The corresponding pointer is removed from network->probes
+    network_pop_flying_probe(network, probe, tag);
+
+    // We pass the probe and the reply to the upper layer: the pair takes
+    // over the reference held by the network layer on the probe.
+    probe_reply_set_probe(probe_reply, probe);
+    probe_reply_set_reply(probe_reply, reply);
+
+    // Notify the instance which has build the probe that we've got the
+    // corresponding reply. The pair is released along with the last
+    // reference to this event.
+    pt_throw(NULL, probe->caller, event_create(PROBE_REPLY, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
+    return true;
+
+ERR_PROBE_REPLY_CREATE:
+ERR_PROBE_DISCARDED:
+    probe_free(reply);
+    goto ERR_PROBE_DISCARDED_FAST_PATH;
+ERR_PROBE_WRAP_PACKET:
+    packet_free(packet);
+ERR_PROBE_DISCARDED_FAST_PATH:
+    return false;
+}
+
+/**
+ * \brief Handler called by the sniffer to allow the network layer
+ *    to process sniffed packets. Packets are directly matched, without
+ *    transiting through network->recvq.
+ * \param packet The sniffed packet
+ * \param network The network layer
+ * \return true
+ */
+
+static bool network_sniffer_callback(packet_t * packet, void * network) {
+    // Discarded replies are not errors
+    network_process_packet((network_t *) network, packet);
+    return true;
 }
 
 //---------------------------------------------------------------------------
@@ -349,8 +877,9 @@ network_t * network_create()
 
     if (!(network = malloc(sizeof(network_t))))          goto ERR_NETWORK;
     if (!(network->socketpool   = socketpool_create()))  goto ERR_SOCKETPOOL;
-    if (!(network->sendq = queue_create(probe_free,  probe_fprintf)))  goto ERR_SENDQ;
-    if (!(network->recvq = queue_create(packet_free, packet_fprintf))) goto ERR_RECVQ;
+    // Probes are only pushed in the sendq by the thread running pt_loop
+    if (!(network->sendq = queue_create_ext(probe_free, probe_fprintf, NETWORK_SENDQ_CAPACITY, QUEUE_SPSC))) goto ERR_SENDQ;
+    if (!(network->recvq = queue_create(packet_free, packet_fprintf)))                                     goto ERR_RECVQ;
 
     if ((network->timerfd = timerfd_create(CLOCK_REALTIME, 0)) == -1) {
         goto ERR_TIMERFD;
@@ -364,17 +893,49 @@ network_t * network_create()
         goto ERR_GROUP;
     }
 #endif
-    if (!(network->sniffer = sniffer_create(network->recvq, network_sniffer_callback))) {
+    // The sniffer backend must be chosen before the sockets are polled
+    // by the main loop, hence options are read here.
+    network->sniffer = sniffer_create_ext(
+        network,
+        network_sniffer_callback,
+        options_network_get_sniffer_backend(),
+        options_network_get_sniffer_interface()
+    );
+    if (!network->sniffer) {
         goto ERR_SNIFFER;
     }
 
-    if (!(network->probes = dynarray_create())) goto ERR_PROBES;
+    if (!(network->probes = probe_table_create())) goto ERR_PROBES;
+    if (!(network->timeouts = timing_wheel_create(NETWORK_TIMEOUT_TICK, get_timestamp()))) goto ERR_TIMEOUTS;
+    if (!(network->pacer = pacer_create()))           goto ERR_PACER;
+    if (!(network->paced_probes = deque_create()))    goto ERR_PACED_PROBES;
+    if ((network->pacing_timerfd = timerfd_create(CLOCK_REALTIME, 0)) == -1) {
+        goto ERR_PACING_TIMERFD;
+    }
 
     network->last_tag = 0;
+    network->use_wide_tags = false;
+    field_handle_init(&network->probe_tag,      "checksum",       1); // Transport layer of the probe
+    field_handle_init(&network->reply_tag,      "checksum",       3); // Transport layer quoted in the ICMP reply
+    field_handle_init(&network->probe_tag_high, "identification", 0); // IPv4 layer of the probe
+    field_handle_init(&network->reply_tag_high, "identification", 2); // IPv4 layer quoted in the ICMP reply
+    network->ipv4 = protocol_search("ipv4");
+    network->send_batch_size = NETWORK_DEFAULT_SEND_BATCH;
     network->timeout = NETWORK_DEFAULT_TIMEOUT;
+    network->next_deadline = 0;
+    network->num_fast_path_hits = 0;
+    network->num_fast_path_misses = 0;
     network->is_verbose = false;
     return network;
 
+ERR_PACING_TIMERFD:
+    deque_free(network->paced_probes, NULL);
+ERR_PACED_PROBES:
+    pacer_free(network->pacer);
+ERR_PACER:
+    timing_wheel_free(network->timeouts);
+ERR_TIMEOUTS:
+    probe_table_free(network->probes, NULL);
 ERR_PROBES:
     sniffer_free(network->sniffer);
 ERR_SNIFFER:
@@ -402,7 +963,15 @@ ERR_NETWORK:
 void network_free(network_t * network)
 {
     if (network) {
-        dynarray_free(network->probes, (ELEMENT_FREE) probe_free);
+        if (network->is_verbose) {
+            sniffer_fprintf_statistics(stderr, network->sniffer);
+            network_fprintf_statistics(stderr, network);
+        }
+        timing_wheel_free(network->timeouts);
+        probe_table_free(network->probes, (ELEMENT_FREE) probe_free);
+        deque_free(network->paced_probes, (ELEMENT_FREE) probe_free);
+        pacer_free(network->pacer);
+        close(network->pacing_timerfd);
         close(network->timerfd);
         sniffer_free(network->sniffer);
         queue_free(network->sendq);// , (ELEMENT_FREE) probe_free);
@@ -423,6 +992,49 @@ double network_get_timeout(const network_t * network) {
     return network->timeout;
 }
 
+bool network_set_send_batch_size(network_t * network, size_t send_batch_size) {
+    if (send_batch_size < 1 || send_batch_size > NETWORK_SEND_BATCH_MAX) {
+        fprintf(stderr, "network_set_send_batch_size: invalid batch size (%zu)\n", send_batch_size);
+        return false;
+    }
+    network->send_batch_size = send_batch_size;
+    return true;
+}
+
+void network_set_wide_tags(network_t * network, bool use_wide_tags) {
+    network->use_wide_tags = use_wide_tags;
+}
+
+bool network_set_pacing(network_t * network, double rate, double dst_rate, double prefix_rate, double burst) {
+    if (!pacer_set_rates(network->pacer, rate, dst_rate, prefix_rate, burst)) {
+        fprintf(stderr, "network_set_pacing: invalid parameters\n");
+        return false;
+    }
+    return true;
+}
+
+double network_get_queue_delay(const network_t * network) {
+    const probe_t * probe;
+
+    if (!(probe = deque_front(network->paced_probes))) return 0;
+    return get_timestamp() - probe_get_queueing_time(probe);
+}
+
+size_t network_get_num_fast_path_hits(const network_t * network) {
+    return network->num_fast_path_hits;
+}
+
+size_t network_get_num_fast_path_misses(const network_t * network) {
+    return network->num_fast_path_misses;
+}
+
+void network_fprintf_statistics(FILE * out, const network_t * network) {
+    fprintf(out, "Replies: %zu classified from their bytes, %zu dissected\n",
+        network->num_fast_path_hits,
+        network->num_fast_path_misses
+    );
+}
+
 inline int network_get_sendq_fd(network_t * network) {
     return queue_get_fd(network->sendq);
 }
@@ -447,6 +1059,10 @@ inline int network_get_timerfd(network_t * network) {
     return network->timerfd;
 }
 
+inline int network_get_pacing_timerfd(network_t * network) {
+    return network->pacing_timerfd;
+}
+
 #ifdef USE_SCHEDULING
 inline int network_get_group_timerfd(network_t * network) {
     return network->scheduled_timerfd;
@@ -457,7 +1073,7 @@ probe_group_t * network_get_scheduled_probes(network_t * network) {
 }
 #endif
 
-bool network_tag_probe(network_t * network, probe_t * probe)
+bool network_tag_probe(network_t * network, probe_t * probe, uint32_t * ptag)
 {
     uint16_t   tag,         // Network-side endianness
                checksum;    // Host-side endianness
@@ -467,7 +1083,7 @@ bool network_tag_probe(network_t * network, probe_t * probe)
 
     // For probes having a payload of size 0 and a "body" field (like icmp)
     layer_t  * last_layer;
-    bool       tag_in_body = false;
+    const protocol_field_t * body_field = NULL;
 
     /* The probe gets assigned a unique tag. Currently we encode it in the UDP
      * checksum, but I guess the tag will be protocol dependent. Also, since the
@@ -492,47 +1108,55 @@ bool network_tag_probe(network_t * network, probe_t * probe)
     // The last layer is the payload, the previous one is the last protocol layer.
     // If this layer has a "body" field like icmp, we have no payload and
     // we use the body field.
-    if (last_layer->protocol && protocol_get_field(last_layer->protocol, "body")) {
-        tag_in_body = true;
+    if (last_layer->protocol) {
+        body_field = protocol_get_field(last_layer->protocol, "body");
     }
 
-    tag = htons(network_get_available_tag(network));
+    if (!network_get_available_tag(network, ptag)) {
+        goto ERR_GET_AVAILABLE_TAG;
+    }
+    tag = htons(*ptag & 0xffff);
 
-    // Write the tag at offset zero of the payload
-    if (tag_in_body) {
-        probe_write_field(probe, "body", &tag, tag_size);
+    // The 16 most significant bits of a wide tag are written before fixing
+    // the checksum since they may be stored in the checksummed payload.
+    if (network->use_wide_tags && !probe_set_tag_high(network, probe, *ptag >> 16)) {
+        fprintf(stderr, "Can't set wide tag\n");
+        goto ERR_PROBE_SET_TAG_HIGH;
+    }
+
+    // Write the tag at offset zero of the payload, and fix the checksum to
+    // get a well-formed packet. As the probe is usually well-formed before
+    // being tagged, the checksum is updated incrementally.
+    if (body_field) {
+        if (!(probe_rewrite_bytes(probe, num_layers - 2, body_field->offset, &tag, tag_size))) {
+            goto ERR_PROBE_WRITE_PAYLOAD;
+        }
     } else {
         if (payload_size < tag_size) {
             fprintf(stderr, "Payload too short (payload_size = %u tag_size = %u)\n", (unsigned int)payload_size, (unsigned int)tag_size);
             goto ERR_INVALID_PAYLOAD;
         }
 
-        if (!(probe_write_payload(probe, &tag, tag_size))) {
+        if (!(probe_rewrite_bytes(probe, num_layers - 1, 0, &tag, tag_size))) {
             goto ERR_PROBE_WRITE_PAYLOAD;
         }
     }
 
-    // Fix checksum to get a well-formed packet
-    if (!(probe_update_checksum(probe))) {
-        fprintf(stderr, "Can't update fields\n");
-        goto ERR_PROBE_UPDATE_FIELDS;
-    }
-
     // Retrieve the checksum of UDP/TCP/ICMP checksum (host-side endianness)
-    if (!(probe_extract_tag(probe, &checksum))) {
+    if (!(probe_extract_tag(network, probe, &checksum))) {
         fprintf(stderr, "Can't extract tag\n");
         goto ERR_PROBE_EXTRACT_CHECKSUM;
     }
 
     // Write the probe ID in the UDP/TCP/ICMP checksum
-    if (!(probe_set_tag(probe, ntohs(tag)))) {
+    if (!(probe_set_tag(network, probe, ntohs(tag)))) {
         fprintf(stderr, "Can't set tag\n");
         goto ERR_PROBE_SET_TAG;
     }
 
     // Write the tag using the network-side endianness in the payload
     checksum = htons(checksum);
-    if (tag_in_body) {
+    if (body_field) {
         if (!(probe_write_field(probe, "body", &checksum, tag_size))) {
             fprintf(stderr, "Can't set body\n");
             goto ERR_PROBE_SET_FIELD;
@@ -550,9 +1174,10 @@ ERR_PROBE_SET_FIELD:
 ERR_BUFFER_WRITE_BYTES2:
 ERR_PROBE_SET_TAG:
 ERR_PROBE_EXTRACT_CHECKSUM:
-ERR_PROBE_UPDATE_FIELDS:
 ERR_PROBE_WRITE_PAYLOAD:
 ERR_INVALID_PAYLOAD:
+ERR_PROBE_SET_TAG_HIGH:
+ERR_GET_AVAILABLE_TAG:
 ERR_GET_LAYER:
     return false;
 }
@@ -575,172 +1200,263 @@ bool network_send_probe(network_t * network, probe_t * probe)
 #endif
 }
 
-// TODO This could be replaced by watchers: FD -> action
-bool network_process_sendq(network_t * network)
+bool network_send_probe_batch(network_t * network, probe_batch_t * probe_batch)
 {
-    probe_t           * probe;
-    packet_t          * packet;
-    size_t              num_flying_probes;
-    struct itimerspec   new_timeout;
-
-    // Probe skeleton when entering the network layer.
-    // We have to duplicate the probe since the same address of skeleton
-    // may have been passed to pt_send_probe.
-    // => We duplicate this probe in the
-    // network layer registry (network->probes) and then tagged.
-
-    // Do not free probe at the end of this function.
-    // Its address will be saved in network->probes and freed later.
-    probe = queue_pop_element(network->sendq, NULL);
+    size_t    i, num_probes = probe_batch_get_num_probes(probe_batch);
+    double    queueing_time = get_timestamp();
+#ifdef USE_SCHEDULING
+    probe_t * probe;
+    bool      ret = true;
 
-    // Tag the probe
-    if (!network_tag_probe(network, probe)) {
-        fprintf(stderr, "Can't tag probe\n");
-        goto ERR_TAG_PROBE;
+    // Scheduled probes are passed one by one to the probe group
+    for (i = 0; i < num_probes; i++) {
+        if (probe_get_delay(probe_batch_get_probe(probe_batch, i)) != DELAY_BEST_EFFORT) break;
     }
-
-    if (network->is_verbose) {
-        printf("Sending probe packet:\n");
-        probe_dump(probe);
+    if (i < num_probes) {
+        for (i = 0; i < num_probes; i++) {
+            probe = probe_batch_get_probe(probe_batch, i);
+            if (!network_send_probe(network, probe)) {
+                probe_free(probe);
+                ret = false;
+            }
+        }
+        return ret;
     }
+#endif
 
-    // Make a packet from the probe structure
-    if (!(packet = probe_create_packet(probe))) {
-        fprintf(stderr, "Can't create packet\n");
-    	goto ERR_CREATE_PACKET;
+    for (i = 0; i < num_probes; i++) {
+        probe_set_queueing_time(probe_batch_get_probe(probe_batch, i), queueing_time);
+    }
+    if (!queue_push_elements(network->sendq, (void **) probe_batch->probes, num_probes)) {
+        probe_batch_free(probe_batch);
+        return false;
     }
+    return true;
+}
 
-    // Send the packet
-    if (!(socketpool_send_packet(network->socketpool, packet))) {
-        fprintf(stderr, "Can't send packet\n");
-        goto ERR_SEND_PACKET;
+bool network_prepare_skeleton(network_t * network, probe_t * skel)
+{
+    // See probe_set_tag_high
+    if (network->use_wide_tags
+    && !probe_is_ipv4(skel)
+    &&  probe_get_payload_size(skel) < 2 * sizeof(uint16_t)) {
+        return probe_payload_resize(skel, 2 * sizeof(uint16_t));
     }
+    return true;
+}
 
-    // Update the sending time
-    probe_set_sending_time(probe, get_timestamp());
+/**
+ * \brief Tag and send a batch of probes.
+ * \param network The network layer.
+ * \param probes The probes to send (up to NETWORK_SEND_BATCH_MAX probes).
+ * \param num_probes The number of probes.
+ * \return true iif every probe has been sent
+ */
 
-    // Register this probe in the list of flying probes
-    if (!(dynarray_push_element(network->probes, probe))) {
-        fprintf(stderr, "Can't register probe\n");
-        goto ERR_PUSH_PROBE;
-    }
+static bool network_send_probes(network_t * network, probe_t ** probes, size_t num_probes)
+{
+    probe_t           * probe;
+    packet_t          * packets[NETWORK_SEND_BATCH_MAX];
+    uint32_t            tag,
+                        tags[NETWORK_SEND_BATCH_MAX];
+    bool                sent[NETWORK_SEND_BATCH_MAX];
+    size_t              i, num_packets = 0, num_sent;
+    double              sending_time;
+
+    // A probe which cannot be sent is dropped (see network_drop_probe)
+    for (i = 0; i < num_probes; i++) {
+        probe = probes[i];
+
+        // Tag the probe
+        if (!network_tag_probe(network, probe, &tag)) {
+            fprintf(stderr, "Can't tag probe\n");
+            network_drop_probe(network, probe);
+            continue;
+        }
 
-    // We've just sent a probe and currently, this is the only one in transit.
-    // So currently, there is no running timer, prepare timerfd.
-    num_flying_probes = dynarray_get_size(network->probes);
-    if (num_flying_probes == 1) {
-        itimerspec_set_delay(&new_timeout, network_get_timeout(network));
-        if (timerfd_settime(network->timerfd, 0, &new_timeout, NULL) == -1) {
-            fprintf(stderr, "Can't set timerfd\n");
-            goto ERR_TIMERFD;
+        // Let the replies to this probe pass the kernel filter
+        if (!network_add_probe_signature(network, probe)) {
+            fprintf(stderr, "Can't update the sniffer filter\n");
         }
-    }
-    return true;
 
-ERR_TIMERFD:
-ERR_PUSH_PROBE:
-ERR_SEND_PACKET:
-    packet_free(packet);
-ERR_CREATE_PACKET:
-ERR_TAG_PROBE:
-    return false;
-}
+        if (network->is_verbose) {
+            printf("Sending probe packet:\n");
+            probe_dump(probe);
+        }
 
-bool network_process_recvq(network_t * network)
-{
-    probe_t       * probe,
-                  * reply;
-    packet_t      * packet;
-    probe_reply_t * probe_reply;
+        // Make a packet from the probe structure
+        if (!(packets[num_packets] = probe_create_packet(probe))) {
+            fprintf(stderr, "Can't create packet\n");
+            network_drop_probe(network, probe);
+            continue;
+        }
 
-    // Pop the packet from the queue
-    if (!(packet = queue_pop_element(network->recvq, NULL))) {
-        goto ERR_PACKET_POP;
-    }
+        // Register this probe in the table of flying probes right now, so
+        // that its tag cannot be allocated to another probe of this batch.
+        if (!(probe_table_push(network->probes, tag, probe))) {
+            fprintf(stderr, "Can't register probe\n");
+            network_drop_probe(network, probe);
+            continue;
+        }
 
-    // Transform the reply into a probe_t instance
-    if(!(reply = probe_wrap_packet(packet))) {
-        goto ERR_PROBE_WRAP_PACKET;
+        probes[num_packets] = probe;
+        tags[num_packets]   = tag;
+        num_packets++;
     }
-    probe_set_recv_time(reply, get_timestamp());
 
-    if (network->is_verbose) {
-        printf("Got reply:\n");
-        probe_dump(reply);
+    if (num_packets == 0) goto ERR_NO_PACKET;
+
+    // Send the packets (one system call per address family)
+    num_sent = socketpool_send_packets(network->socketpool, packets, num_packets, sent);
+
+    // Update the sending times and schedule the deadlines, unregister the
+    // probes which have not been sent
+    sending_time = get_timestamp();
+    for (i = 0; i < num_packets; i++) {
+        if (sent[i]) {
+            probe_set_sending_time(probes[i], sending_time);
+            timing_wheel_add(
+                network->timeouts,
+                &probes[i]->timer,
+                network_get_probe_deadline(network, probes[i]),
+                (void *) (uintptr_t) tags[i]
+            );
+        } else {
+            fprintf(stderr, "Can't send packet\n");
+            probe_table_pop(network->probes, tags[i]);
+            network_drop_probe(network, probes[i]);
+        }
     }
 
-    // Find the probe corresponding to this reply
-    // The corresponding pointer (if any) is removed from network->probes
-    if (!(probe = network_get_matching_probe(network, reply))) {
-        goto ERR_PROBE_DISCARDED;
+    // Arm the timer if one of these probes is the next one to expire.
+    if (!network_update_timer(network, false)) {
+        fprintf(stderr, "Can't set timerfd\n");
+        goto ERR_UPDATE_TIMER;
     }
 
-    // Build a pair made of the probe and its corresponding reply
-    if (!(probe_reply = probe_reply_create())) {
-        goto ERR_PROBE_REPLY_CREATE;
-    }
+    return num_sent == num_probes;
 
-    // We're pass to the upper layer the probe and the reply to the upper layer.
-    probe_reply_set_probe(probe_reply, probe);
-    probe_reply_set_reply(probe_reply, reply);
+ERR_UPDATE_TIMER:
+ERR_NO_PACKET:
+    return false;
+}
+
+/**
+ * \brief Arm network->pacing_timerfd.
+ * \param network The network layer.
+ * \param delay The delay (in seconds), 0 to disarm the timer.
+ * \return true iif successful
+ */
 
-    // Notify the instance which has build the probe that we've got the corresponding reply
+static bool network_update_pacing_timer(network_t * network, double delay) {
+    return update_timer(network->pacing_timerfd, delay > 0 && delay < NETWORK_MIN_TIMER_DELAY ? NETWORK_MIN_TIMER_DELAY : delay);
+}
 
-    // TODO this provokes a double free:
-    //pt_throw(NULL, probe->caller, event_create(PROBE_REPLY, probe_reply, NULL, (ELEMENT_FREE) probe_reply_free));
-    pt_throw(NULL, probe->caller, event_create(PROBE_REPLY, probe_reply, NULL, NULL));
+bool network_process_paced_probes(network_t * network)
+{
+    probe_t  * probe,
+             * probes[NETWORK_SEND_BATCH_MAX];
+    size_t     i, num_probes = 0,
+               num_cells = deque_get_num_cells(network->paced_probes);
+    double     now = get_timestamp(),
+               delay, min_delay = 0;
+    bool       ret = true;
+
+    // Pick the probes allowed by the pacer, from the oldest one to the
+    // youngest one. The other ones are kept in place: the picked probes
+    // leave tombstones, and the next probes are not even visited once the
+    // batch is full.
+    for (i = 0; i < num_cells; i++) {
+        if (!(probe = deque_get_ith_cell(network->paced_probes, i))) {
+            continue;
+        } else if (num_probes == network->send_batch_size) {
+            // Send the next probes as soon as possible
+            min_delay = NETWORK_MIN_TIMER_DELAY;
+            break;
+        } else if ((delay = pacer_get_global_delay(network->pacer, now)) > 0) {
+            // No probe can be sent until the global bucket is refilled
+            min_delay = delay;
+            break;
+        } else if (pacer_consume(network->pacer, probe, now, &delay)) {
+            probes[num_probes++] = deque_del_ith_cell(network->paced_probes, i);
+        } else if (min_delay == 0 || delay < min_delay) {
+            min_delay = delay;
+        }
+    }
+    deque_trim(network->paced_probes);
 
-    // TODO probe_reply_free frees only the reply but probe_reply_deep_free cannot be used as other things may have references to its contents.
-    return true;
+    if (num_probes > 0) {
+        ret = network_send_probes(network, probes, num_probes);
+    }
 
-ERR_PROBE_REPLY_CREATE:
-ERR_PROBE_DISCARDED:
-    probe_free(reply);
-ERR_PROBE_WRAP_PACKET:
-    //packet_free(packet); TODO provoke segfault in case of stars
-ERR_PACKET_POP:
-    return false;
-}
+    // Wake up when the next delayed probe may be sent (or disarm the timer)
+    if (!network_update_pacing_timer(network, deque_get_size(network->paced_probes) > 0 ? min_delay : 0)) {
+        fprintf(stderr, "Can't set pacing timerfd\n");
+        ret = false;
+    }
 
-void network_process_sniffer(network_t * network, uint8_t protocol_id) {
-    sniffer_process_packets(network->sniffer, protocol_id);
+    return ret;
 }
 
-bool network_drop_expired_flying_probe(network_t * network)
+// TODO This could be replaced by watchers: FD -> action
+bool network_process_sendq(network_t * network)
 {
-    // Drop every expired probes
-    size_t    i, num_flying_probes = dynarray_get_size(network->probes);
-    bool      ret = false;
-    probe_t * probe;
+    probe_t * probes[NETWORK_SEND_BATCH_MAX];
+    size_t    i, num_probes;
 
-    // Is there flying probe(s) ?
-    if (num_flying_probes > 0) {
+    // Probe skeleton when entering the network layer.
+    // We have to duplicate the probe since the same address of skeleton
+    // may have been passed to pt_send_probe.
+    // => We duplicate this probe in the
+    // network layer registry (network->probes) and then tagged.
 
-        // Iterate on each expired probes (at least the oldest one has expired)
-        for (i = 0 ;i < num_flying_probes; i++) {
-            probe = dynarray_get_ith_element(network->probes, i);
+    // Do not free probes at the end of this function.
+    // Their addresses will be saved in network->probes and freed later.
+    num_probes = queue_pop_elements(network->sendq, (void **) probes, network->send_batch_size);
 
-            // Some probe may expires very soon and may expire before the next probe timeout
-            // update. If so, the timer will be disarmed and libparistraceroute may freeze.
-            // To avoid this kind of deadlock, we provoke a probe timeout for each probe
-            // expiring in less that EXTRA_DELAY seconds.
-            if (network_get_probe_timeout(network, probe) - EXTRA_DELAY > 0) break;
+    if (!pacer_is_enabled(network->pacer)) {
+        return num_probes > 0 && network_send_probes(network, probes, num_probes);
+    }
 
-            // This probe has expired, raise a PROBE_TIMEOUT event.
-            pt_throw(NULL, probe->caller, event_create(PROBE_TIMEOUT, probe, NULL, NULL)); //(ELEMENT_FREE) probe_free));
+    // The pacer decides when these probes leave the network layer
+    for (i = 0; i < num_probes; i++) {
+        if (!deque_push_back(network->paced_probes, probes[i])) {
+            fprintf(stderr, "Can't delay probe\n");
+            network_drop_probe(network, probes[i]);
         }
+    }
 
-        // Delete the i oldest probes, which have expired.
-        if (i != 0) {
-            dynarray_del_n_elements(network->probes, 0, i, NULL);
-        }
+    return network_process_paced_probes(network);
+}
 
-        ret = network_update_next_timeout(network);
-    } else {
-        fprintf(stderr, "network_drop_expired_flying_probe: a probe has expired, but there are no more flying probes!\n");
+bool network_process_recvq(network_t * network)
+{
+    packet_t * packets[NETWORK_SEND_BATCH_MAX];
+    size_t     i, num_packets, num_processed = 0;
+    bool       ret = true;
+
+    // The eventfd of the recvq is only written when the queue becomes
+    // non-empty, so drain it completely.
+    while ((num_packets = queue_pop_elements(network->recvq, (void **) packets, NETWORK_SEND_BATCH_MAX))) {
+        for (i = 0; i < num_packets; i++) {
+            if (!network_process_packet(network, packets[i])) ret = false;
+        }
+        num_processed += num_packets;
     }
 
-    return ret;
+    return ret && num_processed > 0;
+}
+
+void network_process_sniffer(network_t * network, uint8_t protocol_id) {
+    sniffer_process_packets(network->sniffer, protocol_id);
+}
+
+bool network_drop_expired_flying_probe(network_t * network)
+{
+    // Drop every expired probes at once, then arm the timer for the next
+    // deadline (timerfd_settime also resets the activation of network->timerfd).
+    timing_wheel_advance(network->timeouts, get_timestamp(), network_expire_probe, network);
+    return network_update_timer(network, true);
 }
 
 //------------------------------------------------------------------------------------
@@ -23,8 +23,14 @@
 #include "socketpool.h"  // socketpool_t
 #include "sniffer.h"     // sniffer_t
 #include "dynarray.h"    // dynarray_t
+#include "deque.h"       // deque_t
+#include "probe_table.h" // probe_table_t
+#include "field_handle.h" // field_handle_t
+#include "timing_wheel.h" // timing_wheel_t
+#include "pacer.h"       // pacer_t
 #include "options.h"     // option_t
 #include "probe_group.h" // probe_group_t
+#include "probe_batch.h" // probe_batch_t
 #include "use.h"
 
 // If no matching reply has been sniffed in the next 3 sec, we
@@ -33,8 +39,38 @@
 // thanks to network_set_timeout() and network_get_timeout().
 
 #define NETWORK_DEFAULT_TIMEOUT 3
+
+// Probe deadlines are rounded up to a multiple of this value (in seconds).
+#define NETWORK_TIMEOUT_TICK 0.001
 #define OPTIONS_NETWORK_WAIT {NETWORK_DEFAULT_TIMEOUT, 0, INT_MAX}
 #define HELP_w "Set the number of seconds to wait for response to a probe (default is 5.0)"
+// Maximum number of probes sent each time the sendq is processed.
+
+#define NETWORK_DEFAULT_SEND_BATCH 32
+#define NETWORK_SEND_BATCH_MAX     256
+#define OPTIONS_NETWORK_SEND_BATCH {NETWORK_DEFAULT_SEND_BATCH, 1, NETWORK_SEND_BATCH_MAX}
+#define HELP_send_batch "Set the maximum number of queued probes sent at once (default is 32, pass 1 to send probes one by one)"
+
+// Maximum number of probes waiting in the sendq (see network_send_probe).
+#define NETWORK_SENDQ_CAPACITY QUEUE_DEFAULT_CAPACITY
+
+#ifdef USE_PACKET_RING
+#  define HELP_capture "Set how replies are captured: 'raw' (raw ICMP sockets, default) or 'ring' (memory-mapped TPACKET_V3 rings)"
+#else
+#  define HELP_capture "Set how replies are captured: 'raw' (raw ICMP sockets, default)"
+#endif
+#define HELP_listen_interface "Only capture replies received on a given interface (requires --capture ring)"
+
+// Pacing of the probes (a null rate means unlimited).
+#define OPTIONS_NETWORK_PPS        {0, 0, 1000000}
+#define OPTIONS_NETWORK_DST_PPS    {0, 0, 1000000}
+#define OPTIONS_NETWORK_PREFIX_PPS {0, 0, 1000000}
+#define OPTIONS_NETWORK_BURST      {PACER_DEFAULT_BURST, 1, 1000000}
+#define HELP_pps        "Set the maximum number of probes sent per second (default is 0, i.e. unlimited)"
+#define HELP_dst_pps    "Set the maximum number of probes sent per second to a given destination (default is 0, i.e. unlimited)"
+#define HELP_prefix_pps "Set the maximum number of probes sent per second to a given /24 (IPv4) or /48 (IPv6) prefix (default is 0, i.e. unlimited)"
+#define HELP_burst      "Set the number of probes that may be sent at once when pacing is enabled (default is 10)"
+#define HELP_wide_tags "Use 32-bit probe tags (stored in the transport checksum and in the IPv4 identification or the IPv6 payload) to allow more probes in flight"
 
 /**
  * \struct network_t
@@ -101,23 +137,39 @@
 // network->sendq if it is not yet sent, or either in network->probes if it is
 // in flight).
 //
-// Matching probes (see network_get_matching_probe) must be freed once
-// duplicated and raised to the upper layers, or move in a dedicated
-// dynarray for archive or duplicate detection purposes.
+// The reference held by the network layer on a probe is handed over to the
+// PROBE_REPLY event (through its probe_reply_t) or to the PROBE_TIMEOUT event
+// raised for this probe. Upper layers share these probes and replies by
+// taking references (see probe_ref, probe_reply_ref) instead of duplicating
+// them.
 
 typedef struct network_s {
     socketpool_t  * socketpool;        /**< Pool of sockets used by this network */
     queue_t       * sendq;             /**< Queue containing packet to send  (probe_t instances) */
-    queue_t       * recvq;             /**< Queue containing received packet (packet_t instances) */
+    queue_t       * recvq;             /**< Queue containing received packet (packet_t instances). Sniffed packets are directly processed and do not transit through this queue */
     sniffer_t     * sniffer;           /**< Sniffer to use on this network */
-    dynarray_t    * probes;            /**< Probes in transit, from the oldest probe_t instance to the youngest one. */
+    probe_table_t * probes;            /**< Probes in transit, indexed by tag, from the oldest probe_t instance to the youngest one. */
+    timing_wheel_t * timeouts;         /**< Deadlines of the probes in transit */
     int             timerfd;           /**< Used for probe timeouts. Linux specific. Activated when a probe timeout occurs */
-    uint16_t        last_tag;          /**< Last probe ID used */
+    double          next_deadline;     /**< When timerfd is activated (0 if disarmed) */
+    uint32_t        last_tag;          /**< Last probe ID used */
+    bool            use_wide_tags;     /**< Use 32-bit probe IDs instead of 16-bit probe IDs */
+    field_handle_t  probe_tag;         /**< Field of a probe carrying the 16 least significant bits of its tag */
+    field_handle_t  reply_tag;         /**< Field of a reply carrying the 16 least significant bits of the tag of the probe */
+    field_handle_t  probe_tag_high;    /**< Field of an IPv4 probe carrying the 16 most significant bits of a wide tag */
+    field_handle_t  reply_tag_high;    /**< Field of an IPv4 reply carrying the 16 most significant bits of a wide tag */
+    const protocol_t * ipv4;           /**< The IPv4 protocol, whose quoted header carries reply_tag_high (NULL if not supported) */
+    size_t          send_batch_size;   /**< Maximum number of probes sent by network_process_sendq */
+    pacer_t       * pacer;             /**< Rate limits applied to the probes leaving sendq */
+    deque_t       * paced_probes;      /**< Probes popped from sendq and delayed by the pacer, from the oldest to the youngest */
+    int             pacing_timerfd;    /**< Activated when network->paced_probes may be sent */
     double          timeout;           /**< The timeout value used by this network (in seconds) */
 #ifdef USE_SCHEDULING
     int             scheduled_timerfd; /**< Used for probe delays. Activated when a probe delay occurs */
     probe_group_t * scheduled_probes;  /**< Scheduled probes */
 #endif
+    size_t          num_fast_path_hits;   /**< Number of replies matched straight from their bytes (see network_process_packet) */
+    size_t          num_fast_path_misses; /**< Number of replies which have been dissected to be matched */
     bool            is_verbose;        /**< Print debug messages*/
 } network_t;
 
@@ -129,6 +181,44 @@ typedef struct network_s {
 
 double options_network_get_timeout();
 
+/**
+ * \brief Retrieve the maximum number of probes sent at once.
+ * \return The value passed to --send-batch.
+ */
+
+size_t options_network_get_send_batch_size();
+
+/**
+ * \brief Retrieve whether the network layer must use 32-bit tags.
+ * \return true iif --wide-tags has been passed.
+ */
+
+bool options_network_get_wide_tags();
+
+/**
+ * \brief Retrieve the pacing parameters passed by the user.
+ * \param prate Where the global rate (probes per second) is written.
+ * \param pdst_rate Where the per-destination rate is written.
+ * \param pprefix_rate Where the per-prefix rate is written.
+ * \param pburst Where the burst size is written.
+ */
+
+void options_network_get_pacing(double * prate, double * pdst_rate, double * pprefix_rate, double * pburst);
+
+/**
+ * \brief Get the sniffer backend selected by the user.
+ * \return The corresponding backend.
+ */
+
+sniffer_backend_t options_network_get_sniffer_backend();
+
+/**
+ * \brief Get the interface the sniffer must listen to.
+ * \return The interface name, NULL for any interface.
+ */
+
+const char * options_network_get_sniffer_interface();
+
 /**
  * \brief Get the command-line options related to the layer network.
  * \return A pointer to a structure containing the options.
@@ -182,6 +272,81 @@ void network_set_is_verbose(network_t * network, bool verbose);
 
 void network_set_timeout(network_t * network, double new_timeout);
 
+/**
+ * \brief Set the maximum number of queued probes sent each time
+ *    network_process_sendq() is called.
+ * \param network The network layer.
+ * \param send_batch_size The new batch size (between 1 and NETWORK_SEND_BATCH_MAX).
+ * \return true iif successful.
+ */
+
+bool network_set_send_batch_size(network_t * network, size_t send_batch_size);
+
+/**
+ * \brief Set whether the network layer tags the probes using 32-bit tags.
+ *    The 16 least significant bits of a tag are always stored in the
+ *    transport checksum. The 16 most significant bits of a wide tag are
+ *    stored in the IPv4 identification field (IPv4) or in the bytes 2-3
+ *    of the payload (IPv6).
+ * \param network The network layer.
+ * \param use_wide_tags Pass true to use 32-bit tags, false to use 16-bit tags.
+ */
+
+void network_set_wide_tags(network_t * network, bool use_wide_tags);
+
+/**
+ * \brief Set the rate limits applied to the probes sent by a network layer.
+ *    Each probe must get a token from a global bucket, from the bucket of
+ *    its destination and from the bucket of its destination prefix (/24
+ *    for IPv4, /48 for IPv6). Probes that cannot be sent yet wait in
+ *    network->paced_probes.
+ * \param network The network layer.
+ * \param rate The global rate (probes per second, 0 if unlimited).
+ * \param dst_rate The per-destination rate (probes per second, 0 if unlimited).
+ * \param prefix_rate The per-prefix rate (probes per second, 0 if unlimited).
+ * \param burst The capacity of each bucket (>= 1).
+ * \return true iif successful.
+ */
+
+bool network_set_pacing(network_t * network, double rate, double dst_rate, double prefix_rate, double burst);
+
+/**
+ * \brief Retrieve the number of replies classified straight from their
+ *    bytes (IPv4 / ICMPv4 / IPv4 / * and IPv6 / ICMPv6 / IPv6 / * errors),
+ *    without being dissected unless they match a flying probe.
+ * \param network The network layer.
+ * \return The corresponding number of replies.
+ */
+
+size_t network_get_num_fast_path_hits(const network_t * network);
+
+/**
+ * \brief Retrieve the number of replies which have been dissected
+ *    to be matched (see network_get_num_fast_path_hits).
+ * \param network The network layer.
+ * \return The corresponding number of replies.
+ */
+
+size_t network_get_num_fast_path_misses(const network_t * network);
+
+/**
+ * \brief Print how many replies have been classified straight from
+ *    their bytes and how many have been dissected.
+ * \param out The output stream.
+ * \param network The network layer.
+ */
+
+void network_fprintf_statistics(FILE * out, const network_t * network);
+
+/**
+ * \brief Retrieve how long the oldest probe waiting for the pacer has
+ *    been queued in the network layer.
+ * \param network The network layer.
+ * \return The delay (in seconds), 0 if no probe is delayed by the pacer.
+ */
+
+double network_get_queue_delay(const network_t * network);
+
 /**
  * \brief Retrieve the file descriptor activated whenever a
  *   packet is ready to be sent.
@@ -218,6 +383,15 @@ int network_get_recvq_fd(network_t * network);
 
 int network_get_timerfd(network_t * network);
 
+/**
+ * \brief Retrieve the file descriptor activated whenever
+ *   probes delayed by the pacer may be sent.
+ * \param network The network layer.
+ * \return The corresponding file descriptor
+ */
+
+int network_get_pacing_timerfd(network_t * network);
+
 /**
  * \brief Retrieve the file descriptor activated whenever a
  *   delay occurs.
@@ -237,16 +411,30 @@ int network_get_group_timerfd(network_t * network);
 probe_group_t * network_get_group_probes(network_t * network);
 
 /**
- * \brief Send the next packet stored network->sendq
+ * \brief Send the next packets stored in network->sendq. Up to
+ *    network->send_batch_size probes are tagged and sent at once.
+ *    If pacing is enabled, the probes are first handed to the pacer
+ *    (see network_process_paced_probes).
  * \param network The network layer..
- * \return true iif successfull
+ * \return true iif every poped probe has been sent
  */
 
 bool network_process_sendq(network_t * network);
 
+/**
+ * \brief Send the probes delayed by the pacer which may now be sent
+ *    (up to network->send_batch_size probes), and arm
+ *    network->pacing_timerfd for the remaining ones.
+ * \param network The network layer.
+ * \return true iif successful
+ */
+
+bool network_process_paced_probes(network_t * network);
+
 /**
  * \brief Process received packets: match them with a probe, or discard them.
  * In practice, the receive queue stores all the packets handled by the sniffer.
+ * The whole queue is drained at once.
  * \param network The network layer.
  * \return true iif successful
  */
@@ -255,7 +443,8 @@ bool network_process_recvq(network_t * network);
 
 /**
  * \brief Make the network layer..query its embedded sniffer instance in order
- *   to fetch a received packet.
+ *   to fetch every received packet. Each packet is immediately matched
+ *   with its probe (see network_process_packet).
  * \param network The network layer..
  * \param protocol_id The family of the packet to fetch (IPPROTO_ICMP, IPPROTO_ICMPV6)
  */
@@ -263,10 +452,10 @@ bool network_process_recvq(network_t * network);
 void network_process_sniffer(network_t * network, uint8_t protocol_id);
 
 /**
- * \brief Drop the oldest flying probe (if any) attached to a network_t
- *    instance. The oldest probe is removed from network->probes
- *    and network->timerfd is refreshed to manage the next timeout
- *    if there is still at least one flying probe.
+ * \brief Drop every expired flying probe attached to a network_t
+ *    instance. Each expired probe is removed from network->probes and
+ *    a PROBE_TIMEOUT event is raised. network->timerfd is then refreshed
+ *    to manage the next deadline, if any.
  * \param network The network layer.
  * \return true iif successful
  */
@@ -280,6 +469,30 @@ bool network_drop_expired_flying_probe(network_t * network);
 
 bool network_send_probe(network_t * network, probe_t * probe);
 
+/**
+ * \brief Pass every probe of a batch to the network layer. The best
+ *    effort probes are pushed in the sendq at once, so that the network
+ *    layer is woken up once for the whole batch.
+ * \param network The network layer.
+ * \param probe_batch The probes to send. The probes which cannot be
+ *    passed to the network layer are released (see probe_free).
+ * \return true iif successful
+ */
+
+bool network_send_probe_batch(network_t * network, probe_batch_t * probe_batch);
+
+/**
+ * \brief Prepare a probe skeleton so that the probes cloned from it
+ *    can be tagged in place. The probes of a batch cannot be resized
+ *    (see probe_batch.h), while wide tags require a payload of at least
+ *    4 bytes in IPv6 probes (see network_set_wide_tags).
+ * \param network The network layer.
+ * \param skel The probe skeleton, enlarged if needed.
+ * \return true iif successful
+ */
+
+bool network_prepare_skeleton(network_t * network, probe_t * skel);
+
 #ifdef USE_SCHEDULING
 
 /**
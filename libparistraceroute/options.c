@@ -35,12 +35,17 @@ static void option_dump(const option_t * option) {
 }
 
 /**
- * \brief Free an opt_spect_t instance.
- * \param option The opt_spect_t instance to free.
+ * \brief Release the strings of an opt_spect_t instance made by option_dup.
+ *    The opt_spect_t instance itself is not released, since the options_t
+ *    instances store their opt_spect_t instances by value.
+ * \param option The opt_spect_t instance to clear.
  */
 
-static void option_free(option_t * option) {
-    free(option);
+static void option_clear(option_t * option) {
+    free((char *) option->sf);
+    free((char *) option->lf);
+    free((char *) option->metavar);
+    free((char *) option->help);
 }
 
 /**
@@ -107,7 +112,7 @@ options_t * options_create(bool (* collision_callback)(option_t * option1, const
 
     if (!(options->optspecs = vector_create(
         sizeof(option_t),
-        (ELEMENT_FREE) option_free,
+        (ELEMENT_FREE) option_clear,
         (ELEMENT_DUMP) option_dump
     ))) {
         goto ERR_VECTOR_CREATE;
@@ -123,6 +128,13 @@ ERR_MALLOC:
     return NULL;
 }
 
+void options_free(options_t * options) {
+    if (options) {
+        vector_free(options->optspecs, (ELEMENT_FREE) option_clear);
+        free(options);
+    }
+}
+
 void options_dump(const options_t * options) {
     vector_dump(options->optspecs);
 }
@@ -141,11 +153,18 @@ bool options_add_optspecs(options_t * options, const option_t * optspecs)
 bool options_add_optspec(options_t * options, const option_t * option)
 {
     bool         ret;
-    option_t * colliding_option = options_search_colliding_option(options, option);
+    option_t   * option_copy,
+               * colliding_option = options_search_colliding_option(options, option);
 
     if (!colliding_option) {
-        // No collision, add this option
-        ret = vector_push_element(options->optspecs, (void *) option_dup(option));
+        // No collision, add this option. The vector stores a shallow copy
+        // of option_copy, which then owns its strings.
+        if ((option_copy = option_dup(option))) {
+            if (!(ret = vector_push_element(options->optspecs, option_copy))) {
+                option_clear(option_copy);
+            }
+            free(option_copy);
+        }
     } else if (options->collision_callback) {
         // Collision detected, call collision_callback
         ret = options->collision_callback(colliding_option, option);
@@ -182,8 +201,33 @@ bool options_add_common(options_t * options, char * version)
     return ret;
 }
 
+/**
+ * \brief Set the help message of the options related to a given action
+ *    if they have none.
+ * \param options An options_t instance.
+ * \param action The action of the options to update.
+ * \param help The help message.
+ */
+
+static void options_set_default_help(options_t * options, int (* action)(char *, void *), const char * help) {
+    size_t     i;
+    option_t * option;
+
+    for (i = 0; i < options->optspecs->num_cells; i++) {
+        option = vector_get_ith_element(options->optspecs, i);
+        if (option->action == action && (!option->help || !*option->help)) {
+            free((char *) option->help);
+            option->help = strdup(help);
+        }
+    }
+}
+
 int options_parse(options_t * options, const char * usage, char ** args)
 {
+    // opt_parse sets the missing help messages of these options to string
+    // literals, which options_free could not release.
+    options_set_default_help(options, opt_help,    "print this help message and exit");
+    options_set_default_help(options, opt_version, "print the version number and exit");
     opt_options1st();
     return opt_parse(usage, (struct opt_spec *)(options->optspecs->cells), args);
 }
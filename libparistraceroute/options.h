@@ -69,6 +69,13 @@ typedef struct {
 
 options_t * options_create(bool (* collision_callback)(option_t * option1, const option_t * option2));
 
+/**
+ * \brief Release an options_t instance and the options it contains
+ * \param options A pointer to an options_t structure
+ */
+
+void options_free(options_t * options);
+
 /**
  * \brief Add options to an array of options
  * \param options A pointer to an options_t structure containing the array of options to fill
@@ -0,0 +1,312 @@
+#include "config.h"
+
+#include <stdlib.h>         // malloc, calloc, free
+#include <string.h>         // memcpy, memcmp, memset
+
+#include "pacer.h"
+#include "layer.h"          // layer_t
+
+#define PACER_ENTRIES_INIT 64
+
+// Kinds of keys
+#define PACER_KEY_DST4    1
+#define PACER_KEY_DST6    2
+#define PACER_KEY_PREFIX4 3
+#define PACER_KEY_PREFIX6 4
+
+// Offsets of the destination address in the IP headers
+#define PACER_IPV4_DST_OFFSET 16
+#define PACER_IPV6_DST_OFFSET 24
+
+// Prefix lengths (in bytes) sharing a per-prefix bucket
+#define PACER_IPV4_PREFIX_SIZE 3 // /24
+#define PACER_IPV6_PREFIX_SIZE 6 // /48
+
+//---------------------------------------------------------------------------
+// Private functions
+//---------------------------------------------------------------------------
+
+/**
+ * \brief Refill a bucket.
+ * \param bucket A token_bucket_t instance.
+ * \param rate The rate of the bucket (probes per second).
+ * \param burst The capacity of the bucket.
+ * \param now The current timestamp.
+ */
+
+static inline void token_bucket_refill(token_bucket_t * bucket, double rate, double burst, double now) {
+    if (now > bucket->last) {
+        bucket->tokens += (now - bucket->last) * rate;
+        if (bucket->tokens > burst) bucket->tokens = burst;
+        bucket->last = now;
+    }
+}
+
+/**
+ * \brief Compute how long we have to wait until a bucket stores a token.
+ *    The bucket must have been refilled.
+ * \param bucket A token_bucket_t instance.
+ * \param rate The rate of the bucket (probes per second).
+ * \return The delay (in seconds), 0 if a token is available.
+ */
+
+static inline double token_bucket_get_delay(const token_bucket_t * bucket, double rate) {
+    return bucket->tokens >= 1 ? 0 : (1 - bucket->tokens) / rate;
+}
+
+/**
+ * \brief Hash a key (FNV-1a).
+ * \param key A pacer_key_t instance.
+ * \return The hash.
+ */
+
+static size_t pacer_key_hash(const pacer_key_t * key) {
+    uint32_t hash = 2166136261u;
+    size_t   i;
+
+    hash = (hash ^ key->kind) * 16777619u;
+    for (i = 0; i < sizeof(key->bytes); i++) {
+        hash = (hash ^ key->bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * \brief Build the per-destination and per-prefix keys related to a probe.
+ * \param probe A probe_t instance.
+ * \param dst_key Where the per-destination key is written.
+ * \param prefix_key Where the per-prefix key is written.
+ * \return true iif successful.
+ */
+
+static bool pacer_make_keys(const probe_t * probe, pacer_key_t * dst_key, pacer_key_t * prefix_key)
+{
+    const layer_t * layer;
+
+    if (!(layer = probe_get_layer(probe, 0)) || !layer->segment_size) return false;
+
+    memset(dst_key, 0, sizeof(pacer_key_t));
+    memset(prefix_key, 0, sizeof(pacer_key_t));
+
+    switch (layer->segment[0] >> 4) {
+        case 4:
+            if (layer->segment_size < PACER_IPV4_DST_OFFSET + 4) return false;
+            dst_key->kind    = PACER_KEY_DST4;
+            prefix_key->kind = PACER_KEY_PREFIX4;
+            memcpy(dst_key->bytes, layer->segment + PACER_IPV4_DST_OFFSET, 4);
+            memcpy(prefix_key->bytes, dst_key->bytes, PACER_IPV4_PREFIX_SIZE);
+            break;
+        case 6:
+            if (layer->segment_size < PACER_IPV6_DST_OFFSET + 16) return false;
+            dst_key->kind    = PACER_KEY_DST6;
+            prefix_key->kind = PACER_KEY_PREFIX6;
+            memcpy(dst_key->bytes, layer->segment + PACER_IPV6_DST_OFFSET, 16);
+            memcpy(prefix_key->bytes, dst_key->bytes, PACER_IPV6_PREFIX_SIZE);
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Find the slot storing a key, or the free slot where it would be inserted.
+ * \param pacer A pacer_t instance.
+ * \param key The searched key.
+ * \return The corresponding slot.
+ */
+
+static pacer_entry_t * pacer_find_entry(const pacer_t * pacer, const pacer_key_t * key)
+{
+    size_t mask = pacer->max_entries - 1,
+           i    = pacer_key_hash(key) & mask;
+
+    for (; pacer->entries[i].in_use; i = (i + 1) & mask) {
+        if (memcmp(&pacer->entries[i].key, key, sizeof(pacer_key_t)) == 0) break;
+    }
+    return &pacer->entries[i];
+}
+
+/**
+ * \brief Rebuild the hash table. Full buckets are dropped since they
+ *    are equivalent to new buckets, and the table is enlarged if it is
+ *    still too loaded.
+ * \param pacer A pacer_t instance.
+ * \param now The current timestamp.
+ * \return true iif successful.
+ */
+
+static bool pacer_rehash(pacer_t * pacer, double now)
+{
+    pacer_entry_t * entries = pacer->entries;
+    size_t          i, num_entries = 0,
+                    old_max_entries = pacer->max_entries,
+                    max_entries     = pacer->max_entries;
+    double          rate;
+
+    for (i = 0; i < old_max_entries; i++) {
+        if (!entries[i].in_use) continue;
+        rate = (entries[i].key.kind == PACER_KEY_DST4 || entries[i].key.kind == PACER_KEY_DST6) ?
+            pacer->dst_rate : pacer->prefix_rate;
+        token_bucket_refill(&entries[i].bucket, rate, pacer->burst, now);
+        if (entries[i].bucket.tokens < pacer->burst) num_entries++;
+        else entries[i].in_use = false;
+    }
+
+    // Keep the load factor under 1/4 after the rehash
+    while (4 * (num_entries + 2) > max_entries) max_entries *= 2;
+
+    if (!(pacer->entries = calloc(max_entries, sizeof(pacer_entry_t)))) {
+        pacer->entries = entries;
+        return false;
+    }
+
+    pacer->max_entries = max_entries;
+    pacer->num_entries = num_entries;
+    for (i = 0; i < old_max_entries; i++) {
+        if (entries[i].in_use) {
+            *pacer_find_entry(pacer, &entries[i].key) = entries[i];
+        }
+    }
+    free(entries);
+    return true;
+}
+
+/**
+ * \brief Retrieve the bucket related to a key, create it if needed.
+ *    There must be at least one free slot in the hash table.
+ * \param pacer A pacer_t instance.
+ * \param key The key.
+ * \param now The current timestamp.
+ * \return The corresponding bucket.
+ */
+
+static token_bucket_t * pacer_get_bucket(pacer_t * pacer, const pacer_key_t * key, double now)
+{
+    pacer_entry_t * entry = pacer_find_entry(pacer, key);
+
+    if (!entry->in_use) {
+        entry->key           = *key;
+        entry->bucket.tokens = pacer->burst;
+        entry->bucket.last   = now;
+        entry->in_use        = true;
+        pacer->num_entries++;
+    }
+
+    return &entry->bucket;
+}
+
+//---------------------------------------------------------------------------
+// Public functions
+//---------------------------------------------------------------------------
+
+pacer_t * pacer_create()
+{
+    pacer_t * pacer;
+
+    if (!(pacer = malloc(sizeof(pacer_t))))                                      goto ERR_MALLOC;
+    if (!(pacer->entries = calloc(PACER_ENTRIES_INIT, sizeof(pacer_entry_t))))   goto ERR_CALLOC;
+
+    pacer->rate          = 0;
+    pacer->dst_rate      = 0;
+    pacer->prefix_rate   = 0;
+    pacer->burst         = PACER_DEFAULT_BURST;
+    pacer->global.tokens = PACER_DEFAULT_BURST;
+    pacer->global.last   = 0;
+    pacer->num_entries   = 0;
+    pacer->max_entries   = PACER_ENTRIES_INIT;
+    return pacer;
+
+ERR_CALLOC:
+    free(pacer);
+ERR_MALLOC:
+    return NULL;
+}
+
+void pacer_free(pacer_t * pacer) {
+    if (pacer) {
+        free(pacer->entries);
+        free(pacer);
+    }
+}
+
+bool pacer_set_rates(pacer_t * pacer, double rate, double dst_rate, double prefix_rate, double burst)
+{
+    if (rate < 0 || dst_rate < 0 || prefix_rate < 0 || burst < 1) return false;
+
+    pacer->rate          = rate;
+    pacer->dst_rate      = dst_rate;
+    pacer->prefix_rate   = prefix_rate;
+    pacer->burst         = burst;
+    pacer->global.tokens = burst;
+    pacer->global.last   = 0;
+    pacer->num_entries   = 0;
+    memset(pacer->entries, 0, pacer->max_entries * sizeof(pacer_entry_t));
+    return true;
+}
+
+bool pacer_is_enabled(const pacer_t * pacer) {
+    return pacer->rate > 0 || pacer->dst_rate > 0 || pacer->prefix_rate > 0;
+}
+
+double pacer_get_global_delay(pacer_t * pacer, double now)
+{
+    if (pacer->rate <= 0) return 0;
+    token_bucket_refill(&pacer->global, pacer->rate, pacer->burst, now);
+    return token_bucket_get_delay(&pacer->global, pacer->rate);
+}
+
+bool pacer_consume(pacer_t * pacer, const probe_t * probe, double now, double * pdelay)
+{
+    pacer_key_t      dst_key, prefix_key;
+    token_bucket_t * dst_bucket    = NULL,
+                   * prefix_bucket = NULL;
+    double           delay, max_delay = pacer_get_global_delay(pacer, now);
+
+    if (pacer->dst_rate > 0 || pacer->prefix_rate > 0) {
+        // Probes whose destination cannot be retrieved are only globally paced
+        if (pacer_make_keys(probe, &dst_key, &prefix_key)) {
+            // Keep the load factor of the hash table under 1/2, even if
+            // two buckets are created
+            if (2 * (pacer->num_entries + 2) > pacer->max_entries) {
+                if (!pacer_rehash(pacer, now)) goto ERR_REHASH;
+            }
+            if (pacer->dst_rate > 0) {
+                dst_bucket = pacer_get_bucket(pacer, &dst_key, now);
+            }
+            if (pacer->prefix_rate > 0) {
+                prefix_bucket = pacer_get_bucket(pacer, &prefix_key, now);
+            }
+        }
+    }
+
+    if (dst_bucket) {
+        token_bucket_refill(dst_bucket, pacer->dst_rate, pacer->burst, now);
+        delay = token_bucket_get_delay(dst_bucket, pacer->dst_rate);
+        if (delay > max_delay) max_delay = delay;
+    }
+
+    if (prefix_bucket) {
+        token_bucket_refill(prefix_bucket, pacer->prefix_rate, pacer->burst, now);
+        delay = token_bucket_get_delay(prefix_bucket, pacer->prefix_rate);
+        if (delay > max_delay) max_delay = delay;
+    }
+
+    if (max_delay > 0) {
+        *pdelay = max_delay;
+        return false;
+    }
+
+    // Every bucket has a token
+    if (pacer->rate > 0) pacer->global.tokens -= 1;
+    if (dst_bucket)      dst_bucket->tokens    -= 1;
+    if (prefix_bucket)   prefix_bucket->tokens -= 1;
+    *pdelay = 0;
+    return true;
+
+ERR_REHASH:
+    // Out of memory, do not block the probe
+    *pdelay = 0;
+    return true;
+}
@@ -0,0 +1,130 @@
+#ifndef LIBPT_PACER_H
+#define LIBPT_PACER_H
+
+/**
+ * \file pacer.h
+ * \brief Header file: token-bucket pacing of the probes.
+ *
+ * A pacer_t decides whether a probe may leave the network layer right now.
+ * A probe must get a token from each of the following buckets:
+ *  - a global bucket, shared by every probe;
+ *  - a bucket per destination;
+ *  - a bucket per destination prefix (/24 for IPv4, /48 for IPv6), to
+ *    avoid tripping the ICMP rate limit of the routers in front of it.
+ * Each bucket is refilled at a given rate (in probes per second) and
+ * stores at most "burst" tokens. A null rate disables the corresponding
+ * bucket.
+ */
+
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint8_t
+#include <stdbool.h> // bool
+
+#include "probe.h"   // probe_t
+
+#define PACER_DEFAULT_BURST 10
+
+/**
+ * \struct token_bucket_t
+ * \brief A token bucket.
+ */
+
+typedef struct {
+    double tokens; /**< Number of available tokens */
+    double last;   /**< Timestamp of the last refill */
+} token_bucket_t;
+
+/**
+ * \struct pacer_key_t
+ * \brief Identifies a per-destination or a per-prefix bucket.
+ */
+
+typedef struct {
+    uint8_t kind;      /**< See pacer.c */
+    uint8_t bytes[16]; /**< The (masked) destination address */
+} pacer_key_t;
+
+/**
+ * \struct pacer_entry_t
+ * \brief A slot of the hash table storing the buckets.
+ */
+
+typedef struct {
+    pacer_key_t    key;    /**< The key of this bucket */
+    token_bucket_t bucket; /**< The bucket */
+    bool           in_use; /**< true iif this slot stores a bucket */
+} pacer_entry_t;
+
+/**
+ * \struct pacer_t
+ * \brief Structure describing a pacer.
+ */
+
+typedef struct {
+    double           rate;        /**< Global rate (probes per second, 0 if unlimited) */
+    double           dst_rate;    /**< Per-destination rate (probes per second, 0 if unlimited) */
+    double           prefix_rate; /**< Per-prefix rate (probes per second, 0 if unlimited) */
+    double           burst;       /**< Capacity of each bucket */
+    token_bucket_t   global;      /**< The global bucket */
+    pacer_entry_t  * entries;     /**< Per-destination and per-prefix buckets (open addressing) */
+    size_t           num_entries; /**< Number of buckets stored in entries */
+    size_t           max_entries; /**< Number of slots (a power of 2) */
+} pacer_t;
+
+/**
+ * \brief Create a pacer. Pacing is disabled until pacer_set_rates is called.
+ * \return The newly created pacer if successful, NULL otherwise.
+ */
+
+pacer_t * pacer_create();
+
+/**
+ * \brief Release a pacer from the memory.
+ * \param pacer A pacer_t instance.
+ */
+
+void pacer_free(pacer_t * pacer);
+
+/**
+ * \brief Configure a pacer. The buckets are reset.
+ * \param pacer A pacer_t instance.
+ * \param rate The global rate (probes per second, 0 if unlimited).
+ * \param dst_rate The per-destination rate (probes per second, 0 if unlimited).
+ * \param prefix_rate The per-prefix rate (probes per second, 0 if unlimited).
+ * \param burst The number of probes that may be sent at once (>= 1).
+ * \return true iif successful.
+ */
+
+bool pacer_set_rates(pacer_t * pacer, double rate, double dst_rate, double prefix_rate, double burst);
+
+/**
+ * \brief Check whether a pacer limits the probes.
+ * \param pacer A pacer_t instance.
+ * \return true iif at least one rate is set.
+ */
+
+bool pacer_is_enabled(const pacer_t * pacer);
+
+/**
+ * \brief Compute how long any probe has to wait because of the global bucket.
+ * \param pacer A pacer_t instance.
+ * \param now The current timestamp.
+ * \return The delay (in seconds), 0 if a token is available.
+ */
+
+double pacer_get_global_delay(pacer_t * pacer, double now);
+
+/**
+ * \brief Try to take a token from every bucket related to a probe.
+ *    Tokens are only taken if every bucket has one.
+ * \param pacer A pacer_t instance.
+ * \param probe The probe about to be sent.
+ * \param now The current timestamp.
+ * \param pdelay If the probe cannot be sent now, the delay (in seconds)
+ *    after which it may be sent is written here.
+ * \return true iif the probe may be sent now.
+ */
+
+bool pacer_consume(pacer_t * pacer, const probe_t * probe, double now, double * pdelay);
+
+#endif // LIBPT_PACER_H
@@ -6,11 +6,12 @@
 #include <sys/socket.h> // AF_INET, AF_INET6
 
 #include "packet.h"
+#include "pool.h"       // pools_alloc, pool_release
 
 packet_t * packet_create() {
     packet_t * packet;
 
-    if (!(packet = calloc(1, sizeof(packet_t)))) goto ERR_CALLOC;
+    if (!(packet = pools_calloc(POOL_PACKET)))   goto ERR_CALLOC;
     if (!(packet->buffer = buffer_create()))     goto ERR_BUFFER_CREATE;
     if (!(packet->dst_ip = address_create()))    goto ERR_ADDRESS_CREATE;
     return packet;
@@ -18,7 +19,7 @@ packet_t * packet_create() {
 ERR_ADDRESS_CREATE:
     buffer_free(packet->buffer);
 ERR_BUFFER_CREATE:
-    free(packet);
+    pool_release(packet);
 ERR_CALLOC:
     return NULL;
 }
@@ -45,7 +46,7 @@ packet_t * packet_create_from_bytes(uint8_t * bytes, size_t num_bytes) {
 packet_t * packet_dup(const packet_t * packet) {
     packet_t * ret = NULL;
 
-    if ((ret = malloc(sizeof(packet_t)))) {
+    if ((ret = pools_alloc(POOL_PACKET))) {
         if (!(ret->buffer = buffer_dup(packet->buffer))) goto ERR_BUFFER_DUP;
         if (packet->dst_ip) {
             if (!(ret->dst_ip = address_dup(packet->dst_ip))) goto ERR_DST_IP_DUP;
@@ -57,6 +58,7 @@ packet_t * packet_dup(const packet_t * packet) {
 ERR_DST_IP_DUP:
     buffer_free(ret->buffer);
 ERR_BUFFER_DUP:
+    pool_release(ret);
     return NULL;
 }
 
@@ -66,7 +68,7 @@ void packet_free(packet_t * packet) {
             buffer_free(packet->buffer);
         }
         if (packet->dst_ip) address_free(packet->dst_ip);
-        free(packet);
+        pool_release(packet);
     }
 }
 
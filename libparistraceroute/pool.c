@@ -0,0 +1,324 @@
+#include "use.h"
+#include "config.h"
+
+#include <stdlib.h>     // malloc, free
+#include <string.h>     // memset
+
+#include "pool.h"
+#include "event.h"      // event_t
+#include "probe.h"      // probe_t, probe_reply_t, packet_t, layer_t, dynarray_t
+#include "buffer.h"     // buffer_t
+
+// Approximate size of a slab
+#define POOL_SLAB_SIZE 16384
+
+// Minimal number of objects carved out of a slab
+#define POOL_MIN_OBJECTS_PER_SLAB 16
+
+static const char * pool_names[NUM_POOL_TYPES] = {
+    [POOL_BUFFER]      = "buffer_t",
+    [POOL_DYNARRAY]    = "dynarray_t",
+    [POOL_EVENT]       = "event_t",
+    [POOL_LAYER]       = "layer_t",
+    [POOL_PACKET]      = "packet_t",
+    [POOL_PROBE]       = "probe_t",
+    [POOL_PROBE_REPLY] = "probe_reply_t"
+};
+
+static const size_t pool_sizes[NUM_POOL_TYPES] = {
+    [POOL_BUFFER]      = sizeof(buffer_t),
+    [POOL_DYNARRAY]    = sizeof(dynarray_t),
+    [POOL_EVENT]       = sizeof(event_t),
+    [POOL_LAYER]       = sizeof(layer_t),
+    [POOL_PACKET]      = sizeof(packet_t),
+    [POOL_PROBE]       = sizeof(probe_t),
+    [POOL_PROBE_REPLY] = sizeof(probe_reply_t)
+};
+
+#ifdef USE_POOLS
+
+/**
+ * \union pool_header_t
+ * \brief Header prefixing each object (and each slab).
+ *    Its size preserves the alignment of the object.
+ */
+
+typedef union {
+    struct {
+        pool_t * pool;        /**< Pool of the object, NULL if there was no current pools */
+        bool     is_malloced; /**< true iif the object has been allocated by malloc */
+    } owner;
+    void        * next;       /**< Next free object (or next slab) */
+    long double   align;
+} pool_header_t;
+
+// Pools used by the calling thread
+static __thread pools_t * pools_current = NULL;
+
+/**
+ * \brief Allocate a new slab in a pool and append its objects
+ *    to the free list.
+ * \param pool A pool_t instance.
+ * \return true iif successful.
+ */
+
+static bool pool_add_slab(pool_t * pool) {
+    pool_header_t * slab;
+    uint8_t       * object;
+    size_t          i;
+
+    if (!(slab = malloc(sizeof(pool_header_t) + pool->num_objects_per_slab * pool->object_size))) {
+        return false;
+    }
+    pool->num_mallocs++;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+
+    // Thread the objects from the last one to the first one, so that
+    // they are handed out in the order of their addresses.
+    object = (uint8_t *) (slab + 1) + pool->num_objects_per_slab * pool->object_size;
+    for (i = 0; i < pool->num_objects_per_slab; i++) {
+        object -= pool->object_size;
+        ((pool_header_t *) object)->next = pool->free_objects;
+        pool->free_objects = object;
+    }
+    return true;
+}
+
+/**
+ * \brief Release a pool and its slabs, whatever the objects in use.
+ * \param pool A pool_t instance.
+ */
+
+static void pool_release_slabs(pool_t * pool) {
+    pool_header_t * slab, * next;
+
+    for (slab = pool->slabs; slab; slab = next) {
+        next = slab->next;
+        free(slab);
+    }
+    free(pool);
+}
+
+pool_t * pool_create(const char * name, size_t size) {
+    pool_t * pool;
+    size_t   object_size;
+
+    if (!(pool = calloc(1, sizeof(pool_t)))) return NULL;
+
+    // Round the size up so that the next header remains aligned
+    object_size = sizeof(pool_header_t) + size;
+    object_size += (sizeof(pool_header_t) - object_size % sizeof(pool_header_t)) % sizeof(pool_header_t);
+
+    pool->name = name;
+    pool->object_size = object_size;
+    pool->num_objects_per_slab = POOL_SLAB_SIZE / object_size;
+    if (pool->num_objects_per_slab < POOL_MIN_OBJECTS_PER_SLAB) {
+        pool->num_objects_per_slab = POOL_MIN_OBJECTS_PER_SLAB;
+    }
+    pool->is_enabled = true;
+    return pool;
+}
+
+void pool_free(pool_t * pool) {
+    if (pool) {
+        if (pool->num_in_use > 0) {
+            // Some objects are still in use: the last one releases the pool
+            pool->is_orphan = true;
+        } else {
+            pool_release_slabs(pool);
+        }
+    }
+}
+
+void pool_set_enabled(pool_t * pool, bool is_enabled) {
+    pool->is_enabled = is_enabled;
+}
+
+void * pool_alloc(pool_t * pool) {
+    pool_header_t * header;
+
+    if (pool->is_enabled) {
+        if (!pool->free_objects && !pool_add_slab(pool)) return NULL;
+        header = pool->free_objects;
+        pool->free_objects = header->next;
+        header->owner.is_malloced = false;
+    } else {
+        if (!(header = malloc(pool->object_size))) return NULL;
+        pool->num_mallocs++;
+        header->owner.is_malloced = true;
+    }
+    header->owner.pool = pool;
+
+    pool->num_allocs++;
+    if (++pool->num_in_use > pool->max_in_use) {
+        pool->max_in_use = pool->num_in_use;
+    }
+    return header + 1;
+}
+
+void pool_release(void * object) {
+    pool_header_t * header;
+    pool_t        * pool;
+
+    if (!object) return;
+    header = (pool_header_t *) object - 1;
+
+    if (!(pool = header->owner.pool)) {
+        // Allocated while the thread had no current pools
+        free(header);
+        return;
+    }
+
+    pool->num_releases++;
+    pool->num_in_use--;
+    if (header->owner.is_malloced) {
+        free(header);
+    } else {
+        header->next = pool->free_objects;
+        pool->free_objects = header;
+    }
+
+    if (pool->is_orphan && pool->num_in_use == 0) {
+        pool_release_slabs(pool);
+    }
+}
+
+#else // USE_POOLS
+
+// Objects are allocated by malloc, and no statistics are maintained.
+
+pool_t * pool_create(const char * name, size_t size) {
+    pool_t * pool;
+
+    if ((pool = calloc(1, sizeof(pool_t)))) {
+        pool->name = name;
+        pool->object_size = size;
+    }
+    return pool;
+}
+
+void pool_free(pool_t * pool) {
+    if (pool) free(pool);
+}
+
+void pool_set_enabled(pool_t * pool, bool is_enabled) {
+}
+
+void * pool_alloc(pool_t * pool) {
+    return malloc(pool->object_size);
+}
+
+void pool_release(void * object) {
+    if (object) free(object);
+}
+
+#endif // USE_POOLS
+
+void pool_fprintf_statistics(FILE * out, const pool_t * pool) {
+    fprintf(out, "%-13s: %zu allocated, %zu released, %zu mallocs, %zu in use (peak %zu)\n",
+        pool->name,
+        pool->num_allocs,
+        pool->num_releases,
+        pool->num_mallocs,
+        pool->num_in_use,
+        pool->max_in_use
+    );
+}
+
+//---------------------------------------------------------------------------
+// pools_t
+//---------------------------------------------------------------------------
+
+pools_t * pools_create() {
+    pools_t * pools;
+    size_t    i;
+
+    if (!(pools = malloc(sizeof(pools_t)))) goto ERR_MALLOC;
+    for (i = 0; i < NUM_POOL_TYPES; i++) {
+        if (!(pools->pools[i] = pool_create(pool_names[i], pool_sizes[i]))) goto ERR_POOL_CREATE;
+    }
+    return pools;
+
+ERR_POOL_CREATE:
+    while (i--) pool_free(pools->pools[i]);
+    free(pools);
+ERR_MALLOC:
+    return NULL;
+}
+
+void pools_free(pools_t * pools) {
+    size_t i;
+
+    if (pools) {
+        if (pools_get_current() == pools) {
+            pools_set_current(NULL);
+        }
+        for (i = 0; i < NUM_POOL_TYPES; i++) {
+            pool_free(pools->pools[i]);
+        }
+        free(pools);
+    }
+}
+
+void pools_set_enabled(pools_t * pools, bool is_enabled) {
+    size_t i;
+
+    for (i = 0; i < NUM_POOL_TYPES; i++) {
+        pool_set_enabled(pools->pools[i], is_enabled);
+    }
+}
+
+#ifdef USE_POOLS
+
+void pools_set_current(pools_t * pools) {
+    pools_current = pools;
+}
+
+pools_t * pools_get_current() {
+    return pools_current;
+}
+
+void * pools_alloc(pool_type_t type) {
+    pool_header_t * header;
+
+    if (pools_current) {
+        return pool_alloc(pools_current->pools[type]);
+    }
+
+    if (!(header = malloc(sizeof(pool_header_t) + pool_sizes[type]))) return NULL;
+    header->owner.pool = NULL;
+    return header + 1;
+}
+
+#else // USE_POOLS
+
+void pools_set_current(pools_t * pools) {
+}
+
+pools_t * pools_get_current() {
+    return NULL;
+}
+
+void * pools_alloc(pool_type_t type) {
+    return malloc(pool_sizes[type]);
+}
+
+#endif // USE_POOLS
+
+void * pools_calloc(pool_type_t type) {
+    void * object;
+
+    if ((object = pools_alloc(type))) {
+        memset(object, 0, pool_sizes[type]);
+    }
+    return object;
+}
+
+void pools_fprintf_statistics(FILE * out, const pools_t * pools) {
+    size_t i;
+
+    for (i = 0; i < NUM_POOL_TYPES; i++) {
+        pool_fprintf_statistics(out, pools->pools[i]);
+    }
+}
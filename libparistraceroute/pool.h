@@ -0,0 +1,205 @@
+#ifndef LIBPT_POOL_H
+#define LIBPT_POOL_H
+
+/**
+ * \file pool.h
+ * \brief Header file: fixed-size object pools.
+ *
+ * A pool_t hands out objects of a given size carved out of slabs, and
+ * recycles the released objects through a free list, so that the small
+ * structures allocated for each probe and each reply (probe_t, packet_t,
+ * buffer_t, layer_t, ...) do not each cost a malloc and a free.
+ *
+ * Each pt_loop_t owns a pools_t (one pool per type) which becomes the
+ * current pools of the thread running the loop. The *_create functions
+ * of the pooled types allocate from the current pools of the calling
+ * thread, or from malloc if there is none. Each object is prefixed by a
+ * small header recording where it comes from, so that it is always
+ * released to the right place, whatever the current pools are.
+ *
+ * Releasing a pools_t releases all its slabs at once. A pool whose
+ * objects are not all released at this time is only released once its
+ * last object is released. Pooled objects must be released by the
+ * thread running their loop (the free lists are not synchronized).
+ *
+ * Pools can be disabled at runtime (see pools_set_enabled): each object
+ * is then allocated by malloc, but the allocations are still counted per
+ * type (see pools_fprintf_statistics), so that both modes can be
+ * compared. Pools can also be compiled out (see USE_POOLS in use.h):
+ * the objects are then allocated by malloc without any header, and no
+ * statistics are maintained.
+ */
+
+#include <stddef.h>  // size_t
+#include <stdbool.h> // bool
+#include <stdio.h>   // FILE
+
+/**
+ * \enum pool_type_t
+ * \brief The pooled types.
+ */
+
+typedef enum {
+    POOL_BUFFER,      /**< buffer_t      */
+    POOL_DYNARRAY,    /**< dynarray_t    */
+    POOL_EVENT,       /**< event_t       */
+    POOL_LAYER,       /**< layer_t       */
+    POOL_PACKET,      /**< packet_t      */
+    POOL_PROBE,       /**< probe_t       */
+    POOL_PROBE_REPLY, /**< probe_reply_t */
+    NUM_POOL_TYPES
+} pool_type_t;
+
+/**
+ * \struct pool_t
+ * \brief A pool of fixed-size objects.
+ */
+
+typedef struct pool_s {
+    const char * name;                 /**< Name of the pooled type */
+    size_t       object_size;          /**< Size of an object, header included */
+    size_t       num_objects_per_slab; /**< Number of objects carved out of a slab */
+    void       * slabs;                /**< Allocated slabs (each one starts with the address of the next one) */
+    void       * free_objects;         /**< Released objects (each one starts with the address of the next one) */
+    bool         is_enabled;           /**< false iif objects are allocated by malloc */
+    bool         is_orphan;            /**< true iif the pool must be released along with its last object */
+
+    // Statistics
+    size_t       num_allocs;           /**< Number of objects allocated */
+    size_t       num_releases;         /**< Number of objects released */
+    size_t       num_mallocs;          /**< Number of calls to malloc (slabs or objects) */
+    size_t       num_in_use;           /**< Number of objects not yet released */
+    size_t       max_in_use;           /**< Peak of num_in_use */
+} pool_t;
+
+/**
+ * \struct pools_t
+ * \brief A pool per pooled type.
+ */
+
+typedef struct {
+    pool_t * pools[NUM_POOL_TYPES]; /**< The pools, indexed by pool_type_t */
+} pools_t;
+
+//---------------------------------------------------------------------------
+// pool_t
+//---------------------------------------------------------------------------
+
+/**
+ * \brief Create a pool.
+ * \param name The name of the pooled type (not duplicated).
+ * \param size The size of the objects.
+ * \return The newly allocated pool if successful, NULL otherwise.
+ */
+
+pool_t * pool_create(const char * name, size_t size);
+
+/**
+ * \brief Release a pool and all its slabs. If some of its objects
+ *    are still in use, the pool is released along with the last of them.
+ * \param pool A pool_t instance.
+ */
+
+void pool_free(pool_t * pool);
+
+/**
+ * \brief Enable or disable a pool. The objects of a disabled pool
+ *    are allocated by malloc.
+ * \param pool A pool_t instance.
+ * \param is_enabled Pass true to enable the pool, false otherwise.
+ */
+
+void pool_set_enabled(pool_t * pool, bool is_enabled);
+
+/**
+ * \brief Allocate an object from a pool.
+ * \param pool A pool_t instance.
+ * \return The address of the object if successful, NULL otherwise.
+ */
+
+void * pool_alloc(pool_t * pool);
+
+/**
+ * \brief Release an object allocated by pool_alloc or pools_alloc
+ *    to the place it comes from.
+ * \param object The object (may be NULL).
+ */
+
+void pool_release(void * object);
+
+/**
+ * \brief Print the statistics of a pool.
+ * \param out The output stream.
+ * \param pool A pool_t instance.
+ */
+
+void pool_fprintf_statistics(FILE * out, const pool_t * pool);
+
+//---------------------------------------------------------------------------
+// pools_t
+//---------------------------------------------------------------------------
+
+/**
+ * \brief Create a pool per pooled type.
+ * \return The newly allocated pools if successful, NULL otherwise.
+ */
+
+pools_t * pools_create();
+
+/**
+ * \brief Release the pools and their slabs (see pool_free).
+ *    If they are the current pools, the calling thread has no
+ *    current pools anymore.
+ * \param pools A pools_t instance.
+ */
+
+void pools_free(pools_t * pools);
+
+/**
+ * \brief Enable or disable each pool (see pool_set_enabled).
+ * \param pools A pools_t instance.
+ * \param is_enabled Pass true to enable the pools, false otherwise.
+ */
+
+void pools_set_enabled(pools_t * pools, bool is_enabled);
+
+/**
+ * \brief Set the pools used by the calling thread.
+ * \param pools A pools_t instance, or NULL to allocate the objects
+ *    by malloc.
+ */
+
+void pools_set_current(pools_t * pools);
+
+/**
+ * \brief Retrieve the pools used by the calling thread.
+ * \return The current pools, NULL if none.
+ */
+
+pools_t * pools_get_current();
+
+/**
+ * \brief Allocate an object from the current pools.
+ * \param type The type of the object.
+ * \return The address of the object if successful, NULL otherwise.
+ */
+
+void * pools_alloc(pool_type_t type);
+
+/**
+ * \brief Allocate an object from the current pools and set it to zero.
+ * \param type The type of the object.
+ * \return The address of the object if successful, NULL otherwise.
+ */
+
+void * pools_calloc(pool_type_t type);
+
+/**
+ * \brief Print the statistics of each pool.
+ * \param out The output stream.
+ * \param pools A pools_t instance.
+ */
+
+void pools_fprintf_statistics(FILE * out, const pools_t * pools);
+
+#endif // LIBPT_POOL_H
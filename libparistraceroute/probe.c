@@ -6,13 +6,18 @@
 #include <errno.h>          // errno, EINVAL
 #include <stdarg.h>         // va_start, va_copy, va_arg
 #include <string.h>         // memcpy
+#include <stdint.h>         // SIZE_MAX
 #include <sys/socket.h>     // AF_INET*
+#include <arpa/inet.h>      // ntohs, htons, ntohl, htonl
 
 #include "probe.h"          // probe_t
+#include "probe_batch.h"    // probe_batch_release
 #include "buffer.h"         // buffer_t
 #include "protocol.h"       // protocol_t
 #include "common.h"         // ELEMENT_FREE
 #include "generator.h"      // generator_*
+#include "metafield.h"      // metafield_t
+#include "pool.h"           // pools_calloc, pool_release
 
 //-----------------------------------------------------------
 // Probe consistency
@@ -82,6 +87,15 @@ static void probe_layers_free(probe_t * probe);
 
 static void probe_layers_clear(probe_t * probe);
 
+/**
+ * \brief Dissect the layers of a probe created by probe_wrap_packet
+ *    which have not yet been discovered, until a given depth.
+ * \param probe The probe we're dissecting
+ * \param depth The index of the deepest layer needed by the caller.
+ */
+
+static void probe_dissect(probe_t * probe, size_t depth);
+
 //-----------------------------------------------------------
 // Other static functions
 //-----------------------------------------------------------
@@ -106,6 +120,8 @@ static bool probe_finalize(probe_t * probe)
     size_t    i, num_layers = probe_get_num_layers(probe);
     layer_t * layer;
 
+    probe->has_valid_checksums = false;
+
     // Allow the protocol to do some processing before computing checksums.
     for (i = 0; i < num_layers; i++) {
         layer = probe_get_layer(probe, i);
@@ -118,27 +134,19 @@ static bool probe_finalize(probe_t * probe)
     return ret;
 }
 
-static bool layer_set_field_and_free(layer_t * layer, field_t * field) {
-    bool ret = false;
-
-    if (field) {
-        ret = layer_set_field(layer, field);
-        field_free(field);
-    }
-    return ret;
-}
-
 static bool probe_update_protocol(probe_t * probe)
 {
     size_t    i, num_layers = probe_get_num_layers(probe);
     layer_t * layer,
             * prev_layer;
 
+    probe->has_valid_checksums = false;
+
     for (i = 0, prev_layer = NULL; i < num_layers; i++, prev_layer = layer) {
         layer = probe_get_layer(probe, i);
         if (layer->protocol && prev_layer) {
             // Update 'protocol' field (if any)
-            layer_set_field_and_free(prev_layer, I8("protocol", layer->protocol->protocol));
+            layer_set_field(prev_layer, FIELD_I8("protocol", layer->protocol->protocol));
         }
     }
     return true;
@@ -152,13 +160,15 @@ static bool probe_update_length(probe_t * probe)
               packet_size = probe_get_size(probe);
     layer_t * layer;
 
+    probe->has_valid_checksums = false;
+
     for (i = 0, offset = 0; i < num_layers; i++) {
         layer = probe_get_layer(probe, i);
         if (layer->protocol) {
             // Update 'length' field (if any)
             // This protocol field must always corresponds to the size of the
             // header + its contents.
-            layer_set_field_and_free(layer, I16("length", packet_size - offset));
+            layer_set_field(layer, FIELD_I16("length", packet_size - offset));
             offset += layer->protocol->get_header_size(layer->segment);
         } else {
             // Update payload size
@@ -169,6 +179,33 @@ static bool probe_update_length(probe_t * probe)
     return ret;
 }
 
+/**
+ * \brief Compute and write the checksum of a layer whose protocol
+ *    provides get_pseudo_header_sum and checksum_offset. Unlike the
+ *    write_checksum callback, no pseudo header is allocated.
+ * \param probe The probe.
+ * \param layer A layer of this probe.
+ * \param pseudo_header_sum The folded sum of the pseudo header.
+ */
+
+static void probe_write_checksum(const probe_t * probe, layer_t * layer, uint16_t pseudo_header_sum)
+{
+    const uint8_t * packet_end = packet_get_bytes(probe->packet) + probe_get_size(probe);
+    uint8_t       * checksum_bytes = layer->segment + layer->protocol->checksum_offset;
+    uint16_t        checksum = 0;
+    size_t          size;
+
+    // The segment of a protocol layer is restricted to its header
+    size = layer->protocol->get_checksum_size ?
+        layer->protocol->get_checksum_size(layer->segment) :
+        layer->segment_size;
+    if (layer->segment + size > packet_end) size = packet_end - layer->segment;
+
+    memcpy(checksum_bytes, &checksum, sizeof(uint16_t));
+    checksum = (uint16_t) ~csum_fold(csum_partial(layer->segment, size, pseudo_header_sum));
+    memcpy(checksum_bytes, &checksum, sizeof(uint16_t));
+}
+
 bool probe_update_checksum(probe_t * probe)
 {
     size_t     i, j, num_layers = probe_get_num_layers(probe);
@@ -176,6 +213,8 @@ bool probe_update_checksum(probe_t * probe)
              * layer_prev;
     buffer_t * pseudo_header;
 
+    probe->has_valid_checksums = false;
+
     // Update each layers from the (last - 1) one to the first one.
     for (j = 0; j < num_layers; j++) {
         i = num_layers - j - 1;
@@ -204,6 +243,12 @@ bool probe_update_checksum(probe_t * probe)
                         return false;
                     }
 
+                    // Sum the pseudo header without allocating it, if possible
+                    if (layer->protocol->get_pseudo_header_sum && layer->protocol->checksum_offset) {
+                        probe_write_checksum(probe, layer, layer->protocol->get_pseudo_header_sum(layer_prev->segment));
+                        continue;
+                    }
+
                     if (!(pseudo_header = layer->protocol->create_pseudo_header(layer_prev->segment))) {
                         return false;
                     }
@@ -220,10 +265,149 @@ bool probe_update_checksum(probe_t * probe)
             if (pseudo_header) buffer_free(pseudo_header);
         }
     }
+    probe->has_valid_checksums = true;
+    return true;
+}
+
+// Maximum number of bytes that can be rewritten in a row without
+// recomputing the checksums of the probe.
+#define PROBE_REWRITE_MAX_BYTES 64
+
+// Maximum number of checksums updated incrementally in a probe.
+#define PROBE_REWRITE_MAX_CHECKSUMS 4
+
+/**
+ * \brief Sum (in the sense of csum) the 16-bit words of a checksummed
+ *    area overlapped by some bytes.
+ * \param area Address of the area covered by the checksum.
+ * \param area_size The size of this area.
+ * \param offset The offset of the bytes in this area.
+ * \param bytes The bytes, which may differ from those stored in the area.
+ * \param num_bytes The number of bytes. They must fit in the area.
+ * \return The (unfolded) sum of the words containing these bytes.
+ */
+
+static uint32_t csum_window(const uint8_t * area, size_t area_size, size_t offset, const uint8_t * bytes, size_t num_bytes)
+{
+    union {
+        uint8_t  bytes[2];
+        uint16_t word;
+    }        window;
+    uint32_t sum   = 0;
+    size_t   k,
+             begin = offset & ~(size_t) 1,
+             end   = (offset + num_bytes + 1) & ~(size_t) 1;
+
+    // The words are aligned relatively to the beginning of the area, and
+    // the odd trailing byte of the area (if any) is summed as csum does.
+    if (end > area_size) end = area_size;
+    for (k = begin; k < end; k++) {
+        window.bytes[k & 1] = (k >= offset && k < offset + num_bytes) ? bytes[k - offset] : area[k];
+        if (k & 1) sum += window.word;
+        else if (k + 1 == end) sum += window.bytes[0];
+    }
+    return sum;
+}
+
+/**
+ * \brief Update incrementally (RFC 1624) the checksums of a probe once
+ *    some of its bytes have been overwritten.
+ * \param probe The probe, whose checksums were up to date before
+ *    the bytes were overwritten.
+ * \param i The index of the layer containing the overwritten bytes.
+ * \param bytes Address of the overwritten bytes in the packet.
+ * \param old_bytes A copy of the bytes before they were overwritten.
+ * \param num_bytes The number of overwritten bytes (at most
+ *    PROBE_REWRITE_MAX_BYTES).
+ * \return true iif successful. Otherwise, the checksums must be
+ *    recomputed (see probe_update_checksum). This happens if the
+ *    bytes overlap a checksum or partially overlap a checksummed area.
+ */
+
+static bool probe_update_checksum_incremental(probe_t * probe, size_t i, uint8_t * bytes, const uint8_t * old_bytes, size_t num_bytes)
+{
+    size_t          j, area_size, num_checksums = 0, num_layers = probe_get_num_layers(probe);
+    const uint8_t * packet_end = packet_get_bytes(probe->packet) + probe_get_size(probe);
+    const layer_t * layer;
+    uint8_t       * checksum_bytes[PROBE_REWRITE_MAX_CHECKSUMS],
+                  * inner_checksum_bytes = NULL;
+    uint8_t         new_bytes[PROBE_REWRITE_MAX_BYTES];
+    uint16_t        checksums[PROBE_REWRITE_MAX_CHECKSUMS];
+    uint32_t        old_sum, new_sum;
+
+    // The checksums are only written once they have all been computed,
+    // since the probe must be left unchanged if one of them cannot be updated.
+    for (j = num_layers; j-- > 0;) {
+        layer = probe_get_layer(probe, j);
+        if (!layer->protocol || !layer->protocol->write_checksum) continue;
+        if (!layer->protocol->checksum_offset || num_checksums == PROBE_REWRITE_MAX_CHECKSUMS) return false;
+
+        // The segment of a protocol layer is restricted to its header
+        area_size = layer->protocol->get_checksum_size ?
+            layer->protocol->get_checksum_size(layer->segment) :
+            layer->segment_size;
+        if (layer->segment + area_size > packet_end) area_size = packet_end - layer->segment;
+
+        // A checksum covering another one cannot be updated incrementally
+        if (inner_checksum_bytes && inner_checksum_bytes < layer->segment + area_size) return false;
+        inner_checksum_bytes = layer->segment + layer->protocol->checksum_offset;
+
+        // The rewritten bytes must not overlap the checksum, and must be
+        // either inside or outside the checksummed area.
+        if (bytes < inner_checksum_bytes + sizeof(uint16_t) && bytes + num_bytes > inner_checksum_bytes) return false;
+
+        old_sum = new_sum = 0;
+        if (bytes < layer->segment + area_size && bytes + num_bytes > layer->segment) {
+            if (bytes < layer->segment || bytes + num_bytes > layer->segment + area_size) return false;
+            old_sum += csum_window(layer->segment, area_size, bytes - layer->segment, old_bytes, num_bytes);
+            new_sum += csum_window(layer->segment, area_size, bytes - layer->segment, bytes,     num_bytes);
+        }
+
+        // The pseudo header is built upon the previous layer
+        if (j == i + 1 && layer->protocol->create_pseudo_header) {
+            if (!layer->protocol->get_pseudo_header_sum) return false;
+            new_sum += layer->protocol->get_pseudo_header_sum(probe_get_layer(probe, i)->segment);
+            memcpy(new_bytes, bytes, num_bytes);
+            memcpy(bytes, old_bytes, num_bytes);
+            old_sum += layer->protocol->get_pseudo_header_sum(probe_get_layer(probe, i)->segment);
+            memcpy(bytes, new_bytes, num_bytes);
+        }
+
+        if (old_sum == new_sum) continue;
+
+        checksum_bytes[num_checksums] = inner_checksum_bytes;
+        memcpy(&checksums[num_checksums], inner_checksum_bytes, sizeof(uint16_t));
+        checksums[num_checksums] = csum_adjust(checksums[num_checksums], csum_fold(old_sum), csum_fold(new_sum));
+        num_checksums++;
+    }
+
+    for (j = 0; j < num_checksums; j++) {
+        memcpy(checksum_bytes[j], &checksums[j], sizeof(uint16_t));
+    }
+
+#ifdef USE_CHECKSUM_VERIFICATION
+    {
+        packet_t * packet;
+
+        if ((packet = packet_dup(probe->packet))) {
+            probe_update_checksum(probe);
+            if (memcmp(packet_get_bytes(packet), packet_get_bytes(probe->packet), probe_get_size(probe)) != 0) {
+                fprintf(stderr, "probe_update_checksum_incremental: checksum mismatch (layer %zu)\n", i);
+            }
+            packet_free(packet);
+        }
+    }
+#endif
+
     return true;
 }
 
 layer_t * probe_get_layer(const probe_t * probe, size_t i) {
+    // Only the layers discovered so far are stored in probe->layers,
+    // which acts as a cache and may thus be updated through a const probe.
+    if (probe->has_pending_layers && i >= dynarray_get_size(probe->layers)) {
+        probe_dissect((probe_t *) probe, i);
+    }
     return dynarray_get_ith_element(probe->layers, i);
 }
 
@@ -311,6 +495,13 @@ static bool probe_packet_resize(probe_t * probe, size_t size) {
     layer_t * layer;
     uint8_t * segment;
 
+    // The bytes of a probe belonging to a batch cannot be reallocated
+    if (probe->batch) {
+        fprintf(stderr, "probe_packet_resize: this probe belongs to a batch\n");
+        return false;
+    }
+
+    probe->has_valid_checksums = false;
     if (!packet_resize(probe->packet, size)) {
         return false;
     }
@@ -326,7 +517,7 @@ static bool probe_packet_resize(probe_t * probe, size_t size) {
         if (layer->protocol) {
             // We're in a layer related to a protocol. Update "length" field (if any).
             // It concerns: ipv4, ipv6, udp but not tcp, icmpv4, icmpv6
-            layer_set_field_and_free(layer, I16("length", size - offset));
+            layer_set_field(layer, FIELD_I16("length", size - offset));
             offset += layer->segment_size;
         }
     }
@@ -343,7 +534,7 @@ probe_t * probe_create()
     probe_t * probe;
 
     // We calloc probe to set *_time and caller members to 0
-    if (!(probe = calloc(1, sizeof(probe_t))))   goto ERR_PROBE;
+    if (!(probe = pools_calloc(POOL_PROBE)))     goto ERR_PROBE;
     if (!(probe->packet = packet_create())) {
         fprintf(stderr, "Cannot create packet\n");
         goto ERR_PACKET;
@@ -351,6 +542,7 @@ probe_t * probe_create()
     if (!(probe->layers = dynarray_create()))    goto ERR_LAYERS;
 //    if (!(probe->bitfield = bitfield_create(0))) goto ERR_BITFIELD;
     probe_set_left_to_send(probe, 1);
+    probe->num_refs = 1;
     return probe;
 
     /*
@@ -360,7 +552,7 @@ ERR_BITFIELD:
 ERR_LAYERS:
     packet_free(probe->packet);
 ERR_PACKET:
-    free(probe);
+    pool_release(probe);
 ERR_PROBE:
     return NULL;
 }
@@ -377,9 +569,11 @@ probe_t * probe_dup(const probe_t * probe) {
     ret->queueing_time = probe->queueing_time;
     ret->recv_time     = probe->recv_time;
     ret->caller        = probe->caller;
+    ret->timeout       = probe->timeout;
 #ifdef USE_SCHEDULING
     ret->delay         = probe->delay ? field_dup(probe->delay): NULL;
 #endif
+    ret->has_valid_checksums = probe->has_valid_checksums;
     return ret;
 
     /*
@@ -393,14 +587,25 @@ ERR_PACKET_DUP:
     return NULL;
 }
 
+probe_t * probe_ref(probe_t * probe) {
+    probe->num_refs++;
+    return probe;
+}
+
 void probe_free(probe_t * probe) {
-    if (probe) {
+    // The probe is only freed along with its last reference
+    if (!probe || --probe->num_refs > 0) return;
+
+    if (probe->batch) {
+        // The probe is stored in the memory block of its batch
+        probe_batch_release(probe->batch);
+    } else {
 //        bitfield_free(probe->bitfield);
         probe_layers_free(probe);
         if (probe->packet) {
             packet_free(probe->packet);
         }
-        free(probe);
+        pool_release(probe);
     }
 }
 
@@ -476,72 +681,97 @@ static const protocol_t * get_first_protocol(const packet_t * packet) {
     return protocol;
 }
 
-probe_t * probe_wrap_packet(packet_t * packet)
+/**
+ * \brief Dissect the next layer of a probe created by probe_wrap_packet.
+ * \param probe The probe we're dissecting
+ * \return true iif a layer has been discovered
+ */
+
+static bool probe_dissect_layer(probe_t * probe)
 {
-    probe_t          * probe;
-    size_t             segment_size, remaining_size;
+    uint8_t          * bytes = packet_get_bytes(probe->packet);
+    size_t             size = packet_get_size(probe->packet),
+                       num_layers = dynarray_get_size(probe->layers),
+                       offset = 0,
+                       remaining_size,
+                       segment_size;
     layer_t          * layer;
-    uint8_t          * segment;
     const protocol_t * protocol;
 
-    if (!(probe = probe_create())) {
-        goto ERR_PROBE_CREATE;
+    // Resume the dissection right after the last discovered layer
+    if (num_layers == 0) {
+        if (!(protocol = get_first_protocol(probe->packet))) goto ERR_NO_FIRST_PROTOCOL;
+    } else {
+        layer = dynarray_get_ith_element(probe->layers, num_layers - 1);
+        offset = layer->segment - bytes + layer->segment_size;
+        protocol = layer->protocol->get_next_protocol ?
+            layer->protocol->get_next_protocol(layer) :
+            NULL;
     }
+    remaining_size = offset < size ? size - offset : 0;
 
-    // Clear the probe
-    packet_free(probe->packet);
-    probe->packet = packet;
-    probe_layers_clear(probe);
-
-    // Prepare iteration
-    segment = packet_get_bytes(probe->packet);
-    remaining_size = packet_get_size(probe->packet);
-
-    // Push layers
-    for (protocol = get_first_protocol(packet); protocol; protocol = protocol->get_next_protocol(layer)) {
+    if (protocol) {
         if (remaining_size < protocol->write_default_header(NULL)) {
             // Not enough bytes left for the header, packet is truncated
             segment_size = remaining_size;
         } else {
-            segment_size = protocol->get_header_size(segment);
-        }
-
-        if (!(layer = layer_create_from_segment(protocol, segment, segment_size))) {
-            goto ERR_CREATE_LAYER;
+            segment_size = protocol->get_header_size(bytes + offset);
         }
+    } else {
+        // The remaining bytes form the payload, which ends the dissection.
+        // Rq: Some packets (e.g ICMP type 3) do not have payload.
+        // In this case we push an empty payload
+        segment_size = remaining_size;
+        probe->has_pending_layers = false;
+    }
 
-        if (!probe_push_layer(probe, layer)) {
-            goto ERR_PUSH_LAYER;
-        }
+    if (!(layer = layer_create_from_segment(protocol, bytes + offset, segment_size))) {
+        goto ERR_CREATE_LAYER;
+    }
 
-        segment += segment_size;
-        remaining_size -= segment_size;
-        if (remaining_size < 0) {
-            fprintf(stderr, "probe_wrap_packet: Truncated packet\n");
-            goto ERR_TRUNCATED_PACKET;
-        }
+    if (!probe_push_layer(probe, layer)) {
+        goto ERR_PUSH_LAYER;
+    }
 
-        if (!protocol->get_next_protocol) {
-            break;
-        }
-        continue;
+    return true;
 
-ERR_TRUNCATED_PACKET:
 ERR_PUSH_LAYER:
-        layer_free(layer);
+    layer_free(layer);
 ERR_CREATE_LAYER:
-        goto ERR_LAYER_DISCOVER_LAYER;
+ERR_NO_FIRST_PROTOCOL:
+    return false;
+}
+
+static void probe_dissect(probe_t * probe, size_t depth) {
+    while (probe->has_pending_layers && dynarray_get_size(probe->layers) <= depth) {
+        if (!probe_dissect_layer(probe)) {
+            // The remaining bytes cannot be dissected
+            probe->has_pending_layers = false;
+        }
     }
+}
 
-    // Rq: Some packets (e.g ICMP type 3) do not have payload.
-    // In this case we push an empty payload
-    probe_push_payload(probe, remaining_size);
+probe_t * probe_wrap_packet(packet_t * packet)
+{
+    probe_t * probe;
+
+    // Unlike probe_create, no default packet is allocated.
+    // We calloc probe to set *_time and caller members to 0
+    if (!(probe = pools_calloc(POOL_PROBE)))     goto ERR_PROBE;
+    if (!(probe->layers = dynarray_create()))    goto ERR_LAYERS;
+    probe->packet = packet;
+    probe_set_left_to_send(probe, 1);
+    probe->num_refs = 1;
 
+    // The layers are only dissected once they are accessed (see
+    // probe_get_layer), so that a reply which is discarded once its
+    // tag has been read is not entirely dissected.
+    probe->has_pending_layers = true;
     return probe;
 
-ERR_LAYER_DISCOVER_LAYER:
-    probe_free(probe);
-ERR_PROBE_CREATE:
+ERR_LAYERS:
+    pool_release(probe);
+ERR_PROBE:
     return NULL;
 }
 
@@ -550,6 +780,9 @@ ERR_PROBE_CREATE:
 //-----------------------------------------------------------
 
 size_t probe_get_num_layers(const probe_t * probe) {
+    if (probe->has_pending_layers) {
+        probe_dissect((probe_t *) probe, SIZE_MAX);
+    }
     return dynarray_get_size(probe->layers);
 }
 
@@ -581,8 +814,16 @@ bool probe_set_protocols(probe_t * probe, const char * name1, ...)
                      * prev_layer;
     const protocol_t * protocol;
 
+    // The layers of a probe belonging to a batch cannot be reallocated
+    if (probe->batch) {
+        fprintf(stderr, "probe_set_protocols: this probe belongs to a batch\n");
+        return false;
+    }
+
     // Remove the former layer structure
     probe_layers_clear(probe);
+    probe->has_pending_layers  = false;
+    probe->has_valid_checksums = false;
 
     // Set up the new layer structure
     va_start(args, name1);
@@ -616,11 +857,11 @@ bool probe_set_protocols(probe_t * probe, const char * name1, ...)
         // TODO layer_set_mask(layer, bitfield_get_mask(probe->bitfield) + offset);
 
         // Update 'length' field (if any). It concerns IPv* and UDP, but not TCP or ICMPv*
-        layer_set_field_and_free(layer, I16("length", packet_size - offset));
+        layer_set_field(layer, FIELD_I16("length", packet_size - offset));
 
         // Update 'protocol' field of the previous inserted layer (if any)
         if (prev_layer) {
-            if (!layer_set_field_and_free(prev_layer, I8("protocol", layer->protocol->protocol))) {
+            if (!layer_set_field(prev_layer, FIELD_I8("protocol", layer->protocol->protocol))) {
                 fprintf(stderr, "Can't set 'protocol' in %s header\n", layer->protocol->name);
                 goto ERR_SET_PROTOCOL;
             }
@@ -715,6 +956,7 @@ bool probe_write_payload_ext(probe_t * probe, const void * bytes, size_t num_byt
     if (!layer_write_payload_ext(payload_layer, bytes, num_bytes, offset)) {
         goto ERR_LAYER_WRITE_PAYLOAD_EXT;
     }
+    probe->has_valid_checksums = false;
 
     return true;
 
@@ -735,20 +977,132 @@ bool probe_update_fields(probe_t * probe)
         && probe_update_checksum(probe);
 }
 
-bool probe_set_field_ext(probe_t * probe, size_t depth, const field_t * field)
+bool probe_set_field_handle(probe_t * probe, field_handle_t * handle, const field_t * field)
+{
+    layer_t  * layer;
+    uint8_t  * segment;
+    uint16_t   value16;
+    uint32_t   value32;
+
+    if (!(layer = probe_get_layer(probe, handle->layer))
+    ||  !field_handle_resolve(handle, layer->protocol)) {
+        return false;
+    }
+
+    probe->has_valid_checksums = false;
+
+    // Fast path: integers written without any protocol-specific callback.
+    // The segment may not be aligned, hence memcpy.
+    if (!handle->protocol_field->set && field->type == handle->type) {
+        segment = layer->segment + handle->offset;
+        switch (handle->type) {
+            case TYPE_UINT8:
+                *segment = field->value.int8;
+                return true;
+            case TYPE_UINT16:
+                value16 = htons(field->value.int16);
+                memcpy(segment, &value16, sizeof(uint16_t));
+                return true;
+            case TYPE_UINT32:
+                value32 = htonl(field->value.int32);
+                memcpy(segment, &value32, sizeof(uint32_t));
+                return true;
+            default:
+                break;
+        }
+    }
+
+    return layer_set_protocol_field(layer, handle->protocol_field, field);
+}
+
+bool probe_rewrite_field_handle(probe_t * probe, field_handle_t * handle, const field_t * field)
+{
+    layer_t * layer;
+    uint8_t * bytes;
+    uint8_t   old_bytes[PROBE_REWRITE_MAX_BYTES];
+    size_t    num_bytes;
+    bool      has_valid_checksums = probe->has_valid_checksums;
+
+    if (!(layer = probe_get_layer(probe, handle->layer))
+    ||  !field_handle_resolve(handle, layer->protocol)) {
+        return false;
+    }
+
+    // Bytes possibly altered by the update. A set callback may
+    // alter any byte of the header (for instance IPv6 bit fields).
+    if (handle->protocol_field->set) {
+        bytes     = layer->segment;
+        num_bytes = layer->protocol->get_header_size(layer->segment);
+    } else {
+        bytes     = layer->segment + handle->offset;
+#ifdef USE_BITS
+        num_bytes = (handle->offset_in_bits + handle->size_in_bits + 7) / 8;
+#else
+        num_bytes = field_handle_get_size(handle);
+#endif
+    }
+
+    if (!has_valid_checksums || num_bytes > PROBE_REWRITE_MAX_BYTES) {
+        return probe_set_field_handle(probe, handle, field)
+            && probe_update_checksum(probe);
+    }
+
+    memcpy(old_bytes, bytes, num_bytes);
+    if (!probe_set_field_handle(probe, handle, field)) {
+        // The field may have been partially written
+        memcpy(bytes, old_bytes, num_bytes);
+        probe->has_valid_checksums = has_valid_checksums;
+        return false;
+    }
+
+    if (probe_update_checksum_incremental(probe, handle->layer, bytes, old_bytes, num_bytes)) {
+        probe->has_valid_checksums = true;
+        return true;
+    }
+    return probe_update_checksum(probe);
+}
+
+bool probe_rewrite_bytes(probe_t * probe, size_t i, size_t offset, const void * bytes, size_t num_bytes)
 {
-    bool      ret = false;
-    size_t    i, num_layers = probe_get_num_layers(probe);
     layer_t * layer;
+    uint8_t * dst;
+    uint8_t   old_bytes[PROBE_REWRITE_MAX_BYTES];
+
+    if (!(layer = probe_get_layer(probe, i))
+    ||  offset + num_bytes > layer->segment_size) {
+        fprintf(stderr, "probe_rewrite_bytes: invalid range\n");
+        return false;
+    }
+
+    dst = layer->segment + offset;
+    if (!probe->has_valid_checksums || num_bytes > PROBE_REWRITE_MAX_BYTES) {
+        memcpy(dst, bytes, num_bytes);
+        return probe_update_checksum(probe);
+    }
+
+    memcpy(old_bytes, dst, num_bytes);
+    memcpy(dst, bytes, num_bytes);
+    return probe_update_checksum_incremental(probe, i, dst, old_bytes, num_bytes)
+        || probe_update_checksum(probe);
+}
+
+bool probe_set_field_ext(probe_t * probe, size_t depth, const field_t * field)
+{
+    size_t         i, num_layers = probe_get_num_layers(probe);
+    field_handle_t handle;
+
+    if (!field || field->type == TYPE_GENERATOR) {
+        fprintf(stderr, "probe_set_field_ext: invalid field\n");
+        return false;
+    }
 
     for (i = depth; i < num_layers; i++) {
-        layer = probe_get_layer(probe, i);
-        if (layer_set_field(layer, field)) { // TODO: replace by layer_set_field_and_free
-            ret = true;
-            break;
+        field_handle_init(&handle, field->key, i);
+        if (probe_set_field_handle(probe, &handle, field)) {
+            return true;
         }
     }
-    return ret;
+    return false;
 }
 
 bool probe_set_field(probe_t * probe, const field_t * field) {
@@ -764,6 +1118,7 @@ bool probe_write_field_ext(probe_t * probe, size_t depth, const char * name, voi
         layer = probe_get_layer(probe, i);
         if (layer_write_field(layer, name, bytes, num_bytes)) {
             ret = true;
+            probe->has_valid_checksums = false;
             break;
         }
     }
@@ -774,24 +1129,120 @@ bool probe_write_field(probe_t * probe, const char * name, void * bytes, size_t
     return probe_write_field_ext(probe, 0, name, bytes, num_bytes);
 }
 
-bool probe_set_metafield_ext(probe_t * probe, size_t depth, field_t * field)
-{
-    bool          ret = true;
-    field_t     * hacked_field;
+//-----------------------------------------------------------
+// flow_id
+//-----------------------------------------------------------
 
-    // TODO: TEMP HACK IPv4 flow id is encoded in src_port
-    if (strcmp(field->key, "flow_id") != 0) {
-        fprintf(stderr, "probe_set_metafield_ext: cannot set %s\n", field->key);
+// The flow identifier is encoded in the source port (see probe_metafield_to_field)
+#define PROBE_FLOW_ID_SRC_PORT 24000
+
+// Fields encoding the flow identifier, located without string handling
+// in each probe (see probe_get_flow_id_metafield)
+static metafield_t * flow_id_metafield = NULL;
+
+static void probe_flow_id_metafield_free() __attribute__((destructor));
+
+static void probe_flow_id_metafield_free() {
+    metafield_free(flow_id_metafield);
+}
+
+/**
+ * \brief Retrieve the metafield encoding the flow identifier of a probe.
+ *    It is built on the first call, once the protocols are registered.
+ * \return The corresponding metafield_t instance, NULL in case of failure.
+ */
+
+static const metafield_t * probe_get_flow_id_metafield() {
+    metafield_t * metafield;
+    filter_t    * filter;
+
+    if (flow_id_metafield) return flow_id_metafield;
+
+    if (!(metafield = metafield_create("flow_id"))) goto ERR_METAFIELD_CREATE;
+
+    // Flow UDP
+    if (!(filter = filter_create("udp.src_port", NULL)))   goto ERR_FILTER_CREATE;
+    if (!metafield_add_filter(metafield, filter))          goto ERR_ADD_FILTER;
+
+    // Flow TCP
+    if (!(filter = filter_create("tcp.src_port", NULL)))   goto ERR_FILTER_CREATE;
+    if (!metafield_add_filter(metafield, filter))          goto ERR_ADD_FILTER;
+
+    return (flow_id_metafield = metafield);
+
+ERR_ADD_FILTER:
+    filter_free(filter);
+ERR_FILTER_CREATE:
+    metafield_free(metafield);
+ERR_METAFIELD_CREATE:
+    return NULL;
+}
+
+/**
+ * \brief Locate the flow identifier in a probe.
+ * \param probe A probe_t instance.
+ * \param op The filter_op_t instance set if successful.
+ * \return true iif successful.
+ */
+
+static bool probe_locate_flow_id(const probe_t * probe, filter_op_t * op) {
+    const metafield_t * metafield;
+    filter_op_t         ops[FILTER_MAX_FIELDS];
+
+    if (!(metafield = probe_get_flow_id_metafield())
+    ||  !metafield_compile(metafield, probe, ops)
+    ||  ops[0].offset_in_bits % 8
+    ||  ops[0].size_in_bits != 8 * sizeof(uint16_t)) {
         return false;
     }
+    *op = ops[0];
+    return true;
+}
 
-    // We add 24000 to use port to increase chances to traverse firewalls
-    if ((hacked_field = I16("src_port", 24000 + field->value.int16))) {
-        ret = probe_set_field(probe, hacked_field);
-        field_free(hacked_field);
+bool probe_extract_flow_id(const probe_t * probe, uint16_t * flow_id) {
+    filter_op_t op;
+    uint16_t    src_port;
+
+    if (!probe_locate_flow_id(probe, &op)) return false;
+
+    // We substract 24000 to the port (see probe_metafield_to_field)
+    memcpy(&src_port, probe_get_layer(probe, op.layer)->segment + op.offset_in_bits / 8, sizeof(uint16_t));
+    *flow_id = ntohs(src_port) - PROBE_FLOW_ID_SRC_PORT;
+    return true;
+}
+
+bool probe_rewrite_flow_id(probe_t * probe, uint16_t flow_id) {
+    filter_op_t op;
+    uint16_t    src_port = htons(PROBE_FLOW_ID_SRC_PORT + flow_id);
+
+    return probe_locate_flow_id(probe, &op)
+        && probe_rewrite_bytes(probe, op.layer, op.offset_in_bits / 8, &src_port, sizeof(uint16_t));
+}
+
+/**
+ * \brief Translate a metafield into the field encoding it.
+ * \param metafield The metafield (only "flow_id" is supported).
+ * \param field The field to initialize (see field_init_uint8).
+ * \return The initialized field if successful, NULL otherwise.
+ */
+
+static field_t * probe_metafield_to_field(const field_t * metafield, field_t * field) {
+    // TODO: TEMP HACK IPv4 flow id is encoded in src_port
+    if (strcmp(metafield->key, "flow_id") != 0) {
+        fprintf(stderr, "probe_set_metafield_ext: cannot set %s\n", metafield->key);
+        return NULL;
     }
 
-    return ret;
+    // We add 24000 to use port to increase chances to traverse firewalls
+    return field_init_uint16(field, "src_port", PROBE_FLOW_ID_SRC_PORT + metafield->value.int16);
+}
+
+bool probe_set_metafield_ext(probe_t * probe, size_t depth, field_t * field)
+{
+    field_t hacked_field;
+
+    return probe_metafield_to_field(field, &hacked_field)
+        && probe_set_field(probe, &hacked_field);
 
     /*
     metafield = metafield_search(field->key);
@@ -809,16 +1260,15 @@ bool probe_set_metafield(probe_t * probe, field_t * field) {
 // Internal use
 static field_t * probe_create_metafield_ext(const probe_t * probe, const char * name, size_t depth)
 {
-    uint16_t src_port;
+    uint16_t flow_id;
 
     // TODO to generalize to any metafield
     if (strcmp(name, "flow_id") != 0) return NULL;
 
     // TODO We've hardcoded the flow-id in the src_port and we only support the "flow_id" metafield
     // In IPv6, flow_id should be set thanks to probe_set_field
-    // We substract 24000 to the port (see probe_set_metafield_ext)
-    return probe_extract(probe, "src_port", &src_port) ?
-        IMAX("flow_id", src_port - 24000) :
+    return probe_extract_flow_id(probe, &flow_id) ?
+        IMAX("flow_id", flow_id) :
         NULL;
 }
 
@@ -848,6 +1298,104 @@ bool probe_set_fields(probe_t * probe, field_t * field1, ...) {
     return ret;
 }
 
+/**
+ * \brief Set a field in the first layer carrying it, otherwise the
+ *    corresponding metafield.
+ * \param probe The probe we're updating.
+ * \param field The field assigned to the probe. It is not freed.
+ * \return true iif successful.
+ */
+
+static bool probe_set_value(probe_t * probe, const field_t * field) {
+    field_t hacked_field;
+
+    if (!field) return false;
+    return probe_set_field(probe, field)
+        || (probe_metafield_to_field(field, &hacked_field) && probe_set_field(probe, &hacked_field));
+}
+
+bool probe_set_field_values(probe_t * probe, const field_t * field1, ...) {
+    va_list         args;
+    const field_t * field;
+    bool            ret = true;
+
+    va_start(args, field1);
+    for (field = field1; field; field = va_arg(args, const field_t *)) {
+        if (!probe_set_value(probe, field)) {
+            fprintf(stderr, "probe_set_field_values: Cannot set field '%s'\n", field->key);
+            ret = false;
+        }
+    }
+    va_end(args);
+    probe_update_fields(probe);
+
+    return ret;
+}
+
+bool probe_set_uint8(probe_t * probe, const char * name, uint8_t value) {
+    field_t field;
+    return probe_set_value(probe, field_init_uint8(&field, name, value));
+}
+
+bool probe_set_uint16(probe_t * probe, const char * name, uint16_t value) {
+    field_t field;
+    return probe_set_value(probe, field_init_uint16(&field, name, value));
+}
+
+bool probe_set_uint32(probe_t * probe, const char * name, uint32_t value) {
+    field_t field;
+    return probe_set_value(probe, field_init_uint32(&field, name, value));
+}
+
+bool probe_set_address(probe_t * probe, const char * name, const address_t * address) {
+    field_t field;
+    return probe_set_value(probe, field_init_address(&field, name, address));
+}
+
+/**
+ * \brief Set a field in the first layer carrying it and update the
+ *    checksums of the probe (see probe_rewrite_field_handle).
+ * \param probe The probe we're updating.
+ * \param field The field assigned to the probe.
+ * \return true iif successful.
+ */
+
+static bool probe_rewrite_field(probe_t * probe, const field_t * field)
+{
+    size_t         i, num_layers = probe_get_num_layers(probe);
+    field_handle_t handle;
+
+    if (!field || field->type == TYPE_GENERATOR) return false;
+
+    for (i = 0; i < num_layers; i++) {
+        field_handle_init(&handle, field->key, i);
+        if (field_handle_resolve(&handle, probe_get_layer(probe, i)->protocol)) {
+            return probe_rewrite_field_handle(probe, &handle, field);
+        }
+    }
+    return false;
+}
+
+bool probe_rewrite_fields(probe_t * probe, const field_t * field1, ...) {
+    va_list         args;
+    const field_t * field;
+    field_t         hacked_field;
+    bool            ret = true;
+
+    va_start(args, field1);
+    for (field = field1; field; field = va_arg(args, const field_t *)) {
+        // Update the first matching field, otherwise the first matching metafield
+        if (!probe_rewrite_field(probe, field)
+        &&  !(probe_metafield_to_field(field, &hacked_field) && probe_rewrite_flow_id(probe, field->value.int16))) {
+            fprintf(stderr, "probe_rewrite_fields: Cannot set field '%s'\n", field->key);
+            ret = false;
+        }
+    }
+    va_end(args);
+
+    return ret;
+}
+
 void probe_set_caller(probe_t * probe, void * caller) {
     probe->caller = caller;
 }
@@ -880,6 +1428,14 @@ double probe_get_recv_time(const probe_t * probe) {
     return probe->recv_time;
 }
 
+void probe_set_timeout(probe_t * probe, double timeout) {
+    probe->timeout = timeout;
+}
+
+double probe_get_timeout(const probe_t * probe) {
+    return probe->timeout;
+}
+
 #ifdef USE_SCHEDULING
 bool probe_set_delay(probe_t * probe, field_t * delay)
 {
@@ -995,37 +1551,71 @@ field_t * probe_create_field(const probe_t * probe, const char * name) {
     return probe_create_field_ext(probe, name, 0);
 }
 
-bool probe_extract_ext(const probe_t * probe, const char * name, size_t depth, void * value) {
-    size_t                   i, num_layers = probe_get_num_layers(probe);
-    const layer_t          * layer;
-    const protocol_field_t * protocol_field;
+bool probe_extract_handle(const probe_t * probe, field_handle_t * handle, void * value) {
+    const layer_t * layer;
+    const uint8_t * segment;
+    uint16_t        value16;
+    uint32_t        value32;
 
-    // We go through the layers until we get the required field
-    for(i = depth; i < num_layers; i++) {
-        layer = probe_get_layer(probe, i);
-        if (!(protocol_field = layer_get_protocol_field(layer, name))) continue;
+    if (!(layer = probe_get_layer(probe, handle->layer))
+    ||  !field_handle_resolve(handle, layer->protocol)) {
+        return false;
+    }
 
-        // Hack to convert ipv*_t extracted into address_t value.
-        switch (protocol_field->type) {
-#ifdef USE_IPV4
-            case TYPE_IPV4:
-                memset(value, 0, sizeof(address_t));
-                ((address_t *) value)->family = AF_INET;
-                value = &((address_t *) value)->ip.ipv4;
+    segment = layer->segment + handle->offset;
+
+    // Fast path: integers read without any protocol-specific callback.
+    // Neither the segment nor value may be aligned, hence memcpy.
+    if (!handle->protocol_field->get) {
+        switch (handle->type) {
+            case TYPE_UINT8:
+                *(uint8_t *) value = *segment;
+                return true;
+            case TYPE_UINT16:
+                memcpy(&value16, segment, sizeof(uint16_t));
+                value16 = ntohs(value16);
+                memcpy(value, &value16, sizeof(uint16_t));
+                return true;
+            case TYPE_UINT32:
+                memcpy(&value32, segment, sizeof(uint32_t));
+                value32 = ntohl(value32);
+                memcpy(value, &value32, sizeof(uint32_t));
+                return true;
+            default:
                 break;
+        }
+    }
+
+    // Hack to convert ipv*_t extracted into address_t value.
+    switch (handle->type) {
+#ifdef USE_IPV4
+        case TYPE_IPV4:
+            memset(value, 0, sizeof(address_t));
+            ((address_t *) value)->family = AF_INET;
+            value = &((address_t *) value)->ip.ipv4;
+            break;
 #endif
 #ifdef USE_IPV6
-            case TYPE_IPV6:
-                memset(value, 0, sizeof(address_t));
-                ((address_t *) value)->family = AF_INET6;
-                value = &((address_t *) value)->ip.ipv6;
-                break;
+        case TYPE_IPV6:
+            memset(value, 0, sizeof(address_t));
+            ((address_t *) value)->family = AF_INET6;
+            value = &((address_t *) value)->ip.ipv6;
+            break;
 #endif
-            default: break;
-        }
+        default: break;
+    }
+
+    return layer_extract_protocol_field(layer, handle->protocol_field, value);
+}
 
-        if ((layer = probe_get_layer(probe, i))
-        &&   layer_extract(layer, name, value)) {
+bool probe_extract_ext(const probe_t * probe, const char * name, size_t depth, void * value) {
+    size_t         i, num_layers = probe_get_num_layers(probe);
+    field_handle_t handle;
+
+    // We go through the layers until we get the required field
+    for (i = depth; i < num_layers; i++) {
+        field_handle_init(&handle, name, i);
+        if (probe_extract_handle(probe, &handle, value)) {
             return true;
         }
     }
@@ -1034,16 +1624,9 @@ bool probe_extract_ext(const probe_t * probe, const char * name, size_t depth, v
 }
 
 bool probe_extract(const probe_t * probe, const char * name, void * dst) {
-    field_t * flow_id_field;
-
     // TEMPORARY HACK TO MANAGE flow_id metafield
     if (!strcmp(name, "flow_id")) {
-        if ((flow_id_field = probe_create_metafield(probe, "flow_id")) != NULL) {
-            memcpy(dst, &flow_id_field->value.int16, sizeof(uint16_t));
-            field_free(flow_id_field);
-            return true;
-        }
-        return false;
+        return probe_extract_flow_id(probe, dst);
     }
 
     return probe_extract_ext(probe, name, 0, dst);
@@ -1072,20 +1655,24 @@ ERR_EXTRACT_DST_IP:
 //---------------------------------------------------------------------------
 
 probe_reply_t * probe_reply_create() {
-    return calloc(1, sizeof(probe_reply_t));
-}
+    probe_reply_t * probe_reply;
 
-void probe_reply_free(probe_reply_t * probe_reply) {
-    if (probe_reply) {
-        free(probe_reply);
+    if ((probe_reply = pools_calloc(POOL_PROBE_REPLY))) {
+        probe_reply->num_refs = 1;
     }
+    return probe_reply;
+}
+
+probe_reply_t * probe_reply_ref(probe_reply_t * probe_reply) {
+    probe_reply->num_refs++;
+    return probe_reply;
 }
 
-void probe_reply_deep_free(probe_reply_t * probe_reply) {
-    if (probe_reply) {
-        if (probe_reply->probe) probe_free(probe_reply->probe);
-        if (probe_reply->reply) probe_free(probe_reply->reply);
-        probe_reply_free(probe_reply);
+void probe_reply_free(probe_reply_t * probe_reply) {
+    if (probe_reply && --probe_reply->num_refs == 0) {
+        probe_free(probe_reply->probe);
+        probe_free(probe_reply->reply);
+        pool_release(probe_reply);
     }
 }
 
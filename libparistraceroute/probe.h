@@ -10,13 +10,17 @@
 #include <stddef.h>    // size_t
 
 #include "field.h"     // field_t
+#include "field_handle.h" // field_handle_t
 #include "layer.h"     // layer_t
 //#include "bitfield.h"
 #include "dynarray.h"  // dynarray_t
 #include "packet.h"    // packet_t
+#include "timing_wheel.h" // timing_wheel_node_t
 #include "use.h"
 
 #define DELAY_BEST_EFFORT -1 // This MUST be < 0, see network_send_probe
+
+struct probe_batch_s;
 /**
  * \struct probe_t
  * \brief Structure representing a probe
@@ -34,10 +38,16 @@ typedef struct {
     double       sending_time;  /**< Timestamp set by network layer just after sending the packet (0 if not set) (in micro seconds) */
     double       queueing_time; /**< Timestamp set by pt_loop just before sending the packet (0 if not set) (in micro seconds) */
     double       recv_time;     /**< Only set if this instance is related to a reply. Timestamp set by network layer just after sniffing the reply */
+    double       timeout;       /**< Time to wait for a reply (in seconds). 0 means the default timeout of the algorithm or of the network layer */
+    timing_wheel_node_t timer;  /**< Set by the network layer to schedule the expiration of this probe */
 #ifdef USE_SCHEDULING
     field_t    * delay;         /**< The time to send this probe */
 #endif
     size_t       left_to_send;  /**< Number of times left to use this probe instance to send packets */
+    bool         has_valid_checksums; /**< True iif the checksums are up to date (see probe_update_checksum) and may be updated incrementally */
+    bool         has_pending_layers;  /**< True iif some layers of the packet have not yet been dissected (see probe_wrap_packet) */
+    struct probe_batch_s * batch; /**< Batch whose memory block stores this probe (see probe_batch.h), NULL if allocated on its own */
+    size_t       num_refs;      /**< Number of references to this probe (see probe_ref) */
 } probe_t;
 
 /**
@@ -55,7 +65,21 @@ probe_t * probe_create();
 probe_t * probe_dup(const probe_t * probe_skel);
 
 /**
- * \brief Free a probe
+ * \brief Take an additional reference to a probe, so that it can be
+ *    shared (e.g. by an event and an algorithm) instead of being
+ *    duplicated. References are not synchronized: a probe must only
+ *    be shared by the thread running its loop.
+ * \param probe A pointer to a probe_t structure containing the probe
+ * \return The probe.
+ */
+
+probe_t * probe_ref(probe_t * probe);
+
+/**
+ * \brief Release a reference to a probe. The probe is freed along with
+ *    its last reference. If the probe belongs to a batch, its memory is
+ *    released along with the batch, once every probe of the batch has
+ *    been freed (see probe_batch.h).
  * \param probe A pointer to a probe_t structure containing the probe
  */
 
@@ -71,7 +95,9 @@ size_t probe_get_size(const probe_t * probe);
 
 /**
  * \brief Create a probe_t according to a packet_t instance.
- *   The previous value of probe->packet (if any) is not freed.
+ *   The layers of the packet are dissected lazily, the first time
+ *   a layer at a given depth is accessed (see probe_get_layer).
+ * \param packet The wrapped packet. It is released along with the probe.
  * \return A pointer to a newly allocated probe_t instance if
  *   if successful, NULL otherwise.
  */
@@ -124,6 +150,46 @@ bool probe_set_field_ext(probe_t * probe, size_t depth, const field_t * field);
 
 bool probe_set_field(probe_t * probe, const field_t * field);
 
+/**
+ * \brief Set a field identified by a handle. Unlike probe_set_field,
+ *    only the layer designated by the handle is considered.
+ * \param probe The probe we're updating.
+ * \param handle The handle of the updated field. It is (re)resolved
+ *    if needed, so it must not be shared between threads.
+ * \param field The field assigned to the probe. Its key is ignored.
+ * \return true iif successfull
+ */
+
+bool probe_set_field_handle(probe_t * probe, field_handle_t * handle, const field_t * field);
+
+/**
+ * \brief Set a field identified by a handle and update the checksums
+ *    of the probe accordingly. If the checksums of the probe were up to
+ *    date, they are updated incrementally (RFC 1624) instead of being
+ *    recomputed over the whole packet.
+ * \param probe The probe we're updating.
+ * \param handle The handle of the updated field (see probe_set_field_handle).
+ * \param field The field assigned to the probe. Its key is ignored.
+ * \return true iif successfull
+ */
+
+bool probe_rewrite_field_handle(probe_t * probe, field_handle_t * handle, const field_t * field);
+
+/**
+ * \brief Overwrite some bytes of a layer and update the checksums
+ *    of the probe accordingly (see probe_rewrite_field_handle).
+ *    The size of the probe and the layout of its layers remain unchanged.
+ * \param probe The probe we're updating.
+ * \param i The index of the layer (0 corresponds to the first layer).
+ * \param offset The offset of the overwritten bytes in the segment of this layer.
+ * \param bytes The bytes copied in the probe.
+ * \param num_bytes The number of bytes to copy. They must fit in the
+ *    segment of this layer.
+ * \return true iif successfull
+ */
+
+bool probe_rewrite_bytes(probe_t * probe, size_t i, size_t offset, const void * bytes, size_t num_bytes);
+
 
 bool probe_write_field_ext(probe_t * probe, size_t depth, const char * name, void * bytes, size_t num_bytes);
 bool probe_write_field(probe_t * probe, const char * name, void * bytes, size_t num_bytes);
@@ -155,6 +221,77 @@ bool probe_update_fields(probe_t * probe);
 
 bool probe_set_fields(probe_t * probe, field_t * field1, ...);
 
+/**
+ * \brief Assigns a set of fields to a probe. Unlike probe_set_fields,
+ *    the fields are not freed, so they may be allocated on the stack
+ *    (see FIELD_I8, FIELD_I16, FIELD_I32, FIELD_ADDRESS). For instance:
+ *    probe_set_field_values(probe, FIELD_I8("ttl", ttl), NULL);
+ * \param probe A pointer to a probe_t structure representing the probe
+ * \param field1 The first of a list of pointers to a field_t structure
+ *    representing a field to add. The list is terminated by NULL.
+ * \return true iif successful.
+ */
+
+bool probe_set_field_values(probe_t * probe, const field_t * field1, ...);
+
+/**
+ * \brief Assigns a set of fields to a probe whose layout is already
+ *    up to date, and update its checksums (see probe_rewrite_field_handle).
+ *    Unlike probe_set_fields, the 'length' and 'protocol' fields
+ *    are not updated, and the fields are not freed (see
+ *    probe_set_field_values).
+ * \param probe A pointer to a probe_t structure representing the probe
+ * \param field1 The first of a list of pointers to a field_t structure
+ *    representing a field to add. The list is terminated by NULL.
+ * \return true iif successful.
+ */
+
+bool probe_rewrite_fields(probe_t * probe, const field_t * field1, ...);
+
+/**
+ * \brief Set a 8 bit integer field (or metafield) of a probe without
+ *    allocating any field_t instance (see probe_set_field).
+ * \param probe The probe we're updating
+ * \param name The name of the field
+ * \param value The value of the field (host-side endianness)
+ * \return true iif successful
+ */
+
+bool probe_set_uint8(probe_t * probe, const char * name, uint8_t value);
+
+/**
+ * \brief Set a 16 bit integer field (or metafield) of a probe
+ *    (see probe_set_uint8).
+ * \param probe The probe we're updating
+ * \param name The name of the field
+ * \param value The value of the field (host-side endianness)
+ * \return true iif successful
+ */
+
+bool probe_set_uint16(probe_t * probe, const char * name, uint16_t value);
+
+/**
+ * \brief Set a 32 bit integer field (or metafield) of a probe
+ *    (see probe_set_uint8).
+ * \param probe The probe we're updating
+ * \param name The name of the field
+ * \param value The value of the field (host-side endianness)
+ * \return true iif successful
+ */
+
+bool probe_set_uint32(probe_t * probe, const char * name, uint32_t value);
+
+/**
+ * \brief Set an address field of a probe (see probe_set_uint8).
+ * \param probe The probe we're updating
+ * \param name The name of the field (for instance "src_ip", "dst_ip")
+ * \param address The address. Its family must match the one of the
+ *    IP layer of the probe.
+ * \return true iif successful
+ */
+
+bool probe_set_address(probe_t * probe, const char * name, const address_t * address);
+
 /**
  * \brief Assigns a set of fields to a probe
  * \param probe A pointer to a probe_t structure representing the probe
@@ -200,6 +337,39 @@ bool probe_extract(const probe_t * probe, const char * name, void * dst);
 // TODO depth should be 2nd parameter
 bool probe_extract_ext(const probe_t * probe, const char * name, size_t depth, void * dst);
 
+/**
+ * \brief Extract a value from a field identified by a handle. Unlike
+ *    probe_extract, only the layer designated by the handle is considered.
+ * \param probe The probe from which we're retrieving a field.
+ * \param handle The handle of the queried field. It is (re)resolved
+ *    if needed, so it must not be shared between threads.
+ * \param dst The place where the value is written (an address_t
+ *    for IP addresses). Acts as scanf.
+ * \return true iif successful.
+ */
+
+bool probe_extract_handle(const probe_t * probe, field_handle_t * handle, void * dst);
+
+/**
+ * \brief Extract the flow identifier ("flow_id" metafield) of a probe.
+ *    The fields encoding it are located without any string handling.
+ * \param probe The probe from which we're retrieving the flow identifier.
+ * \param flow_id The place where the flow identifier is written.
+ * \return true iif successful.
+ */
+
+bool probe_extract_flow_id(const probe_t * probe, uint16_t * flow_id);
+
+/**
+ * \brief Set the flow identifier ("flow_id" metafield) of a probe and
+ *    update its checksums (see probe_rewrite_fields).
+ * \param probe The probe we're updating.
+ * \param flow_id The flow identifier.
+ * \return true iif successful.
+ */
+
+bool probe_rewrite_flow_id(probe_t * probe, uint16_t flow_id);
+
 /**
  * \brief Allocate a field based on probe contents according to a given field name.
  * \param probe The probe from which we're retrieving a field.
@@ -323,6 +493,16 @@ void probe_set_recv_time(probe_t * probe, double time);
 
 double probe_get_recv_time(const probe_t * probe);
 
+/**
+ * \brief Set how long the network layer waits for a reply to a probe.
+ * \param probe A probe_t instance.
+ * \param timeout The timeout (in seconds), 0 to use the default timeout.
+ */
+
+void probe_set_timeout(probe_t * probe, double timeout);
+
+double probe_get_timeout(const probe_t * probe);
+
 bool probe_set_delay(probe_t * probe, field_t * delay);
 
 /**
@@ -370,14 +550,41 @@ packet_t * probe_create_packet(probe_t * probe);
 // probe_reply_t
 //---------------------------------------------------------------------------
 
+/**
+ * \struct probe_reply_t
+ * \brief Structure pairing a probe with its reply. It owns a reference
+ *    to both of them, which are released along with its last reference.
+ */
+
 typedef struct {
-    probe_t * probe;
-    probe_t * reply;
+    probe_t * probe;    /**< The probe */
+    probe_t * reply;    /**< The reply provoked by this probe */
+    size_t    num_refs; /**< Number of references to this pair (see probe_reply_ref) */
 } probe_reply_t;
 
+/**
+ * \brief Create an empty (probe, reply) pair. The caller holds the
+ *    only reference to this pair.
+ * \return The newly allocated pair if successful, NULL otherwise.
+ */
+
 probe_reply_t * probe_reply_create();
+
+/**
+ * \brief Take an additional reference to a (probe, reply) pair.
+ * \param probe_reply A probe_reply_t instance.
+ * \return The pair.
+ */
+
+probe_reply_t * probe_reply_ref(probe_reply_t * probe_reply);
+
+/**
+ * \brief Release a reference to a (probe, reply) pair. Along with its
+ *    last reference, the pair releases its probe and its reply.
+ * \param probe_reply A probe_reply_t instance.
+ */
+
 void probe_reply_free(probe_reply_t * probe_reply);
-void probe_reply_deep_free(probe_reply_t * probe_reply);
 
 // Accessors
 
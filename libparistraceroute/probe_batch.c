@@ -0,0 +1,157 @@
+#include "config.h"
+
+#include <stdlib.h>         // malloc, free
+#include <string.h>         // memcpy, memset
+
+#include "probe_batch.h"
+#include "buffer.h"         // buffer_t
+
+// Alignment of the chunks carved out of the memory block of a batch
+#define PROBE_BATCH_ALIGN(size) (((size) + 15) & ~((size_t) 15))
+
+/**
+ * \brief Release the memory block of a batch.
+ * \param probe_batch A probe_batch_t instance.
+ * \param num_probes The number of probes initialized in this block.
+ */
+
+static void probe_batch_release_block(probe_batch_t * probe_batch, size_t num_probes) {
+#ifdef USE_SCHEDULING
+    size_t i;
+
+    for (i = 0; i < num_probes; i++) {
+        if (probe_batch->probes[i]->delay) field_free(probe_batch->probes[i]->delay);
+    }
+#endif
+    free(probe_batch);
+}
+
+probe_batch_t * probe_batch_create(
+    const probe_template_t * probe_template,
+    size_t                   num_probes,
+    probe_mutator_t          mutator,
+    void                   * data
+) {
+    const probe_t * skel = probe_template->skel;
+    size_t          num_layers = probe_template->num_layers,
+                    size = packet_get_size(skel->packet),
+                    header_size, probe_size, i, j;
+    probe_batch_t * probe_batch;
+    probe_t       * probe;
+    uint8_t       * chunk;
+    layer_t      ** layers;
+    layer_t       * layer;
+
+    if (num_probes == 0) goto ERR_INVALID_NUM_PROBES;
+
+    // Layout of the block: the batch, the address of each probe, then the
+    // probe_t structure of each probe followed by its packet, its layers
+    // and its bytes.
+    header_size = PROBE_BATCH_ALIGN(sizeof(probe_batch_t))
+        + PROBE_BATCH_ALIGN(num_probes * sizeof(probe_t *));
+    probe_size = PROBE_BATCH_ALIGN(sizeof(probe_t))
+        + PROBE_BATCH_ALIGN(sizeof(packet_t))
+        + PROBE_BATCH_ALIGN(sizeof(buffer_t))
+        + PROBE_BATCH_ALIGN(sizeof(address_t))
+        + PROBE_BATCH_ALIGN(sizeof(dynarray_t))
+        + PROBE_BATCH_ALIGN(num_layers * sizeof(layer_t *))
+        + PROBE_BATCH_ALIGN(num_layers * sizeof(layer_t))
+        + PROBE_BATCH_ALIGN(size);
+
+    if (!(probe_batch = malloc(header_size + num_probes * probe_size))) goto ERR_MALLOC;
+    probe_batch->probes     = (probe_t **) ((uint8_t *) probe_batch + PROBE_BATCH_ALIGN(sizeof(probe_batch_t)));
+    probe_batch->num_probes = num_probes;
+    probe_batch->num_refs   = num_probes;
+
+    chunk = (uint8_t *) probe_batch + header_size;
+    for (i = 0; i < num_probes; i++) {
+        // Same initialization as probe_template_clone
+        probe = (probe_t *) chunk;
+        memset(probe, 0, sizeof(probe_t));
+        chunk += PROBE_BATCH_ALIGN(sizeof(probe_t));
+
+        probe->packet = (packet_t *) chunk;
+        chunk += PROBE_BATCH_ALIGN(sizeof(packet_t));
+        probe->packet->buffer = (buffer_t *) chunk;
+        chunk += PROBE_BATCH_ALIGN(sizeof(buffer_t));
+        probe->packet->dst_ip = (address_t *) chunk;
+        memcpy(probe->packet->dst_ip, skel->packet->dst_ip, sizeof(address_t));
+        chunk += PROBE_BATCH_ALIGN(sizeof(address_t));
+
+        probe->layers = (dynarray_t *) chunk;
+        chunk += PROBE_BATCH_ALIGN(sizeof(dynarray_t));
+        layers = (layer_t **) chunk;
+        chunk += PROBE_BATCH_ALIGN(num_layers * sizeof(layer_t *));
+        layer = (layer_t *) chunk;
+        chunk += PROBE_BATCH_ALIGN(num_layers * sizeof(layer_t));
+
+        probe->packet->buffer->data = chunk;
+        probe->packet->buffer->size = size;
+        memcpy(chunk, packet_get_bytes(skel->packet), size);
+        chunk += PROBE_BATCH_ALIGN(size);
+
+        // Instantiate the layers from the compiled layout
+        for (j = 0; j < num_layers; j++) {
+            layer[j].protocol     = probe_template->layers[j].protocol;
+            layer[j].segment      = probe->packet->buffer->data + probe_template->layers[j].offset;
+            layer[j].mask         = NULL;
+            layer[j].segment_size = probe_template->layers[j].segment_size;
+            layers[j] = &layer[j];
+        }
+        probe->layers->elements = (void **) layers;
+        probe->layers->size     = num_layers;
+        probe->layers->max_size = num_layers;
+        probe->layers->arena    = NULL;
+
+        probe->sending_time  = skel->sending_time;
+        probe->queueing_time = skel->queueing_time;
+        probe->recv_time     = skel->recv_time;
+        probe->caller        = skel->caller;
+        probe->timeout       = skel->timeout;
+        probe->has_valid_checksums = skel->has_valid_checksums;
+        probe->batch         = probe_batch;
+        probe->num_refs      = 1;
+        probe_set_left_to_send(probe, 1);
+        probe_batch->probes[i] = probe;
+
+#ifdef USE_SCHEDULING
+        if (skel->delay && !(probe->delay = field_dup(skel->delay))) goto ERR_FIELD_DUP;
+#endif
+        if (mutator && !mutator(probe, i, data)) {
+            i++;
+            goto ERR_MUTATOR;
+        }
+    }
+
+    return probe_batch;
+
+ERR_MUTATOR:
+#ifdef USE_SCHEDULING
+ERR_FIELD_DUP:
+#endif
+    probe_batch_release_block(probe_batch, i);
+ERR_MALLOC:
+ERR_INVALID_NUM_PROBES:
+    return NULL;
+}
+
+void probe_batch_free(probe_batch_t * probe_batch) {
+    if (probe_batch) {
+        probe_batch_release_block(probe_batch, probe_batch->num_probes);
+    }
+}
+
+void probe_batch_release(probe_batch_t * probe_batch) {
+    // The probes of a batch may be released by distinct threads
+    if (__atomic_sub_fetch(&probe_batch->num_refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        probe_batch_free(probe_batch);
+    }
+}
+
+inline size_t probe_batch_get_num_probes(const probe_batch_t * probe_batch) {
+    return probe_batch->num_probes;
+}
+
+inline probe_t * probe_batch_get_probe(const probe_batch_t * probe_batch, size_t i) {
+    return probe_batch->probes[i];
+}
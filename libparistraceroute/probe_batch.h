@@ -0,0 +1,103 @@
+#ifndef LIBPT_PROBE_BATCH_H
+#define LIBPT_PROBE_BATCH_H
+
+/**
+ * \file probe_batch.h
+ * \brief Header file: probes cloned in bulk from a probe template.
+ *
+ * A probe_batch_t clones a compiled skeleton (see probe_template.h)
+ * several times into a single memory block: the probe_t structures,
+ * their packets, their layers and their bytes are carved out of this
+ * block instead of being allocated one by one. A callback (the mutator)
+ * alters each probe once it has been cloned (TTL, flow identifier,
+ * destination, ...).
+ *
+ * Each probe of a batch holds a reference to its batch. probe_free()
+ * releases this reference, and the whole block is released once every
+ * probe of the batch has been released. As their memory is shared, the
+ * probes of a batch can be altered in place (see probe_set_field,
+ * probe_rewrite_fields), but they can neither be resized nor have their
+ * layers changed (see probe_payload_resize, probe_set_protocols).
+ */
+
+#include <stdbool.h>        // bool
+#include <stddef.h>         // size_t
+
+#include "probe.h"          // probe_t
+#include "probe_template.h" // probe_template_t
+
+/**
+ * \brief Callback used to alter each probe of a batch.
+ * \param probe The probe to alter.
+ * \param i The index of this probe in the batch.
+ * \param data The data passed to probe_batch_create.
+ * \return true iif successful.
+ */
+
+typedef bool (* probe_mutator_t)(probe_t * probe, size_t i, void * data);
+
+/**
+ * \struct probe_batch_t
+ * \brief Probes cloned in a single memory block.
+ */
+
+typedef struct probe_batch_s {
+    probe_t ** probes;     /**< Address of each probe of the batch */
+    size_t     num_probes; /**< Number of probes in the batch */
+    size_t     num_refs;   /**< Number of probes not yet released (see probe_free) */
+} probe_batch_t;
+
+/**
+ * \brief Clone a probe template several times in a single memory block.
+ * \param probe_template The compiled skeleton.
+ * \param num_probes The number of probes to create (at least 1).
+ * \param mutator Function called back to alter each probe once
+ *    cloned (NULL if the probes must remain unchanged).
+ * \param data Data passed to the mutator.
+ * \return The newly created batch if successful, NULL otherwise
+ *    (in particular if the mutator fails).
+ */
+
+probe_batch_t * probe_batch_create(
+    const probe_template_t * probe_template,
+    size_t                   num_probes,
+    probe_mutator_t          mutator,
+    void                   * data
+);
+
+/**
+ * \brief Release every probe of a batch, and thus the batch itself.
+ *    It must only be called if the probes have not been released
+ *    individually (see probe_free).
+ * \param probe_batch A probe_batch_t instance.
+ */
+
+void probe_batch_free(probe_batch_t * probe_batch);
+
+/**
+ * \brief Release the reference held by a probe of a batch. This function
+ *    is called by probe_free, and the batch is freed once every of its
+ *    probes has been released.
+ * \param probe_batch A probe_batch_t instance.
+ */
+
+void probe_batch_release(probe_batch_t * probe_batch);
+
+/**
+ * \brief Retrieve the number of probes of a batch.
+ * \param probe_batch A probe_batch_t instance.
+ * \return The corresponding number of probes.
+ */
+
+size_t probe_batch_get_num_probes(const probe_batch_t * probe_batch);
+
+/**
+ * \brief Retrieve a probe of a batch.
+ * \param probe_batch A probe_batch_t instance.
+ * \param i The index of the probe (lower than probe_batch_get_num_probes).
+ * \return The corresponding probe.
+ */
+
+probe_t * probe_batch_get_probe(const probe_batch_t * probe_batch, size_t i);
+
+#endif // LIBPT_PROBE_BATCH_H
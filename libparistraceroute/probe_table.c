@@ -0,0 +1,200 @@
+#include "config.h"
+
+#include <stdlib.h>         // malloc, calloc, free
+#include <stdio.h>          // printf
+
+#include "probe_table.h"
+
+#define PROBE_TABLE_SLOTS_BITS   7 // 128 slots
+
+//---------------------------------------------------------------------------
+// Private functions
+//---------------------------------------------------------------------------
+
+/**
+ * \brief Compute the home slot of a tag (Fibonacci hashing).
+ * \param table A probe_table_t instance.
+ * \param tag A tag.
+ * \return The index of the slot.
+ */
+
+static inline size_t probe_table_hash(const probe_table_t * table, uint32_t tag) {
+    return (uint32_t) (tag * 2654435761u) >> (32 - table->slots_bits);
+}
+
+/**
+ * \brief Find the slot indexing a given tag.
+ * \param table A probe_table_t instance.
+ * \param tag The searched tag.
+ * \return The index of the slot if found, table->num_slots otherwise.
+ */
+
+static size_t probe_table_find_slot(const probe_table_t * table, uint32_t tag) {
+    size_t mask = table->num_slots - 1,
+           i    = probe_table_hash(table, tag);
+
+    for (; table->slots[i].probe; i = (i + 1) & mask) {
+        if (table->slots[i].tag == tag) return i;
+    }
+    return table->num_slots;
+}
+
+/**
+ * \brief Index a tag in the hash table. The tag must not be already indexed
+ *   and there must be at least one free slot.
+ * \param table A probe_table_t instance.
+ * \param tag The tag.
+ * \param probe The probe carrying this tag.
+ */
+
+static void probe_table_insert_slot(probe_table_t * table, uint32_t tag, probe_t * probe) {
+    size_t mask = table->num_slots - 1,
+           i    = probe_table_hash(table, tag);
+
+    while (table->slots[i].probe) i = (i + 1) & mask;
+    table->slots[i].tag   = tag;
+    table->slots[i].probe = probe;
+}
+
+/**
+ * \brief Free a slot of the hash table. The following slots of the
+ *   cluster are shifted backward so that no tombstone is needed.
+ * \param table A probe_table_t instance.
+ * \param i The index of the slot to free.
+ */
+
+static void probe_table_del_slot(probe_table_t * table, size_t i) {
+    size_t mask = table->num_slots - 1, j, k;
+
+    for (j = (i + 1) & mask; table->slots[j].probe; j = (j + 1) & mask) {
+        k = probe_table_hash(table, table->slots[j].tag);
+
+        // Move slots[j] in i if its home slot k is not cyclically in ]i, j]
+        if ((i <= j) ? (k <= i || k > j) : (k <= i && k > j)) {
+            table->slots[i] = table->slots[j];
+            i = j;
+        }
+    }
+    table->slots[i].probe = NULL;
+}
+
+/**
+ * \brief Double the number of slots of the hash table.
+ * \param table A probe_table_t instance.
+ * \return true iif successful.
+ */
+
+static bool probe_table_grow_slots(probe_table_t * table) {
+    probe_table_slot_t * slots = table->slots;
+    size_t               i, num_slots = table->num_slots;
+
+    if (!(table->slots = calloc(2 * num_slots, sizeof(probe_table_slot_t)))) {
+        table->slots = slots;
+        return false;
+    }
+
+    table->num_slots = 2 * num_slots;
+    table->slots_bits++;
+    for (i = 0; i < num_slots; i++) {
+        if (slots[i].probe) {
+            probe_table_insert_slot(table, slots[i].tag, slots[i].probe);
+        }
+    }
+    free(slots);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Public functions
+//---------------------------------------------------------------------------
+
+probe_table_t * probe_table_create()
+{
+    probe_table_t * table;
+
+    if (!(table = malloc(sizeof(probe_table_t)))) goto ERR_MALLOC;
+    if (!(table->slots = calloc(1 << PROBE_TABLE_SLOTS_BITS, sizeof(probe_table_slot_t)))) goto ERR_SLOTS;
+
+    table->num_slots   = 1 << PROBE_TABLE_SLOTS_BITS;
+    table->slots_bits  = PROBE_TABLE_SLOTS_BITS;
+    table->num_probes  = 0;
+    return table;
+
+ERR_SLOTS:
+    free(table);
+ERR_MALLOC:
+    return NULL;
+}
+
+void probe_table_free(probe_table_t * table, void (*element_free)(void * element))
+{
+    size_t i;
+
+    if (table) {
+        if (element_free) {
+            for (i = 0; i < table->num_slots; i++) {
+                if (table->slots[i].probe) {
+                    element_free(table->slots[i].probe);
+                }
+            }
+        }
+        free(table->slots);
+        free(table);
+    }
+}
+
+bool probe_table_push(probe_table_t * table, uint32_t tag, probe_t * probe)
+{
+    if (probe_table_find_slot(table, tag) != table->num_slots) {
+        fprintf(stderr, "probe_table_push: tag 0x%x is already in use\n", tag);
+        goto ERR_TAG_IN_USE;
+    }
+
+    // Keep the load factor of the hash table under 1/2
+    if (2 * (table->num_probes + 1) > table->num_slots) {
+        if (!probe_table_grow_slots(table)) goto ERR_GROW_SLOTS;
+    }
+
+    probe_table_insert_slot(table, tag, probe);
+    table->num_probes++;
+    return true;
+
+ERR_GROW_SLOTS:
+ERR_TAG_IN_USE:
+    return false;
+}
+
+probe_t * probe_table_get(const probe_table_t * table, uint32_t tag)
+{
+    size_t i = probe_table_find_slot(table, tag);
+
+    return i == table->num_slots ? NULL : table->slots[i].probe;
+}
+
+probe_t * probe_table_pop(probe_table_t * table, uint32_t tag)
+{
+    size_t    i = probe_table_find_slot(table, tag);
+    probe_t * probe;
+
+    if (i == table->num_slots) return NULL;
+    probe = table->slots[i].probe;
+    probe_table_del_slot(table, i);
+    table->num_probes--;
+    return probe;
+}
+
+size_t probe_table_get_size(const probe_table_t * table) {
+    return table ? table->num_probes : 0;
+}
+
+void probe_table_dump(const probe_table_t * table)
+{
+    size_t i;
+
+    printf("\n%u flying probe(s) :\n", (unsigned int) probe_table_get_size(table));
+    for (i = 0; i < table->num_slots; i++) {
+        if (table->slots[i].probe) {
+            printf(" 0x%x\n", table->slots[i].tag);
+        }
+    }
+}
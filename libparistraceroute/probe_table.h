@@ -0,0 +1,104 @@
+#ifndef LIBPT_PROBE_TABLE_H
+#define LIBPT_PROBE_TABLE_H
+
+/**
+ * \file probe_table.h
+ * \brief Header file: table of flying probes.
+ *
+ * probe_table_t stores the probes in transit handled by the network layer.
+ * Probes are indexed by their tag (see network_tag_probe) in an open
+ * addressing hash table, so that matching a reply costs O(1) whatever the
+ * number of flying probes. The deadlines of the flying probes are handled
+ * separately (see timing_wheel.h).
+ */
+
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint32_t
+#include <stdbool.h> // bool
+
+#include "probe.h"   // probe_t
+
+/**
+ * \struct probe_table_slot_t
+ * \brief A slot of the hash table indexing the flying probes by tag.
+ */
+
+typedef struct {
+    uint32_t   tag;   /**< The tag of the indexed probe */
+    probe_t  * probe; /**< The indexed probe (NULL if the slot is free) */
+} probe_table_slot_t;
+
+/**
+ * \struct probe_table_t
+ * \brief Structure describing a table of flying probes.
+ */
+
+typedef struct {
+    probe_table_slot_t  * slots;       /**< Hash table: tag -> probe */
+    size_t                num_slots;   /**< Number of slots (a power of 2) */
+    unsigned              slots_bits;  /**< log2(num_slots) */
+    size_t                num_probes;  /**< Number of probes stored in the table */
+} probe_table_t;
+
+/**
+ * \brief Create an empty probe table.
+ * \return The newly allocated probe table if successful, NULL otherwise.
+ */
+
+probe_table_t * probe_table_create();
+
+/**
+ * \brief Release a probe table from the memory.
+ * \param table A probe_table_t instance.
+ * \param element_free Function called on each probe still stored in the
+ *    table (may be NULL).
+ */
+
+void probe_table_free(probe_table_t * table, void (*element_free)(void * element));
+
+/**
+ * \brief Register a probe which has just been sent.
+ * \param table A probe_table_t instance.
+ * \param tag The tag of this probe. It must not be used by another probe
+ *    stored in the table.
+ * \param probe The probe.
+ * \return true iif successful.
+ */
+
+bool probe_table_push(probe_table_t * table, uint32_t tag, probe_t * probe);
+
+/**
+ * \brief Retrieve the probe having a given tag.
+ * \param table A probe_table_t instance.
+ * \param tag The searched tag.
+ * \return The corresponding probe if any, NULL otherwise.
+ */
+
+probe_t * probe_table_get(const probe_table_t * table, uint32_t tag);
+
+/**
+ * \brief Remove from the table the probe having a given tag.
+ * \param table A probe_table_t instance.
+ * \param tag The searched tag.
+ * \return The removed probe if any, NULL otherwise.
+ */
+
+probe_t * probe_table_pop(probe_table_t * table, uint32_t tag);
+
+/**
+ * \brief Retrieve the number of probes stored in the table.
+ * \param table A probe_table_t instance.
+ * \return The number of probes.
+ */
+
+size_t probe_table_get_size(const probe_table_t * table);
+
+/**
+ * \brief Print the tags of the probes stored in the table
+ *   (in no particular order).
+ * \param table A probe_table_t instance.
+ */
+
+void probe_table_dump(const probe_table_t * table);
+
+#endif // LIBPT_PROBE_TABLE_H
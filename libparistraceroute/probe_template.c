@@ -0,0 +1,112 @@
+#include "config.h"
+
+#include <stdlib.h>         // malloc, calloc, free
+
+#include "probe_template.h"
+#include "common.h"         // ELEMENT_FREE
+#include "layer.h"          // layer_create_from_segment
+#include "pool.h"           // pools_calloc, pool_release
+
+probe_template_t * probe_template_create(const probe_t * probe)
+{
+    probe_template_t * probe_template;
+    const layer_t    * layer;
+    const uint8_t    * bytes;
+    size_t             i;
+
+    if (!(probe_template = malloc(sizeof(probe_template_t)))) goto ERR_MALLOC;
+
+    // Parse the skeleton once, as probe_dup does for each duplicated probe
+    if (!(probe_template->skel = probe_dup(probe)))          goto ERR_PROBE_DUP;
+
+    // Finalize the skeleton once, so that the cloned probes are well-formed
+    // and only need an incremental checksum update once altered.
+    if (!probe_update_fields(probe_template->skel))          goto ERR_PROBE_UPDATE_FIELDS;
+
+    probe_template->num_layers = probe_get_num_layers(probe_template->skel);
+    if (!(probe_template->layers = calloc(probe_template->num_layers, sizeof(probe_template_layer_t)))) {
+        goto ERR_LAYERS;
+    }
+
+    bytes = packet_get_bytes(probe_template->skel->packet);
+    for (i = 0; i < probe_template->num_layers; i++) {
+        layer = probe_get_layer(probe_template->skel, i);
+        probe_template->layers[i].protocol     = layer->protocol;
+        probe_template->layers[i].offset       = layer->segment - bytes;
+        probe_template->layers[i].segment_size = layer->segment_size;
+    }
+
+    return probe_template;
+
+ERR_LAYERS:
+ERR_PROBE_UPDATE_FIELDS:
+    probe_free(probe_template->skel);
+ERR_PROBE_DUP:
+    free(probe_template);
+ERR_MALLOC:
+    return NULL;
+}
+
+void probe_template_free(probe_template_t * probe_template) {
+    if (probe_template) {
+        probe_free(probe_template->skel);
+        free(probe_template->layers);
+        free(probe_template);
+    }
+}
+
+inline const probe_t * probe_template_get_skel(const probe_template_t * probe_template) {
+    return probe_template->skel;
+}
+
+probe_t * probe_template_clone(const probe_template_t * probe_template)
+{
+    const probe_t * skel = probe_template->skel;
+    probe_t       * probe;
+    layer_t       * layer;
+    uint8_t       * bytes;
+    size_t          i;
+
+    // We calloc probe to set *_time and caller members to 0
+    if (!(probe = pools_calloc(POOL_PROBE)))          goto ERR_PROBE;
+    if (!(probe->packet = packet_dup(skel->packet)))  goto ERR_PACKET_DUP;
+    if (!(probe->layers = dynarray_create()))         goto ERR_LAYERS;
+
+    // Instantiate the layers from the compiled layout
+    bytes = packet_get_bytes(probe->packet);
+    for (i = 0; i < probe_template->num_layers; i++) {
+        layer = layer_create_from_segment(
+            probe_template->layers[i].protocol,
+            bytes + probe_template->layers[i].offset,
+            probe_template->layers[i].segment_size
+        );
+        if (!layer) goto ERR_CREATE_LAYER;
+        if (!dynarray_push_element(probe->layers, layer)) {
+            layer_free(layer);
+            goto ERR_PUSH_LAYER;
+        }
+    }
+
+    probe->sending_time  = skel->sending_time;
+    probe->queueing_time = skel->queueing_time;
+    probe->recv_time     = skel->recv_time;
+    probe->caller        = skel->caller;
+    probe->timeout       = skel->timeout;
+    probe->has_valid_checksums = skel->has_valid_checksums;
+#ifdef USE_SCHEDULING
+    probe->delay         = skel->delay ? field_dup(skel->delay) : NULL;
+#endif
+    probe_set_left_to_send(probe, 1);
+    probe->num_refs = 1;
+    return probe;
+
+ERR_PUSH_LAYER:
+ERR_CREATE_LAYER:
+    dynarray_free(probe->layers, (ELEMENT_FREE) layer_free);
+ERR_LAYERS:
+    packet_free(probe->packet);
+ERR_PACKET_DUP:
+    pool_release(probe);
+ERR_PROBE:
+    return NULL;
+}
@@ -0,0 +1,80 @@
+#ifndef LIBPT_PROBE_TEMPLATE_H
+#define LIBPT_PROBE_TEMPLATE_H
+
+/**
+ * \file probe_template.h
+ * \brief Header file: compiled probe skeletons.
+ *
+ * probe_dup() re-discovers the layers of the duplicated probe by parsing
+ * its packet. A probe_template_t parses a probe skeleton once and stores
+ * its layout (protocol, offset and size of each layer), so that cloning
+ * the skeleton only copies its bytes and instantiates the layers from
+ * this layout. The 'length', 'protocol' and 'checksum' fields of the
+ * skeleton are updated once when it is compiled, so that the fields of a
+ * cloned probe may be rewritten with an incremental checksum update (see
+ * probe_rewrite_field_handle). A template is immutable: if the skeleton is
+ * altered, a new template must be created.
+ */
+
+#include <stddef.h>    // size_t
+
+#include "probe.h"     // probe_t
+#include "protocol.h"  // protocol_t
+
+/**
+ * \struct probe_template_layer_t
+ * \brief Layout of a layer of a compiled probe.
+ */
+
+typedef struct {
+    const protocol_t * protocol;     /**< Protocol of this layer (NULL for the payload) */
+    size_t             offset;       /**< Offset of the segment of this layer in the packet */
+    size_t             segment_size; /**< Size of the segment of this layer */
+} probe_template_layer_t;
+
+/**
+ * \struct probe_template_t
+ * \brief A compiled probe skeleton.
+ */
+
+typedef struct {
+    probe_t                * skel;       /**< Private copy of the skeleton */
+    probe_template_layer_t * layers;     /**< Layout of each layer of the skeleton */
+    size_t                   num_layers; /**< Number of layers */
+} probe_template_t;
+
+/**
+ * \brief Compile a probe skeleton.
+ * \param probe The probe skeleton. It is copied, so it may be
+ *    altered or freed once the template is created.
+ * \return The newly created template if successful, NULL otherwise.
+ */
+
+probe_template_t * probe_template_create(const probe_t * probe);
+
+/**
+ * \brief Release a probe template from the memory. The probes
+ *    cloned from this template are not affected.
+ * \param probe_template A probe_template_t instance.
+ */
+
+void probe_template_free(probe_template_t * probe_template);
+
+/**
+ * \brief Retrieve the skeleton compiled in a template.
+ * \param probe_template A probe_template_t instance.
+ * \return The corresponding skeleton (it must not be altered).
+ */
+
+const probe_t * probe_template_get_skel(const probe_template_t * probe_template);
+
+/**
+ * \brief Create a probe from a template. The resulting probe is
+ *    the same as probe_dup(skel), where skel is the compiled skeleton.
+ * \param probe_template A probe_template_t instance.
+ * \return The newly created probe if successful, NULL otherwise.
+ */
+
+probe_t * probe_template_clone(const probe_template_t * probe_template);
+
+#endif // LIBPT_PROBE_TEMPLATE_H
@@ -88,22 +88,6 @@ void protocol_iter_fields(
     }
 }
 
-uint16_t csum(const uint16_t * bytes, size_t size) {
-    // Adapted from http://www.netpatch.ru/windows-files/pingscan/raw_ping.c.html
-    uint32_t sum = 0;
-
-    while (size > 1) {
-        sum += *bytes++;
-        size -= sizeof(uint16_t);
-    }
-    if (size) {
-        sum += * (const uint8_t *) bytes;
-    }
-    sum  = (sum >> 16) + (sum & 0xffff);
-    sum += (sum >> 16);
-    return (uint16_t) ~sum;
-}
-
 static inline void callback_protocol_field_dump(const protocol_field_t * protocol_field, void * data) {
     protocol_field_dump(protocol_field);
 }
@@ -10,6 +10,7 @@
 
 #include "protocol_field.h"
 #include "buffer.h"
+#include "checksum.h"
 
 #define END_PROTOCOL_FIELDS { .key = NULL }
 
@@ -58,6 +59,35 @@ typedef struct protocol_s {
 
     buffer_t * (*create_pseudo_header)(const uint8_t * segment);
 
+    /**
+     * \brief Points to a callback which computes the sum of the pseudo
+     *    header needed to compute the checksum of a segment of this protocol,
+     *    without allocating it. Set iif create_pseudo_header is set.
+     * \param segment The address of the previous segment (see create_pseudo_header).
+     * \return The folded sum of the pseudo header (see csum_fold).
+     */
+
+    uint16_t (*get_pseudo_header_sum)(const uint8_t * segment);
+
+    /**
+     * \brief Points to a callback which returns the number of bytes covered
+     *    by the checksum of a segment of this protocol (the pseudo header
+     *    excluded). If NULL, the checksum only covers the header.
+     * \param segment The address of the segment.
+     * \return The number of bytes covered by the checksum.
+     */
+
+    size_t (*get_checksum_size)(const uint8_t * segment);
+
+    /**
+     * Offset (in bytes) of the checksum in the header. It allows to update
+     * the checksum incrementally (see probe_rewrite_field_handle) without
+     * looking up the "checksum" field. 0 if the checksum cannot be updated
+     * incrementally.
+     */
+
+    size_t checksum_offset;
+
     /**
      * Pointer to a protocol_field_t structure holding the header fields
      */
@@ -161,15 +191,6 @@ void protocol_iter_fields(const protocol_t * protocol, void * data, void (*callb
 
 const protocol_field_t * protocol_get_field(const protocol_t * protocol, const char * name);
 
-/**
- * \brief Calculate an Internet checksum.
- * \param bytes Bytes used to compute the checksum
- * \param size Number of bytes to consider
- * \return The corresponding checksum
- */
-
-uint16_t csum(const uint16_t * buf, size_t size);
-
 /**
  * \brief Print information stored in a protocol instance
  * \param protocol A protocol_t instance
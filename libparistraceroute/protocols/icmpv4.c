@@ -183,6 +183,7 @@ static protocol_t icmpv4 = {
     .name                 = "icmpv4",
     .protocol             = IPPROTO_ICMP,
     .write_checksum       = icmpv4_write_checksum,
+    .checksum_offset      = offsetof(struct icmphdr, ICMPV4_CHECKSUM),
     .fields               = icmpv4_fields,
     .write_default_header = icmpv4_write_default_header, // TODO generic
     .get_header_size      = icmpv4_get_header_size,
@@ -181,6 +181,8 @@ static protocol_t icmpv6 = {
     .protocol             = IPPROTO_ICMPV6,
     .write_checksum       = icmpv6_write_checksum,
     .create_pseudo_header = ipv6_pseudo_header_create,
+    .get_pseudo_header_sum = ipv6_pseudo_header_sum,
+    .checksum_offset      = offsetof(struct icmp6_hdr, icmp6_cksum),
     .fields               = icmpv6_fields,
     .write_default_header = icmpv6_write_default_header, // TODO generic memcpy + header size
     .get_header_size      = icmpv6_get_header_size,
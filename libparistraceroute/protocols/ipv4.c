@@ -300,6 +300,7 @@ static protocol_t ipv4 = {
     .protocol             = IPPROTO_IPIP, // XXX only IP over IP (encapsulation). Beware probe.c, icmpv4_get_next_protocol_id
     .write_checksum       = ipv4_write_checksum,
     .create_pseudo_header = NULL,
+    .checksum_offset      = offsetof(struct iphdr, check),
     .fields               = ipv4_fields,
     .write_default_header = ipv4_write_default_header, // TODO generic
     .get_header_size      = ipv4_get_header_size,
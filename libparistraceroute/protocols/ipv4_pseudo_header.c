@@ -5,16 +5,17 @@
 
 #include "os/netinet/ip.h"    // ip_hdr
 #include <arpa/inet.h>        // htons
+#include "../checksum.h"      // csum_partial, csum_fold
 
-buffer_t * ipv4_pseudo_header_create(const uint8_t * ipv4_segment)
+/**
+ * \brief Initialize an IPv4 pseudo header according to an IPv4 header.
+ * \param ipv4_segment Address of the IPv4 segment
+ * \param ipv4_pseudo_header The pseudo header to initialize
+ */
+
+static void ipv4_pseudo_header_init(const uint8_t * ipv4_segment, ipv4_pseudo_header_t * ipv4_pseudo_header)
 {
     const struct iphdr * ip_hdr = (const struct iphdr *) ipv4_segment;
-    buffer_t           * ipv4_psh;
-    ipv4_pseudo_header_t ipv4_pseudo_header; // TODO we should directly points to ipv4_psh's bytes to avoid one copy
-
-    if (!(ipv4_psh = buffer_create())) {
-        goto ERR_BUFFER_CREATE;
-    }
 
     // Deduce the size of the UDP segment (header + data) according to the IP header
     // - size of the IP segment: ip_hdr->tot_len
@@ -22,11 +23,23 @@ buffer_t * ipv4_pseudo_header_create(const uint8_t * ipv4_segment)
     size_t size = htons(ntohs(ip_hdr->tot_len) - 4 * ip_hdr->ihl);
 
     // Initialize the pseudo header
-    ipv4_pseudo_header.ip_src   = ip_hdr->saddr;
-    ipv4_pseudo_header.ip_dst   = ip_hdr->daddr;
-    ipv4_pseudo_header.zero     = 0;
-    ipv4_pseudo_header.protocol = ip_hdr->protocol;
-    ipv4_pseudo_header.size     = size;
+    ipv4_pseudo_header->ip_src   = ip_hdr->saddr;
+    ipv4_pseudo_header->ip_dst   = ip_hdr->daddr;
+    ipv4_pseudo_header->zero     = 0;
+    ipv4_pseudo_header->protocol = ip_hdr->protocol;
+    ipv4_pseudo_header->size     = size;
+}
+
+buffer_t * ipv4_pseudo_header_create(const uint8_t * ipv4_segment)
+{
+    buffer_t           * ipv4_psh;
+    ipv4_pseudo_header_t ipv4_pseudo_header; // TODO we should directly points to ipv4_psh's bytes to avoid one copy
+
+    if (!(ipv4_psh = buffer_create())) {
+        goto ERR_BUFFER_CREATE;
+    }
+
+    ipv4_pseudo_header_init(ipv4_segment, &ipv4_pseudo_header);
 
     // Prepare and return the corresponding buffer
     if (!buffer_write_bytes(ipv4_psh, (uint8_t *) &ipv4_pseudo_header, sizeof(ipv4_pseudo_header_t))) {
@@ -41,5 +54,13 @@ ERR_BUFFER_CREATE:
     return NULL;
 }
 
+uint16_t ipv4_pseudo_header_sum(const uint8_t * ipv4_segment)
+{
+    ipv4_pseudo_header_t ipv4_pseudo_header;
+
+    ipv4_pseudo_header_init(ipv4_segment, &ipv4_pseudo_header);
+    return csum_fold(csum_partial(&ipv4_pseudo_header, sizeof(ipv4_pseudo_header_t), 0));
+}
+
 #endif // USE_IPV4
 
@@ -27,6 +27,14 @@ typedef struct {
 
 buffer_t * ipv4_pseudo_header_create(const uint8_t * ipv4_segment);
 
+/**
+ * \brief Compute the sum of an IPv4 pseudo header without allocating it.
+ * \param ipv4_segment Address of the IPv4 segment
+ * \return The folded sum of the corresponding pseudo header (see csum_fold)
+ */
+
+uint16_t ipv4_pseudo_header_sum(const uint8_t * ipv4_segment);
+
 #endif // USE_IPV4
 
 #endif // LIBPT_PROTOCOLS_IPV4_PSEUDO_HEADER_H
@@ -10,22 +10,18 @@
 
 #include <stdio.h>
 #include "buffer.h"
+#include "../checksum.h"      // csum_partial, csum_fold
 
-buffer_t * ipv6_pseudo_header_create(const uint8_t * ipv6_segment)
+/**
+ * \brief Initialize an IPv6 pseudo header according to an IPv6 header.
+ * \param ipv6_segment Address of the IPv6 segment
+ * \param data The pseudo header to initialize
+ */
+
+static void ipv6_pseudo_header_init(const uint8_t * ipv6_segment, ipv6_pseudo_header_t * data)
 {
-    buffer_t             * psh;
     const struct ip6_hdr * iph = (const struct ip6_hdr *) ipv6_segment;
-    ipv6_pseudo_header_t * data;
 
-    if (!(psh = buffer_create())) {
-        goto ERR_BUFFER_CREATE;
-    }
-
-    if (!(buffer_resize(psh, sizeof(ipv6_pseudo_header_t)))) {
-        goto ERR_BUFFER_RESIZE;
-    }
-
-    data = (ipv6_pseudo_header_t *) buffer_get_data(psh);
     memcpy((uint8_t *) data + offsetof(ipv6_pseudo_header_t, ip_src), &iph->ip6_src, sizeof(ipv6_t));
     memcpy((uint8_t *) data + offsetof(ipv6_pseudo_header_t, ip_dst), &iph->ip6_dst, sizeof(ipv6_t));
 
@@ -35,7 +31,21 @@ buffer_t * ipv6_pseudo_header_create(const uint8_t * ipv6_segment)
     data->zeros = 0;
     data->zero  = 0;
     data->protocol = iph->ip6_ctlun.ip6_un1.ip6_un1_nxt;
+}
+
+buffer_t * ipv6_pseudo_header_create(const uint8_t * ipv6_segment)
+{
+    buffer_t * psh;
 
+    if (!(psh = buffer_create())) {
+        goto ERR_BUFFER_CREATE;
+    }
+
+    if (!(buffer_resize(psh, sizeof(ipv6_pseudo_header_t)))) {
+        goto ERR_BUFFER_RESIZE;
+    }
+
+    ipv6_pseudo_header_init(ipv6_segment, (ipv6_pseudo_header_t *) buffer_get_data(psh));
     return psh;
 
 ERR_BUFFER_RESIZE:
@@ -44,4 +54,12 @@ ERR_BUFFER_CREATE:
     return NULL;
 }
 
+uint16_t ipv6_pseudo_header_sum(const uint8_t * ipv6_segment)
+{
+    ipv6_pseudo_header_t data;
+
+    ipv6_pseudo_header_init(ipv6_segment, &data);
+    return csum_fold(csum_partial(&data, sizeof(ipv6_pseudo_header_t), 0));
+}
+
 #endif // USE_IPV6
@@ -29,6 +29,14 @@ typedef struct {
 
 buffer_t * ipv6_pseudo_header_create(const uint8_t * ipv6_segment);
 
+/**
+ * \brief Compute the sum of an IPv6 pseudo header without allocating it.
+ * \param ipv6_segment Address of the IPv6 segment
+ * \return The folded sum of the corresponding pseudo header (see csum_fold)
+ */
+
+uint16_t ipv6_pseudo_header_sum(const uint8_t * ipv6_segment);
+
 #endif // USE_IPV6
 
 #endif // LIBPT_PROTOCOLS_IPV6_PSEUDO_HEADER_H
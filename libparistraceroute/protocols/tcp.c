@@ -342,6 +342,39 @@ buffer_t * tcp_create_pseudo_header(const uint8_t * ip_segment)
     return buffer;
 }
 
+uint16_t tcp_get_pseudo_header_sum(const uint8_t * ip_segment)
+{
+    uint16_t sum = 0;
+
+    switch (ip_segment[0] >> 4) {
+#ifdef USE_IPV4
+        case 4:
+            sum = ipv4_pseudo_header_sum(ip_segment);
+            break;
+#endif
+#ifdef USE_IPV6
+        case 6:
+            sum = ipv6_pseudo_header_sum(ip_segment);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    return sum;
+}
+
+/**
+ * \brief Retrieve the number of bytes covered by the TCP checksum
+ *    (see tcp_write_checksum).
+ * \param tcp_segment Points to the begining of the TCP header.
+ * \return The size of the TCP header and of its (hardcoded) payload.
+ */
+
+size_t tcp_get_checksum_size(const uint8_t * tcp_segment) {
+    return tcp_get_header_size(tcp_segment) + 2;
+}
+
 /**
  * \brief check whether the tcp protocols of 2 probes match
  * \param _probe the probe to analyse
@@ -385,6 +418,9 @@ static protocol_t tcp = {
     .protocol             = IPPROTO_TCP,
     .write_checksum       = tcp_write_checksum,
     .create_pseudo_header = tcp_create_pseudo_header,
+    .get_pseudo_header_sum = tcp_get_pseudo_header_sum,
+    .get_checksum_size    = tcp_get_checksum_size,
+    .checksum_offset      = offsetof(struct tcphdr, CHECKSUM),
     .fields               = tcp_fields,
   //.defaults             = tcp_defaults,             // XXX used when generic
     .write_default_header = tcp_write_default_header, // TODO generic
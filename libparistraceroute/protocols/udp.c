@@ -178,6 +178,38 @@ buffer_t * udp_create_pseudo_header(const uint8_t * ip_segment)
     return buffer;
 }
 
+uint16_t udp_get_pseudo_header_sum(const uint8_t * ip_segment)
+{
+    uint16_t sum = 0;
+
+    switch (ip_segment[0] >> 4) {
+#ifdef USE_IPV4
+        case 4:
+            sum = ipv4_pseudo_header_sum(ip_segment);
+            break;
+#endif
+#ifdef USE_IPV6
+        case 6:
+            sum = ipv6_pseudo_header_sum(ip_segment);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    return sum;
+}
+
+/**
+ * \brief Retrieve the number of bytes covered by the UDP checksum.
+ * \param udp_segment Points to the begining of the UDP header.
+ * \return The size of the UDP header and its content.
+ */
+
+size_t udp_get_checksum_size(const uint8_t * udp_segment) {
+    return ntohs(((const struct udphdr *) udp_segment)->LENGTH);
+}
+
 /**
  * \brief check whether the udp protocols of 2 probes match
  * \param _probe the probe to analyse
@@ -222,6 +254,9 @@ static protocol_t udp = {
     .protocol             = IPPROTO_UDP,
     .write_checksum       = udp_write_checksum,
     .create_pseudo_header = udp_create_pseudo_header,
+    .get_pseudo_header_sum = udp_get_pseudo_header_sum,
+    .get_checksum_size    = udp_get_checksum_size,
+    .checksum_offset      = offsetof(struct udphdr, CHECKSUM),
     .fields               = udp_fields,
   //.defaults             = udp_defaults,             // XXX used when generic
     .write_default_header = udp_write_default_header, // TODO generic
@@ -21,18 +21,18 @@
 
 #define MAXEVENTS 100
 
-static pt_loop_t * s_loop = NULL; // Needed while we use twalk.
-
 //---------------------------------------------------------------------------
 // pt_loop options
 //---------------------------------------------------------------------------
 
 //static int    timeout[4]     = {180,    0,   UINT16_MAX, 1};
 static double timeout[3] = OPTIONS_PT_LOOP_TIMEOUT;
+static int    no_pools   = 0;
 
 static option_t pt_loop_options[] = {
-    // action              short long          metavar    help    variable
-    {opt_store_double_lim, "t",  "--timeout",  "TIMEOUT", HELP_t, timeout},
+    // action              short      long          metavar         help           variable
+    {opt_store_double_lim, "t",       "--timeout",  "TIMEOUT",      HELP_t,        timeout},
+    {opt_store_1,          OPT_NO_SF, "--no-pools", OPT_NO_METAVAR, HELP_no_pools, &no_pools},
     END_OPT_SPECS
 };
 
@@ -44,30 +44,41 @@ double options_pt_loop_get_timeout() {
     return timeout[0];
 }
 
+bool options_pt_loop_get_pools() {
+    return !no_pools;
+}
+
 void options_pt_loop_init(pt_loop_t * loop) {
     pt_loop_set_timeout(loop, options_pt_loop_get_timeout());
+    pt_loop_set_pools_enabled(loop, options_pt_loop_get_pools());
 }
 
 void pt_loop_set_timeout(pt_loop_t * loop, double new_timeout) {
     loop->timeout = new_timeout;
 }
 
+void pt_loop_set_pools_enabled(pt_loop_t * loop, bool is_enabled) {
+    pools_set_enabled(loop->pools, is_enabled);
+}
+
 //----------------------------------------------------------------
 // Static functions
 //----------------------------------------------------------------
 
 /**
- * \brief process algorithm events (internal usage, see visitor for twalk)
- * \param node Current instance
- * \param visit Unused
- * \param level Unused
+ * \brief Process the pending events of an algorithm instance (internal usage).
+ * \param instance The algorithm instance.
  */
 
-static void pt_process_instance(
-    const void * node,
-    VISIT        visit,
-    int          level
-);
+static void pt_process_instance(algorithm_instance_t * instance);
+
+/**
+ * \brief Process the pending events of every ready instance (internal usage).
+ *    Instances made ready meanwhile are processed too.
+ * \param loop The libparistraceroute loop
+ */
+
+static void pt_process_ready_instances(pt_loop_t * loop);
 
 /**
  * \brief Free algorithm instances (internal usage, see visitor for twalk)
@@ -96,12 +107,12 @@ static void pt_instance_iter(
 
 
 /**
- * \brief (Internal usage) Release from the memory loop->user_events.
+ * \brief (Internal usage) Release the references held by loop->user_events.
  * \param loop The main loop.
  */
 
 static inline void pt_loop_clear_user_events(pt_loop_t * loop) {
-    dynarray_clear(loop->events_user, NULL); //(ELEMENT_FREE) event_free); TODO this provoke a segfault in case of stars
+    dynarray_clear(loop->events_user, (ELEMENT_FREE) event_free);
 }
 
 /**
@@ -135,14 +146,15 @@ ERR_FD:
 }
 
 /**
- * \brief Prepare a EFD_SEMAPHORE event_fd.
+ * \brief Prepare an event_fd.
+ * \param flags The flags passed to eventfd (e.g. EFD_SEMAPHORE).
  * \return The corresponding file descriptor, -1 in case of failure.
  */
 
-static inline int make_event_fd() {
+static inline int make_event_fd(int flags) {
     int fd;
 
-    if ((fd = eventfd(0, EFD_SEMAPHORE)) == -1) {
+    if ((fd = eventfd(0, flags)) == -1) {
         perror("Error eventfd");
     }
     return fd;
@@ -253,18 +265,23 @@ pt_loop_t * pt_loop_create(void (*handler_user)(pt_loop_t *, event_t *, void *),
     if (!(loop = malloc(sizeof(pt_loop_t)))) goto ERR_MALLOC;
     loop->handler_user = handler_user;
 
+    // The objects allocated from now by this thread are pooled
+    if (!(loop->pools = pools_create())) goto ERR_POOLS_CREATE;
+    pools_set_current(loop->pools);
+
     // Prepare epoll file descriptor
     if ((loop->efd = epoll_create1(0)) == -1) {
         perror("Error epoll_create1");
         goto ERR_EPOLL;
     }
 
-    // Prepare algorithm events fd and register it in loop->efd
-    if ((loop->eventfd_algorithm = make_event_fd()) == -1) goto ERR_MAKE_EVENTFD_ALGORITHM;
+    // Prepare algorithm events fd and register it in loop->efd. A single
+    // read resets it, whatever the number of batches notified meanwhile.
+    if ((loop->eventfd_algorithm = make_event_fd(0)) == -1) goto ERR_MAKE_EVENTFD_ALGORITHM;
     if (!register_efd(loop, loop->eventfd_algorithm))      goto ERR_EVENTFD_ALGORITHM;
 
     // Prepare user events fd and register it in loop->efd
-    if ((loop->eventfd_user = make_event_fd()) == -1)      goto ERR_MAKE_EVENTFD_USER;
+    if ((loop->eventfd_user = make_event_fd(EFD_SEMAPHORE)) == -1) goto ERR_MAKE_EVENTFD_USER;
     if (!register_efd(loop, loop->eventfd_user))           goto ERR_EVENTFD_USER;
 
     // Signal processing
@@ -282,6 +299,7 @@ pt_loop_t * pt_loop_create(void (*handler_user)(pt_loop_t *, event_t *, void *),
     if (!register_efd(loop, network_get_icmpv6_sockfd(loop->network))) goto ERR_EVENTFD_SNIFFER_ICMPV6;
 #endif
     if (!register_efd(loop, network_get_timerfd(loop->network)))       goto ERR_EVENTFD_TIMEOUT;
+    if (!register_efd(loop, network_get_pacing_timerfd(loop->network))) goto ERR_EVENTFD_PACING;
     if (!register_efd(loop, network_get_group_timerfd(loop->network))) goto ERR_EVENTFD_GROUP;
 
     // Buffer where pending events are stored
@@ -298,6 +316,8 @@ pt_loop_t * pt_loop_create(void (*handler_user)(pt_loop_t *, event_t *, void *),
     loop->next_algorithm_id = 1; // 0 means unaffected ?
     loop->cur_instance = NULL;
     loop->algorithm_instances_root = NULL;
+    loop->ready_head = NULL;
+    loop->ready_tail = NULL;
 
     return loop;
 
@@ -305,6 +325,7 @@ ERR_EVENTS_USER:
     free(loop->epoll_events);
 ERR_EVENTS:
 ERR_EVENTFD_GROUP:
+ERR_EVENTFD_PACING:
 ERR_EVENTFD_TIMEOUT:
 #ifdef USE_IPV4
 ERR_EVENTFD_SNIFFER_ICMPV4:
@@ -327,6 +348,8 @@ ERR_EVENTFD_ALGORITHM:
     close(loop->efd);
 ERR_MAKE_EVENTFD_ALGORITHM:
 ERR_EPOLL:
+    pools_free(loop->pools);
+ERR_POOLS_CREATE:
     free(loop);
 ERR_MALLOC:
     return NULL;
@@ -334,7 +357,10 @@ ERR_MALLOC:
 
 void pt_loop_free(pt_loop_t * loop)
 {
+    bool is_verbose;
+
     if (loop) {
+        is_verbose = loop->network->is_verbose;
         if (loop->events_user)  dynarray_free(loop->events_user, (ELEMENT_FREE) event_free);
         if (loop->epoll_events) free(loop->epoll_events);
         network_free(loop->network);
@@ -345,6 +371,13 @@ void pt_loop_free(pt_loop_t * loop)
 
         // Events are cleared while destroying algorithm instances
         pt_instance_iter(loop, pt_free_instance);
+
+        // The slabs are released at once. The objects not yet released
+        // keep their pool alive (see pool_free).
+        if (is_verbose) {
+            pools_fprintf_statistics(stderr, loop->pools);
+        }
+        pools_free(loop->pools);
         free(loop);
     }
 }
@@ -368,25 +401,19 @@ inline void pt_instance_iter(
     twalk(loop->algorithm_instances_root, action);
 }
 
-void pt_process_instance(const void * node, VISIT visit, int level)
+void pt_process_instance(algorithm_instance_t * instance)
 {
-    algorithm_instance_t * instance = *((algorithm_instance_t * const *) node);
-    size_t                 i, num_events;
-    uint64_t               ret;
-    ssize_t                count;
+    size_t i, num_events;
 
     // Save temporarily this algorithm context.
     instance->loop->cur_instance = instance;
 
-    // Execute algorithm handler for each events.
+    // Execute algorithm handler for each events. Events raised meanwhile
+    // for this instance make it ready again and are processed later.
     num_events = dynarray_get_size(instance->events);
     for (i = 0; i < num_events; i++) {
-        event_t * event;
+        event_t * event = dynarray_get_ith_element(instance->events, i);
 
-        count = read(instance->loop->eventfd_algorithm, &ret, sizeof(ret));
-        if (count == -1) return;
-
-        event = dynarray_get_ith_element(instance->events, i);
         instance->algorithm->handler(
             instance->loop, event,
             &instance->data,
@@ -396,6 +423,7 @@ void pt_process_instance(const void * node, VISIT visit, int level)
 
         // Next events for this instance are ignored.
         if (event->type == ALGORITHM_TERM) {
+            num_events = dynarray_get_size(instance->events);
             break;
         }
     }
@@ -403,8 +431,17 @@ void pt_process_instance(const void * node, VISIT visit, int level)
     // Restore the algorithm context
     instance->loop->cur_instance = NULL;
 
-    // Flush events queue
-    algorithm_instance_clear_events(instance);
+    // Flush the processed events
+    dynarray_del_n_elements(instance->events, 0, num_events, (ELEMENT_FREE) event_free);
+}
+
+void pt_process_ready_instances(pt_loop_t * loop)
+{
+    algorithm_instance_t * instance;
+
+    while ((instance = pt_pop_ready_instance(loop))) {
+        pt_process_instance(instance);
+    }
 }
 
 // Notify the called algorithm that it can start
@@ -415,7 +452,11 @@ void pt_free_instance(
     int          level
 ) {
     algorithm_instance_t * instance = *((algorithm_instance_t * const *) node);
-    algorithm_instance_free(instance); // No notification
+
+    // twalk visits an internal node three times
+    if (visit == postorder || visit == leaf) {
+        algorithm_instance_free(instance); // No notification
+    }
 }
 
 int pt_loop(pt_loop_t * loop) {
@@ -434,11 +475,15 @@ int pt_loop(pt_loop_t * loop) {
 #endif
     int network_timerfd       = network_get_timerfd(loop->network);
     int network_group_timerfd = network_get_group_timerfd(loop->network);
+    int network_pacing_timerfd = network_get_pacing_timerfd(loop->network);
     ssize_t s;
     struct signalfd_siginfo fdsi;
 
     // This boolean is used to avoid to terminate twice when --timeout is used.
     bool max_time_has_expired = false;
+
+    // Allocate from the pools of this loop, whatever the loop created last
+    pools_set_current(loop->pools);
     double max_time = loop->timeout;
 
     // Take the time for the timeout of the algorithm.
@@ -486,6 +531,11 @@ int pt_loop(pt_loop_t * loop) {
                 if (!network_process_recvq(loop->network)) {
                     if (loop->network->is_verbose) fprintf(stderr, "pt_loop: Cannot fetch packet\n");
                 }
+            } else if (loop->status != PT_LOOP_INTERRUPTED && cur_fd == network_pacing_timerfd) {
+                // Some probes delayed by the pacer may now be sent
+                if (!network_process_paced_probes(loop->network)) {
+                    if (loop->network->is_verbose) fprintf(stderr, "pt_loop: Can't send paced packet\n");
+                }
             } else if (loop->status != PT_LOOP_INTERRUPTED && cur_fd == network_group_timerfd) {
                  //printf("pt_loop processing scheduled probes\n");
                 network_process_scheduled_probe(loop->network);
@@ -499,15 +549,16 @@ int pt_loop(pt_loop_t * loop) {
 #endif
             } else if (cur_fd == loop->eventfd_algorithm) {
 
-                // There is one common queue shared by every instancied algorithms.
-                // We call pt_process_algorithms_iter() to find for which instance
-                // the event has been raised. Then we process this event thanks
-                // to pt_process_algorithms_instance() that calls the handler.
+                // pt_throw() appends the instances having pending events to
+                // a ready list, and only notifies the loop when this list
+                // becomes non-empty. A single read acknowledges the whole batch.
+                uint64_t value;
+                if (read(loop->eventfd_algorithm, &value, sizeof(value)) == -1) {
+                    perror("pt_loop: read");
+                }
 
                 // << This must be thread safe!!
-                s_loop = loop;
-                pt_instance_iter(loop, pt_process_instance);
-                s_loop = NULL;
+                pt_process_ready_instances(loop);
                 // >> This must be thread safe!!
 
             } else if (cur_fd == loop->eventfd_user) {
@@ -554,10 +605,61 @@ bool pt_send_probe(pt_loop_t * loop, probe_t * probe) {
     // Annotate which algorithm has generated this probe
     probe_set_caller(probe, loop->cur_instance);
 
+    // Probes without their own timeout inherit the one of their algorithm
+    if (probe_get_timeout(probe) <= 0) {
+        probe_set_timeout(probe, algorithm_instance_get_probe_timeout(loop->cur_instance));
+    }
+
     // Tagging is achieved by network layer
     return network_send_probe(loop->network, probe);
 }
 
+probe_template_t * pt_create_probe_template(pt_loop_t * loop, const probe_t * skel) {
+    probe_template_t * probe_template = NULL;
+    probe_t          * skel_dup;
+
+    // The skeleton of the caller is left unchanged
+    if (!(skel_dup = probe_dup(skel))) goto ERR_PROBE_DUP;
+    if (network_prepare_skeleton(loop->network, skel_dup)) {
+        probe_template = probe_template_create(skel_dup);
+    }
+    probe_free(skel_dup);
+ERR_PROBE_DUP:
+    return probe_template;
+}
+
+bool pt_send_probes(
+    pt_loop_t              * loop,
+    const probe_template_t * probe_template,
+    size_t                   num_probes,
+    probe_mutator_t          mutator,
+    void                   * data
+) {
+    probe_batch_t * probe_batch;
+    probe_t       * probe;
+    double          timeout = algorithm_instance_get_probe_timeout(loop->cur_instance);
+    size_t          i;
+
+    if (!(probe_batch = probe_batch_create(probe_template, num_probes, mutator, data))) {
+        goto ERR_PROBE_BATCH_CREATE;
+    }
+
+    // Same annotations as pt_send_probe
+    for (i = 0; i < num_probes; i++) {
+        probe = probe_batch_get_probe(probe_batch, i);
+        probe_set_caller(probe, loop->cur_instance);
+        if (probe_get_timeout(probe) <= 0) {
+            probe_set_timeout(probe, timeout);
+        }
+    }
+
+    // From now on, the batch is released along with its probes (see probe_free)
+    return network_send_probe_batch(loop->network, probe_batch);
+
+ERR_PROBE_BATCH_CREATE:
+    return false;
+}
+
 void pt_loop_terminate(pt_loop_t * loop) {
     loop->status = PT_LOOP_TERMINATE;
 }
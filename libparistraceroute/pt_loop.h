@@ -21,7 +21,9 @@
 #include "options.h"
 #include "probe.h"
 #include "network.h"
+#include "probe_batch.h"
 #include "event.h"
+#include "pool.h"
 
 //---------------------------------------------------------------------------
 // pt_loop options
@@ -32,6 +34,7 @@
 
 #define OPTIONS_PT_LOOP_TIMEOUT {PT_LOOP_DEFAULT_TIMEOUT, 0, INT_MAX}
 #define HELP_t "Set the timeout in seconds of the measurement (default is 180 seconds, pass 0 to set it to infinity)."
+#define HELP_no_pools "Allocate probes, packets and events by malloc instead of recycling them through object pools."
 
 /**
  * \brief Retrieve the timeout defined for the pt_loop.
@@ -40,6 +43,13 @@
 
 double options_pt_loop_get_timeout();
 
+/**
+ * \brief Retrieve whether the object pools are enabled.
+ * \return false iif --no-pools has been passed.
+ */
+
+bool options_pt_loop_get_pools();
+
 /**
  * \brief Get the command-line options related to the pt_loop.
  * \return A pointer to a structure containing the options.
@@ -61,10 +71,15 @@ typedef struct pt_loop_s {
     // Network
     network_t                   * network;                  /**< The network layer */
 
+    // Memory
+    pools_t                     * pools;                    /**< Pools of the objects allocated while this loop runs (see pool.h) */
+
     // Algorithms
     void                        * algorithm_instances_root;
     unsigned int                  next_algorithm_id;
-    int                           eventfd_algorithm;
+    int                           eventfd_algorithm;        /**< Written whenever the ready list becomes non-empty */
+    struct algorithm_instance_s * ready_head;               /**< Oldest instance having pending events */
+    struct algorithm_instance_s * ready_tail;               /**< Youngest instance having pending events */
 
     // User
     int                           eventfd_user;             /**< User notification */
@@ -100,6 +115,8 @@ typedef struct pt_loop_s {
  * \param handler_user A pointer to a function declared in the user's program
  *   called whenever a event concerning the user arises. This handler
  *   - receives a pointer to the libparistraceroute loop,
+ *   - must not release the event it handles (the loop releases it
+ *     once the handler returns, see event_ref),
  *   - must return a value
  *     < 0: if the libparistraceroute loop has to be stopped (failure)
  *     = 0: if the libparistraceroute loop has to be stopped (success)
@@ -155,6 +172,15 @@ void options_pt_loop_init(pt_loop_t * loop);
 
 void pt_loop_set_timeout(pt_loop_t * loop, double new_timeout);
 
+/**
+ * \brief Enable or disable the object pools of a libparistraceroute loop.
+ *    Once disabled, the objects are allocated by malloc (see pool.h).
+ * \param loop The libparistraceroute loop.
+ * \param is_enabled Pass true to enable the pools, false otherwise.
+ */
+
+void pt_loop_set_pools_enabled(pt_loop_t * loop, bool is_enabled);
+
 /**
  * \brief Retrieve the user events stored in the user queue.
  * \param loop The libparistraceroute loop.
@@ -183,6 +209,39 @@ size_t pt_loop_get_num_user_events(pt_loop_t * loop);
 
 bool pt_send_probe(pt_loop_t * loop, probe_t * probe);
 
+/**
+ * \brief Compile a probe skeleton into a probe template (see
+ *    probe_template_create) whose probes can be tagged by the network
+ *    layer of a loop without being resized (see network_prepare_skeleton).
+ * \param loop The main loop
+ * \param skel The probe skeleton. It is copied, so it may be altered
+ *    or freed once the template is created.
+ * \return The newly created template if successful, NULL otherwise.
+ */
+
+probe_template_t * pt_create_probe_template(pt_loop_t * loop, const probe_t * skel);
+
+/**
+ * \brief Send several probes cloned from a probe template. The probes
+ *    are cloned in a single memory block (see probe_batch.h) and passed
+ *    at once to the network layer.
+ * \param loop The main loop
+ * \param probe_template The compiled probe skeleton
+ * \param num_probes The number of probes to send
+ * \param mutator Function called back to alter each probe before it is
+ *    sent (TTL, flow identifier, ...), NULL if not needed.
+ * \param data Data passed to the mutator
+ * \return true iif successful
+ */
+
+bool pt_send_probes(
+    pt_loop_t              * loop,
+    const probe_template_t * probe_template,
+    size_t                   num_probes,
+    probe_mutator_t          mutator,
+    void                   * data
+);
+
 /**
  * \brief Stop the main loop. It is usually used to break the pt_loop call in the main program.
  * \param loop The main loop
@@ -1,64 +1,237 @@
 #include "config.h"
 
-#include <stdlib.h>         // malloc, free
-#include <unistd.h>         // read
-#include "os/sys/eventfd.h" // event_fd
+#include <stdlib.h>         // posix_memalign, free
+#include <stdio.h>          // perror
+#include <unistd.h>         // read, close
+#include "os/sys/eventfd.h" // eventfd
 
 #include "queue.h"
 
+//---------------------------------------------------------------------------
+// Private functions
+//---------------------------------------------------------------------------
+
+/**
+ * \brief Notify the consumer that the queue is not empty, unless it has
+ *    already been notified. The pushed elements are already visible to
+ *    the consumer: if the eventfd cannot be written, the next push
+ *    tries again.
+ * \param queue A queue_t instance.
+ */
+
+static inline void queue_signal(queue_t * queue) {
+    if (__atomic_exchange_n(&queue->is_signaled, true, __ATOMIC_SEQ_CST)) return;
+    if (eventfd_write(queue->eventfd, 1) == -1) {
+        perror("queue_signal");
+        __atomic_store_n(&queue->is_signaled, false, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * \brief Reset the eventfd of a queue observed as empty by the consumer.
+ *    An element pushed meanwhile may have missed the notification, so the
+ *    queue is checked again once the eventfd has been reset.
+ * \param queue A queue_t instance.
+ */
+
+static void queue_unsignal(queue_t * queue) {
+    eventfd_t value;
+
+    __atomic_store_n(&queue->is_signaled, false, __ATOMIC_SEQ_CST);
+    if (read(queue->eventfd, &value, sizeof(value)) == -1) {
+        // EAGAIN: the eventfd was not set
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (!queue_is_empty(queue)) {
+        __atomic_store_n(&queue->is_signaled, true, __ATOMIC_SEQ_CST);
+        eventfd_write(queue->eventfd, 1);
+    }
+}
+
+/**
+ * \brief Pop the oldest element of a queue (consumer side).
+ * \param queue A queue_t instance.
+ * \param pelement Where the poped element is written.
+ * \return true iif an element has been poped.
+ */
+
+static inline bool queue_pop_slot(queue_t * queue, void ** pelement) {
+    size_t         pos  = queue->head;
+    queue_slot_t * slot = &queue->slots[pos & queue->mask];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) return false;
+
+    *pelement = slot->element;
+    __atomic_store_n(&slot->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+    queue->head = pos + 1;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Public functions
+//---------------------------------------------------------------------------
+
 queue_t * queue_create_impl(
     void   (*element_free)(void * element),
-    void   (*element_fprintf)(FILE * out, const void * element)
+    void   (*element_fprintf)(FILE * out, const void * element),
+    size_t   capacity,
+    queue_mode_t mode
 ) {
     queue_t * queue;
+    size_t    i, num_slots = 1;
+
+    if (capacity == 0) goto ERR_INVALID_CAPACITY;
+    while (num_slots < capacity) num_slots <<= 1;
 
     // Alloc queue
-    if (!(queue = malloc(sizeof(queue_t)))) {
+    if (posix_memalign((void **) &queue, QUEUE_CACHE_LINE_SIZE, sizeof(queue_t))) {
         goto ERR_QUEUE;
     }
 
     // Create an eventfd
-    if ((queue->eventfd = eventfd(0, EFD_SEMAPHORE)) == -1) {
+    if ((queue->eventfd = eventfd(0, EFD_NONBLOCK)) == -1) {
         goto ERR_EVENTFD;
     }
 
-    // Create the list that will contain the elements
-    if (!(queue->elements = list_create(element_free, element_fprintf))) {
-        goto ERR_ELEMENTS;
+    // Create the ring that will contain the elements
+    if (posix_memalign((void **) &queue->slots, QUEUE_CACHE_LINE_SIZE, num_slots * sizeof(queue_slot_t))) {
+        goto ERR_SLOTS;
+    }
+    for (i = 0; i < num_slots; i++) {
+        queue->slots[i].seq     = i;
+        queue->slots[i].element = NULL;
     }
+
+    queue->mask            = num_slots - 1;
+    queue->mode            = mode;
+    queue->element_free    = element_free;
+    queue->element_fprintf = element_fprintf;
+    queue->tail            = 0;
+    queue->head            = 0;
+    queue->is_signaled     = false;
     return queue;
 
-ERR_ELEMENTS:
+ERR_SLOTS:
     close(queue->eventfd);
 ERR_EVENTFD:
     free(queue);
 ERR_QUEUE:
+ERR_INVALID_CAPACITY:
     return NULL;
 }
 
 void queue_free(queue_t * queue) {
+    void * element;
+
     if (queue) {
-        if (queue->elements) list_free(queue->elements);
+        while (queue_pop_slot(queue, &element)) {
+            if (queue->element_free) queue->element_free(element);
+        }
+        free(queue->slots);
         close(queue->eventfd);
         free(queue);
     }
 }
 
-inline bool queue_push_element(queue_t *queue, void * element) {
-    // Push an element in the queue
-    // If successfull, write 1 in the file descriptor.
-    return list_push_element(queue->elements, element)
-        && (eventfd_write(queue->eventfd, 1) != -1);
+bool queue_push_element(queue_t * queue, void * element) {
+    size_t         pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED), seq;
+    queue_slot_t * slot;
+
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == pos) {
+            // The slot is free, reserve it
+            if (queue->mode == QUEUE_SPSC) {
+                __atomic_store_n(&queue->tail, pos + 1, __ATOMIC_RELAXED);
+                break;
+            }
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // Another producer has reserved this slot, pos has been updated
+        } else if ((ptrdiff_t) (seq - pos) < 0) {
+            // The slot still stores an element pushed one round ago
+            return false;
+        } else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Publish the element, then wake up the consumer if needed
+    slot->element = element;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    queue_signal(queue);
+    return true;
 }
 
-void * queue_pop_element(queue_t *queue, void (*element_free)(void * element)) {
-    eventfd_t value;
-    return (read(queue->eventfd, &value, sizeof(value)) != -1) ?
-        list_pop_element(queue->elements, element_free) :
-        NULL;
+bool queue_push_elements(queue_t * queue, void ** elements, size_t num_elements) {
+    size_t         pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED), seq, i;
+    queue_slot_t * slot;
+
+    if (num_elements == 0) return true;
+    if (num_elements > queue->mask + 1) return false;
+
+    for (;;) {
+        // The slots are released in order by the consumer, so the whole
+        // range is free iif its last slot is free.
+        slot = &queue->slots[(pos + num_elements - 1) & queue->mask];
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == pos + num_elements - 1) {
+            // The slots are free, reserve them
+            if (queue->mode == QUEUE_SPSC) {
+                __atomic_store_n(&queue->tail, pos + num_elements, __ATOMIC_RELAXED);
+                break;
+            }
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + num_elements, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // Another producer has reserved some of these slots, pos has been updated
+        } else if ((ptrdiff_t) (seq - (pos + num_elements - 1)) < 0) {
+            // Not enough free slots
+            return false;
+        } else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Publish the elements, then wake up the consumer once
+    for (i = 0; i < num_elements; i++) {
+        slot = &queue->slots[(pos + i) & queue->mask];
+        slot->element = elements[i];
+        __atomic_store_n(&slot->seq, pos + i + 1, __ATOMIC_RELEASE);
+    }
+    queue_signal(queue);
+    return true;
+}
+
+void * queue_pop_element(queue_t * queue, void (*element_free)(void * element)) {
+    void * element = NULL;
+
+    if (queue_pop_slot(queue, &element)) {
+        if (element_free) element_free(element);
+    }
+    if (queue_is_empty(queue)) queue_unsignal(queue);
+    return element;
+}
+
+size_t queue_pop_elements(queue_t * queue, void ** elements, size_t num_elements) {
+    size_t i;
+
+    for (i = 0; i < num_elements && queue_pop_slot(queue, &elements[i]); i++);
+
+    // The eventfd remains readable as long as the queue is not empty
+    if (queue_is_empty(queue)) queue_unsignal(queue);
+    return i;
+}
+
+bool queue_is_empty(const queue_t * queue) {
+    return __atomic_load_n(&queue->slots[queue->head & queue->mask].seq, __ATOMIC_ACQUIRE) != queue->head + 1;
 }
 
 inline int queue_get_fd(const queue_t * queue) {
     return queue->eventfd;
 }
-
@@ -1,34 +1,112 @@
 #ifndef LIBPT_QUEUE_H
 #define LIBPT_QUEUE_H
 
+/**
+ * \file queue.h
+ * \brief Header file: bounded FIFO queue notifying its consumer through an eventfd.
+ *
+ * A queue_t is a ring of pointers shared by one consumer and either one
+ * producer (QUEUE_SPSC) or several producers (QUEUE_MPSC). Each slot
+ * carries a sequence number telling whether it stores an element, so that
+ * neither pushing nor popping requires a lock or a memory allocation.
+ *
+ * The eventfd is only written when the queue becomes non-empty, and it
+ * remains readable until the consumer has drained the queue. A consumer
+ * woken up by the eventfd should thus pop as many elements as possible
+ * (see queue_pop_elements) before returning to the main loop.
+ */
+
 #include <stdbool.h>
+#include <stddef.h> // size_t
+#include <stdio.h>  // FILE
 
 #include "common.h"
-#include "containers/list.h"
+
+// Default number of elements that a queue can store
+#define QUEUE_DEFAULT_CAPACITY 65536
+
+// Size of a cache line, used to prevent producers and consumer from
+// invalidating each other's cache lines.
+#define QUEUE_CACHE_LINE_SIZE 64
+
+/**
+ * \enum queue_mode_t
+ * \brief Threads allowed to access a queue.
+ */
+
+typedef enum {
+    QUEUE_SPSC, /**< Single producer, single consumer */
+    QUEUE_MPSC  /**< Multiple producers, single consumer */
+} queue_mode_t;
+
+/**
+ * \struct queue_slot_t
+ * \brief A slot of a queue.
+ */
 
 typedef struct {
-    list_t * elements; /**< Elements stored in the queue */
-    int      eventfd;  /**< File descriptor notifying an update in the queue */
+    size_t   seq;     /**< pos + 1 if the slot stores the element pushed at position pos, pos otherwise */
+    void   * element; /**< The stored element */
+} queue_slot_t;
+
+/**
+ * \struct queue_t
+ * \brief Structure describing a queue.
+ */
+
+typedef struct {
+    // Read-only once the queue is created
+    queue_slot_t * slots;           /**< Ring of capacity slots */
+    size_t         mask;            /**< capacity - 1 (capacity is a power of 2) */
+    queue_mode_t   mode;            /**< QUEUE_SPSC or QUEUE_MPSC */
+    int            eventfd;         /**< File descriptor notifying that the queue is not empty */
+    void        (* element_free)(void * element);                      /**< Callback used to free the elements */
+    void        (* element_fprintf)(FILE * out, const void * element); /**< Callback used to print the elements */
+
+    // Written by the producers
+    size_t         tail __attribute__((aligned(QUEUE_CACHE_LINE_SIZE))); /**< Position of the next pushed element */
+    bool           is_signaled;     /**< True iif the eventfd has been written since the consumer last drained the queue */
+
+    // Written by the consumer
+    size_t         head __attribute__((aligned(QUEUE_CACHE_LINE_SIZE))); /**< Position of the next poped element */
 } queue_t;
 
 /**
  * \brief Create a new queue
  * \param element_free Callback used to free elements.
+ * \param element_fprintf Callback used to print elements.
+ * \param capacity The maximum number of elements stored in the queue
+ *    (rounded up to a power of 2).
+ * \param mode QUEUE_SPSC or QUEUE_MPSC. A QUEUE_SPSC queue reserves its
+ *    slots without atomic read-modify-write, and must thus be fed by a
+ *    single thread.
  * \return A pointer to the newly created queue, NULL otherwise.
  */
 
 queue_t * queue_create_impl(
     void   (*element_free)(void * element),
-    void   (*element_fprintf)(FILE * out, const void * element)
+    void   (*element_fprintf)(FILE * out, const void * element),
+    size_t   capacity,
+    queue_mode_t mode
 );
 
 #define queue_create(element_free, element_fprintf) queue_create_impl(\
     (ELEMENT_FREE)    element_free, \
-    (ELEMENT_FPRINTF) element_fprintf \
+    (ELEMENT_FPRINTF) element_fprintf, \
+    QUEUE_DEFAULT_CAPACITY, \
+    QUEUE_MPSC \
+)
+
+#define queue_create_ext(element_free, element_fprintf, capacity, mode) queue_create_impl(\
+    (ELEMENT_FREE)    element_free, \
+    (ELEMENT_FPRINTF) element_fprintf, \
+    capacity, \
+    mode \
 )
 
 /**
- * \brief Delete a queue structure.
+ * \brief Delete a queue structure. The elements still stored in
+ *    the queue are freed.
  * \param queue Points to the queue structure to delete.
  */
 
@@ -38,11 +116,26 @@ void queue_free(queue_t * queue);
  * \brief Push an element in the queue
  * \param queue Points to the impacted queue instance
  * \param element Points to the pushed element
- * \return true iif successfull
+ * \return true iif successfull (false if the queue is full). Once
+ *    pushed, the element belongs to the queue, even if the consumer
+ *    could not be notified (it is then notified by the next push).
  */
 
 bool queue_push_element(queue_t * queue, void * element);
 
+/**
+ * \brief Push several elements in the queue at once. The consumer
+ *    is notified once.
+ * \param queue Points to the impacted queue instance
+ * \param elements The pushed elements (from the oldest to the youngest).
+ * \param num_elements The number of pushed elements.
+ * \return true iif successfull (false if the queue cannot store every
+ *    element, in which case no element is pushed). Once pushed, the
+ *    elements belong to the queue (see queue_push_element).
+ */
+
+bool queue_push_elements(queue_t * queue, void ** elements, size_t num_elements);
+
 /**
  * \brief Pop an element from the queue.
  * \param queue The queue from which we pop an element.
@@ -52,6 +145,26 @@ bool queue_push_element(queue_t * queue, void * element);
 
 void * queue_pop_element(queue_t * queue, void (*element_free)(void * element));
 
+/**
+ * \brief Pop several elements from the queue.
+ * \param queue The queue from which we pop the elements.
+ * \param elements An array of at least num_elements cells in which
+ *    the poped elements are written (from the oldest to the youngest).
+ * \param num_elements The maximum number of elements to pop.
+ * \return The number of poped elements.
+ */
+
+size_t queue_pop_elements(queue_t * queue, void ** elements, size_t num_elements);
+
+/**
+ * \brief Check whether a queue is empty. This is only reliable
+ *    when called by the consumer.
+ * \param queue A pointer to a queue instance.
+ * \return true iif the queue is empty.
+ */
+
+bool queue_is_empty(const queue_t * queue);
+
 /**
  * \brief Retrieve the file descriptor stored in a queue_t instance.
  * \param queue A pointer to a queue instance.
@@ -4,6 +4,7 @@
 #include <stdlib.h>      // malloc
 #include <stdio.h>       // perror
 #include <string.h>      // memcpy, memset
+#include <errno.h>       // errno, EAGAIN
 #include <unistd.h>      // fnctl
 #include <fcntl.h>       // fnctl
 #include <sys/socket.h>  // socket, bind,
@@ -15,9 +16,14 @@
 #  include <netinet/ip6.h> // ip6_hdr
 #endif
 
+#ifdef USE_PACKET_RING
+#  include <linux/if_ether.h> // ETH_P_IP, ETH_P_IPV6
+#endif
+
 #include "sniffer.h"
 
-#define BUFLEN 4096
+#define BUFLEN      4096 // Size of a buffer storing a sniffed packet
+#define CMSG_BUFLEN 1024 // Size of a buffer storing IPv6 ancillary data
 
 // Solaris/Sun
 // http://livre.g6.asso.fr/index.php/L%27exemple_%C2%AB_mini-ping_%C2%BB_revisit%C3%A9
@@ -58,7 +64,7 @@ static bool create_icmpv4_socket(sniffer_t * sniffer, uint16_t port)
     }
 
     // Make the socket non-blocking
-    if (fcntl(sniffer->icmpv4_sockfd, F_SETFD, O_NONBLOCK) == -1) {
+    if (fcntl(sniffer->icmpv4_sockfd, F_SETFL, O_NONBLOCK) == -1) {
         goto ERR_FCNTL;
     }
 
@@ -103,7 +109,7 @@ static bool create_icmpv6_socket(sniffer_t * sniffer, uint16_t port)
     }
 
     // Make the socket non-blocking
-    if (fcntl(sniffer->icmpv6_sockfd, F_SETFD, O_NONBLOCK) == -1) {
+    if (fcntl(sniffer->icmpv6_sockfd, F_SETFL, O_NONBLOCK) == -1) {
         goto ERR_FCNTL;
     }
 
@@ -147,23 +153,35 @@ ERR_SOCKET:
 }
 #endif
 
-sniffer_t * sniffer_create(void * recv_param, bool (*recv_callback)(packet_t *, void *))
-{
-    sniffer_t * sniffer;
+/**
+ * \brief Initialize the raw sockets of a sniffer_t instance.
+ * \param sniffer A pointer to a sniffer_t instance
+ * \return true iif successful
+ */
 
-    // TODO: We currently only listen for ICMP thanks to raw sockets which
-    // requires root privileges
-	// Can we set port to 0 to capture all packets wheter ICMP, UDP or TCP?
-    if (!(sniffer = malloc(sizeof(sniffer_t)))) goto ERR_MALLOC;
+static bool sniffer_create_sockets(sniffer_t * sniffer)
+{
 #ifdef USE_IPV4
     if (!create_icmpv4_socket(sniffer, 0))      goto ERR_CREATE_ICMPV4_SOCKET;
 #endif
 #ifdef USE_IPV6
     if (!create_icmpv6_socket(sniffer, 0))      goto ERR_CREATE_ICMPV6_SOCKET;
 #endif
-    sniffer->recv_param = recv_param;
-    sniffer->recv_callback = recv_callback;
-    return sniffer;
+
+#ifdef USE_KERNEL_FILTER
+    // Until a probe is sent, only the ICMP types are checked. If the
+    // filter cannot be attached, the sniffer still works (unfiltered).
+#ifdef USE_IPV4
+    sniffer_filter_init(&sniffer->filter4, IPPROTO_ICMP);
+    sniffer_filter_attach(&sniffer->filter4, sniffer->icmpv4_sockfd);
+#endif
+#ifdef USE_IPV6
+    sniffer_filter_init(&sniffer->filter6, IPPROTO_ICMPV6);
+    sniffer_filter_attach(&sniffer->filter6, sniffer->icmpv6_sockfd);
+#endif
+#endif
+    return true;
+
 #ifdef USE_IPV6
 ERR_CREATE_ICMPV6_SOCKET:
 #ifdef USE_IPV4
@@ -173,6 +191,168 @@ ERR_CREATE_ICMPV6_SOCKET:
 #ifdef USE_IPV4
 ERR_CREATE_ICMPV4_SOCKET:
 #endif
+    return false;
+}
+
+#ifdef USE_PACKET_RING
+/**
+ * \brief Initialize the packet rings of a sniffer_t instance. The file
+ *    descriptors of the rings replace the raw sockets, so that the caller
+ *    can poll them exactly like with the raw backend.
+ * \param sniffer A pointer to a sniffer_t instance
+ * \param ifname The interface to listen to, NULL for any interface.
+ * \return true iif successful
+ */
+
+static bool sniffer_create_rings(sniffer_t * sniffer, const char * ifname)
+{
+#ifdef USE_IPV4
+    if (!(sniffer->ring4 = sniffer_ring_create(ETH_P_IP, ifname)))   goto ERR_CREATE_RING4;
+    sniffer->icmpv4_sockfd = sniffer_ring_get_fd(sniffer->ring4);
+#endif
+#ifdef USE_IPV6
+    if (!(sniffer->ring6 = sniffer_ring_create(ETH_P_IPV6, ifname))) goto ERR_CREATE_RING6;
+    sniffer->icmpv6_sockfd = sniffer_ring_get_fd(sniffer->ring6);
+#endif
+    return true;
+
+#ifdef USE_IPV6
+ERR_CREATE_RING6:
+#ifdef USE_IPV4
+    sniffer_ring_free(sniffer->ring4);
+    sniffer->ring4 = NULL;
+#endif
+#endif
+#ifdef USE_IPV4
+ERR_CREATE_RING4:
+#endif
+    return false;
+}
+
+/**
+ * \brief Retrieve the packet ring related to a protocol.
+ * \param sniffer A pointer to a sniffer_t instance
+ * \param protocol_id The family of the packets (IPPROTO_ICMP, IPPROTO_ICMPV6)
+ * \return The corresponding ring, NULL if not found.
+ */
+
+static sniffer_ring_t * sniffer_get_ring(sniffer_t * sniffer, uint8_t protocol_id)
+{
+    switch (protocol_id) {
+#ifdef USE_IPV4
+        case IPPROTO_ICMP:   return sniffer->ring4;
+#endif
+#ifdef USE_IPV6
+        case IPPROTO_ICMPV6: return sniffer->ring6;
+#endif
+        default:             return NULL;
+    }
+}
+#endif // USE_PACKET_RING
+
+/**
+ * \brief Retrieve the socket related to a protocol.
+ * \param sniffer A pointer to a sniffer_t instance
+ * \param protocol_id The family of the packets (IPPROTO_ICMP, IPPROTO_ICMPV6)
+ * \return The corresponding socket, -1 if not found.
+ */
+
+static int sniffer_get_sockfd(const sniffer_t * sniffer, uint8_t protocol_id)
+{
+    switch (protocol_id) {
+#ifdef USE_IPV4
+        case IPPROTO_ICMP:   return sniffer->icmpv4_sockfd;
+#endif
+#ifdef USE_IPV6
+        case IPPROTO_ICMPV6: return sniffer->icmpv6_sockfd;
+#endif
+        default:             return -1;
+    }
+}
+
+#ifdef USE_KERNEL_FILTER
+/**
+ * \brief Retrieve the kernel filter related to a protocol.
+ * \param sniffer A pointer to a sniffer_t instance
+ * \param protocol_id The family of the packets (IPPROTO_ICMP, IPPROTO_ICMPV6)
+ * \return The corresponding filter, NULL if not found.
+ */
+
+static sniffer_filter_t * sniffer_get_filter(sniffer_t * sniffer, uint8_t protocol_id)
+{
+    switch (protocol_id) {
+#ifdef USE_IPV4
+        case IPPROTO_ICMP:   return &sniffer->filter4;
+#endif
+#ifdef USE_IPV6
+        case IPPROTO_ICMPV6: return &sniffer->filter6;
+#endif
+        default:             return NULL;
+    }
+}
+#endif // USE_KERNEL_FILTER
+
+sniffer_t * sniffer_create(void * recv_param, bool (*recv_callback)(packet_t *, void *))
+{
+    return sniffer_create_ext(recv_param, recv_callback, SNIFFER_BACKEND_RAW, NULL);
+}
+
+sniffer_t * sniffer_create_ext(
+    void              * recv_param,
+    bool             (* recv_callback)(packet_t *, void *),
+    sniffer_backend_t   backend,
+    const char        * ifname
+) {
+    sniffer_t * sniffer;
+
+    // TODO: We currently only listen for ICMP thanks to raw sockets which
+    // requires root privileges
+	// Can we set port to 0 to capture all packets wheter ICMP, UDP or TCP?
+    if (!(sniffer = malloc(sizeof(sniffer_t)))) goto ERR_MALLOC;
+    if (!(sniffer->buffers  = malloc(SNIFFER_BATCH_SIZE * BUFLEN)))                   goto ERR_BUFFERS;
+    if (!(sniffer->messages = calloc(SNIFFER_BATCH_SIZE, sizeof(struct mmsghdr))))    goto ERR_MESSAGES;
+    if (!(sniffer->iovecs   = calloc(SNIFFER_BATCH_SIZE, sizeof(struct iovec))))      goto ERR_IOVECS;
+#ifdef USE_IPV6
+    if (!(sniffer->cmsg_buffers = malloc(SNIFFER_BATCH_SIZE * CMSG_BUFLEN)))          goto ERR_CMSG_BUFFERS;
+    if (!(sniffer->from = calloc(SNIFFER_BATCH_SIZE, sizeof(struct sockaddr_in6))))   goto ERR_FROM;
+#endif
+#ifdef USE_PACKET_RING
+    sniffer->ring4 = NULL;
+    sniffer->ring6 = NULL;
+#endif
+
+    sniffer->backend = backend;
+    switch (backend) {
+        case SNIFFER_BACKEND_RAW:
+            if (!sniffer_create_sockets(sniffer)) goto ERR_CREATE_SOCKETS;
+            break;
+#ifdef USE_PACKET_RING
+        case SNIFFER_BACKEND_RING:
+            if (!sniffer_create_rings(sniffer, ifname)) goto ERR_CREATE_SOCKETS;
+            break;
+#endif
+        default:
+            fprintf(stderr, "sniffer_create_ext: invalid backend (%d)\n", backend);
+            goto ERR_CREATE_SOCKETS;
+    }
+
+    sniffer->recv_param = recv_param;
+    sniffer->recv_callback = recv_callback;
+    return sniffer;
+
+ERR_CREATE_SOCKETS:
+#ifdef USE_IPV6
+    free(sniffer->from);
+ERR_FROM:
+    free(sniffer->cmsg_buffers);
+ERR_CMSG_BUFFERS:
+#endif
+    free(sniffer->iovecs);
+ERR_IOVECS:
+    free(sniffer->messages);
+ERR_MESSAGES:
+    free(sniffer->buffers);
+ERR_BUFFERS:
     free(sniffer);
 ERR_MALLOC:
     return NULL;
@@ -181,12 +361,28 @@ ERR_MALLOC:
 void sniffer_free(sniffer_t * sniffer)
 {
     if (sniffer) {
+#ifdef USE_PACKET_RING
+        if (sniffer->backend == SNIFFER_BACKEND_RING) {
+            // The rings own icmpv4_sockfd and icmpv6_sockfd
+            sniffer_ring_free(sniffer->ring4);
+            sniffer_ring_free(sniffer->ring6);
+        } else
+#endif
+        {
 #ifdef USE_IPV4
-        close(sniffer->icmpv4_sockfd);
+            close(sniffer->icmpv4_sockfd);
 #endif
 #ifdef USE_IPV6
-        close(sniffer->icmpv6_sockfd);
+            close(sniffer->icmpv6_sockfd);
+#endif
+        }
+#ifdef USE_IPV6
+        free(sniffer->from);
+        free(sniffer->cmsg_buffers);
 #endif
+        free(sniffer->iovecs);
+        free(sniffer->messages);
+        free(sniffer->buffers);
         free(sniffer);
     }
 }
@@ -274,111 +470,197 @@ static bool rebuild_ipv6_header(
 }
 
 /**
- * \brief Fetch an IPv6/ICMPv6 packet from an IPv6 socket
- * \param ipv6_sockfd An IPv6 socket which is sniffing an ICMPv6 packet
- * \param bytes A preallocated buffer in which we write the full IPv6 packet.
- * \param len The size of the preallocated buffer
- * \param flags
+ * \brief Complete an IPv6/ICMPv6 packet fetched from an IPv6 socket.
+ *   The socket only returns the bytes nested in the IPv6 packet (in the
+ *   case of traceroute, the ICMPv6/UDP/payload layers), which are written
+ *   right after the room left for the IPv6 header.
+ * \param msg The message filled by recvmmsg. Its first iovec points
+ *    to the nested bytes.
+ * \param num_bytes The number of nested bytes fetched.
+ * \return The size of the full IPv6 packet, 0 in case of failure.
  */
 
-static ssize_t recv_icmpv6(int ipv6_sockfd, void * bytes, size_t len, int flags) {
-    ssize_t               num_bytes;
-    char                  cmsg_buf[BUFLEN];
-    struct sockaddr_in6   from;
-    struct ip6_hdr      * ip6_header = (struct ip6_hdr *) bytes;
+static ssize_t icmpv6_complete_packet(struct msghdr * msg, ssize_t num_bytes) {
+    struct ip6_hdr * ip6_header = (struct ip6_hdr *) ((uint8_t *) msg->msg_iov->iov_base - sizeof(struct ip6_hdr));
 
-    struct iovec iov = {
-        .iov_base = ((uint8_t *) bytes) + sizeof(struct ip6_hdr),
-        .iov_len  = len - sizeof(struct ip6_hdr)
-    };
-
-    struct msghdr msg = {
-        .msg_name       = &from,            // socket address
-        .msg_namelen    = sizeof(from),     // sizeof socket
-        .msg_iov        = &iov,             // buffer (scather/gather array)
-        .msg_iovlen     = 1,                // number of msg_iov elements
-        .msg_control    = cmsg_buf,         // ancillary data
-        .msg_controllen = sizeof(cmsg_buf), // sizeof ancillary data
-        .msg_flags      = flags             // flags related to recv messages
-    };
-
-    // We do not need memset since we will explicitely set each bit of
-    // the IPv6 header. Uncomment to debug.
-    //memset(bytes, 0, sizeof(struct ip6_hdr));
-
-    // Fetch the bytes nested in the IPv6 packet (in the case of traceroute,
-    // we fetch ICMPv6/UDP/payload layers).
-    if ((num_bytes = recvmsg(ipv6_sockfd, &msg, flags)) == -1) {
-        fprintf(stderr, "recv_ipv6_header: Can't fetch data\n");
-        goto ERR_RECVMSG;
-    }
-
-    if (msg.msg_flags & MSG_TRUNC) {
+    if (msg->msg_flags & MSG_TRUNC) {
         fprintf(stderr, "recv_ipv6_header: data truncated\n");
         goto ERR_MSG_TRUNC;
     }
 
-    if (msg.msg_flags & MSG_CTRUNC) {
+    if (msg->msg_flags & MSG_CTRUNC) {
         fprintf(stderr, "recv_ipv6_header: ancillary data truncated\n");
         goto ERR_MSG_CTRUNK;
     }
 
-    if(!rebuild_ipv6_header(ip6_header, &msg, &from, num_bytes)) {
+    if(!rebuild_ipv6_header(ip6_header, msg, msg->msg_name, num_bytes)) {
         fprintf(stderr, "recv_ipv6_header: error in rebuild_ipv6_header\n");
         goto ERR_REBUILD_IPV6_HEADER;
     }
 
     return num_bytes + sizeof(struct ip6_hdr);
+
 ERR_REBUILD_IPV6_HEADER:
 ERR_MSG_CTRUNK:
 ERR_MSG_TRUNC:
-ERR_RECVMSG:
     return 0;
 }
 
 #endif // USE_IPV6
 
+/**
+ * \brief Prepare sniffer->messages before calling recvmmsg. This must
+ *    be done before each call since the kernel updates the length of the
+ *    address and of the ancillary data of each message.
+ * \param sniffer Points to a sniffer_t instance.
+ * \param protocol_id The family of the packets to fetch (IPPROTO_ICMP, IPPROTO_ICMPV6)
+ */
+
+static void sniffer_prepare_messages(sniffer_t * sniffer, uint8_t protocol_id) {
+    size_t          i;
+    struct msghdr * msg;
+
+    for (i = 0; i < SNIFFER_BATCH_SIZE; i++) {
+        msg = &sniffer->messages[i].msg_hdr;
+        memset(msg, 0, sizeof(struct msghdr));
+        sniffer->iovecs[i].iov_base = sniffer->buffers + i * BUFLEN;
+        sniffer->iovecs[i].iov_len  = BUFLEN;
+        msg->msg_iov    = &sniffer->iovecs[i];
+        msg->msg_iovlen = 1;
+#ifdef USE_IPV6
+        if (protocol_id == IPPROTO_ICMPV6) {
+            // Leave room for the IPv6 header, rebuilt thanks to the ancillary data
+            sniffer->iovecs[i].iov_base = (uint8_t *) sniffer->iovecs[i].iov_base + sizeof(struct ip6_hdr);
+            sniffer->iovecs[i].iov_len -= sizeof(struct ip6_hdr);
+            msg->msg_name       = &sniffer->from[i];
+            msg->msg_namelen    = sizeof(struct sockaddr_in6);
+            msg->msg_control    = sniffer->cmsg_buffers + i * CMSG_BUFLEN;
+            msg->msg_controllen = CMSG_BUFLEN;
+        }
+#endif
+    }
+}
+
 void sniffer_process_packets(sniffer_t * sniffer, uint8_t protocol_id)
 {
-    uint8_t    recv_bytes[BUFLEN];
-    ssize_t    num_bytes = 0;
+    int        i, num_messages, sockfd;
+    uint8_t  * recv_bytes;
+    ssize_t    num_bytes;
     packet_t * packet;
+#ifdef USE_PACKET_RING
+    sniffer_ring_t * ring;
 
-    switch (protocol_id) {
-#ifdef USE_IPV4
-        case IPPROTO_ICMP:
-            num_bytes = recv(sniffer->icmpv4_sockfd, recv_bytes, BUFLEN, 0);
-            break;
+    if (sniffer->backend == SNIFFER_BACKEND_RING) {
+        if (!(ring = sniffer_get_ring(sniffer, protocol_id))) {
+            fprintf(stderr, "sniffer_process_packets: invalid protocol (%d)\n", protocol_id);
+            return;
+        }
+        sniffer_ring_process_packets(ring, sniffer->recv_callback, sniffer->recv_param);
+        return;
+    }
 #endif
-#ifdef USE_IPV6
-        case IPPROTO_ICMPV6:
-            num_bytes = recv_icmpv6(sniffer->icmpv6_sockfd, recv_bytes, BUFLEN, 0);
+
+    if ((sockfd = sniffer_get_sockfd(sniffer, protocol_id)) == -1) {
+        fprintf(stderr, "sniffer_process_packets: invalid protocol (%d)\n", protocol_id);
+        return;
+    }
+
+    // Drain the socket: fetch up to SNIFFER_BATCH_SIZE packets per system
+    // call until the socket has no more pending packet.
+    do {
+        sniffer_prepare_messages(sniffer, protocol_id);
+        if ((num_messages = recvmmsg(sockfd, sniffer->messages, SNIFFER_BATCH_SIZE, MSG_DONTWAIT, NULL)) == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("sniffer_process_packets: Can't fetch data");
+            }
             break;
+        }
+
+        for (i = 0; i < num_messages; i++) {
+            recv_bytes = sniffer->buffers + i * BUFLEN;
+            num_bytes  = sniffer->messages[i].msg_len;
+#ifdef USE_IPV6
+            if (protocol_id == IPPROTO_ICMPV6) {
+                num_bytes = icmpv6_complete_packet(&sniffer->messages[i].msg_hdr, num_bytes);
+            }
 #endif
-    }
 
-	if (num_bytes >= 4) {
-		// We have to make some modifications on the datagram
-		// received because the raw format varies between
-		// OSes:
-		//  - Linux: the whole packet is in network endianess
-		//  - NetBSD: the packet is in network endianess except
-		//  IP total length and frag ofs(?) are in host-endian
-		//  - FreeBSD: same as NetBSD?
-		//  - Apple: same as NetBSD?
-		//  Bug? On NetBSD, the IP length seems incorrect
+            if (num_bytes >= 4) {
+                // We have to make some modifications on the datagram
+                // received because the raw format varies between
+                // OSes:
+                //  - Linux: the whole packet is in network endianess
+                //  - NetBSD: the packet is in network endianess except
+                //  IP total length and frag ofs(?) are in host-endian
+                //  - FreeBSD: same as NetBSD?
+                //  - Apple: same as NetBSD?
+                //  Bug? On NetBSD, the IP length seems incorrect
 #if defined __APPLE__ || __NetBSD__ || __FreeBSD__
-		//uint16_t ip_len = read16(recv_bytes, 2);
-		//writebe16(recv_bytes, 2, ip_len);
-        printf("sniffer_process_packets: something unclear here\n");
+                //uint16_t ip_len = read16(recv_bytes, 2);
+                //writebe16(recv_bytes, 2, ip_len);
+                printf("sniffer_process_packets: something unclear here\n");
 #endif
-		if (sniffer->recv_callback != NULL) {
-            packet = packet_create_from_bytes(recv_bytes, num_bytes);
-
-			if (!(sniffer->recv_callback(packet, sniffer->recv_param))) {
-                fprintf(stderr, "Error in sniffer's callback\n");
+                if (sniffer->recv_callback != NULL) {
+                    if (!(packet = packet_create_from_bytes(recv_bytes, num_bytes))) {
+                        fprintf(stderr, "sniffer_process_packets: Can't create packet\n");
+                        continue;
+                    }
+
+                    if (!(sniffer->recv_callback(packet, sniffer->recv_param))) {
+                        fprintf(stderr, "Error in sniffer's callback\n");
+                    }
+                }
             }
         }
-	}
+#ifdef USE_KERNEL_FILTER
+        sniffer_get_filter(sniffer, protocol_id)->num_received += num_messages;
+#endif
+    } while (num_messages == SNIFFER_BATCH_SIZE);
+}
+
+#ifdef USE_KERNEL_FILTER
+bool sniffer_add_signature(sniffer_t * sniffer, uint8_t protocol_id, uint8_t protocol, uint16_t dst_port)
+{
+    sniffer_filter_t    * filter;
+    sniffer_signature_t   signature = {
+        .protocol = protocol,
+        .dst_port = dst_port
+    };
+
+    if (sniffer->backend != SNIFFER_BACKEND_RAW) return true;
+
+    if (!(filter = sniffer_get_filter(sniffer, protocol_id))) {
+        fprintf(stderr, "sniffer_add_signature: invalid protocol (%d)\n", protocol_id);
+        return false;
+    }
+
+    // Only regenerate the filter if the signature is new
+    return sniffer_filter_add_signature(filter, &signature) ?
+        sniffer_filter_attach(filter, sniffer_get_sockfd(sniffer, protocol_id)) :
+        true;
 }
 
+void sniffer_fprintf_statistics(FILE * out, const sniffer_t * sniffer)
+{
+    if (sniffer->backend != SNIFFER_BACKEND_RAW) return;
+#ifdef USE_IPV4
+    fprintf(out, "ICMPv4: %llu packet(s) received, %llu packet(s) filtered out by the kernel\n",
+        (unsigned long long) sniffer->filter4.num_received,
+        (unsigned long long) sniffer_filter_get_num_filtered(&sniffer->filter4)
+    );
+#endif
+#ifdef USE_IPV6
+    fprintf(out, "ICMPv6: %llu packet(s) received, %llu packet(s) filtered out by the kernel\n",
+        (unsigned long long) sniffer->filter6.num_received,
+        (unsigned long long) sniffer_filter_get_num_filtered(&sniffer->filter6)
+    );
+#endif
+}
+#else
+bool sniffer_add_signature(sniffer_t * sniffer, uint8_t protocol_id, uint8_t protocol, uint16_t dst_port) {
+    return true;
+}
+
+void sniffer_fprintf_statistics(FILE * out, const sniffer_t * sniffer) {
+}
+#endif // USE_KERNEL_FILTER
@@ -9,10 +9,37 @@
  * libpcap implementation too
  */
 
-#include <stdbool.h> // bool
-#include "packet.h"  // packet_t
+#include <stdio.h>       // FILE
+#include <stdbool.h>     // bool
+#include <sys/socket.h>  // struct mmsghdr
+#include <sys/uio.h>     // struct iovec
+#include <netinet/in.h>  // struct sockaddr_in6
+#include "packet.h"      // packet_t
 #include "use.h"
 
+#ifdef USE_PACKET_RING
+#  include "sniffer_ring.h" // sniffer_ring_t
+#endif
+
+#ifdef USE_KERNEL_FILTER
+#  include "sniffer_filter.h" // sniffer_filter_t
+#endif
+
+// Maximum number of packets fetched by a single recvmmsg() call
+#define SNIFFER_BATCH_SIZE 32
+
+/**
+ * \enum sniffer_backend_t
+ * \brief How a sniffer captures the packets.
+ */
+
+typedef enum {
+    SNIFFER_BACKEND_RAW,  /**< Raw ICMP sockets (default) */
+#ifdef USE_PACKET_RING
+    SNIFFER_BACKEND_RING  /**< AF_PACKET sockets and memory-mapped TPACKET_V3 rings */
+#endif
+} sniffer_backend_t;
+
 /**
  * \struct sniffer_t
  * \brief Structure representing a packet sniffer. The sniffer calls
@@ -20,16 +47,38 @@
  *    sniffer->recv_param may point to a queue_t instance and
  *    sniffer->recv_callback may be used to feed this queue whenever
  *    a packet is sniffed.
+ *    Packets are fetched by batch in a pool of buffers preallocated
+ *    once for all.
  */
 
 typedef struct {
+    sniffer_backend_t backend; /**< Backend used to capture the packets */
+#ifdef USE_IPV4
+    int     icmpv4_sockfd;  /**< Raw socket for sniffing ICMPv4 packets (or ring4's socket) */
+#endif
+#ifdef USE_IPV6
+    int     icmpv6_sockfd;  /**< Raw socket for sniffing ICMPv6 packets (or ring6's socket) */
+#endif
+#ifdef USE_PACKET_RING
+    sniffer_ring_t      * ring4;        /**< IPv4 ring (SNIFFER_BACKEND_RING only) */
+    sniffer_ring_t      * ring6;        /**< IPv6 ring (SNIFFER_BACKEND_RING only) */
+#endif
+#ifdef USE_KERNEL_FILTER
 #ifdef USE_IPV4
-    int     icmpv4_sockfd;  /**< Raw socket for sniffing ICMPv4 packets */
+    sniffer_filter_t      filter4;      /**< Filter attached to icmpv4_sockfd (SNIFFER_BACKEND_RAW only) */
 #endif
 #ifdef USE_IPV6
-    int     icmpv6_sockfd;  /**< Raw socket for sniffing ICMPv6 packets */
+    sniffer_filter_t      filter6;      /**< Filter attached to icmpv6_sockfd (SNIFFER_BACKEND_RAW only) */
+#endif
 #endif
     void  * recv_param;     /**< This pointer is passed whenever recv_callback is called */
+    uint8_t             * buffers;      /**< SNIFFER_BATCH_SIZE buffers storing the sniffed packets */
+    struct mmsghdr      * messages;     /**< SNIFFER_BATCH_SIZE messages passed to recvmmsg */
+    struct iovec        * iovecs;       /**< SNIFFER_BATCH_SIZE iovecs pointing to sniffer->buffers */
+#ifdef USE_IPV6
+    uint8_t             * cmsg_buffers; /**< SNIFFER_BATCH_SIZE buffers storing the IPv6 ancillary data */
+    struct sockaddr_in6 * from;         /**< SNIFFER_BATCH_SIZE sources of the sniffed IPv6 packets */
+#endif
     bool (* recv_callback)(packet_t * packet, void * recv_param); /**< Callback for received packets */
 } sniffer_t;
 
@@ -41,6 +90,23 @@ typedef struct {
 
 sniffer_t * sniffer_create(void * recv_param, bool (*recv_callback)(packet_t *, void *));
 
+/**
+ * \brief Creates a new sniffer using a given backend.
+ * \param recv_param This pointer is passed whenever recv_callback is called.
+ * \param recv_callback This function is called whenever a packet is sniffed.
+ * \param backend The backend used to capture the packets.
+ * \param ifname The interface to listen to (e.g. "veth0"), or NULL to listen
+ *    to every interface. Only relevant for SNIFFER_BACKEND_RING.
+ * \return Pointer to a sniffer_t structure representing a packet sniffer
+ */
+
+sniffer_t * sniffer_create_ext(
+    void              * recv_param,
+    bool             (* recv_callback)(packet_t *, void *),
+    sniffer_backend_t   backend,
+    const char        * ifname
+);
+
 /**
  * \brief Free a sniffer_t structure.
  * \param sniffer Points to a sniffer_t instance.
@@ -71,14 +137,38 @@ int sniffer_get_icmpv6_sockfd(sniffer_t * sniffer);
 #endif
 
 /**
- * \brief Fetch a packet from the listening socket. The sniffer then
- *   call recv_callback and pass to this function this packet and
- *   eventual data stored in sniffer->recv_packet. If this callback
- *   returns false, a message is printed.
+ * \brief Fetch every pending packet from the listening socket (up to
+ *   SNIFFER_BATCH_SIZE packets per recvmmsg() call). For each packet,
+ *   the sniffer then call recv_callback and pass to this function this
+ *   packet and eventual data stored in sniffer->recv_param. If this
+ *   callback returns false, a message is printed.
  * \param sniffer Points to a sniffer_t instance.
  * \param protocol_id The family of the packet to fetch (IPPROTO_ICMP, IPPROTO_ICMPV6)
  */
 
 void sniffer_process_packets(sniffer_t * sniffer, uint8_t protocol_id);
 
+/**
+ * \brief Notify the sniffer that probes having a given signature are
+ *   about to be sent, so that the kernel passes the ICMP errors related
+ *   to these probes. The kernel filter is only regenerated if this
+ *   signature is new. This does nothing if the kernel filter is disabled.
+ * \param sniffer Points to a sniffer_t instance.
+ * \param protocol_id The family of the expected replies (IPPROTO_ICMP, IPPROTO_ICMPV6)
+ * \param protocol The transport protocol of the probes (IPPROTO_UDP, IPPROTO_TCP...)
+ * \param dst_port The destination port of the probes (0 if not relevant)
+ * \return true iif successful
+ */
+
+bool sniffer_add_signature(sniffer_t * sniffer, uint8_t protocol_id, uint8_t protocol, uint16_t dst_port);
+
+/**
+ * \brief Print how many ICMP packets have been passed to and discarded by
+ *   the kernel filter.
+ * \param out The output stream.
+ * \param sniffer Points to a sniffer_t instance.
+ */
+
+void sniffer_fprintf_statistics(FILE * out, const sniffer_t * sniffer);
+
 #endif // LIBPT_SNIFFER_H
@@ -0,0 +1,210 @@
+#include "use.h"
+#include "config.h"
+
+#ifdef USE_KERNEL_FILTER
+
+#include <stdio.h>              // fopen, fscanf, perror
+#include <string.h>             // strcmp
+#include <sys/socket.h>         // setsockopt
+#include <netinet/in.h>         // IPPROTO_ICMP, IPPROTO_ICMPV6
+#include <netinet/ip_icmp.h>    // ICMP_ECHOREPLY, ICMP_TIME_EXCEEDED, ICMP_DEST_UNREACH
+#include <netinet/icmp6.h>      // ICMP6_ECHO_REPLY, ICMP6_TIME_EXCEEDED, ICMP6_DST_UNREACH
+
+#include "sniffer_filter.h"
+
+#define BPF_ACCEPT 0xffffffff   // Pass the whole packet to userspace
+#define BPF_REJECT 0            // Drop the packet
+
+// Offset of the quoted header in an ICMP error message
+#define ICMP_ERROR_HEADER_SIZE 8
+
+//---------------------------------------------------------------------------
+// Private functions
+//---------------------------------------------------------------------------
+
+/**
+ * \brief Read the host-wide number of ICMP (or ICMPv6) packets received.
+ * \param protocol_id IPPROTO_ICMP or IPPROTO_ICMPV6.
+ * \param pnum_in_msgs Where the counter is written.
+ * \return true iif successful.
+ */
+
+static bool read_icmp_in_msgs(uint8_t protocol_id, uint64_t * pnum_in_msgs)
+{
+    FILE               * file;
+    char                 name[64];
+    unsigned long long   value;
+    bool                 found = false, is_header = true;
+
+    switch (protocol_id) {
+        case IPPROTO_ICMP:
+            // "Icmp: InMsgs ..." followed by "Icmp: <InMsgs> ..."
+            if (!(file = fopen("/proc/net/snmp", "r"))) return false;
+            while (!found && fscanf(file, "%63s", name) == 1) {
+                if (strcmp(name, "Icmp:") == 0) {
+                    if (!is_header && fscanf(file, "%llu", &value) == 1) found = true;
+                    is_header = false;
+                }
+            }
+            break;
+        case IPPROTO_ICMPV6:
+            // "Icmp6InMsgs <InMsgs>"
+            if (!(file = fopen("/proc/net/snmp6", "r"))) return false;
+            while (!found && fscanf(file, "%63s %llu", name, &value) == 2) {
+                found = (strcmp(name, "Icmp6InMsgs") == 0);
+            }
+            break;
+        default:
+            return false;
+    }
+
+    fclose(file);
+    if (found) *pnum_in_msgs = value;
+    return found;
+}
+
+/**
+ * \brief Compile a filter into a classic BPF program.
+ *   IPv4 raw sockets pass the IP header to the filter, IPv6 raw sockets
+ *   only pass the ICMPv6 message. In both cases, X is set so that the
+ *   quoted transport header starts at X + ICMP_ERROR_HEADER_SIZE.
+ * \param filter A sniffer_filter_t instance.
+ * \param insns An array of at least SNIFFER_FILTER_MAX_INSNS instructions.
+ * \return The number of instructions, 0 in case of failure.
+ */
+
+static size_t sniffer_filter_compile(const sniffer_filter_t * filter, struct sock_filter * insns)
+{
+    size_t                      i, n = 0;
+    const sniffer_signature_t * signature;
+
+    switch (filter->protocol_id) {
+        case IPPROTO_ICMP:
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0);             // X = IP header length
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_LD  | BPF_B | BPF_IND, 0);             // A = ICMP type
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_ECHOREPLY, 0, 1);
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, BPF_ACCEPT);
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_TIME_EXCEEDED, 2, 0);
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP_DEST_UNREACH,  1, 0);
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, BPF_REJECT);
+            if (filter->match_any) break;
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_LD  | BPF_B | BPF_IND, ICMP_ERROR_HEADER_SIZE + 9); // A = quoted protocol
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_ST, 0);                                 // M[0] = A
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_LD  | BPF_B | BPF_IND, ICMP_ERROR_HEADER_SIZE);     // A = quoted IP header length
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xf);
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 2);
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0);
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0);                     // X = offset of the quoted transport header - 8
+            break;
+        case IPPROTO_ICMPV6:
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_LD  | BPF_B | BPF_ABS, 0);             // A = ICMPv6 type
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_ECHO_REPLY, 0, 1);
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, BPF_ACCEPT);
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_TIME_EXCEEDED, 2, 0);
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_DST_UNREACH,   1, 0);
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, BPF_REJECT);
+            if (filter->match_any) break;
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_LD  | BPF_B | BPF_ABS, ICMP_ERROR_HEADER_SIZE + 6); // A = quoted next header
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_ST, 0);                                 // M[0] = A
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_LDX | BPF_W | BPF_IMM, 40);            // X = IPv6 header length (no extension header)
+            break;
+        default:
+            fprintf(stderr, "sniffer_filter_compile: invalid protocol (%d)\n", filter->protocol_id);
+            return 0;
+    }
+
+    if (filter->match_any) {
+        insns[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, BPF_ACCEPT);
+        return n;
+    }
+
+    // Accept the packet as soon as the quoted header matches a signature
+    for (i = 0; i < filter->num_signatures; i++) {
+        signature = &filter->signatures[i];
+        insns[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_MEM, 0);                          // A = quoted protocol
+        if (signature->dst_port) {
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, signature->protocol, 0, 3);
+            insns[n++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_H | BPF_IND, ICMP_ERROR_HEADER_SIZE + 2); // A = quoted destination port
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, signature->dst_port, 0, 1);
+        } else {
+            insns[n++] = (struct sock_filter) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, signature->protocol, 0, 1);
+        }
+        insns[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, BPF_ACCEPT);
+    }
+    insns[n++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, BPF_REJECT);
+
+    return n;
+}
+
+//---------------------------------------------------------------------------
+// Public functions
+//---------------------------------------------------------------------------
+
+void sniffer_filter_init(sniffer_filter_t * filter, uint8_t protocol_id)
+{
+    filter->protocol_id    = protocol_id;
+    filter->num_signatures = 0;
+    filter->match_any      = true;
+    filter->num_received   = 0;
+    if (!read_icmp_in_msgs(protocol_id, &filter->num_in_msgs)) {
+        filter->num_in_msgs = 0;
+    }
+}
+
+bool sniffer_filter_add_signature(sniffer_filter_t * filter, const sniffer_signature_t * signature)
+{
+    size_t i;
+
+    for (i = 0; i < filter->num_signatures; i++) {
+        if (filter->signatures[i].protocol == signature->protocol
+        &&  filter->signatures[i].dst_port == signature->dst_port) {
+            return false;
+        }
+    }
+
+    if (filter->num_signatures == SNIFFER_FILTER_MAX_SIGNATURES) {
+        // Too many signatures, fall back to a filter only checking ICMP types
+        if (filter->match_any) return false;
+        filter->match_any = true;
+        return true;
+    }
+
+    filter->signatures[filter->num_signatures++] = *signature;
+    filter->match_any = false;
+    return true;
+}
+
+bool sniffer_filter_attach(sniffer_filter_t * filter, int sockfd)
+{
+    struct sock_filter insns[SNIFFER_FILTER_MAX_INSNS];
+    struct sock_fprog  program;
+
+    if (!(program.len = sniffer_filter_compile(filter, insns))) goto ERR_COMPILE;
+    program.filter = insns;
+
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) == -1) {
+        perror("sniffer_filter_attach: error in setsockopt");
+        goto ERR_SETSOCKOPT;
+    }
+
+    return true;
+
+ERR_SETSOCKOPT:
+ERR_COMPILE:
+    return false;
+}
+
+uint64_t sniffer_filter_get_num_filtered(const sniffer_filter_t * filter)
+{
+    uint64_t num_in_msgs, num_filtered = 0;
+
+    if (read_icmp_in_msgs(filter->protocol_id, &num_in_msgs)
+    &&  num_in_msgs >= filter->num_in_msgs
+    &&  num_in_msgs - filter->num_in_msgs > filter->num_received) {
+        num_filtered = num_in_msgs - filter->num_in_msgs - filter->num_received;
+    }
+
+    return num_filtered;
+}
+
+#endif // USE_KERNEL_FILTER
@@ -0,0 +1,98 @@
+#ifndef LIBPT_SNIFFER_FILTER_H
+#define LIBPT_SNIFFER_FILTER_H
+
+/**
+ * \file sniffer_filter.h
+ * \brief Header file: kernel-side filter of the sniffer raw sockets (Linux only).
+ *
+ * A raw ICMP socket receives every ICMP packet delivered to the host.
+ * A sniffer_filter_t compiles a classic BPF program attached to such a
+ * socket (SO_ATTACH_FILTER) so that the kernel only passes to userspace:
+ *  - echo replies,
+ *  - time exceeded and destination unreachable messages quoting a packet
+ *    which matches one of the signatures (transport protocol and
+ *    destination port) of the probes sent so far.
+ */
+
+#include "use.h"
+
+#ifdef USE_KERNEL_FILTER
+
+#include <stddef.h>        // size_t
+#include <stdint.h>        // uint*_t
+#include <stdbool.h>       // bool
+#include <linux/filter.h>  // struct sock_filter
+
+// Maximum number of signatures. Once exceeded, the filter no more inspects
+// the quoted packet and only checks the ICMP type.
+#define SNIFFER_FILTER_MAX_SIGNATURES 8
+
+// Maximum number of instructions of a compiled filter
+#define SNIFFER_FILTER_MAX_INSNS (16 + 5 * SNIFFER_FILTER_MAX_SIGNATURES)
+
+/**
+ * \struct sniffer_signature_t
+ * \brief Packets quoted in the ICMP errors we are interested in.
+ */
+
+typedef struct {
+    uint8_t  protocol; /**< Transport protocol of the probes (IPPROTO_UDP, IPPROTO_TCP, ...) */
+    uint16_t dst_port; /**< Destination port of the probes (0 if not relevant) */
+} sniffer_signature_t;
+
+/**
+ * \struct sniffer_filter_t
+ * \brief Kernel-side filter attached to a raw ICMP (or ICMPv6) socket.
+ */
+
+typedef struct {
+    uint8_t             protocol_id;    /**< IPPROTO_ICMP or IPPROTO_ICMPV6 */
+    sniffer_signature_t signatures[SNIFFER_FILTER_MAX_SIGNATURES]; /**< Signatures of the probes sent so far */
+    size_t              num_signatures; /**< Number of signatures */
+    bool                match_any;      /**< True once too many signatures have been added */
+    uint64_t            num_received;   /**< Number of packets passed by the kernel */
+    uint64_t            num_in_msgs;    /**< Host ICMP InMsgs counter when the filter was attached */
+} sniffer_filter_t;
+
+/**
+ * \brief Initialize a filter. No signature is registered, so the filter
+ *    only checks the ICMP type until sniffer_filter_add_signature is called.
+ * \param filter The filter to initialize.
+ * \param protocol_id IPPROTO_ICMP or IPPROTO_ICMPV6.
+ */
+
+void sniffer_filter_init(sniffer_filter_t * filter, uint8_t protocol_id);
+
+/**
+ * \brief Register a signature in a filter.
+ * \param filter A sniffer_filter_t instance.
+ * \param signature The signature of a probe.
+ * \return true iif the filter has changed and must be attached again.
+ */
+
+bool sniffer_filter_add_signature(sniffer_filter_t * filter, const sniffer_signature_t * signature);
+
+/**
+ * \brief Compile a filter into a classic BPF program and attach it to
+ *    a socket (the previous program, if any, is replaced).
+ * \param filter A sniffer_filter_t instance.
+ * \param sockfd The raw ICMP (or ICMPv6) socket.
+ * \return true iif successful.
+ */
+
+bool sniffer_filter_attach(sniffer_filter_t * filter, int sockfd);
+
+/**
+ * \brief Estimate how many ICMP packets have been discarded by the kernel
+ *    since the filter has been attached. This relies on the host-wide
+ *    ICMP InMsgs counter, so the packets handled while the filter was
+ *    not attached are not accounted.
+ * \param filter A sniffer_filter_t instance.
+ * \return The number of packets filtered out.
+ */
+
+uint64_t sniffer_filter_get_num_filtered(const sniffer_filter_t * filter);
+
+#endif // USE_KERNEL_FILTER
+
+#endif // LIBPT_SNIFFER_FILTER_H
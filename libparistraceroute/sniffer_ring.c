@@ -0,0 +1,221 @@
+#include "use.h"
+#include "config.h"
+
+#ifdef USE_PACKET_RING
+
+#include <stdlib.h>             // malloc, free
+#include <stdio.h>              // perror
+#include <string.h>             // memset
+#include <unistd.h>             // close
+#include <sys/socket.h>         // socket, bind, setsockopt
+#include <sys/mman.h>           // mmap, munmap
+#include <arpa/inet.h>          // htons
+#include <net/if.h>             // if_nametoindex
+#include <netinet/in.h>         // IPPROTO_ICMP, IPPROTO_ICMPV6
+#include <linux/if_packet.h>    // tpacket_req3, tpacket3_hdr, sockaddr_ll
+#include <linux/if_ether.h>     // ETH_P_IP, ETH_P_IPV6
+
+#include "sniffer_ring.h"
+
+#define SNIFFER_RING_BLOCK_SIZE   (1 << 17) // Must be a multiple of the page size
+#define SNIFFER_RING_NUM_BLOCKS   16
+#define SNIFFER_RING_FRAME_SIZE   2048
+#define SNIFFER_RING_BLOCK_TIMEOUT 1        // A non-full block is retired after 1ms
+
+//---------------------------------------------------------------------------
+// Private functions
+//---------------------------------------------------------------------------
+
+/**
+ * \brief Retrieve the i-th block of the ring.
+ * \param ring A sniffer_ring_t instance.
+ * \param i The index of the block.
+ * \return The address of the corresponding block descriptor.
+ */
+
+static inline struct tpacket_block_desc * sniffer_ring_get_block(const sniffer_ring_t * ring, size_t i) {
+    return (struct tpacket_block_desc *) (ring->blocks + i * ring->block_size);
+}
+
+/**
+ * \brief Check whether a captured packet is an ICMP (or an ICMPv6)
+ *    packet. This check is done in place, in the ring.
+ * \param ring A sniffer_ring_t instance.
+ * \param bytes The packet, starting from the IP header.
+ * \param num_bytes The number of bytes captured.
+ * \return true iif the packet must be passed to the network layer.
+ */
+
+static bool sniffer_ring_is_icmp(const sniffer_ring_t * ring, const uint8_t * bytes, size_t num_bytes) {
+    switch (ring->ethertype) {
+        case ETH_P_IP:
+            // Version and protocol fields
+            return num_bytes >= 20 && (bytes[0] >> 4) == 4 && bytes[9] == IPPROTO_ICMP;
+        case ETH_P_IPV6:
+            // Version and next header fields (extension headers are not supported)
+            return num_bytes >= 40 && (bytes[0] >> 4) == 6 && bytes[6] == IPPROTO_ICMPV6;
+        default:
+            return false;
+    }
+}
+
+/**
+ * \brief Process every packet stored in a block of the ring.
+ * \param ring A sniffer_ring_t instance.
+ * \param block The block to process.
+ * \param recv_callback See sniffer_ring_process_packets.
+ * \param recv_param See sniffer_ring_process_packets.
+ * \return The number of packets passed to recv_callback.
+ */
+
+static size_t sniffer_ring_process_block(
+    const sniffer_ring_t       * ring,
+    struct tpacket_block_desc  * block,
+    bool                      (* recv_callback)(packet_t *, void *),
+    void                       * recv_param
+) {
+    struct tpacket3_hdr * hdr;
+    struct sockaddr_ll  * sll;
+    uint8_t             * bytes;
+    packet_t            * packet;
+    size_t                i, num_packets = 0;
+
+    hdr = (struct tpacket3_hdr *) ((uint8_t *) block + block->hdr.bh1.offset_to_first_pkt);
+    for (i = 0; i < block->hdr.bh1.num_pkts; i++) {
+        sll   = (struct sockaddr_ll *) ((uint8_t *) hdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+        bytes = (uint8_t *) hdr + hdr->tp_mac; // SOCK_DGRAM: no link-layer header
+
+        // Our own probes (e.g. ICMP echo requests) are captured too.
+        if (sll->sll_pkttype != PACKET_OUTGOING
+        &&  sniffer_ring_is_icmp(ring, bytes, hdr->tp_snaplen)) {
+            // The reply outlives the block, so it is copied in a packet_t.
+            if (!(packet = packet_create_from_bytes(bytes, hdr->tp_snaplen))) {
+                fprintf(stderr, "sniffer_ring_process_block: Can't create packet\n");
+            } else {
+                if (!recv_callback(packet, recv_param)) {
+                    fprintf(stderr, "Error in sniffer's callback\n");
+                }
+                num_packets++;
+            }
+        }
+
+        hdr = (struct tpacket3_hdr *) ((uint8_t *) hdr + hdr->tp_next_offset);
+    }
+
+    return num_packets;
+}
+
+//---------------------------------------------------------------------------
+// Public functions
+//---------------------------------------------------------------------------
+
+sniffer_ring_t * sniffer_ring_create(uint16_t ethertype, const char * ifname)
+{
+    sniffer_ring_t      * ring;
+    struct sockaddr_ll    sll;
+    struct tpacket_req3   req;
+    int                   version = TPACKET_V3;
+
+    if (!(ring = malloc(sizeof(sniffer_ring_t)))) goto ERR_MALLOC;
+
+    ring->ethertype  = ethertype;
+    ring->block_size = SNIFFER_RING_BLOCK_SIZE;
+    ring->num_blocks = SNIFFER_RING_NUM_BLOCKS;
+    ring->cur_block  = 0;
+
+    // SOCK_DGRAM: packets are captured from their network header
+    if ((ring->sockfd = socket(AF_PACKET, SOCK_DGRAM | SOCK_NONBLOCK, htons(ethertype))) == -1) {
+        perror("sniffer_ring_create: error while creating socket");
+        goto ERR_SOCKET;
+    }
+
+    if (setsockopt(ring->sockfd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1) {
+        perror("sniffer_ring_create: TPACKET_V3 not supported");
+        goto ERR_SETSOCKOPT_VERSION;
+    }
+
+    memset(&req, 0, sizeof(struct tpacket_req3));
+    req.tp_block_size     = ring->block_size;
+    req.tp_block_nr       = ring->num_blocks;
+    req.tp_frame_size     = SNIFFER_RING_FRAME_SIZE;
+    req.tp_frame_nr       = (ring->block_size * ring->num_blocks) / SNIFFER_RING_FRAME_SIZE;
+    req.tp_retire_blk_tov = SNIFFER_RING_BLOCK_TIMEOUT;
+
+    if (setsockopt(ring->sockfd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1) {
+        perror("sniffer_ring_create: error while creating the ring");
+        goto ERR_SETSOCKOPT_RX_RING;
+    }
+
+    ring->blocks = mmap(NULL, ring->block_size * ring->num_blocks, PROT_READ | PROT_WRITE, MAP_SHARED, ring->sockfd, 0);
+    if (ring->blocks == MAP_FAILED) {
+        perror("sniffer_ring_create: error while mapping the ring");
+        goto ERR_MMAP;
+    }
+
+    memset(&sll, 0, sizeof(struct sockaddr_ll));
+    sll.sll_family   = AF_PACKET;
+    sll.sll_protocol = htons(ethertype);
+    if (ifname && !(sll.sll_ifindex = if_nametoindex(ifname))) {
+        fprintf(stderr, "sniffer_ring_create: unknown interface %s\n", ifname);
+        goto ERR_IF_NAMETOINDEX;
+    }
+
+    if (bind(ring->sockfd, (struct sockaddr *) &sll, sizeof(struct sockaddr_ll)) == -1) {
+        perror("sniffer_ring_create: error while binding the socket");
+        goto ERR_BIND;
+    }
+
+    return ring;
+
+ERR_BIND:
+ERR_IF_NAMETOINDEX:
+    munmap(ring->blocks, ring->block_size * ring->num_blocks);
+ERR_MMAP:
+ERR_SETSOCKOPT_RX_RING:
+ERR_SETSOCKOPT_VERSION:
+    close(ring->sockfd);
+ERR_SOCKET:
+    free(ring);
+ERR_MALLOC:
+    return NULL;
+}
+
+void sniffer_ring_free(sniffer_ring_t * ring) {
+    if (ring) {
+        munmap(ring->blocks, ring->block_size * ring->num_blocks);
+        close(ring->sockfd);
+        free(ring);
+    }
+}
+
+int sniffer_ring_get_fd(const sniffer_ring_t * ring) {
+    return ring->sockfd;
+}
+
+size_t sniffer_ring_process_packets(
+    sniffer_ring_t * ring,
+    bool          (* recv_callback)(packet_t *, void *),
+    void           * recv_param
+) {
+    struct tpacket_block_desc * block;
+    size_t                      i, num_blocks = 0, num_packets = 0;
+
+    // Process every block owned by the user...
+    for (num_blocks = 0; num_blocks < ring->num_blocks; num_blocks++) {
+        block = sniffer_ring_get_block(ring, (ring->cur_block + num_blocks) % ring->num_blocks);
+        if (!(block->hdr.bh1.block_status & TP_STATUS_USER)) break;
+        num_packets += sniffer_ring_process_block(ring, block, recv_callback, recv_param);
+    }
+
+    // ... and then give them back to the kernel at once.
+    __sync_synchronize();
+    for (i = 0; i < num_blocks; i++) {
+        block = sniffer_ring_get_block(ring, (ring->cur_block + i) % ring->num_blocks);
+        block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    }
+    ring->cur_block = (ring->cur_block + num_blocks) % ring->num_blocks;
+
+    return num_packets;
+}
+
+#endif // USE_PACKET_RING
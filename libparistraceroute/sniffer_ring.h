@@ -0,0 +1,84 @@
+#ifndef LIBPT_SNIFFER_RING_H
+#define LIBPT_SNIFFER_RING_H
+
+/**
+ * \file sniffer_ring.h
+ * \brief Header file: memory-mapped packet ring (Linux only).
+ *
+ * A sniffer_ring_t captures the packets of a given ethertype thanks to an
+ * AF_PACKET socket and a TPACKET_V3 receive ring shared with the kernel.
+ * Packets are inspected in place in the ring, so that the packets which
+ * are not ICMP replies (outgoing packets, other protocols) are skipped
+ * without being copied. Blocks of the ring are handed back to the kernel
+ * by batch once all their packets have been processed.
+ */
+
+#include "use.h"
+
+#ifdef USE_PACKET_RING
+
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint8_t, uint16_t
+#include <stdbool.h> // bool
+
+#include "packet.h"  // packet_t
+
+/**
+ * \struct sniffer_ring_t
+ * \brief Structure describing a TPACKET_V3 receive ring.
+ */
+
+typedef struct {
+    int       sockfd;     /**< AF_PACKET socket */
+    uint16_t  ethertype;  /**< Ethertype of the captured packets (ETH_P_IP or ETH_P_IPV6) */
+    uint8_t * blocks;     /**< The ring, mapped in memory */
+    size_t    block_size; /**< Size of a block (in bytes) */
+    size_t    num_blocks; /**< Number of blocks in the ring */
+    size_t    cur_block;  /**< Index of the next block to process */
+} sniffer_ring_t;
+
+/**
+ * \brief Create a receive ring.
+ * \param ethertype The ethertype of the packets to capture (ETH_P_IP or ETH_P_IPV6).
+ * \param ifname The name of the interface to listen to (e.g. "veth0"),
+ *    or NULL to listen to every interface.
+ * \return The newly created ring if successful, NULL otherwise.
+ */
+
+sniffer_ring_t * sniffer_ring_create(uint16_t ethertype, const char * ifname);
+
+/**
+ * \brief Release a receive ring from the memory.
+ * \param ring A sniffer_ring_t instance.
+ */
+
+void sniffer_ring_free(sniffer_ring_t * ring);
+
+/**
+ * \brief Retrieve the file descriptor activated whenever a block
+ *    of the ring is ready.
+ * \param ring A sniffer_ring_t instance.
+ * \return The corresponding file descriptor.
+ */
+
+int sniffer_ring_get_fd(const sniffer_ring_t * ring);
+
+/**
+ * \brief Process every block ready in the ring. For each incoming
+ *    ICMP (resp. ICMPv6) packet, a packet_t instance is built and passed
+ *    to recv_callback. The processed blocks are then released.
+ * \param ring A sniffer_ring_t instance.
+ * \param recv_callback The function called for each captured packet.
+ * \param recv_param The pointer passed to recv_callback.
+ * \return The number of packets passed to recv_callback.
+ */
+
+size_t sniffer_ring_process_packets(
+    sniffer_ring_t * ring,
+    bool          (* recv_callback)(packet_t *, void *),
+    void           * recv_param
+);
+
+#endif // USE_PACKET_RING
+
+#endif // LIBPT_SNIFFER_RING_H
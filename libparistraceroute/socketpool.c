@@ -61,6 +61,10 @@ socketpool_t * socketpool_create() {
     socketpool_t * socketpool;
     
     if (!(socketpool = malloc(sizeof(socketpool_t))))             goto ERR_MALLOC;
+    if (!(socketpool->messages  = calloc(SOCKETPOOL_BATCH_SIZE, sizeof(struct mmsghdr))))          goto ERR_MESSAGES;
+    if (!(socketpool->iovecs    = calloc(SOCKETPOOL_BATCH_SIZE, sizeof(struct iovec))))            goto ERR_IOVECS;
+    if (!(socketpool->addresses = calloc(SOCKETPOOL_BATCH_SIZE, sizeof(struct sockaddr_storage)))) goto ERR_ADDRESSES;
+    if (!(socketpool->indexes   = calloc(SOCKETPOOL_BATCH_SIZE, sizeof(size_t))))                  goto ERR_INDEXES;
 #ifdef USE_IPV4
     if (!(create_raw_socket(AF_INET,  &socketpool->ipv4_sockfd))) goto ERR_CREATE_RAW_SOCKET_IPV4;
 #endif
@@ -78,6 +82,14 @@ ERR_CREATE_RAW_SOCKET_IPV6:
 #ifdef USE_IPV4
 ERR_CREATE_RAW_SOCKET_IPV4:
 #endif
+    free(socketpool->indexes);
+ERR_INDEXES:
+    free(socketpool->addresses);
+ERR_ADDRESSES:
+    free(socketpool->iovecs);
+ERR_IOVECS:
+    free(socketpool->messages);
+ERR_MESSAGES:
     free(socketpool);
 ERR_MALLOC:
     return NULL;
@@ -95,47 +107,70 @@ void socketpool_free(socketpool_t * socketpool) {
             perror("socketpool_free: Error while closing IPv6 socket");
         }
 #endif
+        free(socketpool->indexes);
+        free(socketpool->addresses);
+        free(socketpool->iovecs);
+        free(socketpool->messages);
         free(socketpool);
     }
 }
 
-bool socketpool_send_packet(const socketpool_t * socketpool, const packet_t * packet)
+/**
+ * \brief Prepare the destination address of a packet.
+ * \param socketpool The socketpool to use
+ * \param packet The packet to send
+ * \param sock The sockaddr_u instance to fill
+ * \param psocklen Address of a socklen_t in which the size of the
+ *    meaningful part of *sock is written.
+ * \return The file descriptor of the socket to use, -1 in case of failure.
+ */
+
+static int socketpool_prepare_sockaddr(const socketpool_t * socketpool, const packet_t * packet, sockaddr_u * sock, socklen_t * psocklen)
 {
-	sockaddr_u              sock;
-    int                     sockfd;
-    socklen_t               socklen;
-    const struct sockaddr * dst_addr;
-    
-    memset(&sock, 0, sizeof(sockaddr_u));
+    int sockfd;
+
+    memset(sock, 0, sizeof(sockaddr_u));
 
     // Prepare socket 
     // We don't care about the dst_port set in the packet
     switch (packet->dst_ip->family) {
 #ifdef USE_IPV4
         case AF_INET:
-            sock.sin.sin_family = AF_INET;
-            sock.sin.sin_addr   = packet->dst_ip->ip.ipv4;
+            sock->sin.sin_family = AF_INET;
+            sock->sin.sin_addr   = packet->dst_ip->ip.ipv4;
             sockfd = socketpool->ipv4_sockfd;
-            socklen = sizeof(struct sockaddr_in);
-            dst_addr = (struct sockaddr *) &sock.sin;
+            *psocklen = sizeof(struct sockaddr_in);
             break;
 #endif
 #ifdef USE_IPV6
         case AF_INET6:
-            sock.sin6.sin6_family = AF_INET6;
-            memcpy(&sock.sin6.sin6_addr, &packet->dst_ip->ip.ipv6, sizeof(ipv6_t));
+            sock->sin6.sin6_family = AF_INET6;
+            memcpy(&sock->sin6.sin6_addr, &packet->dst_ip->ip.ipv6, sizeof(ipv6_t));
             sockfd = socketpool->ipv6_sockfd;
-            socklen = sizeof(struct sockaddr_in6);
-            dst_addr = (struct sockaddr *) &sock.sin6;
+            *psocklen = sizeof(struct sockaddr_in6);
             break;
 #endif
         default:
             fprintf(stderr, "socketpool_send_packet: Address family not supported\n");
-            goto ERR_INVALID_FAMILY;
+            sockfd = -1;
+            break;
+    }
+
+    return sockfd;
+}
+
+bool socketpool_send_packet(const socketpool_t * socketpool, const packet_t * packet)
+{
+    sockaddr_u  sock;
+    int         sockfd;
+    socklen_t   socklen;
+
+    if ((sockfd = socketpool_prepare_sockaddr(socketpool, packet, &sock, &socklen)) == -1) {
+        goto ERR_INVALID_FAMILY;
     }
 
     // Send the packet
-    if (sendto(sockfd, packet_get_bytes(packet), packet_get_size(packet), 0, dst_addr, socklen) == -1) {
+    if (sendto(sockfd, packet_get_bytes(packet), packet_get_size(packet), 0, &sock.sa, socklen) == -1) {
         perror("send_data: Sending error in queue");
         goto ERR_SEND_TO;
     }
@@ -146,3 +181,107 @@ ERR_SEND_TO:
 ERR_INVALID_FAMILY:
     return false;
 }
+
+/**
+ * \brief Send the messages prepared in socketpool->messages.
+ *    A message which cannot be sent is skipped and the
+ *    following ones are sent anyway.
+ * \param socketpool The socketpool to use
+ * \param sockfd The socket used to send the messages
+ * \param num_messages The number of messages to send
+ * \param sent See socketpool_send_packets
+ * \return The number of messages sent
+ */
+
+static size_t socketpool_flush_messages(socketpool_t * socketpool, int sockfd, size_t num_messages, bool * sent)
+{
+    size_t i = 0, j, num_sent = 0;
+    int    ret;
+
+    while (i < num_messages) {
+        if ((ret = sendmmsg(sockfd, socketpool->messages + i, num_messages - i, 0)) == -1) {
+            // The i-th message cannot be sent
+            perror("socketpool_send_packets: Sending error in queue");
+            i++;
+            continue;
+        }
+
+        for (j = 0; j < (size_t) ret; j++) {
+            sent[socketpool->indexes[i + j]] = true;
+        }
+        i += ret;
+        num_sent += ret;
+    }
+
+    return num_sent;
+}
+
+/**
+ * \brief Send every packet of a given address family.
+ * \param socketpool The socketpool to use
+ * \param family The address family of the packets to send
+ * \param packets See socketpool_send_packets
+ * \param num_packets See socketpool_send_packets
+ * \param sent See socketpool_send_packets
+ * \return The number of packets sent
+ */
+
+static size_t socketpool_send_packets_family(socketpool_t * socketpool, int family, packet_t * const * packets, size_t num_packets, bool * sent)
+{
+    size_t       i, num_messages = 0, num_sent = 0;
+    int          sockfd = -1;
+    socklen_t    socklen;
+    sockaddr_u * sock;
+
+    for (i = 0; i < num_packets; i++) {
+        if (packets[i]->dst_ip->family != family) continue;
+
+        sock = (sockaddr_u *) &socketpool->addresses[num_messages];
+        if ((sockfd = socketpool_prepare_sockaddr(socketpool, packets[i], sock, &socklen)) == -1) {
+            return num_sent;
+        }
+
+        socketpool->iovecs[num_messages].iov_base = packet_get_bytes(packets[i]);
+        socketpool->iovecs[num_messages].iov_len  = packet_get_size(packets[i]);
+        socketpool->messages[num_messages].msg_hdr = (struct msghdr) {
+            .msg_name    = sock,
+            .msg_namelen = socklen,
+            .msg_iov     = &socketpool->iovecs[num_messages],
+            .msg_iovlen  = 1
+        };
+        socketpool->indexes[num_messages] = i;
+
+        if (++num_messages == SOCKETPOOL_BATCH_SIZE) {
+            num_sent += socketpool_flush_messages(socketpool, sockfd, num_messages, sent);
+            num_messages = 0;
+        }
+    }
+
+    if (num_messages) {
+        num_sent += socketpool_flush_messages(socketpool, sockfd, num_messages, sent);
+    }
+
+    return num_sent;
+}
+
+size_t socketpool_send_packets(socketpool_t * socketpool, packet_t * const * packets, size_t num_packets, bool * sent)
+{
+    size_t i, num_sent = 0;
+
+    for (i = 0; i < num_packets; i++) {
+        sent[i] = false;
+    }
+
+#ifdef USE_IPV4
+    num_sent += socketpool_send_packets_family(socketpool, AF_INET,  packets, num_packets, sent);
+#endif
+#ifdef USE_IPV6
+    num_sent += socketpool_send_packets_family(socketpool, AF_INET6, packets, num_packets, sent);
+#endif
+
+    if (num_sent < num_packets) {
+        fprintf(stderr, "socketpool_send_packets: %zu packet(s) not sent\n", num_packets - num_sent);
+    }
+
+    return num_sent;
+}
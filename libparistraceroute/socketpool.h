@@ -1,9 +1,16 @@
 #ifndef LIBPT_SOCKETPOOL_H
 #define LIBPT_SOCKETPOOL_H
 
+#include <stddef.h>     // size_t
+#include <sys/socket.h> // struct mmsghdr, struct sockaddr_storage
+#include <sys/uio.h>    // struct iovec
+
 #include "packet.h"
 #include "use.h"
 
+// Maximum number of packets passed to a single sendmmsg() call
+#define SOCKETPOOL_BATCH_SIZE 64
+
 typedef struct {
 #ifdef USE_IPV4
     int ipv4_sockfd; /**< File descriptor of the IPv4 raw socket */
@@ -11,6 +18,10 @@ typedef struct {
 #ifdef USE_IPV6
     int ipv6_sockfd; /**< File descriptor of the IPv6 raw socket */
 #endif
+    struct mmsghdr          * messages;  /**< Messages passed to sendmmsg (SOCKETPOOL_BATCH_SIZE cells) */
+    struct iovec            * iovecs;    /**< Bytes of each message (SOCKETPOOL_BATCH_SIZE cells) */
+    struct sockaddr_storage * addresses; /**< Destination of each message (SOCKETPOOL_BATCH_SIZE cells) */
+    size_t                  * indexes;   /**< Index of the packet related to each message (SOCKETPOOL_BATCH_SIZE cells) */
 } socketpool_t;
 
 /**
@@ -38,4 +49,18 @@ void socketpool_free(socketpool_t * socketpool);
 
 bool socketpool_send_packet(const socketpool_t * socketpool, const packet_t * packet);
 
+/**
+ * \brief Sends several packets on the network using a socket from the pool.
+ *    Packets are grouped by address family and each group is sent
+ *    using sendmmsg() (one call per SOCKETPOOL_BATCH_SIZE packets).
+ * \param socketpool The socketpool to use
+ * \param packets The packets to send
+ * \param num_packets The number of packets to send
+ * \param sent An array of num_packets booleans. sent[i] is set to true
+ *    iif packets[i] has been sent.
+ * \return The number of packets sent
+ */
+
+size_t socketpool_send_packets(socketpool_t * socketpool, packet_t * const * packets, size_t num_packets, bool * sent);
+
 #endif // LIBPT_SOCKETPOOL_H
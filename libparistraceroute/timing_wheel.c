@@ -0,0 +1,299 @@
+#include "config.h"
+
+#include <stdlib.h>         // malloc, free
+#include <math.h>           // ceil, floor
+
+#include "timing_wheel.h"
+
+#define TIMING_WHEEL_SLOT_MASK (TIMING_WHEEL_NUM_SLOTS - 1)
+
+// Number of ticks covered by a slot of a given level
+#define TIMING_WHEEL_LEVEL_TICKS(level) ((uint64_t) 1 << (TIMING_WHEEL_SLOT_BITS * (level)))
+
+// Farthest delay (in ticks) that can be stored. It is one upper slot short
+// of the whole range so that a timer never lands in the current upper slot.
+#define TIMING_WHEEL_MAX_DELAY \
+    (TIMING_WHEEL_LEVEL_TICKS(TIMING_WHEEL_NUM_LEVELS) - TIMING_WHEEL_LEVEL_TICKS(TIMING_WHEEL_NUM_LEVELS - 1))
+
+//---------------------------------------------------------------------------
+// Private functions
+//---------------------------------------------------------------------------
+
+/**
+ * \brief Retrieve the index of the slot of a level matching a given tick.
+ * \param tick A tick.
+ * \param level A level.
+ * \return The index of the slot.
+ */
+
+static inline size_t timing_wheel_get_index(uint64_t tick, size_t level) {
+    return (tick >> (TIMING_WHEEL_SLOT_BITS * level)) & TIMING_WHEEL_SLOT_MASK;
+}
+
+/**
+ * \brief Check whether a slot is empty.
+ * \param head The sentinel of the slot.
+ * \return true iif the slot is empty.
+ */
+
+static inline bool timing_wheel_slot_is_empty(const timing_wheel_node_t * head) {
+    return head->next == head;
+}
+
+/**
+ * \brief Store a timer in the slot matching its expiration tick.
+ *    The level is the one of the most significant slot index in which
+ *    node->expires and wheel->now differ. The slot of a timer stored in
+ *    an upper level is thus always ahead of the current slot of this
+ *    level, and is cascaded when wheel->now reaches it.
+ * \param wheel A timing_wheel_t instance.
+ * \param node The timer. node->expires must be greater or equal to wheel->now.
+ */
+
+static void timing_wheel_insert(timing_wheel_t * wheel, timing_wheel_node_t * node)
+{
+    uint64_t              diff = node->expires ^ wheel->now;
+    size_t                level, slot;
+    timing_wheel_node_t * head;
+
+    // Timers beyond the range of the upper level are stored in the upper
+    // level (see TIMING_WHEEL_MAX_DELAY).
+    for (level = 0; level < TIMING_WHEEL_NUM_LEVELS - 1; level++) {
+        if (diff < TIMING_WHEEL_LEVEL_TICKS(level + 1)) break;
+    }
+
+    slot = timing_wheel_get_index(node->expires, level);
+    head = &wheel->slots[level][slot];
+
+    node->level = level;
+    node->slot  = slot;
+    node->prev  = head->prev;
+    node->next  = head;
+    head->prev->next = node;
+    head->prev       = node;
+    wheel->occupied[level] |= (uint64_t) 1 << slot;
+}
+
+/**
+ * \brief Remove a timer from its slot.
+ * \param wheel A timing_wheel_t instance.
+ * \param node The timer.
+ */
+
+static void timing_wheel_unlink(timing_wheel_t * wheel, timing_wheel_node_t * node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = NULL;
+
+    if (timing_wheel_slot_is_empty(&wheel->slots[node->level][node->slot])) {
+        wheel->occupied[node->level] &= ~((uint64_t) 1 << node->slot);
+    }
+}
+
+/**
+ * \brief Move every timer of a slot in a temporary list.
+ * \param wheel A timing_wheel_t instance.
+ * \param level The level of the slot.
+ * \param slot The index of the slot.
+ * \param list The sentinel of the temporary list.
+ */
+
+static void timing_wheel_detach_slot(timing_wheel_t * wheel, size_t level, size_t slot, timing_wheel_node_t * list)
+{
+    timing_wheel_node_t * head = &wheel->slots[level][slot];
+
+    if (timing_wheel_slot_is_empty(head)) {
+        list->prev = list->next = list;
+    } else {
+        list->next = head->next;
+        list->prev = head->prev;
+        list->next->prev = list;
+        list->prev->next = list;
+        head->prev = head->next = head;
+    }
+    wheel->occupied[level] &= ~((uint64_t) 1 << slot);
+}
+
+/**
+ * \brief Compute the next tick for which timing_wheel_process_tick has
+ *    something to do.
+ * \param wheel A timing_wheel_t instance. It must store at least one timer.
+ * \return The corresponding tick.
+ */
+
+static uint64_t timing_wheel_get_next_tick(const timing_wheel_t * wheel)
+{
+    uint64_t tick, next = UINT64_MAX, rotated;
+    size_t   level, index, distance;
+
+    for (level = 0; level < TIMING_WHEEL_NUM_LEVELS; level++) {
+        if (!wheel->occupied[level]) continue;
+
+        // Distance between the current slot and the next non-empty slot
+        index    = timing_wheel_get_index(wheel->now, level);
+        rotated  = (wheel->occupied[level] >> index) | (index ? wheel->occupied[level] << (TIMING_WHEEL_NUM_SLOTS - index) : 0);
+        distance = __builtin_ctzll(rotated);
+
+        if (level == 0) {
+            tick = wheel->now + distance;
+        } else {
+            // Tick at which this slot is cascaded. The current slot of an
+            // upper level only stores timers (distance == 0) if wheel->now
+            // is the first tick of this slot and has not been processed yet
+            // (see timing_wheel_insert).
+            tick = ((wheel->now >> (TIMING_WHEEL_SLOT_BITS * level)) + distance) << (TIMING_WHEEL_SLOT_BITS * level);
+        }
+
+        if (tick < next) next = tick;
+    }
+
+    return next;
+}
+
+/**
+ * \brief Process the tick wheel->now: cascade the upper slots reached at
+ *    this tick, then fire the timers of the current slot of the first level.
+ *    wheel->now is moved to the next tick before the callbacks are called,
+ *    so that a timer scheduled by a callback never lands in the slot being
+ *    fired.
+ * \param wheel A timing_wheel_t instance.
+ * \param callback See timing_wheel_advance.
+ * \param param See timing_wheel_advance.
+ * \return The number of timers fired.
+ */
+
+static size_t timing_wheel_process_tick(
+    timing_wheel_t * wheel,
+    void          (* callback)(void * element, void * param),
+    void           * param
+) {
+    timing_wheel_node_t   list, * node;
+    size_t                level, num_fired = 0;
+
+    // Cascade: the timers of the upper slot reached now are moved to lower levels
+    for (level = 1; level < TIMING_WHEEL_NUM_LEVELS; level++) {
+        if (timing_wheel_get_index(wheel->now, level - 1) != 0) break;
+        timing_wheel_detach_slot(wheel, level, timing_wheel_get_index(wheel->now, level), &list);
+        while (!timing_wheel_slot_is_empty(&list)) {
+            node = list.next;
+            list.next = node->next;
+            node->next->prev = &list;
+            timing_wheel_insert(wheel, node);
+        }
+    }
+
+    // Fire
+    timing_wheel_detach_slot(wheel, 0, timing_wheel_get_index(wheel->now, 0), &list);
+    wheel->now++;
+    while (!timing_wheel_slot_is_empty(&list)) {
+        node = list.next;
+        list.next = node->next;
+        node->next->prev = &list;
+        node->prev = node->next = NULL;
+        wheel->num_timers--;
+        num_fired++;
+        callback(node->element, param);
+    }
+
+    return num_fired;
+}
+
+//---------------------------------------------------------------------------
+// Public functions
+//---------------------------------------------------------------------------
+
+timing_wheel_t * timing_wheel_create(double tick, double origin)
+{
+    timing_wheel_t * wheel;
+    size_t           level, slot;
+
+    if (tick <= 0) goto ERR_INVALID_TICK;
+    if (!(wheel = malloc(sizeof(timing_wheel_t)))) goto ERR_MALLOC;
+
+    for (level = 0; level < TIMING_WHEEL_NUM_LEVELS; level++) {
+        for (slot = 0; slot < TIMING_WHEEL_NUM_SLOTS; slot++) {
+            wheel->slots[level][slot].prev = &wheel->slots[level][slot];
+            wheel->slots[level][slot].next = &wheel->slots[level][slot];
+        }
+        wheel->occupied[level] = 0;
+    }
+    wheel->now        = 0;
+    wheel->origin     = origin;
+    wheel->tick       = tick;
+    wheel->num_timers = 0;
+    return wheel;
+
+ERR_MALLOC:
+ERR_INVALID_TICK:
+    return NULL;
+}
+
+void timing_wheel_free(timing_wheel_t * wheel) {
+    if (wheel) free(wheel);
+}
+
+void timing_wheel_node_init(timing_wheel_node_t * node) {
+    node->prev = node->next = NULL;
+    node->element = NULL;
+}
+
+void timing_wheel_add(timing_wheel_t * wheel, timing_wheel_node_t * node, double deadline, void * element)
+{
+    double ticks = ceil((deadline - wheel->origin) / wheel->tick);
+
+    // Expired deadlines fire at the next call to timing_wheel_advance
+    node->expires = ticks > wheel->now ? (uint64_t) ticks : wheel->now;
+    if (node->expires - wheel->now > TIMING_WHEEL_MAX_DELAY) {
+        node->expires = wheel->now + TIMING_WHEEL_MAX_DELAY;
+    }
+    node->element = element;
+    timing_wheel_insert(wheel, node);
+    wheel->num_timers++;
+}
+
+void timing_wheel_del(timing_wheel_t * wheel, timing_wheel_node_t * node)
+{
+    if (timing_wheel_node_is_scheduled(node)) {
+        timing_wheel_unlink(wheel, node);
+        wheel->num_timers--;
+    }
+}
+
+size_t timing_wheel_advance(
+    timing_wheel_t * wheel,
+    double           now,
+    void          (* callback)(void * element, void * param),
+    void           * param
+) {
+    double   ticks = floor((now - wheel->origin) / wheel->tick);
+    uint64_t target, next;
+    size_t   num_fired = 0;
+
+    if (ticks < wheel->now) return 0;
+    target = (uint64_t) ticks;
+
+    // Jump from one relevant tick to the next one
+    while (wheel->now <= target) {
+        if (wheel->num_timers == 0
+        || (next = timing_wheel_get_next_tick(wheel)) > target) {
+            wheel->now = target + 1;
+            break;
+        }
+        if (next > wheel->now) wheel->now = next;
+        num_fired += timing_wheel_process_tick(wheel, callback, param);
+    }
+
+    return num_fired;
+}
+
+bool timing_wheel_get_next_deadline(const timing_wheel_t * wheel, double * pdeadline)
+{
+    if (wheel->num_timers == 0) return false;
+    *pdeadline = wheel->origin + timing_wheel_get_next_tick(wheel) * wheel->tick;
+    return true;
+}
+
+size_t timing_wheel_get_size(const timing_wheel_t * wheel) {
+    return wheel->num_timers;
+}
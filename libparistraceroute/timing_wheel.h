@@ -0,0 +1,147 @@
+#ifndef LIBPT_TIMING_WHEEL_H
+#define LIBPT_TIMING_WHEEL_H
+
+/**
+ * \file timing_wheel.h
+ * \brief Header file: hierarchical timing wheel.
+ *
+ * A timing_wheel_t stores deadlines rounded up to the next tick. Each level
+ * is made of TIMING_WHEEL_NUM_SLOTS slots, and a slot of level l covers
+ * TIMING_WHEEL_NUM_SLOTS^l ticks. Scheduling and cancelling a timer costs
+ * O(1). Timers stored in the upper levels are cascaded to the lower levels
+ * when their slot is reached, and every timer of a slot is fired at once.
+ *
+ * Timers are intrusive: the caller embeds a timing_wheel_node_t in the
+ * structure to schedule, so that the wheel never allocates memory.
+ */
+
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint*_t
+#include <stdbool.h> // bool
+
+#define TIMING_WHEEL_SLOT_BITS  6
+#define TIMING_WHEEL_NUM_SLOTS  (1 << TIMING_WHEEL_SLOT_BITS)
+#define TIMING_WHEEL_NUM_LEVELS 4
+
+/**
+ * \struct timing_wheel_node_t
+ * \brief A timer stored in a timing wheel.
+ */
+
+typedef struct timing_wheel_node_s {
+    struct timing_wheel_node_s * prev;    /**< Previous timer of the slot (NULL if not scheduled) */
+    struct timing_wheel_node_s * next;    /**< Next timer of the slot */
+    uint64_t                     expires; /**< Tick at which this timer fires */
+    void                       * element; /**< Element passed to the callback when this timer fires */
+    uint8_t                      level;   /**< Level storing this timer */
+    uint8_t                      slot;    /**< Slot storing this timer */
+} timing_wheel_node_t;
+
+/**
+ * \struct timing_wheel_t
+ * \brief Structure describing a timing wheel.
+ */
+
+typedef struct {
+    timing_wheel_node_t slots[TIMING_WHEEL_NUM_LEVELS][TIMING_WHEEL_NUM_SLOTS]; /**< Sentinels of the slots */
+    uint64_t            occupied[TIMING_WHEEL_NUM_LEVELS]; /**< Bitmaps of the non-empty slots */
+    uint64_t            now;        /**< Next tick to process */
+    double              origin;     /**< Timestamp of the tick 0 */
+    double              tick;       /**< Duration of a tick (in seconds) */
+    size_t              num_timers; /**< Number of scheduled timers */
+} timing_wheel_t;
+
+/**
+ * \brief Create a timing wheel.
+ * \param tick The duration of a tick (in seconds). Deadlines are
+ *    rounded up to a multiple of this value.
+ * \param origin The current timestamp.
+ * \return The newly created timing wheel if successful, NULL otherwise.
+ */
+
+timing_wheel_t * timing_wheel_create(double tick, double origin);
+
+/**
+ * \brief Release a timing wheel from the memory. The scheduled
+ *    timers are not fired.
+ * \param wheel A timing_wheel_t instance.
+ */
+
+void timing_wheel_free(timing_wheel_t * wheel);
+
+/**
+ * \brief Initialize a timer.
+ * \param node The timer.
+ */
+
+void timing_wheel_node_init(timing_wheel_node_t * node);
+
+/**
+ * \brief Check whether a timer is scheduled.
+ * \param node The timer.
+ * \return true iif the timer is stored in a timing wheel.
+ */
+
+static inline bool timing_wheel_node_is_scheduled(const timing_wheel_node_t * node) {
+    return node->prev != NULL;
+}
+
+/**
+ * \brief Schedule a timer. Deadlines too far in the future (i.e. beyond
+ *    the range of the upper level) are brought forward to the farthest
+ *    deadline that the wheel can store.
+ * \param wheel A timing_wheel_t instance.
+ * \param node The timer. It must not be scheduled.
+ * \param deadline When the timer must fire (timestamp).
+ * \param element The element passed to the callback when the timer fires.
+ */
+
+void timing_wheel_add(timing_wheel_t * wheel, timing_wheel_node_t * node, double deadline, void * element);
+
+/**
+ * \brief Cancel a timer. This does nothing if the timer is not scheduled.
+ * \param wheel A timing_wheel_t instance.
+ * \param node The timer.
+ */
+
+void timing_wheel_del(timing_wheel_t * wheel, timing_wheel_node_t * node);
+
+/**
+ * \brief Fire every timer having expired at a given moment.
+ *    The timers are unscheduled before the callback is called, so that
+ *    the callback may safely schedule or cancel other timers.
+ * \param wheel A timing_wheel_t instance.
+ * \param now The current timestamp.
+ * \param callback The function called on the element of each expired timer.
+ * \param param The second parameter passed to the callback.
+ * \return The number of timers fired.
+ */
+
+size_t timing_wheel_advance(
+    timing_wheel_t * wheel,
+    double           now,
+    void          (* callback)(void * element, void * param),
+    void           * param
+);
+
+/**
+ * \brief Retrieve when timing_wheel_advance must be called next. This
+ *    is the deadline of the earliest timer if it is stored in the first
+ *    level, or the moment when the earliest non-empty slot of an upper
+ *    level is cascaded.
+ * \param wheel A timing_wheel_t instance.
+ * \param pdeadline Where the deadline is written.
+ * \return true iif at least one timer is scheduled.
+ */
+
+bool timing_wheel_get_next_deadline(const timing_wheel_t * wheel, double * pdeadline);
+
+/**
+ * \brief Retrieve the number of scheduled timers.
+ * \param wheel A timing_wheel_t instance.
+ * \return The number of scheduled timers.
+ */
+
+size_t timing_wheel_get_size(const timing_wheel_t * wheel);
+
+#endif // LIBPT_TIMING_WHEEL_H
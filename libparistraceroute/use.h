@@ -17,4 +17,26 @@
 // Enable scheduling of probes
 #define USE_SCHEDULING
 
+// Enable the memory-mapped packet ring sniffer backend (Linux only)
+#ifdef __linux__
+#  define USE_PACKET_RING
+#endif
+
+// Enable the kernel-side filtering of the sniffed ICMP packets (Linux only)
+#ifdef __linux__
+#  define USE_KERNEL_FILTER
+#endif
+
+// Enable the object pools (see pool.h)
+#define USE_POOLS
+
+// Enable the SIMD implementations of the Internet checksum
+#if defined(__x86_64__) || defined(__aarch64__)
+#  define USE_SIMD_CHECKSUM
+#endif
+
+// Cross-check each incremental checksum update against a full
+// recomputation, and report the mismatches on stderr (debug only)
+//#define USE_CHECKSUM_VERIFICATION
+
 #endif // LIBPT_USE_H
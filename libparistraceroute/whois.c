@@ -12,26 +12,23 @@
 #include <unistd.h>     // close
 
 #ifdef USE_CACHE
-#    include "containers/map.h"
+#    include "containers/hashmap.h"
 
-static map_t * cache_ip_asn = NULL;
+// address_t => uint32_t (ASN)
+static hashmap_t * cache_ip_asn = NULL;
 
 static void __cache_ip_asn_create() __attribute__((constructor));
 static void __cache_ip_asn_free()   __attribute__((destructor));
 
-static void str_dump(const char * s) {
-    printf("%s (%p)", s, s);
-}
-
 static void __cache_ip_asn_create() {
-    cache_ip_asn = map_create(
-        address_dup, address_free, address_dump, address_compare,
-        strdup,      free,         str_dump
+    cache_ip_asn = hashmap_create(
+        sizeof(address_t), sizeof(uint32_t),
+        address_hash, address_compare
     );
 }
 
 static void __cache_ip_asn_free() {
-    if (cache_ip_asn) map_free(cache_ip_asn);
+    if (cache_ip_asn) hashmap_free(cache_ip_asn);
 }
 
 #endif
@@ -241,50 +238,27 @@ bool whois_get_asn(
     uint32_t        * asn,
     int               mask_cache
 ) {
-    bool ret = true;
-
-	// FIXME
-/*
-
-	// valgrind error in map
-
-	address_get_size: Invalid family==6139== Invalid read of size 1
-	==6139==    at 0x4E42696: address_compare (address.c:183)
-	==6139==    by 0x514414F: tfind (in /lib/x86_64-linux-gnu/libc-2.22.so)
-	==6139==    by 0x4E47D39: set_find (set.c:70)
-	==6139==    by 0x4E477A8: map_find_impl (map.c:145)
-	==6139==    by 0x4E521BB: whois_get_asn (whois.c:249)
-	==6139==    by 0x400917: main (traceroute.c:99)
-	==6139==  Address 0xffffffffffffffff is not stack'd, malloc'd or (recently) free'd
-*/
-
-/*
+    bool       ret = false;
 #ifdef USE_CACHE
-    if (cache_ip_asn && (mask_cache & CACHE_READ)) {
-
-        address_dump(queried_address);
-		printf("\n");
+    uint32_t * pcached;
 
-        ret = map_find(cache_ip_asn, queried_address, asn);
-
-		if (ret) printf("hit cache!");
-        address_dump(queried_address);
-		printf("\n");
+    if (cache_ip_asn && (mask_cache & CACHE_READ)) {
+        if ((pcached = hashmap_find(cache_ip_asn, queried_address))) {
+            *asn = *pcached;
+            ret = true;
+        }
     }
 
     if (!ret) {
 #endif
-*/
         whois(queried_address, whois_callback_get_asn, asn);
-		ret = (*asn != 0);
-/*
+        ret = (*asn != 0);
 #ifdef USE_CACHE
-        if (mask_cache & CACHE_WRITE) {
-            map_update(cache_ip_asn, queried_address, asn_dup);
+        if (ret && cache_ip_asn && (mask_cache & CACHE_WRITE)) {
+            hashmap_update(cache_ip_asn, queried_address, asn);
         }
     }
 #endif
-*/
     return ret;
 }
 
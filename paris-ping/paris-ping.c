@@ -269,7 +269,8 @@ void loop_handler(pt_loop_t * loop, event_t * event, void * user_data)
         default:
             break;
     }
-    event_free(event);
+
+    // The event is released by the loop once this handler returns
 }
 
 const char * get_ip_protocol_name(int family) {
@@ -384,7 +385,7 @@ int main(int argc, char ** argv)
         NULL
     );
 
-    probe_set_field(probe, ADDRESS("dst_ip", &dst_addr));
+    probe_set_address(probe, "dst_ip", &dst_addr);
 
     if (src_ip.s) {  // true if user has specified an interface address (-I)
         if (is_ipv4) {
@@ -399,13 +400,13 @@ int main(int argc, char ** argv)
             fprintf(stderr, "E: Invalid source address %s\n", src_ip.s);
             goto ERR_ADDRESS_IP_FROM_STRING;
         } else {
-            probe_set_field(probe, ADDRESS("src_ip", &src_addr));
+            probe_set_address(probe, "src_ip", &src_addr);
         }
     }
 
     probe_set_delay(probe, DOUBLE("delay", send_time[0]));
 
-    probe_set_field(probe, I8("ttl", max_ttl[0]));
+    probe_set_uint8(probe, "ttl", max_ttl[0]);
 
     // TODO fix BITS(x, y)
     /*
@@ -514,6 +515,7 @@ ERR_ADDRESS_GUESS_FAMILY:
     if (errno) perror(gai_strerror(errno));
 ERR_CHECK_OPTIONS:
 ERR_OPT_PARSE:
+    options_free(options);
 ERR_INIT_OPTIONS:
     free(version);
     exit(exit_code);
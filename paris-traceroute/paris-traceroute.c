@@ -220,6 +220,9 @@ void loop_handler(pt_loop_t * loop, event_t * event, void * user_data)
                 lattice_dump(mda_data->lattice, (ELEMENT_DUMP) mda_lattice_elt_dump);
                 printf("\n");
                 mda_data_free(mda_data);
+            } else if (strcmp(algorithm_name, "traceroute") == 0) {
+                // The instance is deleted before handling ALGORITHM_TERM
+                traceroute_data_free(event->issuer->data);
             }
 
             // Tell to the algorithm it can free its data
@@ -256,7 +259,8 @@ void loop_handler(pt_loop_t * loop, event_t * event, void * user_data)
         default:
             break;
     }
-    event_free(event);
+
+    // The event is released by the loop once this handler returns
 }
 
 const char * get_ip_protocol_name(int family) {
@@ -373,7 +377,7 @@ int main(int argc, char ** argv)
         NULL
     );
 
-    probe_set_field(probe, ADDRESS("dst_ip", &dst_addr));
+    probe_set_address(probe, "dst_ip", &dst_addr);
 
     if (send_time[3]) {
         if(send_time[0] <= 10) { // seconds
@@ -475,6 +479,7 @@ ERR_ADDRESS_GUESS_FAMILY:
     if (errno) perror(gai_strerror(errno));
 ERR_CHECK_OPTIONS:
 ERR_OPT_PARSE:
+    options_free(options);
 ERR_INIT_OPTIONS:
     free(version);
     exit(exit_code);
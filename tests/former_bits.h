@@ -0,0 +1,191 @@
+#ifndef LIBPT_TESTS_FORMER_BITS_H
+#define LIBPT_TESTS_FORMER_BITS_H
+
+/**
+ * \file former_bits.h
+ * \brief bits_extract and bits_write as they were implemented before
+ *    they moved bits through 64-bit words (see bits.c). test_bits compares
+ *    them with the current implementation, and bench_bits measures both.
+ *
+ * The code is unchanged, except that its assertions are removed: the
+ * former implementation returns wrong bits for some fields, and these
+ * cases must be reported rather than abort the program. It only supports
+ * offsets lower than 8 bits.
+ */
+
+#include <stdlib.h>  // calloc
+#include <stdio.h>   // fprintf
+#include <string.h>  // memcpy
+#include <stdint.h>  // uint8_t
+#include <stdbool.h> // bool
+
+#include "bits.h"    // byte_extract, byte_write_bits
+#include "common.h"  // MIN, MAX
+
+static uint8_t * former_bits_extract(
+    const uint8_t * bytes,
+    size_t          offset_in_bits,
+    size_t          length_in_bits,
+    uint8_t       * dest
+) {
+    size_t  i          = offset_in_bits >> 3,
+            idest      = 0,
+            j,
+            num_bits   = length_in_bits % 8,  // Number of bits extracted from the first byte
+            num_bytes  = length_in_bits >> 3, // Number of complete byte to extract
+            offset     = (offset_in_bits + num_bits) % 8,
+            size       = num_bytes + (num_bits ? 1 : 0);
+    uint8_t msb, lsb;
+    bool    is_aligned = ((offset_in_bits + length_in_bits % 8) == 0);
+
+    // Allocate the destination buffer
+    if (!dest) {
+        if (!(dest = calloc(1, size))) goto ERR_CALLOC;
+    }
+
+    // Grab the n first bits from the first relevant byte (i)
+    // and store them in the 1st destination byte.
+    if (num_bits) {
+        dest[idest++] = byte_extract(bytes[i++], offset_in_bits, num_bits, 8 - num_bits);
+    }
+
+    // Retrieve the num_bytes remaining bytes to duplicate
+    // into dest.
+    for (j = 0; j < num_bytes; ++j, ++idest, ++i) {
+        if (is_aligned) {
+            dest[idest] = bytes[i];
+        } else {
+            // Fetch the 'idest'-th byte of 'dest'
+            // - its 'offset' most significant bits are in bytes[i-1]
+            // - its remaining less significant bits are in bytes[i]
+            msb = byte_extract(bytes[i - 1], offset, 8 - offset, 0);
+            lsb = byte_extract(bytes[i], 0, offset, 8 - offset);
+            dest[idest] = msb | lsb;
+        }
+    }
+
+    return dest;
+
+ERR_CALLOC:
+    return NULL;
+}
+
+#define FORMER_BITS_MOVE(p, offset, num_bits) \
+  p     += (offset + num_bits) >> 3; \
+  offset = (offset + num_bits) % 8
+
+static bool former_bits_write(
+    uint8_t       * out,
+    const size_t    offset_in_bits_out,
+    const uint8_t * in,
+    const size_t    offset_in_bits_in,
+    size_t          length_in_bits
+) {
+    bool success = true;
+
+    // Notations:
+    //   . bit not modified
+    //   X bit being updated (same for Y) at this step.
+    //   * bit to be update, but not in this step.
+    //   | corresponds to byte bounds in the output.
+    // Principle:
+    //   Writting .....**|********|** is achieved in three steps.
+    // Steps:
+    //   1) Write .....XX|********|**.....
+    //   2) Write .....**|XXXXXXXX|**....
+    //   3) Write .....**|********|XX....
+
+    size_t num_remaining_bits = length_in_bits;
+    size_t n;
+    size_t offset_out = offset_in_bits_out;
+    size_t offset_in  = offset_in_bits_in;
+
+    if (offset_in  >= 8) {
+        fprintf(stderr, "former_bits_write: offset_in (%zu) must be < 8\n", offset_in);
+        return false;
+    }
+    if (offset_out  >= 8) {
+        fprintf(stderr, "former_bits_write: offset_out (%zu) must be < 8\n", offset_out);
+        return false;
+    }
+
+    // 1st output (incomplete) byte:
+    if (offset_out) {
+
+        // Case 1:
+        //     in: |.....XXX|YY******|
+        //    out: |...XXXYY|********|
+        // Case 2:
+        //     in: |...XXX**|********|
+        //    out: |.....XXX|********|
+        // Case 3:
+        //     in: |XXX*****|
+        //    out: |.....XXX|
+
+        // Cases 1, 2, 3: Write XXX
+        n = MIN(8 - MAX(offset_in, offset_out), num_remaining_bits);
+        success &= byte_write_bits(out, offset_out, *in, offset_in, n);
+        num_remaining_bits -= n;
+        FORMER_BITS_MOVE(out, offset_out, n);
+        FORMER_BITS_MOVE(in,  offset_in,  n);
+
+        // If case 1: Write YY|
+        if (offset_out) {
+            n = MIN(8 - n - offset_out, num_remaining_bits);
+            success &= byte_write_bits(out, offset_out, *in, offset_in, n);
+            num_remaining_bits -= n;
+            FORMER_BITS_MOVE(out, offset_out, n);
+            FORMER_BITS_MOVE(in,  offset_in,  n);
+        }
+    }
+
+    // Full output bytes
+    if (!offset_in) {
+        n = num_remaining_bits >> 3;
+        memcpy(out, in, n);
+        num_remaining_bits -= n << 3;
+    } else {
+        for (; num_remaining_bits >= 8; num_remaining_bits -= 8) {
+            //  in: |***XXXXX|YYY.....
+            // out: |XXXXXYYY|
+
+            // Write |XXXXX***|
+            n = MIN(8 - offset_in, num_remaining_bits);
+            success &= byte_write_bits(out, offset_out, *in, offset_in, n);
+            FORMER_BITS_MOVE(out, offset_out, n);
+            FORMER_BITS_MOVE(in,  offset_in,  n);
+
+            // Write |*****YYY|
+            n = MIN(8 - n, num_remaining_bits);
+            success &= byte_write_bits(out, offset_out, *in, offset_in, n);
+            FORMER_BITS_MOVE(out, offset_out, n);
+            FORMER_BITS_MOVE(in,  offset_in,  n);
+        }
+    }
+
+    // Last byte
+    n = num_remaining_bits;
+    if (n) {
+        // Case1:
+        //    in: |**XXX...|
+        //   out: |XXX.....|
+        // Case2:
+        //    in: |*****XXX|YY......
+        //   out: |XXXYY...|
+
+        // Case 1, 2: Write XXX
+        n = MIN(8 - offset_in, num_remaining_bits);
+        success &= byte_write_bits(out, offset_out, *in, offset_in, n);
+        num_remaining_bits -= n;
+
+        // Case 2: Write YY (if any)
+        if (num_remaining_bits) {
+            n = num_remaining_bits;
+            success &= byte_write_bits(out, 0, *in, offset_in, n);
+        }
+    }
+
+    return success;
+}
+
+#endif // LIBPT_TESTS_FORMER_BITS_H
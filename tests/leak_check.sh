@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Run a full traceroute toward 127.0.0.1 and ::1, with the paris-traceroute and
+# the mda algorithms, with paris-traceroute built with AddressSanitizer (see
+# tests/Makefile.am). The test fails if a memory error or a leak is detected,
+# and is skipped if paris-traceroute cannot create its raw sockets (make check
+# must then be run as root).
+#
+
+PARIS_TRACEROUTE=./paris-traceroute-asan
+OUTPUT=leak_check.out
+
+# A traceroute toward the local host takes a few seconds
+if command -v timeout > /dev/null; then
+    PARIS_TRACEROUTE="timeout 120 $PARIS_TRACEROUTE"
+fi
+
+ASAN_OPTIONS="detect_leaks=1:abort_on_error=0:exitcode=23"
+export ASAN_OPTIONS
+
+status=0
+for target in 127.0.0.1 ::1; do
+    for algorithm in paris-traceroute mda; do
+        for pools in "" --no-pools; do
+            echo "paris-traceroute -n -a $algorithm $pools $target"
+            $PARIS_TRACEROUTE -n -a $algorithm $pools $target > $OUTPUT 2>&1
+            ret=$?
+            cat $OUTPUT
+
+            if grep -q "Cannot create a raw socket" $OUTPUT; then
+                echo "SKIP: paris-traceroute requires raw sockets"
+                rm -f $OUTPUT
+                exit 77
+            fi
+
+            if [ $ret -ne 0 ] || grep -q "Sanitizer" $OUTPUT; then
+                echo "FAIL: paris-traceroute -n -a $algorithm $pools $target (exit status: $ret)"
+                status=1
+            fi
+        done
+    done
+done
+
+rm -f $OUTPUT
+exit $status
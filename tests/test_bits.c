@@ -0,0 +1,213 @@
+/**
+ * \file test_bits.c
+ * \brief Randomized differential test of bits_extract and bits_write
+ *    (see bits.h) against their former implementation (see former_bits.h).
+ *
+ * Each random case is checked against a bit-by-bit model, which is the
+ * reference: the test fails iif the current implementation disagrees
+ * with the model. The former implementation is run on the same cases
+ * whenever it supports them (offsets lower than 8 bits), and the cases
+ * where it disagrees with the current one are counted and reported; each
+ * of them must be a case where the former implementation was wrong.
+ *
+ * Usage: test_bits [num_cases [seed]]
+ */
+
+#include <stdlib.h>        // malloc, free, rand
+#include <stdio.h>         // printf, fflush
+#include <unistd.h>        // dup, dup2, close
+#include <fcntl.h>         // open
+#include <string.h>        // memcmp, memcpy, memset
+#include <stdint.h>        // uint8_t
+#include <stdbool.h>       // bool
+
+#include "bits.h"          // bits_extract, bits_write
+#include "former_bits.h"   // former_bits_extract, former_bits_write
+
+#define NUM_CASES    1000000
+#define MAX_OFFSET   64
+#define MAX_NUM_BITS 160
+#define MAX_BYTES    ((MAX_OFFSET + MAX_NUM_BITS + 7) / 8)
+
+typedef struct {
+    size_t num_cases;   /**< Number of cases checked */
+    size_t num_errors;  /**< Number of cases where the current implementation is wrong */
+    size_t num_former;  /**< Number of cases run by the former implementation */
+    size_t num_fixed;   /**< Number of cases where the former implementation was wrong */
+} stats_t;
+
+// The former implementation complains on the standard error about some
+// of the cases it gets wrong: it is silenced while it runs.
+static int null_fd = -1;
+
+static int quiet_begin() {
+    int fd;
+
+    fflush(stderr);
+    fd = dup(STDERR_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+    return fd;
+}
+
+static void quiet_end(int fd) {
+    fflush(stderr);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+}
+
+static inline bool model_get_bit(const uint8_t * bytes, size_t i) {
+    return (bytes[i / 8] >> (7 - i % 8)) & 1;
+}
+
+static inline void model_set_bit(uint8_t * bytes, size_t i, bool value) {
+    if (value) {
+        bytes[i / 8] |=  (1 << (7 - i % 8));
+    } else {
+        bytes[i / 8] &= ~(1 << (7 - i % 8));
+    }
+}
+
+/**
+ * \brief Bit-by-bit model of bits_extract.
+ */
+
+static void model_extract(const uint8_t * bytes, size_t offset_in_bits, size_t num_bits, uint8_t * dest) {
+    size_t size = (num_bits + 7) / 8, i;
+
+    memset(dest, 0, size);
+    for (i = 0; i < num_bits; i++) {
+        model_set_bit(dest, size * 8 - num_bits + i, model_get_bit(bytes, offset_in_bits + i));
+    }
+}
+
+/**
+ * \brief Bit-by-bit model of bits_write.
+ */
+
+static void model_write(uint8_t * out, size_t offset_out, const uint8_t * in, size_t offset_in, size_t num_bits) {
+    size_t i;
+
+    for (i = 0; i < num_bits; i++) {
+        model_set_bit(out, offset_out + i, model_get_bit(in, offset_in + i));
+    }
+}
+
+static void fill(uint8_t * bytes, size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i++) bytes[i] = (uint8_t) rand();
+}
+
+static void report(const char * function, size_t offset_out, size_t offset_in, size_t num_bits, stats_t * stats) {
+    if (stats->num_errors++ < 10) {
+        fprintf(stderr, "%s: mismatch (offset_out = %zu, offset_in = %zu, num_bits = %zu)\n",
+            function, offset_out, offset_in, num_bits);
+    }
+}
+
+static void check_extract(stats_t * stats) {
+    size_t    offset   = rand() % MAX_OFFSET,
+              num_bits = 1 + rand() % MAX_NUM_BITS,
+              size_in  = (offset + num_bits + 7) / 8,
+              size     = (num_bits + 7) / 8;
+    uint8_t * in, * dest;
+    uint8_t   expected[MAX_BYTES], former[MAX_BYTES + 1];
+
+    // The input is exactly sized so that an overflow is caught by
+    // sanitizers. The former implementation is given some slack.
+    if (!(in = malloc(size_in))) return;
+    fill(in, size_in);
+    model_extract(in, offset, num_bits, expected);
+    stats->num_cases++;
+
+    // Alternately let bits_extract allocate the output, or pass a
+    // dirty buffer.
+    if (rand() % 2) {
+        dest = bits_extract(in, offset, num_bits, NULL);
+    } else if ((dest = malloc(size))) {
+        memset(dest, 0xa5, size);
+        bits_extract(in, offset, num_bits, dest);
+    }
+
+    if (!dest || memcmp(dest, expected, size)) {
+        report("bits_extract", 0, offset, num_bits, stats);
+    } else if (offset < 8) {
+        // The former implementation may read one byte before and one
+        // byte after the field.
+        uint8_t padded[MAX_BYTES + 2] = { 0 };
+        int     fd;
+
+        memcpy(padded + 1, in, size_in);
+        memset(former, 0, sizeof(former));
+        stats->num_former++;
+        fd = quiet_begin();
+        former_bits_extract(padded + 1, offset, num_bits, former);
+        quiet_end(fd);
+        if (memcmp(former, dest, size)) stats->num_fixed++;
+    }
+
+    free(dest);
+    free(in);
+}
+
+static void check_write(stats_t * stats) {
+    size_t    offset_out = rand() % MAX_OFFSET,
+              offset_in  = rand() % MAX_OFFSET,
+              num_bits   = 1 + rand() % MAX_NUM_BITS,
+              size_out   = (offset_out + num_bits + 7) / 8,
+              size_in    = (offset_in  + num_bits + 7) / 8;
+    uint8_t * in, * out;
+    uint8_t   expected[MAX_BYTES], former[MAX_BYTES + 1], padded[MAX_BYTES + 1] = { 0 };
+    bool      success;
+    int       fd;
+
+    if (!(in = malloc(size_in)))   goto ERR_MALLOC_IN;
+    if (!(out = malloc(size_out))) goto ERR_MALLOC_OUT;
+    fill(in, size_in);
+    fill(out, size_out);
+    memcpy(expected, out, size_out);
+    memcpy(former, out, size_out);
+    model_write(expected, offset_out, in, offset_in, num_bits);
+    stats->num_cases++;
+
+    if (!bits_write(out, offset_out, in, offset_in, num_bits) || memcmp(out, expected, size_out)) {
+        report("bits_write", offset_out, offset_in, num_bits, stats);
+    } else if (offset_out < 8 && offset_in < 8) {
+        memcpy(padded, in, size_in);
+        stats->num_former++;
+        fd = quiet_begin();
+        success = former_bits_write(former, offset_out, padded, offset_in, num_bits);
+        quiet_end(fd);
+        if (!success || memcmp(former, out, size_out)) stats->num_fixed++;
+    }
+
+    free(out);
+ERR_MALLOC_OUT:
+    free(in);
+ERR_MALLOC_IN:
+    return;
+}
+
+static void print_stats(const char * function, const stats_t * stats) {
+    printf("%-12s %zu cases, %zu mismatches, the former implementation differs in %zu/%zu cases\n",
+        function, stats->num_cases, stats->num_errors, stats->num_fixed, stats->num_former);
+}
+
+int main(int argc, char ** argv) {
+    size_t  num_cases = argc > 1 ? strtoul(argv[1], NULL, 10) : NUM_CASES,
+            i;
+    stats_t extract = { 0 },
+            write   = { 0 };
+
+    if ((null_fd = open("/dev/null", O_WRONLY)) < 0) return EXIT_FAILURE;
+    srand(argc > 2 ? strtoul(argv[2], NULL, 10) : 1);
+    for (i = 0; i < num_cases; i++) {
+        check_extract(&extract);
+        check_write(&write);
+    }
+
+    print_stats("bits_extract", &extract);
+    print_stats("bits_write", &write);
+    close(null_fd);
+    return (extract.num_errors || write.num_errors) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
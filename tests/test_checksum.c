@@ -0,0 +1,161 @@
+/**
+ * \file test_checksum.c
+ * \brief Compare the Internet checksum computed by every implementation
+ *    of csum_partial supported by the running CPU with the scalar loop
+ *    that libparistraceroute used before the SIMD implementations
+ *    (see checksum.h).
+ *
+ * Every length from 0 to MAX_SIZE bytes is checked at every offset from 0
+ * to MAX_OFFSET - 1 bytes, on random, all-0x00 and all-0xff buffers, with
+ * and without an initial partial sum. csum_partial_copy is checked along
+ * the way, including the bytes around the copied ones.
+ */
+
+#include <stdlib.h>    // malloc, free, rand
+#include <stdio.h>     // printf, fprintf
+#include <string.h>    // memcmp, memset
+#include <stdint.h>    // uint*_t
+#include <stdbool.h>   // bool
+
+#include "checksum.h"  // csum, csum_partial, csum_partial_copy
+
+#define MAX_SIZE     1600 // Larger than an Ethernet frame
+#define MAX_OFFSET   32
+#define MARGIN       64   // Bytes checked around the copied bytes
+#define BIG_SIZE     65535
+
+typedef enum {
+    PATTERN_RANDOM,
+    PATTERN_ZEROS,
+    PATTERN_ONES,
+    NUM_PATTERNS
+} pattern_t;
+
+static const char * implementations[] = { "word", "sse2", "avx2", "neon" };
+
+/**
+ * \brief Reference implementation: the scalar loop of csum_partial
+ *    (protocol.c) before it moved to checksum.c.
+ * \param bytes Bytes to add.
+ * \param size Number of bytes to consider.
+ * \param sum The partial sum.
+ * \return The updated partial sum.
+ */
+
+static uint32_t scalar_csum_partial(const void * bytes, size_t size, uint32_t sum) {
+    const uint16_t * words = bytes;
+
+    while (size > 1) {
+        sum += *words++;
+        size -= sizeof(uint16_t);
+    }
+    if (size) {
+        sum += * (const uint8_t *) words;
+    }
+    return sum;
+}
+
+static uint16_t scalar_csum(const void * bytes, size_t size, uint32_t sum) {
+    return (uint16_t) ~csum_fold(scalar_csum_partial(bytes, size, sum));
+}
+
+static void fill(uint8_t * bytes, size_t size, pattern_t pattern) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        switch (pattern) {
+            case PATTERN_RANDOM: bytes[i] = (uint8_t) rand(); break;
+            case PATTERN_ZEROS:  bytes[i] = 0x00;             break;
+            default:             bytes[i] = 0xff;             break;
+        }
+    }
+}
+
+/**
+ * \brief Check the implementation currently used by csum_partial on
+ *    a given buffer.
+ * \param src The checksummed bytes.
+ * \param dst A buffer of size + 2 * MARGIN bytes used to check
+ *    csum_partial_copy.
+ * \param size Number of bytes to consider.
+ * \param sum The initial partial sum.
+ * \return true iif every result matches the reference implementation.
+ */
+
+static bool check(const uint8_t * src, uint8_t * dst, size_t size, uint32_t sum) {
+    uint16_t expected = scalar_csum(src, size, sum);
+    bool     ret = true;
+    size_t   i;
+
+    if (sum == 0 && csum((const uint16_t *) src, size) != expected) ret = false;
+    if ((uint16_t) ~csum_fold(csum_partial(src, size, sum)) != expected) ret = false;
+
+    memset(dst, 0xa5, size + 2 * MARGIN);
+    if ((uint16_t) ~csum_fold(csum_partial_copy(dst + MARGIN, src, size, sum)) != expected) ret = false;
+    if (memcmp(dst + MARGIN, src, size)) ret = false;
+    for (i = 0; i < MARGIN; i++) {
+        if (dst[i] != 0xa5 || dst[MARGIN + size + i] != 0xa5) ret = false;
+    }
+    return ret;
+}
+
+int main() {
+    uint8_t      * src, * dst;
+    size_t         i, size, offset,
+                   num_cases = 0, num_errors = 0;
+    pattern_t      pattern;
+    const uint32_t sums[] = { 0, 0x1234abcd };
+    size_t         j;
+
+    if (!(src = malloc(BIG_SIZE + MAX_OFFSET)))  goto ERR_MALLOC_SRC;
+    if (!(dst = malloc(BIG_SIZE + 2 * MARGIN))) goto ERR_MALLOC_DST;
+    srand(1071);
+
+    for (i = 0; i < sizeof(implementations) / sizeof(implementations[0]); i++) {
+        if (!csum_set_implementation(implementations[i])) {
+            printf("%s: not supported by this CPU, skipped\n", implementations[i]);
+            continue;
+        }
+
+        for (pattern = 0; pattern < NUM_PATTERNS; pattern++) {
+            for (size = 0; size <= MAX_SIZE; size++) {
+                for (offset = 0; offset < MAX_OFFSET; offset++) {
+                    fill(src + offset, size, pattern);
+                    for (j = 0; j < sizeof(sums) / sizeof(sums[0]); j++) {
+                        num_cases++;
+                        if (!check(src + offset, dst, size, sums[j])) {
+                            if (num_errors++ < 10) {
+                                fprintf(stderr, "%s: mismatch (size = %zu, offset = %zu, pattern = %d, sum = %x)\n",
+                                    implementations[i], size, offset, pattern, sums[j]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // All-0xff buffers as large as an IP packet may overflow the
+        // accumulators of the vectorized implementations.
+        for (size = BIG_SIZE - 1024; size <= BIG_SIZE; size += 127) {
+            fill(src, size, PATTERN_ONES);
+            num_cases++;
+            if (!check(src, dst, size, 0)) {
+                if (num_errors++ < 10) {
+                    fprintf(stderr, "%s: mismatch (size = %zu, all 0xff)\n", implementations[i], size);
+                }
+            }
+        }
+        printf("%s: checked\n", implementations[i]);
+    }
+
+    printf("%zu cases, %zu mismatches\n", num_cases, num_errors);
+    free(dst);
+    free(src);
+    return num_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+
+ERR_MALLOC_DST:
+    free(src);
+ERR_MALLOC_SRC:
+    fprintf(stderr, "test_checksum: not enough memory\n");
+    return EXIT_FAILURE;
+}
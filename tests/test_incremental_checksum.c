@@ -0,0 +1,294 @@
+/**
+ * \file test_incremental_checksum.c
+ * \brief Compare the checksums updated incrementally when a field of a
+ *    probe is rewritten (see probe_rewrite_field_handle, probe_rewrite_bytes,
+ *    probe_rewrite_fields, probe_rewrite_flow_id) with the checksums
+ *    recomputed over the whole packet by probe_update_checksum.
+ *
+ * Each probe (UDP, TCP and ICMP over IPv4 and IPv6, with payloads of
+ * various sizes) is rewritten NUM_REWRITES times: TTL, IP addresses,
+ * flow-id, tag (16 least and most significant bits of a wide tag) and
+ * payload bytes, as traceroute, mda and network_tag_probe do. The bytes of the packet must
+ * remain unchanged when probe_update_checksum is called afterwards.
+ *
+ * csum_adjust is checked on random buffers, and the pseudo header sums
+ * (get_pseudo_header_sum) are compared with the sums of the pseudo headers
+ * built by create_pseudo_header.
+ */
+
+#include <stdlib.h>         // malloc, free, rand
+#include <stdio.h>          // printf, fprintf
+#include <string.h>         // memcmp, memcpy
+#include <stdint.h>         // uint*_t
+#include <stdbool.h>        // bool
+
+#include "buffer.h"         // buffer_t
+#include "checksum.h"       // csum, csum_partial, csum_fold, csum_adjust
+#include "field.h"          // FIELD_I8, FIELD_I16
+#include "field_handle.h"   // FIELD_HANDLE
+#include "packet.h"         // packet_get_bytes, packet_get_size
+#include "probe.h"          // probe_t, probe_rewrite_*
+#include "protocol.h"       // protocol_t
+#include "protocol_field.h" // protocol_field_t
+
+#define NUM_REWRITES       2000 // Rewrites per probe
+#define NUM_ADJUSTS      100000 // Random cases of csum_adjust
+#define MAX_BUFFER_SIZE    1500
+#define MAX_REWRITE_SIZE     64 // See PROBE_REWRITE_MAX_BYTES (probe.c)
+
+typedef struct {
+    const char * network;
+    const char * transport;
+} skeleton_t;
+
+static const skeleton_t skeletons[] = {
+    { "ipv4", "udp"    },
+    { "ipv4", "tcp"    },
+    { "ipv4", "icmpv4" },
+    { "ipv6", "udp"    },
+    { "ipv6", "tcp"    },
+    { "ipv6", "icmpv6" }
+};
+
+static const size_t payload_sizes[] = { 2, 3, 4, 33, 1400 };
+
+typedef enum {
+    REWRITE_TTL,
+    REWRITE_SRC_IP,
+    REWRITE_DST_IP,
+    REWRITE_FLOW_ID,
+    REWRITE_TAG,
+    REWRITE_TAG_HIGH,
+    REWRITE_PAYLOAD,
+    NUM_REWRITE_TYPES
+} rewrite_t;
+
+static const char * rewrite_names[] = {
+    "ttl", "src_ip", "dst_ip", "flow_id", "tag", "tag_high", "payload"
+};
+
+static size_t num_cases  = 0,
+              num_errors = 0;
+
+static void fill(uint8_t * bytes, size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        bytes[i] = (uint8_t) rand();
+    }
+}
+
+static void report(const char * fmt, const char * name, size_t payload_size, const char * what) {
+    if (num_errors++ < 10) {
+        fprintf(stderr, fmt, name, payload_size, what);
+    }
+}
+
+/**
+ * \brief Check csum_adjust on random buffers: some aligned words of a
+ *    buffer are modified, and the adjusted checksum is compared with
+ *    the checksum of the whole modified buffer.
+ */
+
+static void check_csum_adjust() {
+    uint8_t  buffer[MAX_BUFFER_SIZE], old_bytes[MAX_REWRITE_SIZE];
+    size_t   i, size, offset, num_bytes;
+    uint16_t checksum, old_sum, new_sum;
+
+    for (i = 0; i < NUM_ADJUSTS; i++) {
+        size      = 2 * (1 + rand() % (MAX_BUFFER_SIZE / 2));
+        num_bytes = 2 * (1 + rand() % (MAX_REWRITE_SIZE / 2));
+        if (num_bytes > size) num_bytes = size;
+        offset    = 2 * (rand() % ((size - num_bytes) / 2 + 1));
+
+        fill(buffer, size);
+        checksum = csum((const uint16_t *) buffer, size);
+        memcpy(old_bytes, buffer + offset, num_bytes);
+        fill(buffer + offset, num_bytes);
+        old_sum = csum_fold(csum_partial(old_bytes, num_bytes, 0));
+        new_sum = csum_fold(csum_partial(buffer + offset, num_bytes, 0));
+
+        num_cases++;
+        if (csum_adjust(checksum, old_sum, new_sum) != csum((const uint16_t *) buffer, size)) {
+            if (num_errors++ < 10) {
+                fprintf(stderr, "csum_adjust: mismatch (size = %zu, offset = %zu, num_bytes = %zu)\n", size, offset, num_bytes);
+            }
+        }
+    }
+    printf("csum_adjust: checked\n");
+}
+
+/**
+ * \brief Compare the pseudo header sum of the transport layer of a probe
+ *    with the sum of the pseudo header built by create_pseudo_header.
+ * \param probe The probe.
+ * \param name The name of the probe (for error messages).
+ */
+
+static void check_pseudo_header_sum(const probe_t * probe, const char * name) {
+    const layer_t * network_layer   = probe_get_layer(probe, 0),
+                  * transport_layer = probe_get_layer(probe, 1);
+    buffer_t      * pseudo_header;
+    uint16_t        expected;
+
+    if (!transport_layer->protocol->get_pseudo_header_sum) return;
+
+    num_cases++;
+    if (!(pseudo_header = transport_layer->protocol->create_pseudo_header(network_layer->segment))) {
+        report("%s (payload: %zu bytes): cannot create the %s pseudo header\n", name, probe_get_payload_size(probe), transport_layer->protocol->name);
+        return;
+    }
+    expected = csum_fold(csum_partial(buffer_get_data(pseudo_header), buffer_get_size(pseudo_header), 0));
+    if (transport_layer->protocol->get_pseudo_header_sum(network_layer->segment) != expected) {
+        report("%s (payload: %zu bytes): %s pseudo header sum mismatch\n", name, probe_get_payload_size(probe), transport_layer->protocol->name);
+    }
+    buffer_free(pseudo_header);
+}
+
+/**
+ * \brief Rewrite a field of a probe, as traceroute, mda or
+ *    network_tag_probe do.
+ * \param probe The probe, whose checksums are up to date.
+ * \param rewrite The rewritten field.
+ * \return true iif successful, false if this field cannot be rewritten
+ *    in this probe.
+ */
+
+static bool rewrite_probe(probe_t * probe, rewrite_t rewrite) {
+    static field_handle_t    ttl_handle = FIELD_HANDLE("ttl", 0);
+    const layer_t          * network_layer   = probe_get_layer(probe, 0),
+                           * transport_layer = probe_get_layer(probe, 1);
+    const protocol_field_t * body_field;
+    bool                     is_ipv4 = (strcmp(network_layer->protocol->name, "ipv4") == 0);
+    uint8_t                  bytes[MAX_REWRITE_SIZE],
+                             ttl = 1 + rand() % 255;
+    size_t                   payload_size = probe_get_payload_size(probe),
+                             offset, num_bytes;
+    field_t                  field = {
+        .key        = "ttl",
+        .value.int8 = ttl,
+        .type       = TYPE_UINT8
+    };
+
+    switch (rewrite) {
+        case REWRITE_TTL:
+            return rand() % 2 ?
+                probe_rewrite_field_handle(probe, &ttl_handle, &field) :
+                probe_rewrite_fields(probe, FIELD_I8("ttl", ttl), NULL);
+        case REWRITE_SRC_IP:
+        case REWRITE_DST_IP:
+            // See struct iphdr and struct ip6_hdr
+            num_bytes = is_ipv4 ? 4 : 16;
+            offset = (is_ipv4 ? 12 : 8) + (rewrite == REWRITE_DST_IP ? num_bytes : 0);
+            fill(bytes, num_bytes);
+            return probe_rewrite_bytes(probe, 0, offset, bytes, num_bytes);
+        case REWRITE_FLOW_ID:
+            // The flow-id metafield only exists in UDP and TCP probes
+            if (strcmp(transport_layer->protocol->name, "udp")
+            &&  strcmp(transport_layer->protocol->name, "tcp")) return false;
+            return probe_rewrite_flow_id(probe, rand() % 1000);
+        case REWRITE_TAG:
+            // See network_tag_probe
+            fill(bytes, sizeof(uint16_t));
+            if ((body_field = protocol_get_field(transport_layer->protocol, "body"))) {
+                return probe_rewrite_bytes(probe, 1, body_field->offset, bytes, sizeof(uint16_t));
+            }
+            return probe_rewrite_bytes(probe, 2, 0, bytes, sizeof(uint16_t));
+        case REWRITE_TAG_HIGH:
+            // See probe_set_tag_high
+            if (is_ipv4) {
+                return probe_rewrite_fields(probe, FIELD_I16("identification", rand()), NULL);
+            }
+            if (payload_size < 2 * sizeof(uint16_t)) return false;
+            fill(bytes, sizeof(uint16_t));
+            return probe_rewrite_bytes(probe, probe_get_num_layers(probe) - 1, sizeof(uint16_t), bytes, sizeof(uint16_t));
+        case REWRITE_PAYLOAD:
+            offset    = rand() % payload_size;
+            num_bytes = 1 + rand() % MAX_REWRITE_SIZE;
+            if (num_bytes > payload_size - offset) num_bytes = payload_size - offset;
+            fill(bytes, num_bytes);
+            return probe_rewrite_bytes(probe, probe_get_num_layers(probe) - 1, offset, bytes, num_bytes);
+        default:
+            return false;
+    }
+}
+
+/**
+ * \brief Rewrite the fields of a probe and check its checksums after
+ *    each rewrite.
+ * \param skeleton The protocols of the probe.
+ * \param payload_size The size of the payload of the probe.
+ * \return true iif the probe has been created.
+ */
+
+static bool check_probe(const skeleton_t * skeleton, size_t payload_size) {
+    probe_t   * probe;
+    uint8_t   * bytes;
+    size_t      i, size;
+    rewrite_t   rewrite;
+    char        name[32];
+    bool        ret = false;
+
+    snprintf(name, sizeof(name), "%s/%s", skeleton->network, skeleton->transport);
+
+    if (!(probe = probe_create()))                                                 goto ERR_PROBE_CREATE;
+    if (!probe_set_protocols(probe, skeleton->network, skeleton->transport, NULL)) goto ERR_PROBE;
+    if (!probe_payload_resize(probe, payload_size))                                goto ERR_PROBE;
+    if (!probe_update_fields(probe))                                               goto ERR_PROBE;
+
+    size = packet_get_size(probe->packet);
+    if (!(bytes = malloc(size))) goto ERR_PROBE;
+
+    for (i = 0; i < NUM_REWRITES; i++) {
+        rewrite = rand() % NUM_REWRITE_TYPES;
+        if (!rewrite_probe(probe, rewrite)) {
+            // Some probes have no flow-id, or a too short payload
+            if (rewrite == REWRITE_FLOW_ID || rewrite == REWRITE_TAG_HIGH) continue;
+            report("%s (payload: %zu bytes): cannot rewrite %s\n", name, payload_size, rewrite_names[rewrite]);
+            break;
+        }
+
+        // The checksums must not change once recomputed
+        num_cases++;
+        memcpy(bytes, packet_get_bytes(probe->packet), size);
+        if (!probe_update_checksum(probe)) {
+            report("%s (payload: %zu bytes): cannot update the checksums after a %s rewrite\n", name, payload_size, rewrite_names[rewrite]);
+            break;
+        }
+        if (memcmp(bytes, packet_get_bytes(probe->packet), size)) {
+            report("%s (payload: %zu bytes): %s rewrite mismatch\n", name, payload_size, rewrite_names[rewrite]);
+        }
+
+        if (rewrite == REWRITE_SRC_IP || rewrite == REWRITE_DST_IP) {
+            check_pseudo_header_sum(probe, name);
+        }
+    }
+    ret = true;
+
+    free(bytes);
+ERR_PROBE:
+    probe_free(probe);
+ERR_PROBE_CREATE:
+    return ret;
+}
+
+int main() {
+    size_t i, j;
+
+    srand(1624);
+    check_csum_adjust();
+
+    for (i = 0; i < sizeof(skeletons) / sizeof(skeletons[0]); i++) {
+        for (j = 0; j < sizeof(payload_sizes) / sizeof(payload_sizes[0]); j++) {
+            if (!check_probe(&skeletons[i], payload_sizes[j])) {
+                fprintf(stderr, "test_incremental_checksum: cannot create the %s/%s probe\n",
+                    skeletons[i].network, skeletons[i].transport);
+                return EXIT_FAILURE;
+            }
+        }
+        printf("%s/%s: checked\n", skeletons[i].network, skeletons[i].transport);
+    }
+
+    printf("%zu cases, %zu mismatches\n", num_cases, num_errors);
+    return num_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
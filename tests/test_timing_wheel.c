@@ -0,0 +1,166 @@
+/**
+ * \file test_timing_wheel.c
+ * \brief Drive a timing wheel (see timing_wheel.h) as pt_loop does: the
+ *    wheel is advanced to the deadline returned by
+ *    timing_wheel_get_next_deadline, and the fired timers schedule or
+ *    cancel other timers.
+ *
+ * Each timer must fire at the tick of its deadline (or at the next tick
+ * if this deadline has already been processed), neither earlier nor later,
+ * and cancelled timers must never fire. A wake-up firing no timer must
+ * cascade upper slots, and thus happen at the first tick of a slot of the
+ * second level.
+ */
+
+#include <stdlib.h>         // rand
+#include <stdio.h>          // printf, fprintf
+#include <stdint.h>         // uint64_t
+#include <stdbool.h>        // bool
+#include <math.h>           // ceil
+
+#include "timing_wheel.h"   // timing_wheel_t
+
+#define NUM_TIMERS      20000   // Timers scheduled during the test
+#define NUM_INITIAL     1000    // Timers scheduled before the first wake-up
+#define MAX_DELAY_BITS  23      // Delays are drawn in [0, 2^MAX_DELAY_BITS) ticks
+
+typedef struct {
+    timing_wheel_node_t node;
+    double              tick;      /**< Tick at which this timer must fire */
+    bool                is_cancelled;
+} timer_t_;
+
+typedef struct {
+    timing_wheel_t * wheel;
+    timer_t_       * timers;
+    size_t           num_scheduled; /**< Timers scheduled so far */
+    double           now;           /**< Current timestamp */
+    double           next_tick;     /**< First tick not yet processed by the wheel */
+    size_t           num_fired;
+    size_t           num_errors;
+} context_t;
+
+/**
+ * \brief Draw a delay (in ticks) whose order of magnitude is uniform,
+ *    so that every level of the wheel is used.
+ * \return The delay.
+ */
+
+static double draw_delay() {
+    uint64_t delay = ((uint64_t) rand() << 16 | (rand() & 0xffff)) & ((1 << (rand() % (MAX_DELAY_BITS + 1))) - 1);
+
+    // Deadlines are not aligned on ticks half of the time
+    return delay + (rand() % 2 ? 0.5 : 0);
+}
+
+/**
+ * \brief Schedule the next timer.
+ * \param context The context of the test.
+ */
+
+static void schedule(context_t * context) {
+    timer_t_ * timer    = &context->timers[context->num_scheduled++];
+    double     deadline = context->now + draw_delay();
+
+    // A deadline which has already been processed fires at the next tick
+    timer->tick         = ceil(deadline) < context->next_tick ? context->next_tick : ceil(deadline);
+    timer->is_cancelled = false;
+    timing_wheel_node_init(&timer->node);
+    timing_wheel_add(context->wheel, &timer->node, deadline, timer);
+}
+
+/**
+ * \brief Callback of the fired timers: check the tick, then cancel
+ *    and schedule other timers.
+ * \param element The fired timer.
+ * \param param The context of the test.
+ */
+
+static void on_fire(void * element, void * param) {
+    timer_t_  * timer   = element,
+              * victim;
+    context_t * context = param;
+    size_t      i;
+
+    context->num_fired++;
+    if (timer->is_cancelled || timer->tick != context->now) {
+        if (context->num_errors++ < 10) {
+            fprintf(stderr, "timer %zu: expected at %.0f, fired at %.0f%s\n",
+                (size_t) (timer - context->timers), timer->tick, context->now,
+                timer->is_cancelled ? " (cancelled)" : "");
+        }
+    }
+
+    // Cancel a timer once in a while
+    if (rand() % 10 == 0) {
+        victim = &context->timers[rand() % context->num_scheduled];
+        if (timing_wheel_node_is_scheduled(&victim->node)) {
+            timing_wheel_del(context->wheel, &victim->node);
+            victim->is_cancelled = true;
+        }
+    }
+
+    for (i = 0; i < 2 && context->num_scheduled < NUM_TIMERS; i++) {
+        schedule(context);
+    }
+}
+
+int main() {
+    context_t context = {
+        .num_scheduled = 0,
+        .now           = 0,
+        .next_tick     = 0,
+        .num_fired     = 0,
+        .num_errors    = 0
+    };
+    size_t    num_cancelled = 0,
+              num_wakeups = 0,
+              num_idle_wakeups = 0,
+              i;
+    double    deadline;
+
+    srand(4217);
+    if (!(context.timers = calloc(NUM_TIMERS, sizeof(timer_t_))))    goto ERR_CALLOC;
+    if (!(context.wheel = timing_wheel_create(1, context.now)))      goto ERR_TIMING_WHEEL_CREATE;
+
+    for (i = 0; i < NUM_INITIAL; i++) {
+        schedule(&context);
+    }
+
+    while (timing_wheel_get_next_deadline(context.wheel, &deadline)) {
+        if (deadline < context.now) {
+            fprintf(stderr, "next deadline %.0f is in the past (now = %.0f)\n", deadline, context.now);
+            context.num_errors++;
+            break;
+        }
+        context.now = deadline;
+        context.next_tick = deadline + 1;
+        num_wakeups++;
+        if (timing_wheel_advance(context.wheel, context.now, on_fire, &context) == 0) {
+            num_idle_wakeups++;
+            if ((uint64_t) context.now % TIMING_WHEEL_NUM_SLOTS && context.num_errors++ < 10) {
+                fprintf(stderr, "wake-up at %.0f: no timer fired, no slot cascaded\n", context.now);
+            }
+        }
+    }
+
+    for (i = 0; i < context.num_scheduled; i++) {
+        if (context.timers[i].is_cancelled) num_cancelled++;
+    }
+    if (context.num_fired + num_cancelled != context.num_scheduled) {
+        fprintf(stderr, "%zu timers scheduled, %zu fired, %zu cancelled\n", context.num_scheduled, context.num_fired, num_cancelled);
+        context.num_errors++;
+    }
+    printf("%zu timers, %zu wake-ups (%zu without any fired timer)\n", context.num_scheduled, num_wakeups, num_idle_wakeups);
+    printf("%zu cases, %zu mismatches\n", context.num_scheduled, context.num_errors);
+
+    timing_wheel_free(context.wheel);
+    free(context.timers);
+    return context.num_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+
+ERR_TIMING_WHEEL_CREATE:
+    free(context.timers);
+ERR_CALLOC:
+    fprintf(stderr, "test_timing_wheel: cannot create the timing wheel\n");
+    return EXIT_FAILURE;
+}
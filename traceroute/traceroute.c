@@ -42,8 +42,8 @@ void loop_handler(pt_loop_t * loop, event_t * event, void * user_data)
             break;
     }
 
-    // Release the event, its nested traceroute_event (if any), its attached probe and reply (if any)
-    //event_free(event); // TODO this may provoke seg fault in case of stars
+    // The loop releases the event, its nested traceroute_event (if any), its
+    // attached probe and reply (if any) once this handler returns
 }
 
 /**
@@ -125,7 +125,7 @@ int main(int argc, char ** argv)
     if (strncmp("icmp", protocol_name, 4) != 0) {
         probe_write_payload(probe, "\0\0\0\0", 4);
     } else {
-        probe_set_field(probe, I32("body", 1));
+        probe_set_uint32(probe, "body", 1);
     }
 
     probe_set_fields(probe,